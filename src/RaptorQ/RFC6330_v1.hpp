@@ -22,6 +22,7 @@
 
 #include "RaptorQ/v1/common.hpp"
 #include "RaptorQ/v1/caches.hpp"
+#include "RaptorQ/v1/stats.hpp"
 #include "RaptorQ/v1/wrapper/CPP_RFC_API.hpp"
 #include "RaptorQ/v1/wrapper/CPP_RFC_API_void.hpp"
 #include "RaptorQ/v1/Thread_Pool.hpp"
@@ -22,6 +22,7 @@
 
 #define RQ_HEADER_ONLY
 #include "RaptorQ/v1/caches.ipp"
+#include "RaptorQ/v1/stats.ipp"
 #include "RaptorQ/v1/RFC.hpp"
 #include "RaptorQ/v1/Thread_Pool.hpp"
 
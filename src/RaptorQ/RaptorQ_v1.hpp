@@ -21,6 +21,7 @@
 #pragma once
 
 #include "RaptorQ/v1/caches.hpp"
+#include "RaptorQ/v1/stats.hpp"
 #include "RaptorQ/v1/wrapper/CPP_RAW_API.hpp"
 #include "RaptorQ/v1/wrapper/CPP_RAW_API_void.hpp"
 
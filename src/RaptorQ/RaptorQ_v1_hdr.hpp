@@ -22,5 +22,6 @@
 
 #define RQ_HEADER_ONLY
 #include "RaptorQ/v1/caches.ipp"
+#include "RaptorQ/v1/stats.ipp"
 #include "RaptorQ/v1/RaptorQ.hpp"
 
@@ -23,6 +23,11 @@
 #include "RaptorQ/v1/common.hpp"
 #include "RaptorQ/v1/Decoder.hpp"
 #include "RaptorQ/v1/Interleaver.hpp"
+#include "RaptorQ/v1/Operation.hpp"
+#include "RaptorQ/v1/util/bulk_copy.hpp"
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
 
 namespace RFC6330__v1 {
 namespace Impl {
@@ -37,11 +42,10 @@ public:
     De_Interleaver (De_Interleaver&&) = default;
     De_Interleaver& operator= (De_Interleaver &&) = default;
     De_Interleaver (const RaptorQ__v1::Impl::DenseMtx *symbols,
-                                                    const Partition sub_blocks,
-                                                    const uint16_t max_esi,
-                                                    const uint8_t alignment)
-        :_symbols (symbols), _sub_blocks (sub_blocks), _max_esi (max_esi),
-                                                                _al (alignment)
+                                                const Sub_Block_Plan *plan,
+                                                const uint16_t max_esi,
+                                                const uint8_t alignment)
+        :_symbols (symbols), _plan (plan), _max_esi (max_esi), _al (alignment)
     {
         IS_FORWARD(Fwd_It, "RaptorQ__v1::Impl::De_Interleaver");
     }
@@ -51,84 +55,136 @@ public:
                                     const std::vector<bool> &real_syms) const;
 private:
     const RaptorQ__v1::Impl::DenseMtx *_symbols;
-    const Partition _sub_blocks;
+    const Sub_Block_Plan *_plan;
     const uint16_t _max_esi;
     const uint8_t _al;
+
+    template <typename Copy>
+    size_t walk (const size_t max_bytes, const uint16_t from_esi,
+                                                            Copy &&copy) const;
+    size_t write (Fwd_It &start, const Fwd_It end, const size_t max_bytes,
+                                            const uint8_t skip,
+                                            const uint16_t from_esi,
+                                            const std::true_type contiguous);
+    size_t write (Fwd_It &start, const Fwd_It end, const size_t max_bytes,
+                                            const uint8_t skip,
+                                            const uint16_t from_esi,
+                                            const std::false_type contiguous);
 };
 
+// The block is: all the sub-symbols of the first sub-block, in esi order,
+// then all the sub-symbols of the second sub-block and so on.
+// Feed "copy" with each run of contiguous bytes, in that order.
+// "copy" returns how much it could take, stop when it's less than the run.
+template <typename Fwd_It>
+template <typename Copy>
+size_t De_Interleaver<Fwd_It>::walk (const size_t max_bytes,
+                                                    const uint16_t from_esi,
+                                                    Copy &&copy) const
+{
+    size_t done = 0;
+    uint16_t esi = from_esi;
+    for (const auto &run : _plan->runs()) {
+        const size_t offset = run.offset * _al;
+        const size_t size = run.size * _al;
+        for (; esi < _max_esi; ++esi) {
+            if (done == max_bytes)
+                return done;
+            const size_t len = std::min (size, max_bytes - done);
+            const size_t copied = copy (RaptorQ__v1::Impl::row_ptr (*_symbols,
+                                                        esi) + offset, len);
+            done += copied;
+            if (copied != len)
+                return done;
+        }
+        esi = 0;
+    }
+    return done;
+}
+
 template <typename Fwd_It>
 size_t De_Interleaver<Fwd_It>::operator() (Fwd_It &start, const Fwd_It end,
                                                     const size_t max_bytes,
                                                     const uint8_t skip,
                                                     const uint16_t from_esi)
 {
+    // return number of BYTES written
     if (start == end)
         return 0;
-    // return number of BYTES written
-    size_t written = 0;
-    int32_t byte = 0;
-    uint32_t subsym_byte = 0;
-    uint16_t esi = from_esi;
-    uint16_t sub_blk = 0;
-    uint16_t sub_sym_size = _al *(_sub_blocks.num(0) > 0 ? _sub_blocks.size(0) :
-                                                      _sub_blocks.size(1));
     // if the Fwd_It::value_type is not aligned with the block size,
     // we need to skip a certain amount of data in the first output element
     // so that we do not overwrite the old data or add unnecessary zeros
     // to (start-1) during the decoding of the previous block.
-    uint8_t offset_al = skip;
+    assert (skip < sizeof(typename std::iterator_traits<Fwd_It>::value_type)
+                                            && "De_Interleaver: skip too big");
+    return write (start, end, max_bytes, skip, from_esi,
+                                RaptorQ__v1::Impl::is_contiguous<Fwd_It>());
+}
+
+template <typename Fwd_It>
+size_t De_Interleaver<Fwd_It>::write (Fwd_It &start, const Fwd_It end,
+                                                    const size_t max_bytes,
+                                                    const uint8_t skip,
+                                                    const uint16_t from_esi,
+                                                    const std::true_type)
+{
+    // contiguous output: copy the runs straight into it.
     using T = typename std::iterator_traits<Fwd_It>::value_type;
-    T element = static_cast<T> (0);
-    if (skip != 0) {
-        assert (skip < sizeof(T) && "De_Interleaver: skip too big");
-        uint8_t *p = reinterpret_cast<uint8_t *> (&*start);
-        for (size_t keep = 0; keep < skip; ++keep) {
-            element += static_cast<T> (*(p++)) << keep * 8;
-        }
-    }
-    while ((start != end && sub_blk < (_sub_blocks.num(0) + _sub_blocks.num(1)))
-                            && (written + offset_al) < (max_bytes + skip)) {
-        element += static_cast<T> (static_cast<uint8_t>((*_symbols)(esi, byte)))
-                                                            << offset_al * 8;
-        ++offset_al;
-        if (offset_al == sizeof(T)) {
-            *start = element;
-            ++start;
-            written += sizeof(T);
-            element = static_cast<T> (0);
-            offset_al = 0;
-        }
-        ++byte;
-        ++subsym_byte;
-        if (subsym_byte == sub_sym_size) {
-            subsym_byte = 0;
-            ++esi;
-            if (esi >= _max_esi) {
-                esi = 0;
-                ++sub_blk;
-            }
-            if (sub_blk < _sub_blocks.num (0)) {
-                sub_sym_size = _sub_blocks.size (0) * _al;
-                byte = sub_sym_size * sub_blk;
-            } else {
-                sub_sym_size = _sub_blocks.size (1) * _al;
-                byte = _sub_blocks.tot (0) * _al +
-                                sub_sym_size * (sub_blk - _sub_blocks.num (0));
-            }
-        }
-    }
+    const size_t room = static_cast<size_t> (end - start) * sizeof(T) - skip;
+    uint8_t *out = reinterpret_cast<uint8_t *> (&*start) + skip;
+    const size_t written = walk (std::min (room, max_bytes), from_esi,
+                        [&out] (const uint8_t *src, const size_t len) -> size_t
+                        {
+                            std::memcpy (out, src, len);
+                            out += len;
+                            return len;
+                        });
+    // a half-written element is still consumed
+    start += static_cast<typename std::iterator_traits<Fwd_It>::difference_type>
+                            ((skip + written + sizeof(T) - 1) / sizeof(T));
+    return written;
+}
+
+template <typename Fwd_It>
+size_t De_Interleaver<Fwd_It>::write (Fwd_It &start, const Fwd_It end,
+                                                    const size_t max_bytes,
+                                                    const uint8_t skip,
+                                                    const uint16_t from_esi,
+                                                    const std::false_type)
+{
+    // build each element in a buffer, then assign it
+    using T = typename std::iterator_traits<Fwd_It>::value_type;
+    uint8_t element[sizeof(T)];
+    size_t offset_al = skip;
+    if (skip != 0)
+        std::memcpy (element, &*start, skip);
+    const size_t written = walk (max_bytes, from_esi,
+                [&] (const uint8_t *src, const size_t len) -> size_t
+                {
+                    size_t copied = 0;
+                    while (copied < len && start != end) {
+                        const size_t bytes = std::min (len - copied,
+                                                        sizeof(T) - offset_al);
+                        std::memcpy (element + offset_al, src + copied, bytes);
+                        offset_al += bytes;
+                        copied += bytes;
+                        if (offset_al == sizeof(T)) {
+                            T val;
+                            std::memcpy (&val, element, sizeof(T));
+                            *start = val;
+                            ++start;
+                            offset_al = 0;
+                        }
+                    }
+                    return copied;
+                });
     assert(!(start == end && offset_al != 0) && "De_Interleaver: can't write");
     if (start != end && offset_al != 0) {
         // we have more stuff in "element", but not enough to fill
         // the iterator. Do not overwrite additional data of the iterator.
-        uint8_t *out = reinterpret_cast<uint8_t *> (&*start);
-        uint8_t *in = reinterpret_cast<uint8_t *> (&element);
-        for (size_t idx = 0; idx < offset_al; ++idx, ++out, ++in)
-            *out = *in;
+        std::memcpy (&*start, element, offset_al);
         ++start;
-        written += offset_al;
     }
-    written -= skip;
     assert (written <= max_bytes && "De_Interleaver: too much writing");
     return written;
 }
@@ -177,31 +233,16 @@ std::vector<bool> De_Interleaver<Fwd_It>::symbols_to_bytes (
 
     ret.resize (block_bytes, false);
 
-    uint32_t byte = 0;
-    uint32_t subsym_byte = 0;
-    uint16_t esi = 0;
-    uint16_t sub_blk = 0;
-    uint16_t sub_sym_size = _al *(_sub_blocks.num(0) > 0 ? _sub_blocks.size(0) :
-                                                      _sub_blocks.size(1));
-    bool we_have_current_symbol = real_syms[esi];
-
-    while (byte != block_bytes) {
-        ret[byte] = we_have_current_symbol;
-        ++byte;
-        ++subsym_byte;
-        if (subsym_byte == sub_sym_size) {
-            subsym_byte = 0;
-            ++esi;
-            we_have_current_symbol = real_syms[esi];
-            if (esi >= _max_esi) {
-                esi = 0;
-                ++sub_blk;
-            }
-            if (sub_blk < _sub_blocks.num (0)) {
-                sub_sym_size = _sub_blocks.size (0) * _al;
-            } else {
-                sub_sym_size = _sub_blocks.size (1) * _al;
+    size_t byte = 0;
+    for (const auto &run : _plan->runs()) {
+        const size_t size = run.size * _al;
+        for (uint16_t esi = 0; esi < _max_esi && byte < block_bytes; ++esi) {
+            const size_t len = std::min (size, block_bytes - byte);
+            if (real_syms[esi]) {
+                std::fill_n (ret.begin() + static_cast<std::ptrdiff_t> (byte),
+                                                                len, true);
             }
+            byte += len;
         }
     }
     return ret;
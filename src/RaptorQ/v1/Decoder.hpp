@@ -26,9 +26,16 @@
 #include "RaptorQ/v1/Parameters.hpp"
 #include "RaptorQ/v1/Precode_Matrix.hpp"
 #include "RaptorQ/v1/Shared_Computation/Decaying_LF.hpp"
+#include "RaptorQ/v1/Shared_Computation/Op_Cache.hpp"
+#include "RaptorQ/v1/Shared_Computation/Stats_Registry.hpp"
 #include "RaptorQ/v1/Thread_Pool.hpp"
 #include "RaptorQ/v1/util/Bitmask.hpp"
+#include "RaptorQ/v1/util/bulk_copy.hpp"
 #include "RaptorQ/v1/util/Graph.hpp"
+#include "RaptorQ/v1/util/tracepoints.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
 #include <memory>
 #include <mutex>
 #include <random>
@@ -42,21 +49,139 @@ namespace RaptorQ__v1 {
 
 namespace Impl {
 
+// Per-thread decoding workspace.
+// The precode matrix (with its LxL base), the D/C/missing matrices and the
+// operation log are kept between decodes, so decoding blocks of the same
+// size does not touch the heap.
+// decode_scratch_max_bytes is for all the threads together: a thread that
+// finds the total over it after its decode releases its own workspace.
+constexpr size_t decode_scratch_max_bytes = 32 * 1024 * 1024;
+
+class RAPTORQ_LOCAL Decode_Scratch
+{
+public:
+    DenseMtx D, C, missing;
+    Bitmask mask;
+    std::vector<uint32_t> repair_esi;
+    std::vector<bool> bitmask_repair;
+    Op_Log ops;
+
+    Decode_Scratch (const Decode_Scratch&) = delete;
+    Decode_Scratch& operator= (const Decode_Scratch&) = delete;
+    Decode_Scratch (Decode_Scratch&&) = delete;
+    Decode_Scratch& operator= (Decode_Scratch&&) = delete;
+    ~Decode_Scratch()
+        { total_bytes() -= _accounted; }
+
+    static Decode_Scratch& local()
+    {
+        #pragma clang diagnostic push
+        #pragma clang diagnostic ignored "-Wexit-time-destructors"
+        #pragma clang diagnostic ignored "-Wglobal-constructors"
+        static thread_local Decode_Scratch scratch;
+        #pragma clang diagnostic pop
+        return scratch;
+    }
+
+    Precode_Matrix<Save_Computation::ON> *precode_on (const uint16_t symbols);
+    Precode_Matrix<Save_Computation::OFF> *precode_off (
+                                                    const uint16_t symbols);
+    // bytes held by the scratch space
+    size_t bytes() const;
+    // account our bytes in the total, release them if it is too much
+    void trim();
+    // bytes held by the scratch spaces of all the threads, at their last
+    // trim()
+    static std::atomic<size_t>& total_bytes()
+    {
+        static std::atomic<size_t> total (0);
+        return total;
+    }
+private:
+    Decode_Scratch()
+        : mask (0), _accounted (0)
+    {}
+    std::unique_ptr<Precode_Matrix<Save_Computation::ON>> _on;
+    std::unique_ptr<Precode_Matrix<Save_Computation::OFF>> _off;
+    size_t _accounted;
+};
+
+inline Precode_Matrix<Save_Computation::ON> *Decode_Scratch::precode_on (
+                                                        const uint16_t symbols)
+{
+    const Parameters params (symbols);
+    if (_on == nullptr || _on->_params.K_padded != params.K_padded) {
+        _on.reset (new Precode_Matrix<Save_Computation::ON> (params, true));
+    }
+    return _on.get();
+}
+
+inline Precode_Matrix<Save_Computation::OFF> *Decode_Scratch::precode_off (
+                                                        const uint16_t symbols)
+{
+    const Parameters params (symbols);
+    if (_off == nullptr || _off->_params.K_padded != params.K_padded) {
+        _off.reset (new Precode_Matrix<Save_Computation::OFF> (params, true));
+    }
+    return _off.get();
+}
+
+inline size_t Decode_Scratch::bytes() const
+{
+    size_t ret = static_cast<size_t> (D.size() + C.size() + missing.size());
+    ret += ops.bytes();
+    if (_on != nullptr)
+        ret += _on->bytes();
+    if (_off != nullptr)
+        ret += _off->bytes();
+    return ret;
+}
+
+inline void Decode_Scratch::trim()
+{
+    const size_t now = bytes();
+    size_t total;
+    if (now >= _accounted) {
+        total = (total_bytes() += now - _accounted);
+    } else {
+        total = (total_bytes() -= _accounted - now);
+    }
+    _accounted = now;
+    if (total <= decode_scratch_max_bytes)
+        return;
+    D = DenseMtx();
+    C = DenseMtx();
+    missing = DenseMtx();
+    ops.release();
+    _on.reset();
+    _off.reset();
+    total_bytes() -= _accounted;
+    _accounted = 0;
+}
+
+// a whole symbol in memory, for batched insertion
+struct RAPTORQ_LOCAL Symbol_Ref
+{
+    const uint8_t *data;
+    uint32_t esi;
+    Error err;
+};
+
 template <typename In_It>
 class RAPTORQ_LOCAL Raw_Decoder
 {
     // decode () can be launched multiple times,
     // But each time the list of source and repair symbols might
     // change.
-    using Vect = Eigen::Matrix<Impl::Octet, 1, Eigen::Dynamic, Eigen::RowMajor>;
     using T_in = typename std::iterator_traits<In_It>::value_type;
 public:
 
     bool end_of_input;
 
     Raw_Decoder (const Block_Size symbols, const size_t symbol_size)
-        :keep_working (true), type (test_computation()),
-                    _symbols (static_cast<uint16_t> (symbols)), mask (_symbols)
+        :keep_working (true), pooled (false),
+                    type (test_computation()), _symbols (static_cast<uint16_t> (symbols)),
+                    _live (Stats_Source::DECODER), mask (_symbols)
     {
         IS_INPUT(In_It, "RaptorQ__v1::Impl::Decoder");
         // symbol size is in octets, but we save it in "T" sizes.
@@ -65,19 +190,13 @@ public:
         concurrent = 0;
         can_retry = false;
         end_of_input = false;
+        _pivot = Pivot::RFC;
+        _live.update (bytes());
     }
     Raw_Decoder (const Block_Size symbols, const size_t symbol_size,
                                                 const uint16_t padding_symbols)
         :Raw_Decoder (symbols, symbol_size)
-    {
-        assert (padding_symbols <= static_cast<uint16_t> (symbols) &&
-                                            "RQ RFC Decoder: too much padding");
-
-        uint16_t to_pad = (static_cast<uint16_t> (symbols) - padding_symbols);
-        source_symbols.block(to_pad, 0, padding_symbols, symbol_size).setZero();
-        for (; to_pad < static_cast<uint16_t> (symbols); ++to_pad)
-            mask.add (to_pad);
-    }
+        { pad (padding_symbols); }
     ~Raw_Decoder();
     Raw_Decoder() = delete;
     Raw_Decoder (const Raw_Decoder&) = delete;
@@ -87,12 +206,22 @@ public:
 
     Error add_symbol (In_It &start, const In_It end, const uint32_t esi,
                                                                 bool padded);
+    // many whole symbols at once, under a single lock.
+    // the result of each symbol is saved in its "err".
+    // returns the number of symbols that were added.
+    uint32_t add_symbols (Symbol_Ref *syms, const uint32_t n);
     Decoder_Result decode (Work_State *thread_keep_working);
     DenseMtx* get_symbols();
     bool has_symbol (const uint16_t symbol) const;
 
     void stop();
     void clear_data();
+    // back to a just-constructed decoder, keeping the allocated memory
+    void reset (const uint16_t padding_symbols);
+    // the decoder will be reused: keep the repair storage once decoded
+    void keep_memory();
+    // memory held by the decoder
+    size_t bytes() const;
     bool is_stopped() const;
     // can start a computation (with different data)
     bool can_decode() const;
@@ -104,49 +233,52 @@ public:
     bool add_concurrent (const uint16_t max_concurrent);
     uint16_t threads() const;
     void drop_concurrent();
+    // how the rows are chosen in the elimination. default: Pivot::RFC
+    void set_pivot (const Pivot strategy);
+    // inactivated columns ("u") of the last elimination. 0 if there was
+    // none, or if its operations were replayed from the cache.
+    uint16_t inactivated() const;
+    // the last decoding that was not stopped. Also added to
+    // the process-wide Stats_Registry.
+    Stats stats() const;
     // you know you will not receive additional data, and can not decode.
     // fill with zeros and return what you have
     // returns the bitmask of the SYMBOLS we had (true) or not (false)
     std::vector<bool> fill_with_zeros();
 
 private:
-    bool keep_working, can_retry;
-    const Save_Computation type;
+    // needs the lock
+    template <typename It>
+    Error insert (It &start, const It end, const uint32_t esi, bool padded);
+
+    bool keep_working, can_retry, pooled;
+    Save_Computation type;
     std::mutex lock;
     const uint16_t _symbols;
     uint16_t concurrent;    // currently running decoders retry
+    Pivot _pivot;
+    mutable std::mutex _stats_lock;
+    Stats _stats;
+    Live_Object _live;
     Bitmask mask;
     DenseMtx source_symbols;
-    std::vector<std::pair<uint32_t, Vect>> received_repair;
+    // repair symbols are appended to "repair_symbols", which is never
+    // shrunk. received_repair: (esi, row in repair_symbols), ordered by esi
+    DenseMtx repair_symbols;
+    std::vector<std::pair<uint32_t, uint32_t>> received_repair;
+
+    void pad (const uint16_t padding_symbols);
+    Decoder_Result decode (Decode_Scratch &scratch,
+                                            Work_State *thread_keep_working);
 
     // to help making things const
     static Save_Computation test_computation()
     {
-        if (DLF<std::vector<uint8_t>, Cache_Key>::get()->get_size() != 0){
+        if (caching_enabled()) {
             return Save_Computation::ON;
         }
         return Save_Computation::OFF;
     }
-    // to help making things const
-    Precode_Matrix<Save_Computation::ON> *init_precode_on (
-                                                const uint16_t symbols) const
-    {
-        if (type == Save_Computation::ON) {
-            return new Precode_Matrix<Save_Computation::ON> (
-                                                        Parameters(symbols));
-        }
-        return nullptr;
-    }
-    // to help making things const
-    Precode_Matrix<Save_Computation::OFF> *init_precode_off(
-                                                const uint16_t symbols) const
-    {
-        if (type == Save_Computation::OFF) {
-            return new Precode_Matrix<Save_Computation::OFF> (
-                                                        Parameters(symbols));
-        }
-        return nullptr;
-    }
 };
 
 
@@ -176,8 +308,55 @@ void Raw_Decoder<In_It>::clear_data()
     concurrent = 0;
     can_retry = false;
     end_of_input = false;
-    mask = Bitmask (_symbols);
+    mask.reset();
+    received_repair.clear();
+}
+
+template <typename In_It>
+void Raw_Decoder<In_It>::pad (const uint16_t padding_symbols)
+{
+    assert (padding_symbols <= _symbols && "RQ RFC Decoder: too much padding");
+
+    uint16_t to_pad = _symbols - padding_symbols;
+    source_symbols.block (to_pad, 0, padding_symbols,
+                                            source_symbols.cols()).setZero();
+    for (; to_pad < _symbols; ++to_pad)
+        mask.add (to_pad);
+}
+
+template <typename In_It>
+void Raw_Decoder<In_It>::reset (const uint16_t padding_symbols)
+{
+    std::unique_lock<std::mutex> lock_all (lock);
+    RQ_UNUSED (lock_all);
+    keep_working = true;
+    type = test_computation();
+    concurrent = 0;
+    can_retry = false;
+    end_of_input = false;
+    mask.reset();
     received_repair.clear();
+    std::unique_lock<std::mutex> stats_lock (_stats_lock);
+    RQ_UNUSED (stats_lock);
+    _stats = Stats();
+    pad (padding_symbols);
+}
+
+template <typename In_It>
+void Raw_Decoder<In_It>::keep_memory()
+{
+    std::unique_lock<std::mutex> lock_all (lock);
+    RQ_UNUSED (lock_all);
+    pooled = true;
+}
+
+template <typename In_It>
+size_t Raw_Decoder<In_It>::bytes() const
+{
+    return sizeof(*this) + static_cast<size_t> (source_symbols.size() +
+                                                    repair_symbols.size()) +
+            received_repair.capacity() * sizeof(received_repair[0]) +
+                                                    (mask._max_nonrepair / 8);
 }
 
 template <typename In_It>
@@ -222,6 +401,26 @@ template <typename In_It>
 uint16_t Raw_Decoder<In_It>::threads() const
     { return concurrent; }
 
+template <typename In_It>
+void Raw_Decoder<In_It>::set_pivot (const Pivot strategy)
+{
+    std::unique_lock<std::mutex> guard (lock);
+    RQ_UNUSED(guard);
+    _pivot = strategy;
+}
+
+template <typename In_It>
+uint16_t Raw_Decoder<In_It>::inactivated() const
+    { return stats().u; }
+
+template <typename In_It>
+Stats Raw_Decoder<In_It>::stats() const
+{
+    std::unique_lock<std::mutex> guard (_stats_lock);
+    RQ_UNUSED(guard);
+    return _stats;
+}
+
 template <typename In_It>
 void Raw_Decoder<In_It>::drop_concurrent()
 {
@@ -266,45 +465,71 @@ Error Raw_Decoder<In_It>::add_symbol (In_It &start, const In_It end,
 
     std::lock_guard<std::mutex> guard (lock);
     RQ_UNUSED(guard);
+    const Error err = insert (start, end, esi, padded);
+    RQ_TRACE3 (decoder_add_symbol, this, esi, static_cast<uint8_t> (err));
+    return err;
+}
 
+template <typename In_It>
+uint32_t Raw_Decoder<In_It>::add_symbols (Symbol_Ref *syms, const uint32_t n)
+{
+    const size_t cols = static_cast<size_t> (source_symbols.cols());
+    uint32_t added = 0;
+    std::lock_guard<std::mutex> guard (lock);
+    RQ_UNUSED(guard);
+    for (uint32_t idx = 0; idx < n; ++idx) {
+        if (syms[idx].esi >= std::pow (2, 20)) {
+            syms[idx].err = Error::WRONG_INPUT;
+            continue;
+        }
+        const uint8_t *start = syms[idx].data;
+        syms[idx].err = insert (start, syms[idx].data + cols, syms[idx].esi,
+                                                                        false);
+        RQ_TRACE3 (decoder_add_symbol, this, syms[idx].esi,
+                                        static_cast<uint8_t> (syms[idx].err));
+        if (syms[idx].err == Error::NONE)
+            ++added;
+    }
+    return added;
+}
+
+template <typename In_It>
+template <typename It>
+Error Raw_Decoder<In_It>::insert (It &start, const It end, const uint32_t esi,
+                                                                bool padded)
+{
     if (mask.get_holes() == 0 || mask.exists (esi))
         return Error::NOT_NEEDED;   // not even needed.
 
-    uint16_t col = 0;
+    const size_t cols = static_cast<size_t> (source_symbols.cols());
     if (esi < _symbols) {
-        for (; start != end && col != source_symbols.cols(); ++start) {
-            T_in al = *start;
-            for (uint8_t *p = reinterpret_cast<uint8_t *> (&al);
-                        p != reinterpret_cast<uint8_t *> (&al) + sizeof(T_in)
-                                        && col != source_symbols.cols(); ++p) {
-                source_symbols (static_cast<int32_t>(esi), col++) = *p;
-            }
-        }
+        uint8_t *dst = row_ptr (source_symbols, static_cast<uint16_t> (esi));
+        const size_t copied = copy_bytes (start, end, dst, cols);
         // input iterator might reach end before we get enough data
         // for the symbol.
-        if (col != source_symbols.cols()) {
-            if (padded) {
-                while (col != source_symbols.cols())
-                    source_symbols (static_cast<int32_t>(esi), col++) = 0;
-            } else {
+        if (copied != cols) {
+            if (!padded)
                 return Error::WRONG_INPUT;
-            }
+            std::memset (dst + copied, 0, cols - copied);
         }
     } else {
-        Vect v = Vect (source_symbols.cols());
-        for (; start != end && col != source_symbols.cols(); ++start) {
-            T_in al = *start;
-            for (uint8_t *p = reinterpret_cast<uint8_t *> (&al);
-                        p != reinterpret_cast<uint8_t *> (&al) + sizeof(T_in)
-                                        && col != source_symbols.cols(); ++p) {
-                v (col++) = *p;
-            }
+        // add a row (at least 8) if needed. conservativeResize is slow
+        // but the matrix grows exponentially and is never shrunk.
+        const uint32_t rep_row = static_cast<uint32_t> (received_repair.size());
+        if (rep_row >= static_cast<uint32_t> (repair_symbols.rows())) {
+            const int32_t new_rows = std::max<int32_t> (8,
+                            2 * static_cast<int32_t> (repair_symbols.rows()));
+            repair_symbols.conservativeResize (new_rows,
+                                                    source_symbols.cols());
+            _live.update (bytes());
         }
+        uint8_t *dst = reinterpret_cast<uint8_t *> (repair_symbols.row (
+                                static_cast<int32_t> (rep_row)).data());
         // input iterator might reach end before we get enough data
         // for the symbol.
-        if (col != v.cols())
+        if (copy_bytes (start, end, dst, cols) != cols)
             return Error::WRONG_INPUT;
-        received_repair.emplace_back (esi, std::move(v));
+        received_repair.emplace_back (esi, rep_row);
         // reorder the received_repair:
         // ordering the repair packets lets us have more deterministic
         // matrices, that we can use for precomputation.
@@ -336,8 +561,7 @@ std::vector<bool> Raw_Decoder<In_It>::fill_with_zeros()
     std::lock_guard<std::mutex> dec_lock (lock);
     RQ_UNUSED(dec_lock);
     stop();
-    // free mem;
-    received_repair = std::vector<std::pair<uint32_t, Vect>>();
+    received_repair.clear();
 
     std::vector<bool> ret (_symbols, false);
 
@@ -354,6 +578,16 @@ std::vector<bool> Raw_Decoder<In_It>::fill_with_zeros()
 
 template <typename In_It>
 Decoder_Result Raw_Decoder<In_It>::decode (Work_State *thread_keep_working)
+{
+    auto &scratch = Decode_Scratch::local();
+    const auto res = decode (scratch, thread_keep_working);
+    scratch.trim();
+    return res;
+}
+
+template <typename In_It>
+Decoder_Result Raw_Decoder<In_It>::decode (Decode_Scratch &scratch,
+                                            Work_State *thread_keep_working)
 {
     // this method can be launched concurrently multiple times.
     // TODO:  do not build matrices with more than 4 overhead elements,
@@ -368,10 +602,10 @@ Decoder_Result Raw_Decoder<In_It>::decode (Work_State *thread_keep_working)
     if (received_repair.size() < mask.get_holes())
         return Decoder_Result::NEED_DATA;
 
-    const std::unique_ptr<Precode_Matrix< Save_Computation::ON>> precode_on (
-                                                init_precode_on (_symbols));
-    const std::unique_ptr<Precode_Matrix<Save_Computation::OFF>> precode_off (
-                                                init_precode_off (_symbols));
+    const uint64_t start = stats_clock();
+    const size_t scratch_bytes = scratch.bytes();
+    Precode_Matrix<Save_Computation::ON> *precode_on = nullptr;
+    Precode_Matrix<Save_Computation::OFF> *precode_off = nullptr;
     std::unique_lock<std::mutex> shared (lock);
     if (!can_retry)
         return Decoder_Result::NEED_DATA;
@@ -380,14 +614,19 @@ Decoder_Result Raw_Decoder<In_It>::decode (Work_State *thread_keep_working)
                                     received_repair.size() - mask.get_holes());
 
     if (type == Save_Computation::ON) {
+        precode_on = scratch.precode_on (_symbols);
         precode_on->gen (static_cast<uint32_t> (overhead));
+        precode_on->set_pivot (_pivot);
     } else {
+        precode_off = scratch.precode_off (_symbols);
         precode_off->gen (static_cast<uint32_t> (overhead));
+        precode_off->set_pivot (_pivot);
     }
 
     uint16_t S_H;
     uint16_t L_rows;
-    std::vector<bool> bitmask_repair;
+    std::vector<bool> &bitmask_repair = scratch.bitmask_repair;
+    bitmask_repair.clear();
     if (type == Save_Computation::ON) {
         L_rows = precode_on->_params.L;
         S_H = precode_on->_params.S + precode_on->_params.H;
@@ -405,27 +644,27 @@ Decoder_Result Raw_Decoder<In_It>::decode (Work_State *thread_keep_working)
         L_rows = precode_off->_params.L;
         S_H = precode_off->_params.S + precode_off->_params.H;
     }
-    const Cache_Key key (L_rows, mask.get_holes(),
-                                static_cast<uint32_t> (received_repair.size()),
-                                            mask.get_bitmask(), bitmask_repair);
-
-    DenseMtx D = DenseMtx (L_rows + overhead, source_symbols.cols());
 
-    // initialize D: first S_H rows == 0
-    D.block(0, 0, S_H, D.cols()).setZero();
     // put non-repair symbols (source symbols) in place
     if (mask.get_holes() == 0) {
         // other thread completed its work before us?
         return Decoder_Result::DECODED;
     }
+    DenseMtx &D = scratch.D;
+    D.resize (L_rows + overhead, source_symbols.cols());
+
+    // initialize D: first S_H rows == 0
+    D.block(0, 0, S_H, D.cols()).setZero();
     D.block (S_H, 0, source_symbols.rows(), D.cols()) = source_symbols;
 
     // mask must be copied to avoid threading problems, same with tracking
     // the repair esi.
-    const Bitmask mask_safe = mask;
-    std::vector<uint32_t> repair_esi;
+    scratch.mask = mask;
+    const Bitmask &mask_safe = scratch.mask;
+    std::vector<uint32_t> &repair_esi = scratch.repair_esi;
+    repair_esi.clear();
     repair_esi.reserve (received_repair.size());
-    for (auto rep : received_repair)
+    for (const auto &rep : received_repair)
         repair_esi.push_back (rep.first);
 
     // fill holes with the first repair symbols available
@@ -437,7 +676,7 @@ Decoder_Result Raw_Decoder<In_It>::decode (Work_State *thread_keep_working)
             continue;
         }
         const uint16_t row = S_H + hole;
-        D.row (row) = symbol->second;
+        D.row (row) = repair_symbols.row (symbol->second);
         ++symbol;
         ++hole;
     }
@@ -445,38 +684,66 @@ Decoder_Result Raw_Decoder<In_It>::decode (Work_State *thread_keep_working)
     D.block (S_H + _symbols, 0, (L_rows - S_H) - _symbols, D.cols()).setZero();
     // fill the remaining (redundant) repair symbols
     for (uint16_t row = L_rows; symbol != received_repair.end(); ++symbol) {
-        D.row (row) = symbol->second;
+        D.row (row) = repair_symbols.row (symbol->second);
         ++row;
     }
 
     // do not lock this part, as it's the expensive part
     shared.unlock();
     bool DO_NOT_SAVE = false;
-    std::deque<Operation> ops;
+    Op_Log &ops = scratch.ops;
+    ops.clear();
 
     Precode_Result precode_res = Precode_Result::DONE;
-    DenseMtx missing;
+    DenseMtx &missing = scratch.missing;
+    uint16_t missing_rows = 0;
+    Stats stats;
+    uint64_t missing_start = 0;
     if (type == Save_Computation::ON) {
-        auto compressed = DLF<std::vector<uint8_t>, Cache_Key>::
-                                                            get()->get (key);
-        auto decompressed = decompress (compressed.first, compressed.second);
-        DenseMtx precomputed = raw_to_Mtx (decompressed, key.out_size());
-        if (precomputed.rows() != 0) {
+        const Cache_Key key (L_rows, mask_safe.get_holes(),
+                                static_cast<uint32_t> (received_repair.size()),
+                                    mask_safe.get_bitmask(), bitmask_repair);
+        size_t cache_compressed, cache_uncompressed;
+        if (get_cached_ops (key, static_cast<size_t> (D.rows()), ops,
+                                    cache_compressed, cache_uncompressed)) {
             DO_NOT_SAVE = true;
-            missing = precomputed * D;
-            missing = precode_on->get_missing (std::move(missing), mask_safe);
+            ops.replay (D);
+            stats = precode_on->stats();
+            stats.cache_hit = 1;
+            stats.cache_compressed = cache_compressed;
+            stats.cache_uncompressed = cache_uncompressed;
+            stats.operations = static_cast<uint32_t> (ops.size());
+            missing_start = stats_clock();
+            missing_rows = precode_on->get_missing (D, mask_safe, missing);
         } else {
-            std::tie (precode_res, missing) = precode_on->intermediate (D,
-                                            mask_safe, repair_esi, ops,
+            precode_res = precode_on->intermediate (D, scratch.C, mask_safe,
+                                            repair_esi, ops,
                                             keep_working, thread_keep_working);
-            missing = precode_on->get_missing (std::move(missing), mask_safe);
+            stats = precode_on->stats();
+            missing_start = stats_clock();
+            if (precode_res == Precode_Result::DONE) {
+                missing_rows = precode_on->get_missing (scratch.C, mask_safe,
+                                                                    missing);
+            }
+        }
+        stats.get_missing = stats_clock() - missing_start;
+        stats.cache_probed = 1;
+        if (!DO_NOT_SAVE && precode_res == Precode_Result::DONE &&
+                                                            missing_rows != 0) {
+            // save the operations, not the LxL matrix they would build.
+            cache_ops_async (ops, key);
         }
-
     } else {
-        std::tie (precode_res, missing) = precode_off->intermediate (D,
-                                            mask_safe, repair_esi, ops,
+        precode_res = precode_off->intermediate (D, scratch.C, mask_safe,
+                                            repair_esi, ops,
                                             keep_working, thread_keep_working);
-        missing = precode_off->get_missing (std::move(missing), mask_safe);
+        stats = precode_off->stats();
+        missing_start = stats_clock();
+        if (precode_res == Precode_Result::DONE) {
+            missing_rows = precode_off->get_missing (scratch.C, mask_safe,
+                                                                    missing);
+        }
+        stats.get_missing = stats_clock() - missing_start;
     }
     if (precode_res == Precode_Result::STOPPED) {
         if (mask.get_holes() == 0)
@@ -484,21 +751,16 @@ Decoder_Result Raw_Decoder<In_It>::decode (Work_State *thread_keep_working)
         return Decoder_Result::STOPPED;
     }
 
-    D = DenseMtx(); // free some memory;
-    if (type == Save_Computation::ON && !DO_NOT_SAVE &&
-                                        precode_res == Precode_Result::DONE) {
-        DenseMtx res;
-        if (missing.rows() != 0) {
-            const int32_t mt_size = static_cast<int32_t>(L_rows + overhead);
-            res.setIdentity (mt_size, mt_size);
-            for (const auto &op : ops)
-                op.build_mtx (res);
-            // TODO: lots of wasted ram? how to compress things directly?
-            auto raw_mtx = Mtx_to_raw (res);
-            auto compressed = compress (raw_mtx);
-            DLF<std::vector<uint8_t>, Cache_Key>::get()->add (compressed.first,
-                                                        compressed.second, key);
-        }
+    stats.total = stats_clock() - start;
+    stats.overhead = overhead;
+    const size_t scratch_grown = scratch.bytes();
+    if (scratch_grown > scratch_bytes)
+        stats.bytes_allocated = scratch_grown - scratch_bytes;
+    Stats_Registry::get().add (Stats_Source::DECODER, stats);
+    {
+        std::unique_lock<std::mutex> stats_lock (_stats_lock);
+        RQ_UNUSED (stats_lock);
+        _stats = stats;
     }
 
     std::lock_guard<std::mutex> dec_lock (lock);
@@ -516,7 +778,7 @@ Decoder_Result Raw_Decoder<In_It>::decode (Work_State *thread_keep_working)
     // remember: we might have received other symbols while decoding.
     uint16_t miss_row = 0;
     for (uint16_t row = 0; row < mask_safe._max_nonrepair &&
-                                            miss_row < missing.rows(); ++row) {
+                                            miss_row < missing_rows; ++row) {
         if (mask_safe.exists (row))
             continue;
         ++miss_row;
@@ -527,8 +789,15 @@ Decoder_Result Raw_Decoder<In_It>::decode (Work_State *thread_keep_working)
     }
 
     keep_working = false;   // tell eventual threads to stop crunching,
-    // free some memory, we don't need recover symbols anymore
-    received_repair = std::vector<std::pair<uint32_t, Vect>>();
+    // we don't need the repair symbols anymore. Keep their memory only
+    // if the decoder goes back to the pool.
+    received_repair.clear();
+    if (!pooled) {
+        // no shrink_to_fit(): it does nothing without exceptions
+        repair_symbols = DenseMtx();
+        std::vector<std::pair<uint32_t, uint32_t>>().swap (received_repair);
+        _live.update (bytes());
+    }
     mask.free();
 
 
@@ -28,9 +28,15 @@
 #include "RaptorQ/v1/Precode_Matrix.hpp"
 #include "RaptorQ/v1/Rand.hpp"
 #include "RaptorQ/v1/Shared_Computation/Decaying_LF.hpp"
+#include "RaptorQ/v1/Shared_Computation/Op_Cache.hpp"
+#include "RaptorQ/v1/Shared_Computation/Precomputed.hpp"
+#include "RaptorQ/v1/Shared_Computation/Stats_Registry.hpp"
 #include "RaptorQ/v1/Thread_Pool.hpp"
+#include "RaptorQ/v1/util/bulk_copy.hpp"
 #include <Eigen/Dense>
+#include <cstring>
 #include <memory>
+#include <mutex>
 #include <type_traits>
 #include <utility>
 
@@ -73,20 +79,24 @@ public:
         typename std::enable_if<!I::value, int>::type = 0>
     void set_data (Rnd_It *from, Rnd_It *to);
 
-    // "Enc" will have two implementations, depending os whether the
-    // interleaver was used or not.
+    // pointers and vector iterators get the symbol straight in memory.
+    size_t Enc (const uint32_t ESI, Fwd_It &output, const Fwd_It end) const
+        { return Enc (ESI, output, end, is_contiguous<Fwd_It>()); }
+    // write the whole symbol, padding included, straight to memory.
+    // returns the bytes written: the symbol size, or 0 on error.
     template <typename R_It = Rnd_It,
         typename F_It = Fwd_It, typename I = Interleaved,
         typename std::enable_if<I::value, int>::type = 0>
-    size_t Enc (const uint32_t ESI, Fwd_It &output, const Fwd_It end) const;
+    size_t Enc_bytes (const uint32_t ESI, uint8_t *output) const;
     template <typename R_It = Rnd_It,
         typename F_It = Fwd_It, typename I = Interleaved,
         typename std::enable_if<!I::value, int>::type = 0>
-    size_t Enc (const uint32_t ESI, Fwd_It &output, const Fwd_It end) const;
+    size_t Enc_bytes (const uint32_t ESI, uint8_t *output) const;
 
 
-    // for both interleaved and non-interleaved
-    DenseMtx get_precomputed (RaptorQ__v1::Work_State *thread_keep_working);
+    // for both interleaved and non-interleaved.
+    // shared with the other encoders with the same K'. nullptr on error.
+    Precomputed get_precomputed (RaptorQ__v1::Work_State *thread_keep_working);
 
     // interleaver-only, precomputed
     template <typename R_It = Rnd_It,
@@ -106,7 +116,8 @@ public:
         typename F_It = Fwd_It, typename I = Interleaved,
         typename std::enable_if<!I::value, int>::type = 0>
     bool generate_symbols (const DenseMtx &precomputed,
-                                        const Rnd_It *from, const Rnd_It *to);
+                                        const Rnd_It *from, const Rnd_It *to,
+                                        const uint16_t threads = 1);
     // non-interleaved: requires source symbols. non-precomputed
     template <typename R_It = Rnd_It,
         typename F_It = Fwd_It, typename I = Interleaved,
@@ -119,6 +130,12 @@ public:
     bool is_stopped() const;
     void clear_data();
     bool ready() const;
+    // memory held by the encoder
+    size_t bytes() const;
+    // the last successful generate_symbols(). Also added to
+    // the process-wide Stats_Registry. With a precomputed matrix
+    // only the total time is known.
+    Stats stats() const;
 
 private:
     const size_t _symbol_size;
@@ -132,6 +149,9 @@ private:
     Rnd_It *_from, *_to;
 
     DenseMtx encoded_symbols;
+    mutable std::mutex _stats_lock;
+    Stats _stats;
+    Live_Object _live;
 
     // interleaved and non-interleaved functions. same signature, though.
     template <typename R_It = Rnd_It,
@@ -146,14 +166,32 @@ private:
 
     std::pair<uint16_t, uint16_t> init_ksh() const;
     bool compute_intermediate (DenseMtx &D,
-                                RaptorQ__v1::Work_State *thread_keep_working);
+                                RaptorQ__v1::Work_State *thread_keep_working,
+                                const uint64_t start);
+    void save_stats (Stats &stats, const uint64_t start);
 
+    size_t Enc (const uint32_t ESI, Fwd_It &output, const Fwd_It end,
+                                                const std::true_type) const;
+    // "Enc" will have two generic implementations, depending os whether the
+    // interleaver was used or not.
+    template <typename R_It = Rnd_It,
+        typename F_It = Fwd_It, typename I = Interleaved,
+        typename std::enable_if<I::value, int>::type = 0>
+    size_t Enc (const uint32_t ESI, Fwd_It &output, const Fwd_It end,
+                                                const std::false_type) const;
+    template <typename R_It = Rnd_It,
+        typename F_It = Fwd_It, typename I = Interleaved,
+        typename std::enable_if<!I::value, int>::type = 0>
+    size_t Enc (const uint32_t ESI, Fwd_It &output, const Fwd_It end,
+                                                const std::false_type) const;
     size_t Enc_repair (const uint32_t ESI, Fwd_It &output,
                                                         const Fwd_It end) const;
+    // 1 x symbol_size matrix. empty if not ready.
+    DenseMtx repair_symbol (const uint32_t ESI) const;
     std::pair<uint16_t, uint16_t> init_ksh();
     static Save_Computation test_computation()
     {
-        if (DLF<std::vector<uint8_t>, Cache_Key>::get()->get_size() != 0)
+        if (caching_enabled())
             return Save_Computation::ON;
         return Save_Computation::OFF;
     }
@@ -170,11 +208,13 @@ Raw_Encoder<Rnd_It, Fwd_It, Interleaved>::Raw_Encoder (const Block_Size symbols,
                                                        const size_t symbol_size)
     : _symbol_size (symbol_size), _symbols (static_cast<uint16_t> (symbols)),
     _type (test_computation()), precode_on  (nullptr), precode_off (nullptr),
-                        _interleaver (nullptr), _from (nullptr), _to (nullptr)
+                        _interleaver (nullptr), _from (nullptr), _to (nullptr),
+                                                _live (Stats_Source::ENCODER)
 {
     IS_RANDOM(Rnd_It, "RaptorQ__v1::Impl::Encoder");
     IS_FORWARD(Fwd_It, "RaptorQ__v1::Impl::Encoder");
     keep_working = true;
+    _live.update (bytes());
 }
 
 template <typename Rnd_It, typename Fwd_It, typename Interleaved>
@@ -186,11 +226,13 @@ Raw_Encoder<Rnd_It, Fwd_It, Interleaved>::Raw_Encoder (
       _symbols (static_cast<uint16_t> (interleaver->extended_symbols (sbn))),
       _SBN (sbn), _type (test_computation()),
       precode_on  (nullptr), precode_off (nullptr),
-     _interleaver (interleaver), _from (nullptr), _to (nullptr)
+     _interleaver (interleaver), _from (nullptr), _to (nullptr),
+                                                _live (Stats_Source::ENCODER)
 {
     IS_RANDOM(Rnd_It, "RaptorQ__v1::Impl::Encoder");
     IS_FORWARD(Fwd_It, "RaptorQ__v1::Impl::Encoder");
     keep_working = true;
+    _live.update (bytes());
 }
 
 template <typename Rnd_It, typename Fwd_It, typename Interleaved>
@@ -223,6 +265,7 @@ void Raw_Encoder<Rnd_It, Fwd_It, Interleaved>::clear_data()
     _interleaver = nullptr;
     _from = nullptr;
     _to = nullptr;
+    _live.update (bytes());
 }
 
 template <typename Rnd_It, typename Fwd_It, typename Interleaved>
@@ -230,29 +273,64 @@ bool Raw_Encoder<Rnd_It, Fwd_It, Interleaved>::ready() const
     { return encoded_symbols.cols() != 0; }
 
 template <typename Rnd_It, typename Fwd_It, typename Interleaved>
-DenseMtx Raw_Encoder<Rnd_It, Fwd_It, Interleaved>::get_precomputed (
+size_t Raw_Encoder<Rnd_It, Fwd_It, Interleaved>::bytes() const
+{
+    size_t ret = sizeof(*this) + static_cast<size_t> (encoded_symbols.size());
+    if (precode_on != nullptr)
+        ret += precode_on->bytes();
+    if (precode_off != nullptr)
+        ret += precode_off->bytes();
+    return ret;
+}
+
+template <typename Rnd_It, typename Fwd_It, typename Interleaved>
+Stats Raw_Encoder<Rnd_It, Fwd_It, Interleaved>::stats() const
+{
+    std::unique_lock<std::mutex> guard (_stats_lock);
+    RQ_UNUSED(guard);
+    return _stats;
+}
+
+template <typename Rnd_It, typename Fwd_It, typename Interleaved>
+void Raw_Encoder<Rnd_It, Fwd_It, Interleaved>::save_stats (Stats &stats,
+                                                        const uint64_t start)
+{
+    stats.total = stats_clock() - start;
+    stats.bytes_allocated = static_cast<uint64_t> (encoded_symbols.size());
+    Stats_Registry::get().add (Stats_Source::ENCODER, stats);
+    _live.update (bytes());
+    std::unique_lock<std::mutex> guard (_stats_lock);
+    RQ_UNUSED(guard);
+    _stats = stats;
+}
+
+template <typename Rnd_It, typename Fwd_It, typename Interleaved>
+Precomputed Raw_Encoder<Rnd_It, Fwd_It, Interleaved>::get_precomputed (
                                 RaptorQ__v1::Work_State *thread_keep_working)
 {
     keep_working = true;
 
+    // only the parameters are needed until we actually compute the matrix
     if (precode_on == nullptr) {
         precode_on = std::unique_ptr<Precode_Matrix<Save_Computation::ON>> (
                 new Precode_Matrix<Save_Computation::ON>(Parameters(_symbols)));
-        precode_on->gen(0);
     }
+    const uint16_t K_prime = precode_on->_params.K_padded;
+    auto &registry = Precomputed_Registry::get();
+    Precomputed shared = registry.find (K_prime);
+    if (shared != nullptr)
+        return shared;
+
+    const uint16_t size = precode_on->_params.L;
+    const auto tmp_bool = std::vector<bool>();
+    const Cache_Key key (size, 0, 0, tmp_bool, tmp_bool);
     if (_type == Save_Computation::ON) {
-        const uint16_t size = precode_on->_params.L;
-        const auto tmp_bool = std::vector<bool>();
-        const Cache_Key key (size, 0, 0, tmp_bool, tmp_bool);
-        auto compressed = DLF<std::vector<uint8_t>, Cache_Key>::
-                                                            get()->get (key);
-        if (compressed.second.size() != 0) {
-            auto uncompressed = decompress (compressed.first,compressed.second);
-            DenseMtx precomputed = raw_to_Mtx (uncompressed, key.out_size());
-            if (precomputed.rows() != 0) {
-                return precomputed;
-            }
-            return DenseMtx();
+        Op_Log cached;
+        if (get_cached_ops (key, size, cached)) {
+            DenseMtx precomputed;
+            precomputed.setIdentity (size, size);
+            cached.replay (precomputed);
+            return registry.publish (K_prime, std::move (precomputed));
         }
         // else not found, generate one.
     }
@@ -269,32 +347,23 @@ DenseMtx Raw_Encoder<Rnd_It, Fwd_It, Interleaved>::get_precomputed (
     D.setZero (K_S_H, 1);
 
     Precode_Result precode_res;
-    std::deque<Operation> ops;
+    Op_Log ops;
     DenseMtx encoded_no_symbols;
+    precode_on->gen (0);
     std::tie (precode_res, encoded_no_symbols) = precode_on->intermediate (D,
                                                         ops, keep_working,
                                                         thread_keep_working);
     if (precode_res != Precode_Result::DONE || encoded_no_symbols.cols() == 0)
-        return DenseMtx();
+        return nullptr;
 
     // RaptorQ succeded.
     // build the precomputed matrix.
     DenseMtx res;
-    // don't save really small matrices.
-
-    const uint16_t size = precode_on->_params.L;
-    const auto tmp_bool = std::vector<bool>();
-    const Cache_Key key (size, 0, 0, tmp_bool, tmp_bool);
     res.setIdentity (size, size);
-    for (const auto &op : ops)
-        op.build_mtx (res);
-    if (_type == Save_Computation::ON) {
-        auto raw_mtx = Mtx_to_raw (res);
-        auto compressed = compress (raw_mtx);
-        DLF<std::vector<uint8_t>, Cache_Key>::get()->add (compressed.first,
-                                                        compressed.second, key);
-    }
-    return res;
+    ops.replay (res);
+    if (_type == Save_Computation::ON)
+        cache_ops_async (ops, key);
+    return registry.publish (K_prime, std::move (res));
 }
 
 
@@ -306,43 +375,22 @@ template <typename R_It, typename F_It, typename I,
 DenseMtx Raw_Encoder<Rnd_It, Fwd_It, Interleaved>::get_raw_symbols(
                                  const uint16_t K_S_H, const uint16_t S_H) const
 {
-    using T = typename std::iterator_traits<Rnd_It>::value_type;
     assert (_to != nullptr && _from != nullptr && "RQ: get raw what?");
 
     DenseMtx D = DenseMtx (K_S_H, _symbol_size);
 
     // fill matrix D: full zero for the first S + H symbols
     D.block (0, 0, S_H, D.cols()).setZero();
-    uint16_t row = S_H;
 
-    // now the C[0...K] symbols follow
-    std::vector<uint8_t> padding (sizeof(T), 0);
+    // now the C[0...K] symbols follow. They are contiguous in D, so copy
+    // the whole input at once, then zero the missing data and
+    // the eventual padding symbols (K...K_padded)
     Rnd_It it = *_from;
-    uint8_t *p = reinterpret_cast<uint8_t*> (&*it);
-    if (it >= *_to)
-        p = padding.data();
-    bool pad = false;
-    size_t in_align = 0;
-    for (; row < S_H + _symbols; ++row) {
-        for (ssize_t col = 0; col < static_cast<ssize_t>(_symbol_size); ++col) {
-            auto val = *(p++);
-            D (row, col) = val;
-            ++in_align;
-            if (in_align == sizeof(T)) {
-                in_align = 0;
-                if (!pad) // windows debug: can't  ++iterator past the end()
-                    ++it;
-                if (it < *_to) {
-                    p = reinterpret_cast<uint8_t*> (&*it);
-                } else {
-                    pad = true;
-                    p = padding.data();
-                }
-            }
-        }
-    }
-    // finally fill with eventual padding symbols (K...K_padded)
-    D.block (row, 0, D.rows() - row, D.cols()).setZero();
+    uint8_t *dst = row_ptr (D, S_H);
+    const size_t size = static_cast<size_t> (K_S_H - S_H) * _symbol_size;
+    const size_t copied = copy_bytes (it, *_to, dst,
+                                static_cast<size_t> (_symbols) * _symbol_size);
+    std::memset (dst + copied, 0, size - copied);
     return D;
 }
 
@@ -358,22 +406,14 @@ DenseMtx Raw_Encoder<Rnd_It, Fwd_It, Interleaved>::get_raw_symbols(
     assert (_interleaver != nullptr);
 
     DenseMtx D = DenseMtx (K_S_H, sizeof(T) * _interleaver->symbol_size());
-    auto C = (*_interleaver)[_SBN];
 
     // fill matrix D: full zero for the first S + H symbols
     D.block (0, 0, S_H, D.cols()).setZero();
     uint16_t row = S_H;
-    // now the C[0...K] symbols follow
-    for (; row < S_H + _interleaver->source_symbols (_SBN); ++row) {
-        auto symbol = C[row - S_H];
-        uint16_t col = 0;
-        for (uint16_t i = 0; i < _interleaver->symbol_size(); ++i) {
-            T val = symbol[i];
-            uint8_t *octet = reinterpret_cast<uint8_t *> (&val);
-            for (uint8_t byte = 0; byte < sizeof(T); ++byte)
-                D (row, col++) = *(octet++);
-        }
-    }
+    // now the C[0...K] symbols follow, gathered from their sub-blocks
+    for (; row < S_H + _interleaver->source_symbols (_SBN); ++row)
+        _interleaver->copy_symbol (_SBN, static_cast<uint16_t> (row - S_H),
+                                                            row_ptr (D, row));
 
     // finally fill with eventual padding symbols (K...K_padded)
     D.block (row, 0, D.rows() - row, D.cols()).setZero();
@@ -393,10 +433,13 @@ bool Raw_Encoder<Rnd_It, Fwd_It, Interleaved>::generate_symbols (
         return false;
     keep_working = true;
 
+    const uint64_t start = stats_clock();
     const uint16_t S_H = precode_on->_params.S + precode_on->_params.H;
     const uint16_t K_S_H = precode_on->_params.K_padded + S_H;
     const DenseMtx D = get_raw_symbols (K_S_H, S_H);
-    encoded_symbols = precomputed * D;
+    encoded_symbols = mtx_mul (precomputed, D);
+    Stats stats;
+    save_stats (stats, start);
     return true;
 }
 
@@ -411,9 +454,10 @@ bool Raw_Encoder<Rnd_It, Fwd_It, Interleaved>::generate_symbols (
         return true;
     keep_working = true;
 
+    const uint64_t start = stats_clock();
     auto ksh = init_ksh();
     DenseMtx D = get_raw_symbols (ksh.first, ksh.second);
-    return compute_intermediate (D, thread_keep_working);
+    return compute_intermediate (D, thread_keep_working, start);
 }
 
 // GENERATE - NON interleaved, precomputed
@@ -422,19 +466,23 @@ template <typename R_It, typename F_It, typename I,
                                 typename std::enable_if<!I::value, int>::type>
 bool Raw_Encoder<Rnd_It, Fwd_It, Interleaved>::generate_symbols (
                                         const DenseMtx &precomputed,
-                                        const Rnd_It *from, const Rnd_It *to)
+                                        const Rnd_It *from, const Rnd_It *to,
+                                        const uint16_t threads)
 {
     if (precomputed.rows() == 0 || from == nullptr || to == nullptr)
         return false;
     keep_working = true;
 
+    const uint64_t start = stats_clock();
     _from = const_cast<Rnd_It*> (from);
     _to = const_cast<Rnd_It*> (to);
     const uint16_t S_H = precode_on->_params.S + precode_on->_params.H;
     const uint16_t K_S_H = precode_on->_params.K_padded + S_H;
 
     const DenseMtx D = get_raw_symbols (K_S_H, S_H);
-    encoded_symbols = precomputed * D;
+    encoded_symbols = mtx_mul (precomputed, D, threads);
+    Stats stats;
+    save_stats (stats, start);
     return true;
 }
 
@@ -453,13 +501,14 @@ bool Raw_Encoder<Rnd_It, Fwd_It, Interleaved>::generate_symbols (
         return true;
     keep_working = true;
 
+    const uint64_t start = stats_clock();
     _from = const_cast<Rnd_It*> (from);
     _to = const_cast<Rnd_It*> (to);
     keep_working = true;
 
     auto ksh = init_ksh();
     DenseMtx D = get_raw_symbols (ksh.first, ksh.second);
-    return compute_intermediate (D, thread_keep_working);
+    return compute_intermediate (D, thread_keep_working, start);
 }
 
 
@@ -476,7 +525,6 @@ std::pair<uint16_t, uint16_t> Raw_Encoder<Rnd_It, Fwd_It, Interleaved>::
             precode_on = std::unique_ptr<Precode_Matrix<Save_Computation::ON>> (
                                     new Precode_Matrix<Save_Computation::ON> (
                                                         Parameters(_symbols)));
-            precode_on->gen(0);
         }
         S_H = precode_on->_params.S + precode_on->_params.H;
         K_S_H = precode_on->_params.K_padded + S_H;
@@ -485,7 +533,6 @@ std::pair<uint16_t, uint16_t> Raw_Encoder<Rnd_It, Fwd_It, Interleaved>::
             precode_off =std::unique_ptr<Precode_Matrix<Save_Computation::OFF>>(
                                     new Precode_Matrix<Save_Computation::OFF> (
                                                         Parameters(_symbols)));
-            precode_off->gen(0);
         }
         S_H = precode_off->_params.S + precode_off->_params.H;
         K_S_H = precode_off->_params.K_padded + S_H;
@@ -495,51 +542,55 @@ std::pair<uint16_t, uint16_t> Raw_Encoder<Rnd_It, Fwd_It, Interleaved>::
 
 template <typename Rnd_It, typename Fwd_It, typename Interleaved>
 bool Raw_Encoder<Rnd_It, Fwd_It, Interleaved>::compute_intermediate (
-                    DenseMtx &D, RaptorQ__v1::Work_State *thread_keep_working)
+                    DenseMtx &D, RaptorQ__v1::Work_State *thread_keep_working,
+                                                        const uint64_t start)
 {
     Precode_Result precode_res;
-    std::deque<Operation> ops;
+    Op_Log ops;
+    Stats stats;
     if (_type == Save_Computation::ON) {
         const uint16_t size = precode_on->_params.L;
         const auto tmp_bool = std::vector<bool>();
         const Cache_Key key (size, 0, 0, tmp_bool, tmp_bool);
-        auto compressed = DLF<std::vector<uint8_t>, Cache_Key>::
-                                                            get()->get (key);
-        if (compressed.second.size() != 0) {
-            auto decompressed = decompress (compressed.first,compressed.second);
-            DenseMtx precomputed = raw_to_Mtx (decompressed, key.out_size());
-            if (precomputed.rows() != 0) {
-                // we have a precomputed matrix! let's use that!
-                encoded_symbols = precomputed * D;
-                // result is granted. we only save matrices that work
-                return true;
-            }
+        size_t cache_compressed, cache_uncompressed;
+        stats.cache_probed = 1;
+        if (get_cached_ops (key, static_cast<size_t> (D.rows()), ops,
+                                    cache_compressed, cache_uncompressed)) {
+            // we have the operations already! let's redo them on D
+            ops.replay (D);
+            encoded_symbols = std::move (D);
+            stats.cache_hit = 1;
+            stats.cache_compressed = cache_compressed;
+            stats.cache_uncompressed = cache_uncompressed;
+            stats.operations = static_cast<uint32_t> (ops.size());
+            save_stats (stats, start);
+            // result is granted. we only save operations that work
+            return true;
         }
+        // intermediate() frees the matrix, generate it every time
+        precode_on->gen (0);
         std::tie (precode_res, encoded_symbols) = precode_on->intermediate (D,
                                                         ops, keep_working,
                                                         thread_keep_working);
 
         if (precode_res != Precode_Result::DONE || encoded_symbols.cols() == 0)
             return false;
+        stats = precode_on->stats();
+        stats.cache_probed = 1;
 
-        // RaptorQ succeded.
-        // build the precomputed matrix.
-        DenseMtx res;
-        if (encoded_symbols.cols() != 0) {
-            res.setIdentity (size, size);
-            for (const auto &op : ops)
-                op.build_mtx (res);
-            auto raw_mtx = Mtx_to_raw (res);
-            compressed = compress (raw_mtx);
-            DLF<std::vector<uint8_t>, Cache_Key>::get()->add (compressed.first,
-                                                        compressed.second, key);
-        }
+        // RaptorQ succeded. save the operations, not the LxL matrix.
+        cache_ops_async (ops, key);
     } else {
+        precode_off->gen (0);
         std::tie (precode_res, encoded_symbols) = precode_off->intermediate (D,
                                                         ops, keep_working,
                                                         thread_keep_working);
+        stats = precode_off->stats();
     }
-    return (Precode_Result::DONE == precode_res) && 0 != encoded_symbols.cols();
+    if ((Precode_Result::DONE != precode_res) || 0 == encoded_symbols.cols())
+        return false;
+    save_stats (stats, start);
+    return true;
 }
 
 // interleaved encoding
@@ -547,8 +598,9 @@ template <typename Rnd_It, typename Fwd_It, typename Interleaved>
 template <typename R_It, typename F_It, typename I,
                                 typename std::enable_if<I::value, int>::type>
 size_t Raw_Encoder<Rnd_It, Fwd_It, Interleaved>::Enc (const uint32_t ESI,
-                                                        Fwd_It &output,
-                                                        const Fwd_It end) const
+                                                Fwd_It &output,
+                                                const Fwd_It end,
+                                                const std::false_type) const
 {
     // returns iterators written
     // ESI means that the first _symbols.source_symbols() are the
@@ -596,13 +648,72 @@ size_t Raw_Encoder<Rnd_It, Fwd_It, Interleaved>::Enc (const uint32_t ESI,
     }
 }
 
+template <typename Rnd_It, typename Fwd_It, typename Interleaved>
+template <typename R_It, typename F_It, typename I,
+                                typename std::enable_if<I::value, int>::type>
+size_t Raw_Encoder<Rnd_It, Fwd_It, Interleaved>::Enc_bytes (const uint32_t ESI,
+                                                        uint8_t *output) const
+{
+    if (_interleaver == nullptr)
+        return 0;
+    using T = typename std::iterator_traits<Rnd_It>::value_type;
+    const size_t bytes = _symbol_size * sizeof(T);
+    if (ESI < _interleaver->source_symbols (_SBN)) {
+        _interleaver->copy_symbol (_SBN, static_cast<uint16_t> (ESI), output);
+        return bytes;
+    }
+    const DenseMtx tmp = repair_symbol (ESI);
+    if (tmp.rows() == 0)
+        return 0;
+    std::memcpy (output, row_ptr (tmp, 0), bytes);
+    return bytes;
+}
+
+template <typename Rnd_It, typename Fwd_It, typename Interleaved>
+template <typename R_It, typename F_It, typename I,
+                                typename std::enable_if<!I::value, int>::type>
+size_t Raw_Encoder<Rnd_It, Fwd_It, Interleaved>::Enc_bytes (const uint32_t ESI,
+                                                        uint8_t *output) const
+{
+    if (_from == nullptr || _to == nullptr)
+        return 0;
+    if (ESI >= _symbols) {
+        const DenseMtx tmp = repair_symbol (ESI);
+        if (tmp.rows() == 0)
+            return 0;
+        std::memcpy (output, row_ptr (tmp, 0), _symbol_size);
+        return _symbol_size;
+    }
+    // source symbol: the input data, then the padding
+    using in_T = typename std::iterator_traits<Rnd_It>::value_type;
+    const size_t in_bytes = static_cast<size_t> (*_to - *_from) * sizeof(in_T);
+    const size_t first = ESI * _symbol_size;
+    size_t done = 0;
+    if (first < in_bytes) {
+        const size_t len = std::min (_symbol_size, in_bytes - first);
+        Rnd_It it = *_from + static_cast<int64_t> (first / sizeof(in_T));
+        const size_t skip = first % sizeof(in_T);
+        if (skip != 0) {
+            const in_T val = *it;
+            ++it;
+            done = std::min (sizeof(in_T) - skip, len);
+            std::memcpy (output, reinterpret_cast<const uint8_t*> (&val) + skip,
+                                                                        done);
+        }
+        done += copy_bytes (it, *_to, output + done, len - done);
+    }
+    std::memset (output + done, 0, _symbol_size - done);
+    return _symbol_size;
+}
+
 // NON interleaved encoding
 template <typename Rnd_It, typename Fwd_It, typename Interleaved>
 template <typename R_It, typename F_It, typename I,
                                 typename std::enable_if<!I::value, int>::type>
 size_t Raw_Encoder<Rnd_It, Fwd_It, Interleaved>::Enc (const uint32_t ESI,
-                                                        Fwd_It &output,
-                                                        const Fwd_It end) const
+                                                Fwd_It &output,
+                                                const Fwd_It end,
+                                                const std::false_type) const
 {
     // returns iterators written
     // ESI means that the first _symbols.source_symbols() are the
@@ -663,25 +774,54 @@ size_t Raw_Encoder<Rnd_It, Fwd_It, Interleaved>::Enc (const uint32_t ESI,
     }
 }
 
-// repair symbol only - no need to diffenretiate between (non)interleaved
+// contiguous output, both interleaved and not: no per-byte shifting
 template <typename Rnd_It, typename Fwd_It, typename Interleaved>
-size_t Raw_Encoder<Rnd_It, Fwd_It, Interleaved>::Enc_repair (const uint32_t ESI,
-                                                        Fwd_It &output,
-                                                        const Fwd_It end) const
+size_t Raw_Encoder<Rnd_It, Fwd_It, Interleaved>::Enc (const uint32_t ESI,
+                                                Fwd_It &output,
+                                                const Fwd_It end,
+                                                const std::true_type) const
+{
+    // returns iterators written
+    using T = typename std::iterator_traits<Fwd_It>::value_type;
+    using in_T = typename std::iterator_traits<Rnd_It>::value_type;
+    if (output == end)
+        return 0;
+    const size_t bytes = Interleaved::value ? _symbol_size * sizeof(in_T) :
+                                                                _symbol_size;
+    const size_t room = static_cast<size_t> (end - output) * sizeof(T);
+    if (room < bytes) {
+        // truncated symbol
+        std::vector<uint8_t> tmp (bytes);
+        if (Enc_bytes (ESI, tmp.data()) == 0)
+            return 0;
+        return put_bytes (output, end, tmp.data(), bytes);
+    }
+    uint8_t *out = reinterpret_cast<uint8_t*> (&*output);
+    if (Enc_bytes (ESI, out) == 0)
+        return 0;
+    const size_t written = (bytes + sizeof(T) - 1) / sizeof(T);
+    std::memset (out + bytes, 0, written * sizeof(T) - bytes);
+    output += static_cast<typename std::iterator_traits<Fwd_It>::
+                                            difference_type> (written);
+    return written;
+}
+
+// shared by Enc_repair and Enc_bytes
+template <typename Rnd_It, typename Fwd_It, typename Interleaved>
+DenseMtx Raw_Encoder<Rnd_It, Fwd_It, Interleaved>::repair_symbol (
+                                                    const uint32_t ESI) const
 {
-    size_t written = 0;
-    // repair symbol requested.
     if (!ready())
-        return written;
+        return DenseMtx();
     uint16_t K;
     if (_type == Save_Computation::ON) {
         if (precode_on == nullptr)
-            return 0;
+            return DenseMtx();
         K = precode_on->_params.K_padded;
     } else {
         if (precode_off == nullptr) {
             if (precode_on == nullptr)
-                return 0;
+                return DenseMtx();
             // we might have used the precode, and thus forced the "precode_on".
             K = precode_on->_params.K_padded;
         } else {
@@ -700,34 +840,23 @@ size_t Raw_Encoder<Rnd_It, Fwd_It, Interleaved>::Enc_repair (const uint32_t ESI,
             tmp = precode_off->encode (encoded_symbols, ISI);
         }
     }
+    return tmp;
+}
 
-    // put "tmp" in output, but the alignment is different
+// repair symbol only - no need to diffenretiate between (non)interleaved
+template <typename Rnd_It, typename Fwd_It, typename Interleaved>
+size_t Raw_Encoder<Rnd_It, Fwd_It, Interleaved>::Enc_repair (const uint32_t ESI,
+                                                        Fwd_It &output,
+                                                        const Fwd_It end) const
+{
+    // repair symbol requested.
+    const DenseMtx tmp = repair_symbol (ESI);
+    if (tmp.rows() == 0)
+        return 0;
 
-    using T = typename std::iterator_traits<Fwd_It>::value_type;
-    T al = static_cast<T> (0);
-    uint8_t *p = reinterpret_cast<uint8_t *>  (&al);
-    for (int32_t i = 0; i < tmp.cols(); ++i) {
-        *p = static_cast<uint8_t> (tmp (0, i));
-        ++p;
-        if (p == reinterpret_cast<uint8_t *>  (&al) + sizeof(T)) {
-            *output = al;
-            ++output;
-            al = static_cast<T> (0);
-            p = reinterpret_cast<uint8_t *>  (&al);
-            ++written;
-            if (output == end)
-                return written;
-        }
-    }
-    if (p != reinterpret_cast<uint8_t *>  (&al) + sizeof(T)) {
-        // symbol size is not aligned with Fwd_It type
-        while (p != reinterpret_cast<uint8_t *>  (&al) + sizeof(T))
-            *(p++) = 0;
-        *output = al;
-        ++output;
-        ++written;
-    }
-    return written;
+    // put "tmp" in output, but the alignment is different
+    return put_bytes (output, end, row_ptr (tmp, 0),
+                                        static_cast<size_t> (tmp.cols()));
 }
 
 }   // namespace Impl
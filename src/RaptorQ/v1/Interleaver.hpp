@@ -23,8 +23,11 @@
 #include "RaptorQ/v1/common.hpp"
 #include "RaptorQ/v1/multiplication.hpp"
 #include "RaptorQ/v1/table2.hpp"
+#include "RaptorQ/v1/util/bulk_copy.hpp"
 #include "RaptorQ/v1/util/div.hpp"
+#include <algorithm>
 #include <cmath>
+#include <cstring>
 #include <limits>
 #include <memory>
 #include <tuple>
@@ -98,6 +101,52 @@ private:
     std::pair<uint16_t, uint16_t> _part1, _part2;
 };
 
+//
+// Sub_Block_Plan:
+//      every symbol is made of one sub-symbol per sub-block, and the layout
+//      is the same for all the source blocks. Compute once where each
+//      sub-symbol starts, so that (de)interleaving can copy whole runs
+//      instead of redoing the partition arithmetic for every element.
+//      Offsets and sizes are in alignments.
+//
+class RAPTORQ_LOCAL Sub_Block_Plan
+{
+public:
+    struct Run
+    {
+        // start of the sub-symbol in the symbol. In a source block of
+        // K symbols the sub-block starts at offset * K,
+        // and symbol "esi" has its sub-symbol at offset * K + esi * size
+        uint32_t offset;
+        uint16_t size;
+    };
+
+    Sub_Block_Plan() = default;
+    Sub_Block_Plan (const Sub_Block_Plan&) = default;
+    Sub_Block_Plan& operator= (const Sub_Block_Plan&) = default;
+    Sub_Block_Plan (Sub_Block_Plan&&) = default;
+    Sub_Block_Plan& operator= (Sub_Block_Plan&&) = default;
+    ~Sub_Block_Plan() = default;
+    explicit Sub_Block_Plan (const Partition &sub_blocks)
+    {
+        uint32_t offset = 0;
+        _runs.reserve (sub_blocks.num (0) + sub_blocks.num (1));
+        for (uint8_t part = 0; part < 2; ++part) {
+            if (sub_blocks.size (part) == 0)
+                continue;
+            for (uint16_t blk = 0; blk < sub_blocks.num (part); ++blk) {
+                _runs.push_back ({offset, sub_blocks.size (part)});
+                offset += sub_blocks.size (part);
+            }
+        }
+    }
+
+    const std::vector<Run>& runs() const
+        { return _runs; }
+private:
+    std::vector<Run> _runs;
+};
+
 template <typename T>
 class RAPTORQ_LOCAL Symbol_Wrap
 {
@@ -334,6 +383,11 @@ public:
                                             const uint16_t min_subsymbol_size,
                                             const size_t max_block_decodable,
                                             const uint16_t symbol_syze);
+    // only the size (in bytes) of the object is known, not the data.
+    // Use block_view() for each block once its data is available.
+    Interleaver (const uint64_t size, const uint16_t min_subsymbol_size,
+                                            const size_t max_block_decodable,
+                                            const uint16_t symbol_syze);
     Interleaver() = delete;
     Interleaver (const Interleaver&) = default;
     Interleaver& operator= (const Interleaver&) = default;
@@ -345,6 +399,15 @@ public:
     Interleaver<Rnd_It>& operator++();
     Source_Block<Rnd_It> operator*() const;
     Source_Block<Rnd_It> operator[] (uint8_t source_block_id) const;
+    // write the whole symbol (with padding) as "symbol_size" bytes
+    void copy_symbol (const uint8_t SBN, const uint16_t esi,
+                                                        uint8_t *dst) const;
+    // same partitioning, but the data is only block "SBN", in [from, to).
+    // anything but "SBN" is out of range for the returned interleaver.
+    Interleaver<Rnd_It> block_view (const uint8_t SBN, const Rnd_It from,
+                                                        const Rnd_It to) const;
+    // number of alignments of the data of block "SBN", padding excluded
+    size_t block_data (const uint8_t SBN) const;
     Partition get_partition() const;
     uint16_t source_symbols (const uint8_t SBN) const;
     Block_Size extended_symbols (const uint8_t SBN) const;
@@ -359,12 +422,22 @@ private:
     // TODO: "const" all of the next vars
     uint16_t _sub_blocks, _source_symbols, _iterator_idx = 0;
     uint8_t _alignment, _source_blocks;
+    // object size in alignments, and where _data_from is in the object
+    uint64_t _data_size;
+    size_t _base = 0;
 
     // Please everyone take a moment to tank the RFC6330 guys for
     // giving such wonderfully self-explanatory names to *everything*.
     // Same names are kept to better track the rfc
     // (SIZE, SIZE, BLOCKNUM, BLOCKNUM) for:
     Partition _source_part, _sub_part;
+    Sub_Block_Plan _plan;
+
+    Interleaver (const Interleaver<Rnd_It> &object, const uint8_t SBN,
+                                        const Rnd_It from, const Rnd_It to);
+    void partition (const uint16_t min_subsymbol_size,
+                                                const size_t max_sub_block);
+    size_t block_start (const uint8_t SBN) const;
 };
 
 ///////////////////////////////////
@@ -380,9 +453,49 @@ Interleaver<Rnd_It>::Interleaver (const Rnd_It data_from,
                                             const size_t max_sub_block,
                                             const uint16_t symbol_size)
     :_data_from (data_from), _data_to (data_to), _symbol_size (symbol_size),
-        _alignment (sizeof(typename std::iterator_traits<Rnd_It>::value_type))
+        _alignment (sizeof(typename std::iterator_traits<Rnd_It>::value_type)),
+        _data_size (static_cast<uint64_t> (data_to - data_from))
+{
+    IS_RANDOM(Rnd_It, "RaptorQ__v1::Impl::Interleaver");
+    partition (min_subsymbol_size, max_sub_block);
+}
+
+template <typename Rnd_It>
+Interleaver<Rnd_It>::Interleaver (const uint64_t size,
+                                            const uint16_t min_subsymbol_size,
+                                            const size_t max_sub_block,
+                                            const uint16_t symbol_size)
+    :_data_from(), _data_to(), _symbol_size (symbol_size),
+        _alignment (sizeof(typename std::iterator_traits<Rnd_It>::value_type)),
+        _data_size (size / _alignment)
 {
     IS_RANDOM(Rnd_It, "RaptorQ__v1::Impl::Interleaver");
+    if (size % _alignment != 0) {
+        _alignment = 0;
+        return;
+    }
+    partition (min_subsymbol_size, max_sub_block);
+}
+
+template <typename Rnd_It>
+Interleaver<Rnd_It>::Interleaver (const Interleaver<Rnd_It> &object,
+                                                        const uint8_t SBN,
+                                                        const Rnd_It from,
+                                                        const Rnd_It to)
+    : _data_from (from), _data_to (to), _symbol_size (object._symbol_size),
+        _sub_blocks (object._sub_blocks),
+        _source_symbols (object._source_symbols),
+        _alignment (object._alignment), _source_blocks (object._source_blocks),
+        _data_size (object._data_size),
+        _base (object._base + object.block_start (SBN)),
+        _source_part (object._source_part), _sub_part (object._sub_part),
+        _plan (object._plan)
+{}
+
+template <typename Rnd_It>
+void Interleaver<Rnd_It>::partition (const uint16_t min_subsymbol_size,
+                                                    const size_t max_sub_block)
+{
     // all parameters are in octets
     assert(_symbol_size >= _alignment &&
                     "RaptorQ: symbol_size must be >= alignment");
@@ -457,16 +570,15 @@ Interleaver<Rnd_It>::Interleaver (const Rnd_It data_from,
 
     std::vector<uint16_t> sizes;
     size_t iter_size =sizeof(typename std::iterator_traits<Rnd_It>::value_type);
-    const uint64_t input_size =
-                    static_cast<uint64_t> (_data_to - _data_from) * iter_size;
-    const uint64_t Kt = div_ceil<uint64_t> (input_size, symbol_size);
+    const uint64_t input_size = _data_size * iter_size;
+    const uint64_t Kt = div_ceil<uint64_t> (input_size, _symbol_size);
     const size_t N_max = static_cast<size_t> (div_floor (_symbol_size,
                                                         min_subsymbol_size));
 
     // symbol_size must be a multiple of our alignment
     if (_symbol_size % _alignment != 0 || min_subsymbol_size < _alignment ||
                                     (min_subsymbol_size % _alignment) != 0 ||
-                                            min_subsymbol_size > symbol_size) {
+                                            min_subsymbol_size > _symbol_size) {
         // nonsense configurations. refuse to work.
         _alignment = 0;
         return;
@@ -506,7 +618,8 @@ Interleaver<Rnd_It>::Interleaver (const Rnd_It data_from,
                                 _source_blocks) <= RaptorQ__v1::Impl::K_max &&
                         "RaptorQ: RFC: ceil(ceil(F/T)/Z must be <= K'_max");
     if (_source_blocks == 0 || _sub_blocks == 0 ||
-                    symbol_size < _alignment || symbol_size % _alignment != 0 ||
+                    _symbol_size < _alignment ||
+                                        _symbol_size % _alignment != 0 ||
                         div_ceil<uint64_t> (
                                 div_ceil<uint64_t> (input_size, _symbol_size),
                                 _source_blocks) > RaptorQ__v1::Impl::K_max) {
@@ -520,6 +633,7 @@ Interleaver<Rnd_It>::Interleaver (const Rnd_It data_from,
 
     // blocks and size for sub-block partitioning
     _sub_part = Partition (_symbol_size / _alignment, _sub_blocks);
+    _plan = Sub_Block_Plan (_sub_part);
 }
 
 template <typename Rnd_It>
@@ -529,38 +643,79 @@ Interleaver<Rnd_It>::operator bool() const
     return _alignment != 0;
 }
 
+template <typename Rnd_It>
+size_t Interleaver<Rnd_It>::block_start (const uint8_t SBN) const
+{
+    // in multiples of T, from _data_from
+    const size_t al_symbol_size = symbol_size();
+    if (SBN < _source_part.num(0))
+        return SBN * _source_part.size(0) * al_symbol_size - _base;
+    // all the previous partition, plus some blocks of the new partition
+    return (_source_part.tot(0) +
+                (SBN - _source_part.num(0)) * _source_part.size(1)) *
+                                                        al_symbol_size - _base;
+}
+
+template <typename Rnd_It>
+size_t Interleaver<Rnd_It>::block_data (const uint8_t SBN) const
+{
+    const uint64_t start = _base + block_start (SBN);
+    if (SBN >= blocks() || start >= _data_size)
+        return 0;
+    const uint64_t size = static_cast<uint64_t> (source_symbols (SBN)) *
+                                                                symbol_size();
+    return static_cast<size_t> (std::min<uint64_t> (size, _data_size - start));
+}
+
+template <typename Rnd_It>
+Interleaver<Rnd_It> Interleaver<Rnd_It>::block_view (const uint8_t SBN,
+                                                        const Rnd_It from,
+                                                        const Rnd_It to) const
+    { return Interleaver<Rnd_It> (*this, SBN, from, to); }
+
 template <typename Rnd_It>
 Source_Block<Rnd_It> Interleaver<Rnd_It>::operator[] (
                                                 uint8_t source_block_id) const
 {
     // now we start working with multiples of T.
     // identify the start and end of the requested block.
-    uint16_t al_symbol_size = _symbol_size /
-                    sizeof(typename std::iterator_traits<Rnd_It>::value_type);
+    uint16_t al_symbol_size = symbol_size();
 
-    if (source_block_id < _source_part.num(0)) {
-        size_t sb_start = source_block_id * _source_part.size(0) *
-                                                                al_symbol_size;
-        size_t sb_end = (source_block_id + 1) * _source_part.size(0) *
-                                                                al_symbol_size;
-
-        return Source_Block<Rnd_It> (_data_from, _data_to, sb_start, sb_end, 0,
-                                                    _sub_part, al_symbol_size);
-    } else if (source_block_id - _source_part.num(0) < _source_part.num(1)) {
-        // start == all the previous partition
-        size_t sb_start = _source_part.tot(0) * al_symbol_size +
-                                    // plus some blocks of the new partition
-                                    (source_block_id - _source_part.num(0)) *
-                                        _source_part.size(1) * al_symbol_size;
-        size_t sb_end =  sb_start + _source_part.size(1) * al_symbol_size;
-
-        return Source_Block<Rnd_It> (_data_from, _data_to, sb_start, sb_end, 0,
-                                                    _sub_part, al_symbol_size);
-    } else  {
+    if (source_block_id >= _source_part.num(0) + _source_part.num(1)) {
         assert(false && "RaptorQ: source_block_id out of range");
         return Source_Block<Rnd_It> (_data_from, _data_to, 0, 0, 0, _sub_part,
                                                                 al_symbol_size);
     }
+    const size_t sb_start = block_start (source_block_id);
+    const size_t sb_end = sb_start + source_symbols (source_block_id) *
+                                                                al_symbol_size;
+    return Source_Block<Rnd_It> (_data_from, _data_to, sb_start, sb_end, 0,
+                                                    _sub_part, al_symbol_size);
+}
+
+template <typename Rnd_It>
+void Interleaver<Rnd_It>::copy_symbol (const uint8_t SBN, const uint16_t esi,
+                                                            uint8_t *dst) const
+{
+    using T = typename std::iterator_traits<Rnd_It>::value_type;
+    const size_t K = source_symbols (SBN);
+    const size_t start = block_start (SBN);
+    const size_t data_size = static_cast<size_t> (_data_to - _data_from);
+    for (const auto &run : _plan.runs()) {
+        const size_t idx = start + run.offset * K + esi * run.size;
+        const size_t bytes = run.size * sizeof(T);
+        size_t copied = 0;
+        if (idx < data_size) {
+            #pragma clang diagnostic push
+            #pragma clang diagnostic ignored "-Wsign-conversion"
+            Rnd_It it = _data_from + idx;
+            #pragma clang diagnostic pop
+            copied = RaptorQ__v1::Impl::copy_bytes (it, _data_to, dst, bytes);
+        }
+        // the end of the input is padded with zeros
+        std::memset (dst + copied, 0, bytes - copied);
+        dst += bytes;
+    }
 }
 
 template <typename Rnd_It>
@@ -22,7 +22,12 @@
 
 #include "RaptorQ/v1/common.hpp"
 #include "RaptorQ/v1/Parameters.hpp"
+#include "RaptorQ/v1/gemm.hpp"
+#include "RaptorQ/v1/multiplication.hpp"
 #include "RaptorQ/v1/Octet.hpp"
+#include <cstring>
+#include <memory>
+#include <vector>
 #include <Eigen/Dense>
 
 namespace RaptorQ__v1 {
@@ -31,10 +36,12 @@ namespace Impl {
 using DenseMtx = Eigen::Matrix<Octet, Eigen::Dynamic, Eigen::Dynamic,
                                                             Eigen::RowMajor>;
 
-
-class RAPTORQ_LOCAL Operation
+// One recorded step of the solver. Plain 8 bytes, so that the log
+// is just an array we can replay, copy and serialize as-is.
+// BLOCK and REORDER carry too much data: the record only holds
+// the index of their out-of-line data in "row_1".
+struct RAPTORQ_LOCAL Op_Rec
 {
-public:
     enum class _t : uint8_t {
         NONE = 0x00,
         SWAP = 0x01,
@@ -43,262 +50,491 @@ public:
         BLOCK = 0x04,
         REORDER = 0x05
     };
-    Operation() = delete;
-    Operation (const Operation &rhs)
-        :_type (rhs._type)
-    {
-        switch (rhs._type)
-        {
-        case _t::SWAP:
-            swap = rhs.swap;
-            break;
-        case _t::ADD_MUL:
-            add_mul = rhs.add_mul;
-            break;
-        case _t::DIV:
-            div = rhs.div;
-            break;
-        case _t::BLOCK:
-            block = rhs.block;
-            break;
-        case _t::REORDER:
-            reorder = rhs.reorder;
-            break;
-        case _t::NONE:
-            break;
-        }
+    _t type;
+    uint8_t scalar;
+    uint16_t row_1, row_2;
+    uint16_t _reserved;
+};
+static_assert (sizeof(Op_Rec) == 8, "RaptorQ: Op_Rec must be 8 bytes");
+
+// row kernels on the raw octets.
+// "Octet" is a single uint8_t, so an Eigen row is a plain byte array.
+inline uint8_t* row_ptr (DenseMtx &mtx, const uint16_t row)
+    { return reinterpret_cast<uint8_t *> (mtx.row (row).data()); }
+inline const uint8_t* row_ptr (const DenseMtx &mtx, const uint16_t row)
+    { return reinterpret_cast<const uint8_t *> (mtx.row (row).data()); }
+
+inline void row_add_mul (uint8_t *dst, const uint8_t *src,
+                                        const size_t len, const uint8_t scalar)
+{
+    if (scalar == 0)
+        return;
+    if (scalar == 1) {
+        // most of the operations: plain xor, easy to vectorize
+        for (size_t i = 0; i < len; ++i)
+            dst[i] ^= src[i];
+        return;
     }
-    Operation& operator= (const Operation &rhs)
+    gf256_add_mul (dst, src, len, scalar);
+}
+
+inline void row_div (uint8_t *dst, const size_t len,
+                                                        const uint8_t scalar)
+{
+    if (scalar <= 1)
+        return;
+    // multiply by the inverse
+    const uint8_t *inv = gf256_tables().mul[oct_exp[255 -
+                                                    oct_log[scalar - 1]]];
+    for (size_t i = 0; i < len; ++i)
+        dst[i] = inv[dst[i]];
+}
+
+// a * b, with the GF(256) kernels instead of Eigen's generic product.
+inline DenseMtx mtx_mul (const DenseMtx &a, const DenseMtx &b,
+                                                    const uint16_t threads = 1)
+{
+    DenseMtx ret (a.rows(), b.cols());
+    if (ret.size() == 0)
+        return ret;
+    gf256_gemm (reinterpret_cast<uint8_t *> (ret.data()),
+                                static_cast<size_t> (ret.cols()),
+                                reinterpret_cast<const uint8_t *> (a.data()),
+                                static_cast<size_t> (a.cols()),
+                                reinterpret_cast<const uint8_t *> (b.data()),
+                                static_cast<size_t> (b.cols()),
+                                static_cast<size_t> (a.rows()),
+                                static_cast<size_t> (a.cols()),
+                                static_cast<size_t> (b.cols()), threads);
+    return ret;
+}
+
+// records per chunk of the Op_Log: 32KB each
+constexpr size_t op_chunk_size = 4096;
+
+// out-of-line data of a BLOCK operation.
+// The phase 3 "X" block is mostly zeros, so keep it as a per-row list
+// of (column, value), unless it is dense enough that the plain
+// matrix is smaller.
+class RAPTORQ_LOCAL Op_Block
+{
+public:
+    Op_Block() : rows (0), cols (0) {}
+    explicit Op_Block (const DenseMtx &mtx)
+        : rows (static_cast<uint16_t> (mtx.rows())),
+          cols (static_cast<uint16_t> (mtx.cols()))
     {
-        assert (_type == rhs._type && "Operation types do not correspond.");
-        switch (rhs._type)
-        {
-        case _t::SWAP:
-            swap = rhs.swap;
-            break;
-        case _t::ADD_MUL:
-            add_mul = rhs.add_mul;
-            break;
-        case _t::DIV:
-            div = rhs.div;
-            break;
-        case _t::BLOCK:
-            block = rhs.block;
-            break;
-        case _t::REORDER:
-            reorder = rhs.reorder;
-            break;
-        case _t::NONE:
-            break;
+        const uint8_t *raw = reinterpret_cast<const uint8_t *> (mtx.data());
+        const size_t size = static_cast<size_t> (mtx.size());
+        size_t nonzero = 0;
+        for (size_t idx = 0; idx < size; ++idx)
+            nonzero += (raw[idx] != 0 ? 1 : 0);
+        if (nonzero * (sizeof(uint16_t) + sizeof(uint8_t)) +
+                            (rows + 1u) * sizeof(uint32_t) >= size) {
+            val.assign (raw, raw + size);
+            return;
+        }
+        row_start.reserve (rows + 1u);
+        col.reserve (nonzero);
+        val.reserve (nonzero);
+        for (uint16_t row = 0; row < rows; ++row) {
+            row_start.push_back (static_cast<uint32_t> (col.size()));
+            for (uint16_t c = 0; c < cols; ++c, ++raw) {
+                if (*raw == 0)
+                    continue;
+                col.push_back (c);
+                val.push_back (*raw);
+            }
         }
-        return *this;
+        row_start.push_back (static_cast<uint32_t> (col.size()));
     }
+    bool sparse() const
+        { return !row_start.empty(); }
+
+    uint16_t rows, cols;
+    // sparse: row "r" has entries [row_start[r], row_start[r + 1])
+    // dense: row_start is empty, val has rows * cols elements.
+    std::vector<uint32_t> row_start;
+    std::vector<uint16_t> col;
+    std::vector<uint8_t> val;
+};
+
+// Log of the operations done by the solver, so that we can redo them
+// on a different matrix later (caching).
+// Records are appended to fixed-size chunks: appending never moves
+// what has already been recorded. BLOCK and REORDER data live out-of-line.
+class RAPTORQ_LOCAL Op_Log
+{
+public:
+    Op_Log() : _size (0) {}
+    Op_Log (const Op_Log&) = delete;
+    Op_Log& operator= (const Op_Log&) = delete;
+    Op_Log (Op_Log&&) = default;
+    Op_Log& operator= (Op_Log&&) = default;
+    ~Op_Log() = default;
 
-    Operation (Operation &&rhs)
-        :_type (rhs._type)
+    void swap (const uint16_t row_1, const uint16_t row_2)
+        { push (Op_Rec::_t::SWAP, row_1, row_2, 0); }
+    void add_mul (const uint16_t row_1, const uint16_t row_2,
+                                                            const Octet scalar)
     {
-        switch (rhs._type)
-        {
-        case _t::SWAP:
-            swap = std::move (rhs.swap);
-            break;
-        case _t::ADD_MUL:
-            add_mul = std::move (rhs.add_mul);
-            break;
-        case _t::DIV:
-            div = std::move (rhs.div);
-            break;
-        case _t::BLOCK:
-            block = std::move (rhs.block);
-            break;
-        case _t::REORDER:
-            reorder = std::move (rhs.reorder);
-            break;
-        case _t::NONE:
-            break;
-        }
+        push (Op_Rec::_t::ADD_MUL, row_1, row_2,
+                                            static_cast<uint8_t> (scalar));
+    }
+    void div (const uint16_t row, const Octet scalar)
+        { push (Op_Rec::_t::DIV, row, 0, static_cast<uint8_t> (scalar)); }
+    void block (const DenseMtx &mtx)
+    {
+        push (Op_Rec::_t::BLOCK, static_cast<uint16_t> (_blocks.size()), 0, 0);
+        _blocks.emplace_back (mtx);
+    }
+    void reorder (const std::vector<uint16_t> &order)
+    {
+        push (Op_Rec::_t::REORDER, static_cast<uint16_t> (_orders.size()), 0,
+                                                                            0);
+        _orders.push_back (order);
     }
 
-    Operation& operator= (Operation &&rhs)
+    size_t size() const
+        { return _size; }
+    bool empty() const
+        { return _size == 0; }
+    const Op_Rec& operator[] (const size_t idx) const
+        { return _chunks[idx / op_chunk_size][idx % op_chunk_size]; }
+    // the records stay allocated for the next operations
+    void clear()
     {
-        assert (_type == rhs._type && "Operation types do not correspond.");
-        switch (rhs._type)
-        {
-        case _t::SWAP:
-            swap = std::move (rhs.swap);
-            break;
-        case _t::ADD_MUL:
-            add_mul = std::move (rhs.add_mul);
-            break;
-        case _t::DIV:
-            div = std::move (rhs.div);
-            break;
-        case _t::BLOCK:
-            block = std::move (rhs.block);
-            break;
-        case _t::REORDER:
-            reorder = std::move (rhs.reorder);
-            break;
-        case _t::NONE:
-            break;
-        }
-        return *this;
+        _blocks.clear();
+        _orders.clear();
+        _size = 0;
     }
+    // clear and free all the memory
+    void release()
+    {
+        clear();
+        _chunks = std::vector<std::unique_ptr<Op_Rec[]>>();
+        _blocks = std::vector<Op_Block>();
+        _orders = std::vector<std::vector<uint16_t>>();
+    }
+    // bytes held by the log
+    size_t bytes() const;
 
-    Operation (const _t type, const uint16_t row_1, const uint16_t row_2)
-        : _type (type), swap (row_1, row_2) { assert (type == _t::SWAP); }
-    Operation (const _t type, const uint16_t row_1, const uint16_t row_2,
-                                                            const Octet scalar)
-        : _type (type), add_mul (row_1, row_2, scalar)
-                                            { assert (type == _t::ADD_MUL); }
-    Operation (const _t type, const uint16_t row, const Octet scalar)
-        : _type (type), div (row, scalar) { assert (type == _t::DIV); }
-    Operation (const _t type, const DenseMtx &mtx)
-        : _type (type), block (mtx) { assert (type == _t::BLOCK); }
-    Operation (const _t type, const std::vector<uint16_t> &order)
-        : _type (type), reorder (order) { assert (type == _t::REORDER); }
+    // redo all the operations on "mtx".
+    void replay (DenseMtx &mtx) const;
+
+    // flat representation: header, records, blocks, orders.
+    std::vector<uint8_t> serialize() const;
+    // "rows": rows of the matrices the log will be replayed on.
+    // false (and empty log) if any operation would go out of them.
+    bool deserialize (const uint8_t *raw, const size_t size,
+                                                        const size_t rows);
+    bool deserialize (const std::vector<uint8_t> &raw, const size_t rows)
+        { return deserialize (raw.data(), raw.size(), rows); }
 
-    ~Operation ()
+private:
+    std::vector<std::unique_ptr<Op_Rec[]>> _chunks;
+    std::vector<Op_Block> _blocks;
+    std::vector<std::vector<uint16_t>> _orders;
+    size_t _size;
+
+    bool valid (const size_t rows) const;
+    void push (const Op_Rec::_t type, const uint16_t row_1,
+                                const uint16_t row_2, const uint8_t scalar)
     {
-        if (_type == _t::BLOCK)
-            block.clear();
-        if (_type == _t::REORDER)
-            reorder.clear();
+        const size_t idx = _size % op_chunk_size;
+        const size_t chunk = _size / op_chunk_size;
+        if (chunk == _chunks.size())
+            _chunks.emplace_back (new Op_Rec[op_chunk_size]);
+        Op_Rec &rec = _chunks[chunk][idx];
+        rec.type = type;
+        rec.scalar = scalar;
+        rec.row_1 = row_1;
+        rec.row_2 = row_2;
+        rec._reserved = 0;
+        ++_size;
     }
-
-    void build_mtx (DenseMtx &mtx) const
+    void replay_block (DenseMtx &mtx, const Op_Block &block) const
     {
-        switch (_type)
-        {
-        case _t::SWAP:
-            return swap.build_mtx (mtx);
-        case _t::ADD_MUL:
-            return add_mul.build_mtx (mtx);
-        case _t::DIV:
-            return div.build_mtx (mtx);
-        case _t::BLOCK:
-            return block.build_mtx (mtx);
-        case _t::REORDER:
-            return reorder.build_mtx (mtx);
-        case _t::NONE:
-            break;
+        // first "rows" rows become block * (first "cols" rows)
+        const size_t len = static_cast<size_t> (mtx.cols());
+        const DenseMtx orig = mtx.topRows (block.cols);
+        if (!block.sparse()) {
+            gf256_gemm (reinterpret_cast<uint8_t *> (mtx.data()), len,
+                        block.val.data(), block.cols,
+                        reinterpret_cast<const uint8_t *> (orig.data()), len,
+                                            block.rows, block.cols, len);
+            return;
+        }
+        for (uint16_t row = 0; row < block.rows; ++row) {
+            uint8_t *dst = row_ptr (mtx, row);
+            std::memset (dst, 0, len);
+            for (uint32_t idx = block.row_start[row];
+                                    idx < block.row_start[row + 1u]; ++idx) {
+                row_add_mul (dst, row_ptr (orig, block.col[idx]), len,
+                                                            block.val[idx]);
+            }
         }
     }
-private:
-    Operation (const _t type)
-        :_type (type) {}
-    class RAPTORQ_LOCAL Swap
+    void replay_reorder (DenseMtx &mtx, const std::vector<uint16_t> &order)
+                                                                        const
     {
-    public:
-        Swap (const uint16_t row_1, const uint16_t row_2)
-            : _row_1 (row_1), _row_2 (row_2) {}
-        Swap (const Swap&) = default;
-        Swap& operator= (const Swap&) = default;
-        Swap (Swap &&) = default;
-        Swap& operator= (Swap &&) = default;
-        ~Swap() {}
-        void build_mtx (DenseMtx &mtx) const
-            { mtx.row(_row_1).swap (mtx.row(_row_2)); }
-    private:
-        uint16_t _row_1, _row_2;
-    };
+        DenseMtx ret = DenseMtx (order.size(), mtx.cols());
 
-    class RAPTORQ_LOCAL Add_Mul
-    {
-    public:
-        Add_Mul (const uint16_t row_1, const uint16_t row_2, const Octet scalar)
-            : _row_1 (row_1), _row_2 (row_2), _scalar (scalar) {}
-        Add_Mul (const Add_Mul&) = default;
-        Add_Mul& operator= (const Add_Mul&) = default;
-        Add_Mul (Add_Mul&&) = default;
-        Add_Mul& operator= (Add_Mul&&) = default;
-        ~Add_Mul() {}
-        void build_mtx (DenseMtx &mtx) const
-        {
-            const auto row = mtx.row (_row_2) * _scalar;
-            mtx.row (_row_1) += row;
-        }
-    private:
-        uint16_t _row_1, _row_2;
-        Octet _scalar;
-    };
+        // reorder some of the lines as requested by the order vector
+        uint16_t row = 0;
+        for (const uint16_t pos : order)
+            ret.row (pos) = mtx.row (row++);
+        mtx.swap (ret);
+        // other lines will not influence the computation, ignore them
+    }
+};
 
-    class RAPTORQ_LOCAL Div
-    {
-    public:
-        Div (const uint16_t row_1, const Octet scalar)
-            : _row_1 (row_1), _scalar (scalar) {}
-        Div (const Div&) = default;
-        Div& operator= (const Div&) = default;
-        Div (Div&&) = default;
-        Div& operator= (Div&&) = default;
-        ~Div() {}
-        void build_mtx (DenseMtx &mtx) const
-            { mtx.row (_row_1) /= _scalar; }
-    private:
-        uint16_t _row_1;
-        Octet _scalar;
-    };
+///////////////////////////////////
+//
+// IMPLEMENTATION OF ABOVE CLASS
+//
+///////////////////////////////////
 
-    class RAPTORQ_LOCAL Block
-    {
-    public:
-        Block (const DenseMtx &block)
-            : _block (block) {}
-        Block (const Block&) = default;
-        Block& operator= (const Block&) = default;
-        Block (Block&&) = default;
-        Block& operator= (Block&&) = default;
-        ~Block() {}
-        void build_mtx (DenseMtx &mtx) const
-        {
-            const auto orig = mtx.block (0,0, _block.cols(), mtx.cols());
-            mtx.block (0, 0, _block.cols(), mtx.cols()) = _block * orig;
+inline void Op_Log::replay (DenseMtx &mtx) const
+{
+    size_t left = _size;
+    for (const auto &chunk : _chunks) {
+        const size_t recs = left < op_chunk_size ? left : op_chunk_size;
+        left -= recs;
+        for (const Op_Rec *op = chunk.get(); op != chunk.get() + recs; ++op) {
+            const size_t cols = static_cast<size_t> (mtx.cols());
+            switch (op->type)
+            {
+            case Op_Rec::_t::SWAP:
+                mtx.row (op->row_1).swap (mtx.row (op->row_2));
+                break;
+            case Op_Rec::_t::ADD_MUL:
+                row_add_mul (row_ptr (mtx, op->row_1),
+                                row_ptr (mtx, op->row_2), cols, op->scalar);
+                break;
+            case Op_Rec::_t::DIV:
+                row_div (row_ptr (mtx, op->row_1), cols, op->scalar);
+                break;
+            case Op_Rec::_t::BLOCK:
+                replay_block (mtx, _blocks[op->row_1]);
+                break;
+            case Op_Rec::_t::REORDER:
+                replay_reorder (mtx, _orders[op->row_1]);
+                break;
+            case Op_Rec::_t::NONE:
+                break;
+            }
         }
-        void clear()
-            { _block = DenseMtx(); }
-    private:
-        DenseMtx _block;
-    };
+    }
+}
 
-    class RAPTORQ_LOCAL Reorder
-    {
-    public:
-        Reorder (const std::vector<uint16_t> &order)
-            : _order (order) {}
-        Reorder (const Reorder&) = default;
-        Reorder& operator= (const Reorder&) = default;
-        Reorder (Reorder&&) = default;
-        Reorder& operator= (Reorder&&) = default;
-        ~Reorder() {}
-        void build_mtx (DenseMtx &mtx) const
-        {
-            uint16_t overhead = static_cast<uint16_t> (
-                                static_cast<uint16_t> (mtx.rows()) - _order.size());
-            DenseMtx ret = DenseMtx (mtx.rows() - overhead , mtx.cols());
+inline size_t Op_Log::bytes() const
+{
+    size_t ret = _chunks.size() * op_chunk_size * sizeof(Op_Rec);
+    for (const auto &blk : _blocks) {
+        ret += blk.row_start.capacity() * sizeof(uint32_t) +
+                    blk.col.capacity() * sizeof(uint16_t) + blk.val.capacity();
+    }
+    for (const auto &ord : _orders)
+        ret += ord.capacity() * sizeof(uint16_t);
+    return ret;
+}
+
+inline std::vector<uint8_t> Op_Log::serialize() const
+{
+    // header: 3x uint32_t: records, blocks, orders.
+    // then: records,
+    //  blocks as (uint16_t rows, uint16_t cols, uint32_t values) plus
+    //      sparse: (rows + 1) x uint32_t row_start, values x uint16_t cols,
+    //      then values x uint8_t.
+    //  orders as (uint32_t size, uint16_t...)
+    // native endianness: the cache is local to the machine anyway.
+    size_t bytes = 3 * sizeof(uint32_t) + _size * sizeof(Op_Rec);
+    for (const auto &blk : _blocks) {
+        bytes += 2 * sizeof(uint16_t) + sizeof(uint32_t) +
+                                    blk.row_start.size() * sizeof(uint32_t) +
+                                    blk.col.size() * sizeof(uint16_t) +
+                                    blk.val.size();
+    }
+    for (const auto &ord : _orders)
+        bytes += sizeof(uint32_t) + ord.size() * sizeof(uint16_t);
+
+    std::vector<uint8_t> ret (bytes);
+    uint8_t *out = ret.data();
+    const uint32_t header[3] = { static_cast<uint32_t> (_size),
+                                    static_cast<uint32_t> (_blocks.size()),
+                                    static_cast<uint32_t> (_orders.size()) };
+    std::memcpy (out, header, sizeof(header));
+    out += sizeof(header);
+
+    size_t left = _size;
+    for (const auto &chunk : _chunks) {
+        const size_t recs = left < op_chunk_size ? left : op_chunk_size;
+        left -= recs;
+        std::memcpy (out, chunk.get(), recs * sizeof(Op_Rec));
+        out += recs * sizeof(Op_Rec);
+    }
+    for (const auto &blk : _blocks) {
+        const uint16_t size[2] = { blk.rows, blk.cols };
+        const uint32_t values = static_cast<uint32_t> (blk.val.size());
+        std::memcpy (out, size, sizeof(size));
+        out += sizeof(size);
+        std::memcpy (out, &values, sizeof(values));
+        out += sizeof(values);
+        std::memcpy (out, blk.row_start.data(),
+                                    blk.row_start.size() * sizeof(uint32_t));
+        out += blk.row_start.size() * sizeof(uint32_t);
+        std::memcpy (out, blk.col.data(), blk.col.size() * sizeof(uint16_t));
+        out += blk.col.size() * sizeof(uint16_t);
+        std::memcpy (out, blk.val.data(), blk.val.size());
+        out += blk.val.size();
+    }
+    for (const auto &ord : _orders) {
+        const uint32_t size = static_cast<uint32_t> (ord.size());
+        std::memcpy (out, &size, sizeof(size));
+        out += sizeof(size);
+        std::memcpy (out, ord.data(), ord.size() * sizeof(uint16_t));
+        out += ord.size() * sizeof(uint16_t);
+    }
+    return ret;
+}
+
+inline bool Op_Log::deserialize (const uint8_t *raw, const size_t size,
+                                                            const size_t rows)
+{
+    clear();
+    const uint8_t *in = raw;
+    const uint8_t *const end = raw + size;
+    uint32_t header[3];
+    if (size < sizeof(header))
+        return false;
+    std::memcpy (header, in, sizeof(header));
+    in += sizeof(header);
 
-            // reorder some of the lines as requested by the _order vector
-            uint16_t row = 0;
-            for (const uint16_t pos : _order)
-                ret.row (pos) = mtx.row (row++);
-            mtx.swap (ret);
-            // other lines will not influence the computation, ignore them
+    if (static_cast<size_t> (end - in) < header[0] * sizeof(Op_Rec))
+        return false;
+    for (uint32_t left = header[0]; left > 0;) {
+        const uint32_t recs = left < op_chunk_size ? left :
+                                        static_cast<uint32_t> (op_chunk_size);
+        const size_t chunk = _size / op_chunk_size;
+        if (chunk == _chunks.size())
+            _chunks.emplace_back (new Op_Rec[op_chunk_size]);
+        std::memcpy (_chunks[chunk].get(), in, recs * sizeof(Op_Rec));
+        in += recs * sizeof(Op_Rec);
+        _size += recs;
+        left -= recs;
+    }
+    _blocks.reserve (header[1]);
+    for (uint32_t blk_idx = 0; blk_idx < header[1]; ++blk_idx) {
+        uint16_t blk_size[2];
+        uint32_t values;
+        if (static_cast<size_t> (end - in) < sizeof(blk_size) + sizeof(values))
+            return false;
+        std::memcpy (blk_size, in, sizeof(blk_size));
+        in += sizeof(blk_size);
+        std::memcpy (&values, in, sizeof(values));
+        in += sizeof(values);
+        _blocks.emplace_back();
+        Op_Block &blk = _blocks.back();
+        blk.rows = blk_size[0];
+        blk.cols = blk_size[1];
+        const size_t dense = static_cast<size_t> (blk.rows) * blk.cols;
+        if (values != dense) {
+            // sparse
+            const size_t bytes = (blk.rows + 1u) * sizeof(uint32_t) +
+                                    values * (sizeof(uint16_t) + 1);
+            if (values > dense || static_cast<size_t> (end - in) < bytes)
+                return false;
+            blk.row_start.resize (blk.rows + 1u);
+            std::memcpy (blk.row_start.data(), in,
+                                    blk.row_start.size() * sizeof(uint32_t));
+            in += blk.row_start.size() * sizeof(uint32_t);
+            blk.col.resize (values);
+            std::memcpy (blk.col.data(), in, values * sizeof(uint16_t));
+            in += values * sizeof(uint16_t);
+            if (blk.row_start.back() != values)
+                return false;
+            for (size_t row = 0; row < blk.rows; ++row) {
+                if (blk.row_start[row] > blk.row_start[row + 1])
+                    return false;
+            }
+            for (const uint16_t c : blk.col) {
+                if (c >= blk.cols)
+                    return false;
+            }
         }
-        void clear()
-            { _order = std::vector<uint16_t>(); }
-    private:
-        std::vector<uint16_t> _order;
-    };
+        if (static_cast<size_t> (end - in) < values)
+            return false;
+        blk.val.assign (in, in + values);
+        in += values;
+    }
+    _orders.reserve (header[2]);
+    for (uint32_t ord = 0; ord < header[2]; ++ord) {
+        uint32_t ord_size;
+        if (static_cast<size_t> (end - in) < sizeof(ord_size))
+            return false;
+        std::memcpy (&ord_size, in, sizeof(ord_size));
+        in += sizeof(ord_size);
+        if (static_cast<size_t> (end - in) < ord_size * sizeof(uint16_t))
+            return false;
+        _orders.emplace_back (ord_size);
+        std::memcpy (_orders.back().data(), in, ord_size * sizeof(uint16_t));
+        in += ord_size * sizeof(uint16_t);
+    }
+    if (in != end || !valid (rows)) {
+        clear();
+        return false;
+    }
+    return true;
+}
 
-    const _t _type;
-    union {
-        Swap swap;
-        Add_Mul add_mul;
-        Div div;
-        Block block;
-        Reorder reorder;
-    };
-};
+// the data might come from other processes: check that replaying it
+// never touches anything outside of the matrix.
+inline bool Op_Log::valid (const size_t rows) const
+{
+    // REORDER changes the number of rows for the next operations
+    size_t cur_rows = rows;
+    for (size_t idx = 0; idx < _size; ++idx) {
+        const Op_Rec &op = (*this)[idx];
+        switch (op.type)
+        {
+        case Op_Rec::_t::NONE:
+            break;
+        case Op_Rec::_t::SWAP:
+        case Op_Rec::_t::ADD_MUL:
+            if (op.row_1 >= cur_rows || op.row_2 >= cur_rows)
+                return false;
+            break;
+        case Op_Rec::_t::DIV:
+            if (op.row_1 >= cur_rows)
+                return false;
+            break;
+        case Op_Rec::_t::BLOCK:
+            if (op.row_1 >= _blocks.size() ||
+                                    _blocks[op.row_1].rows > cur_rows ||
+                                    _blocks[op.row_1].cols > cur_rows) {
+                return false;
+            }
+            break;
+        case Op_Rec::_t::REORDER: {
+            if (op.row_1 >= _orders.size())
+                return false;
+            const auto &order = _orders[op.row_1];
+            if (order.size() > cur_rows)
+                return false;
+            for (const uint16_t pos : order) {
+                if (pos >= order.size())
+                    return false;
+            }
+            cur_rows = order.size();
+            break;
+        }
+        default:
+            return false;
+        }
+    }
+    return true;
+}
 
 }   // namespace Impl
 }   // namespace RaptorQ
@@ -24,8 +24,12 @@
 #include "RaptorQ/v1/degree.hpp"
 #include "RaptorQ/v1/Rand.hpp"
 #include "RaptorQ/v1/table2.hpp"
-#include <cmath>
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <Eigen/Core>
+#include <memory>
+#include <mutex>
 #include <vector>
 
 namespace RaptorQ__v1 {
@@ -50,6 +54,39 @@ public:
     uint16_t d, a, b, d1, a1, b1;   // great names. thanks rfc6330!
 };
 
+// 1 as prime, don't care. Not in our scope anyway.
+// C++11 constexpr: single return statements only, so recurse.
+constexpr bool is_prime_from (const uint32_t n, const uint32_t i)
+{
+    return i * i > n ? true :
+                (n % i == 0 || n % (i + 2) == 0) ? false :
+                                                    is_prime_from (n, i + 6);
+}
+constexpr bool is_prime (const uint32_t n)
+{
+    return n <= 3 ? true :
+                    (n % 2 == 0 || n % 3 == 0) ? false : is_prime_from (n, 5);
+}
+constexpr uint16_t next_prime (const uint16_t n)
+    { return is_prime (n) ? n : next_prime (static_cast<uint16_t> (n + 1)); }
+
+static_assert (next_prime (10) == 11 && next_prime (13) == 13 &&
+                                                    next_prime (24) == 29,
+                                                "RaptorQ: next_prime broken");
+
+// everything that depends only on K', one entry per row of table 2.
+// built once, so that creating new Parameters is just a lookup.
+struct RAPTORQ_LOCAL K_Params
+{
+    uint16_t K_padded, S, H, W, L, P, P1, U, B, J;
+    uint32_t tuple_A, tuple_B;  // rfc 6330, pg 30: "A" and "B" for tuple()
+};
+
+// precompute the tuples of the first K' ESIs only for small blocks:
+// there the tuple generation is a sizeable part of the work, and the
+// tables stay small (~12 bytes per symbol)
+constexpr uint16_t tuple_table_max_K = 8192;
+
 class RAPTORQ_API Parameters
 {
 public:
@@ -68,81 +105,135 @@ public:
     uint16_t K_padded, S, H, W, L, P, P1, U, B; // RFC 6330, pg 22
     uint16_t J;
 private:
-    static bool is_prime (const uint16_t n);
+    uint32_t _tuple_A, _tuple_B;
+    // tuples for ESI [0, K_padded), or nullptr
+    const Tuple *_tuples;
+
+    Tuple gen_tuple (const uint32_t ISI) const;
+    static const std::array<K_Params, table_size>& k_params();
+    static const Tuple* tuple_table (const uint16_t K_idx,
+                                                    const Parameters &params);
 };
 
 
-inline Parameters::Parameters (const uint16_t symbols)
+inline const std::array<K_Params, table_size>& Parameters::k_params()
 {
-    uint16_t idx;
-    for (idx = 0; idx < RaptorQ__v1::Impl::K_padded.size(); ++idx) {
-        if (RaptorQ__v1::Impl::K_padded[idx] >= symbols) {
-            K_padded = RaptorQ__v1::Impl::K_padded[idx];
-            break;
+    #pragma clang diagnostic push
+    #pragma clang diagnostic ignored "-Wexit-time-destructors"
+    #pragma clang diagnostic ignored "-Wglobal-constructors"
+    static const std::array<K_Params, table_size> table = [] () {
+        std::array<K_Params, table_size> ret;
+        for (uint16_t idx = 0; idx < table_size; ++idx) {
+            K_Params &k = ret[idx];
+            k.K_padded = RaptorQ__v1::Impl::K_padded[idx];
+            k.J = RaptorQ__v1::Impl::J_K_padded[idx];
+            std::tie (k.S, k.H, k.W) = RaptorQ__v1::Impl::S_H_W[idx];
+            k.L = k.K_padded + k.S + k.H;
+            k.P = k.L - k.W;
+            k.U = k.P - k.H;
+            k.B = k.W - k.S;
+            // first prime number bigger than P.
+            k.P1 = next_prime (static_cast<uint16_t> (k.P + 1));
+            k.tuple_A = 53591 + static_cast<uint32_t> (k.J) * 997;
+            if (k.tuple_A % 2 == 0)
+                ++k.tuple_A;
+            k.tuple_B = 10267 * (static_cast<uint32_t> (k.J) + 1);
         }
-    }
-
-    J = RaptorQ__v1::Impl::J_K_padded[idx];
-    std::tie (S, H, W) = RaptorQ__v1::Impl::S_H_W [idx];
-
-    L = K_padded + S + H;
-    P = L - W;
-    U = P - H;
-    B = W - S;
-    P1 = P + 1;         // first prime number bigger than P. turns out its
-                        // always between 1 and 14 more numbers.
-    while (!is_prime (P1))  // so this while will be really quick anyway
-        ++P1;
+        return ret;
+    } ();
+    #pragma clang diagnostic pop
+    return table;
 }
 
-inline bool Parameters::is_prime (const uint16_t n)
+inline const Tuple* Parameters::tuple_table (const uint16_t K_idx,
+                                                    const Parameters &params)
 {
-    // 1 as prime, don't care. Not in our scope anyway.
-    // thank you stackexchange for the code
-    if (n <= 3)
-        return true;
-    if (n % 2 == 0 || n % 3 == 0)
-        return false;
-
-    uint32_t i = 5;
-    uint32_t w = 2;
-    while (i * i <= n) {
-        if (n % i == 0)
-            return false;
-        i += w;
-        w = 6 - w;
+    #pragma clang diagnostic push
+    #pragma clang diagnostic ignored "-Wexit-time-destructors"
+    #pragma clang diagnostic ignored "-Wglobal-constructors"
+    static std::mutex mtx;
+    static std::array<std::unique_ptr<std::vector<Tuple>>, table_size> tables;
+    static std::array<std::atomic<const Tuple*>, table_size> ready {};
+    #pragma clang diagnostic pop
+
+    if (params.K_padded > tuple_table_max_K)
+        return nullptr;
+    const Tuple *ret = ready[K_idx].load (std::memory_order_acquire);
+    if (ret != nullptr)
+        return ret;
+    std::lock_guard<std::mutex> guard (mtx);
+    RQ_UNUSED(guard);
+    if (tables[K_idx] == nullptr) {
+        std::unique_ptr<std::vector<Tuple>> tmp (new std::vector<Tuple>());
+        tmp->reserve (params.K_padded);
+        for (uint32_t isi = 0; isi < params.K_padded; ++isi)
+            tmp->push_back (params.gen_tuple (isi));
+        tables[K_idx] = std::move (tmp);
+        ready[K_idx].store (tables[K_idx]->data(), std::memory_order_release);
     }
-    return true;
+    return tables[K_idx]->data();
 }
 
+inline Parameters::Parameters (const uint16_t symbols)
+{
+    auto it = std::lower_bound (RaptorQ__v1::Impl::K_padded.begin(),
+                                RaptorQ__v1::Impl::K_padded.end(), symbols);
+    assert (it != RaptorQ__v1::Impl::K_padded.end() &&
+                                            "RaptorQ: too many symbols");
+    if (it == RaptorQ__v1::Impl::K_padded.end())
+        --it;
+    const uint16_t idx = static_cast<uint16_t> (
+                                it - RaptorQ__v1::Impl::K_padded.begin());
+    const K_Params &k = k_params()[idx];
+
+    K_padded = k.K_padded;
+    S = k.S;
+    H = k.H;
+    W = k.W;
+    L = k.L;
+    P = k.P;
+    P1 = k.P1;
+    U = k.U;
+    B = k.B;
+    J = k.J;
+    _tuple_A = k.tuple_A;
+    _tuple_B = k.tuple_B;
+    _tuples = nullptr;
+    _tuples = tuple_table (idx, *this);
+}
 
 inline uint16_t Parameters::Deg (const uint32_t v) const
 {
     // rfc 6330, pg 27
+    // first "d" with v < degree_distribution[d]
+    auto it = std::upper_bound (RaptorQ__v1::Impl::degree_distribution.begin(),
+                            RaptorQ__v1::Impl::degree_distribution.end(), v);
+    if (it == RaptorQ__v1::Impl::degree_distribution.end())
+        return 0;   // never get here, but don't make the compiler complain
+    const uint16_t d = static_cast<uint16_t> (
+                        it - RaptorQ__v1::Impl::degree_distribution.begin());
+    return (d < (W - 2)) ? d : (W - 2);
+}
 
-    for (uint16_t d = 0; d < RaptorQ__v1::Impl::degree_distribution.size();++d){
-        if (v < RaptorQ__v1::Impl::degree_distribution[d])
-            return (d < (W - 2)) ? d : (W - 2);
-    }
-    return 0;   // never get here, but don't make the compiler complain
+inline Tuple Parameters::tuple (const uint32_t ISI) const
+{
+    if (_tuples != nullptr && ISI < K_padded)
+        return _tuples[ISI];
+    return gen_tuple (ISI);
 }
 
-inline Tuple RaptorQ__v1::Impl::Parameters::tuple (const uint32_t ISI) const
+inline Tuple Parameters::gen_tuple (const uint32_t ISI) const
 {
     RaptorQ__v1::Impl::Tuple ret;
 
     // taken straight from RFC6330, pg 30
     // so thank them for the *beautiful* names
     // also, don't get confused with "B": this one is different,
-    // and thus named "B1"
-
-    size_t A = 53591 + J * 997;
+    // and thus named "B1". "A" and "B1" only depend on J,
+    // so they are in the K_Params table
 
-    if (A % 2 == 0)
-        ++A;
-    size_t B1 = 10267 * (J + 1);
-    uint32_t y = static_cast<uint32_t> (B1 + ISI * A);
-    uint32_t v = rnd_get (y, 0, static_cast<uint32_t> (std::pow(2, 20)));
+    const uint32_t y = _tuple_B + ISI * _tuple_A;
+    const uint32_t v = rnd_get (y, 0, uint32_t(1) << 20);
     ret.d = Deg (v);
     ret.a = 1 + static_cast<uint16_t> (rnd_get (y, 1, W - 1));
     ret.b = static_cast<uint16_t> (rnd_get (y, 2, W));
@@ -26,10 +26,14 @@
 #include "RaptorQ/v1/Operation.hpp"
 #include "RaptorQ/v1/Octet.hpp"
 #include "RaptorQ/v1/Parameters.hpp"
+#include "RaptorQ/v1/Shared_Computation/Stats_Registry.hpp"
 #include "RaptorQ/v1/Thread_Pool.hpp"
+#include "RaptorQ/v1/util/Graph.hpp"
 #include <Eigen/Dense>
-#include <deque>
+#include <algorithm>
+#include <array>
 #include <memory>
+#include <vector>
 
 namespace RaptorQ__v1 {
 namespace Impl {
@@ -47,15 +51,26 @@ enum class RAPTORQ_LOCAL Precode_Result : uint8_t {
     FAILED = 2
 };
 
+// phase 2: pivots eliminated together, and how many rows must be able
+// to use the precomputed xor combinations before we build them.
+constexpr uint16_t phase2_panel = 8;
+constexpr size_t phase2_m4ri_rows = 16;
+// Pivot::LOOKAHEAD: rows whose peeling is simulated at each step
+constexpr size_t lookahead_candidates = 64;
+
 template<Save_Computation IS_OFFLINE>
 class RAPTORQ_API Precode_Matrix
 {
-    using Op_Vec = std::deque<Operation>;
+    using Op_Vec = Op_Log;
 public:
     const Parameters _params;
 
-    Precode_Matrix(const Parameters &params)
-        :_params (params)
+    // a "reusable" matrix keeps its LxL base and its scratch matrices
+    // between computations, so that the next gen()/intermediate() on the
+    // same parameters does not allocate. Otherwise everything that is not
+    // needed anymore is freed as soon as possible.
+    Precode_Matrix(const Parameters &params, const bool reusable = false)
+        :_params (params), _reusable (reusable), _graph (0)
     {}
     Precode_Matrix() = delete;
     Precode_Matrix (const Precode_Matrix&) = default;
@@ -65,25 +80,66 @@ public:
     ~Precode_Matrix() = default;
 
     void gen (const uint32_t repair_overhead);
-
+    // bytes held by the matrix and its scratch space
+    size_t bytes() const;
 
     std::pair<Precode_Result, DenseMtx> intermediate (DenseMtx &D, Op_Vec &ops,
                                         bool &keep_working,
                                         const Work_State *thread_keep_working);
-    std::pair<Precode_Result, DenseMtx> intermediate (DenseMtx &D,
+    // same as above, but write the intermediate symbols in "C"
+    Precode_Result intermediate (DenseMtx &D, DenseMtx &C, Op_Vec &ops,
+                                        bool &keep_working,
+                                        const Work_State *thread_keep_working);
+    Precode_Result intermediate (DenseMtx &D, DenseMtx &C,
                                         const Bitmask &mask,
                                         const std::vector<uint32_t> &repair_esi,
                                         Op_Vec &ops, bool &keep_working,
                                         const Work_State *thread_keep_working);
-    DenseMtx get_missing (const DenseMtx &C, const Bitmask &mask) const;
+    // write the missing symbols in the first rows of "missing",
+    // return how many were written.
+    uint16_t get_missing (const DenseMtx &C, const Bitmask &mask,
+                                                    DenseMtx &missing) const;
     DenseMtx encode (const DenseMtx &C, const uint32_t ISI) const;
 
+    // how phase 1 chooses its rows. Any strategy gives the same result.
+    void set_pivot (const Pivot strategy)
+        { _pivot = strategy; }
+    // rows that must be able to use the precomputed xor tables of phase 2
+    // before we build them. 0: always. Any value gives the same result.
+    void set_phase2_table_rows (const size_t rows)
+        { _phase2_table_rows = rows; }
+    // "u" of the last intermediate(): the columns that were inactivated
+    // (the "P" permanently inactivated included), solved in phases 2-5.
+    uint16_t inactivated() const
+        { return _stats.u; }
+    // timings of the last gen() and intermediate(), with i, u and
+    // the number of recorded operations.
+    const Stats& stats() const
+        { return _stats; }
+
 private:
+    const bool _reusable;
     DenseMtx A;
     uint32_t _repair_overhead = 0;
+    // scratch space, kept only if _reusable
+    DenseMtx _base, _X, _D_2;
+    std::vector<uint16_t> _c;
+    std::vector<std::pair<bool, size_t>> _tracking;
+    std::vector<std::pair<uint16_t, uint16_t>> _r_rows;
+    // scratch space for Pivot::LOOKAHEAD
+    struct Lookahead {
+        std::vector<uint32_t> row_first, col_first;
+        std::vector<uint16_t> row_cols, col_rows, degree, queue, candidates;
+        std::vector<uint8_t> col_gone;
+    } _lookahead;
+    Graph _graph;
+    Pivot _pivot = Pivot::RFC;
+    size_t _phase2_table_rows = phase2_m4ri_rows;
+    Stats _stats;
 
     // indenting here prepresent which function needs which other.
     // not standard, ask me if I care.
+    void init_base (DenseMtx &_A) const;
     void init_LDPC1 (DenseMtx &_A, const uint16_t S, const uint16_t B) const;
     void init_LDPC2 (DenseMtx &_A, const uint16_t skip, const uint16_t rows,
                                                     const uint16_t cols) const;
@@ -97,15 +153,24 @@ private:
     void add_G_ENC (DenseMtx &_A) const;
 
     //DenseMtx intermediate (DenseMtx &D, Op_Vec &ops, bool &keep_working);
+    template<typename Row>
+    void encode_row (const DenseMtx &C, const uint32_t ISI, Row &&out) const;
     void decode_phase0 (const Bitmask &mask,
                                     const std::vector<uint32_t> &repair_esi);
     std::tuple<bool, uint16_t, uint16_t> decode_phase1 (DenseMtx &X,DenseMtx &D,
                                         std::vector<uint16_t> &c,
                                         Op_Vec &ops, bool &keep_working,
                                         const Work_State *thread_keep_working);
+        uint16_t phase1_lookahead (const uint16_t i, const uint16_t u);
     bool decode_phase2 (DenseMtx &D, const uint16_t i,const uint16_t u,
                                         Op_Vec &ops, bool &keep_working,
                                         const Work_State *thread_keep_working);
+        void phase2_update (DenseMtx &D, const uint16_t row_start,
+                                const uint16_t row_end,
+                                const uint16_t panel_row,
+                                const uint16_t panel_col, const uint16_t width,
+                            const std::array<uint8_t, phase2_panel> &divisor,
+                            const std::vector<uint8_t> &mult);
     void decode_phase3 (const DenseMtx &X, DenseMtx &D, const uint16_t i,
                                         Op_Vec &ops);
     void decode_phase4 (DenseMtx &D, const uint16_t i, const uint16_t u,
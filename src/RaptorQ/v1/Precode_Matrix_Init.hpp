@@ -40,22 +40,43 @@ namespace Impl {
 template<Save_Computation IS_OFFLINE>
 void Precode_Matrix<IS_OFFLINE>::gen (const uint32_t repair_overhead)
 {
+    const uint64_t start = stats_clock();
+    _stats = Stats();
     _repair_overhead = repair_overhead;
-    DenseMtx _A = DenseMtx (_params.L + repair_overhead, _params.L);
+    if (!_reusable) {
+        A = DenseMtx (_params.L + repair_overhead, _params.L);
+        init_base (A);
+    } else {
+        // the first L rows depend only on K': generate them only once.
+        if (_base.rows() == 0) {
+            _base = DenseMtx (_params.L, _params.L);
+            init_base (_base);
+        }
+        A.resize (_params.L + repair_overhead, _params.L);
+        A.topRows (_params.L) = _base;
+    }
+    // G_ENC only fills up to L rows, but we might have overhead.
+    // initialize it.
+    A.bottomRows (repair_overhead).setZero();
+    _stats.gen = stats_clock() - start;
+}
 
+template<Save_Computation IS_OFFLINE>
+void Precode_Matrix<IS_OFFLINE>::init_base (DenseMtx &_A) const
+{
     init_LDPC1 (_A, _params.S, _params.B);
     add_identity (_A, _params.S, 0, _params.B);
     init_LDPC2 (_A, _params.W, _params.S, _params.P);
     init_HDPC (_A);
     add_identity (_A, _params.H, _params.S, _params.L - _params.H);
     add_G_ENC (_A);
-    // G_ENC only fills up to L rows, but we might have overhead.
-    // initialize it.
-    for (uint16_t row = _params.L; row < A.rows(); ++row) {
-        for (uint16_t col = 0; col < A.cols(); ++col)
-            _A (row, col) = 0;
-    }
-    A = std::move (_A);
+}
+
+template<Save_Computation IS_OFFLINE>
+size_t Precode_Matrix<IS_OFFLINE>::bytes() const
+{
+    return static_cast<size_t> (A.size() + _base.size() + _X.size() +
+                                                            _D_2.size());
 }
 
 template<Save_Computation IS_OFFLINE>
@@ -183,7 +204,7 @@ void Precode_Matrix<IS_OFFLINE>::init_HDPC (DenseMtx &_A) const
     DenseMtx MT = make_MT();
     DenseMtx GAMMA = make_GAMMA();
 
-    _A.block(_params.S, 0, _params.H, GAMMA.rows()) = MT * GAMMA;
+    _A.block(_params.S, 0, _params.H, GAMMA.rows()) = mtx_mul (MT, GAMMA);
 }
 
 template<Save_Computation IS_OFFLINE>
@@ -22,6 +22,7 @@
 
 #include "RaptorQ/v1/Precode_Matrix.hpp"
 #include "RaptorQ/v1/util/Graph.hpp"
+#include "RaptorQ/v1/util/tracepoints.hpp"
 
 ///////////////////
 //
@@ -41,6 +42,20 @@ std::pair<Precode_Result, DenseMtx> Precode_Matrix<IS_OFFLINE>::intermediate (
                                         DenseMtx &D, Op_Vec &ops,
                                         bool &keep_working,
                                         const Work_State *thread_keep_working)
+{
+    DenseMtx C;
+    const auto res = intermediate (D, C, ops, keep_working,
+                                                        thread_keep_working);
+    if (res != Precode_Result::DONE)
+        return std::make_pair (res, DenseMtx());
+    return std::make_pair (res, std::move (C));
+}
+
+template <Save_Computation IS_OFFLINE>
+Precode_Result Precode_Matrix<IS_OFFLINE>::intermediate (DenseMtx &D,
+                                        DenseMtx &C, Op_Vec &ops,
+                                        bool &keep_working,
+                                        const Work_State *thread_keep_working)
 {
     // rfc 6330, pg 32
     // "c" and "d" are used to track row and columns exchange.
@@ -49,49 +64,81 @@ std::pair<Precode_Result, DenseMtx> Precode_Matrix<IS_OFFLINE>::intermediate (
     // than actually having "d". so we're left only with "c",
     // which is needed 'cause D does not have _params.L columns.
 
-    std::vector<uint16_t> c;
+    std::vector<uint16_t> &c = _c;
 
     c.clear();
     c.reserve (_params.L);
-    DenseMtx C, X = A;
+    _X = A;
 
     bool success;
     uint16_t i, u;
     for (i = 0; i < _params.L; ++i)
         c.emplace_back (i);
+    _stats.i = 0;
+    _stats.u = 0;
+    uint64_t start = stats_clock(), now;
 
     DenseMtx CP_D;
     if (debug)
         CP_D = D;
-    std::tie (success, i, u) = decode_phase1 (X, D, c , ops,
+    RQ_TRACE3 (decode_phase_entry, 1, D.rows(), D.cols());
+    std::tie (success, i, u) = decode_phase1 (_X, D, c , ops,
                                             keep_working, thread_keep_working);
+    now = stats_clock();
+    _stats.phase[1] = now - start;
+    RQ_TRACE2 (decode_phase_exit, 1, _stats.phase[1]);
+    start = now;
     if (stop (keep_working, thread_keep_working))
-        return std::make_pair (Precode_Result::STOPPED, DenseMtx());
+        return Precode_Result::STOPPED;
     if (!success)
-        return std::make_pair (Precode_Result::FAILED, DenseMtx());
+        return Precode_Result::FAILED;
+    _stats.i = i;
+    _stats.u = u;
 
+    RQ_TRACE3 (decode_phase_entry, 2, D.rows(), D.cols());
     success = decode_phase2 (D, i, u, ops, keep_working, thread_keep_working);
+    now = stats_clock();
+    _stats.phase[2] = now - start;
+    RQ_TRACE2 (decode_phase_exit, 2, _stats.phase[2]);
+    start = now;
     if (stop (keep_working, thread_keep_working))
-        return std::make_pair (Precode_Result::STOPPED, DenseMtx());
+        return Precode_Result::STOPPED;
     if (!success)
-        return std::make_pair (Precode_Result::FAILED, DenseMtx());
+        return Precode_Result::FAILED;
     // A now should be considered as being LxL from now
-    decode_phase3 (X, D, i, ops);
+    RQ_TRACE3 (decode_phase_entry, 3, D.rows(), D.cols());
+    decode_phase3 (_X, D, i, ops);
+    now = stats_clock();
+    _stats.phase[3] = now - start;
+    RQ_TRACE2 (decode_phase_exit, 3, _stats.phase[3]);
+    start = now;
     if (stop (keep_working, thread_keep_working))
-        return std::make_pair (Precode_Result::STOPPED, DenseMtx());
+        return Precode_Result::STOPPED;
 
-    X = DenseMtx ();    // free some memory, X is not needed anymore.
+    if (!_reusable) {
+        // free some memory, X is not needed anymore.
+        _X = DenseMtx();
+        _D_2 = DenseMtx();
+    }
+    RQ_TRACE3 (decode_phase_entry, 4, D.rows(), D.cols());
     decode_phase4 (D, i, u, ops, keep_working, thread_keep_working);
+    now = stats_clock();
+    _stats.phase[4] = now - start;
+    RQ_TRACE2 (decode_phase_exit, 4, _stats.phase[4]);
+    start = now;
     if (stop (keep_working, thread_keep_working))
-        return std::make_pair (Precode_Result::STOPPED, DenseMtx());
+        return Precode_Result::STOPPED;
     if (!success)
-        return std::make_pair (Precode_Result::FAILED, DenseMtx());
+        return Precode_Result::FAILED;
 
+    RQ_TRACE3 (decode_phase_entry, 5, D.rows(), D.cols());
     decode_phase5 (D, i, ops, keep_working, thread_keep_working);
+    _stats.phase[5] = stats_clock() - start;
+    RQ_TRACE2 (decode_phase_exit, 5, _stats.phase[5]);
     if (stop (keep_working, thread_keep_working))
-        return std::make_pair (Precode_Result::STOPPED, DenseMtx());
+        return Precode_Result::STOPPED;
     if (!success)
-        return std::make_pair (Precode_Result::FAILED, DenseMtx());
+        return Precode_Result::FAILED;
 
     // A now must be an LxL identity matrix: check it.
     // CHECK DISABLED: phase4  does not modify A, as it's never readed
@@ -103,55 +150,61 @@ std::pair<Precode_Result, DenseMtx> Precode_Matrix<IS_OFFLINE>::intermediate (
     //          return C;
     //  }
     //}
-    A = DenseMtx(); // free A memory.
+    if (!_reusable)
+        A = DenseMtx(); // free A memory.
 
     if (IS_OFFLINE == Save_Computation::ON)
-        ops.emplace_back (Operation::_t::REORDER, c);
+        ops.reorder (c);
+    _stats.operations = static_cast<uint32_t> (ops.size());
 
-    C = DenseMtx (_params.L, D.cols());
+    C.resize (_params.L, D.cols());
     for (i = 0; i < _params.L; ++i)
         C.row (c[i]) = D.row (i);
 
     if (debug && ops.size() != 0) {
         DenseMtx test_off (D.rows(), D.rows());
         test_off.setIdentity (CP_D.rows(), CP_D.rows());
-        for (const auto &op : ops)
-            op.build_mtx (test_off);
+        ops.replay (test_off);
         DenseMtx test_res = test_off * CP_D;
         assert (test_res == C && "RQ: I'm different!");
     }
-    return std::make_pair (Precode_Result::DONE, C);
+    return Precode_Result::DONE;
 }
 
 template <Save_Computation IS_OFFLINE>
-std::pair<Precode_Result, DenseMtx> Precode_Matrix<IS_OFFLINE>::intermediate (
-                                        DenseMtx &D, const Bitmask &mask,
+Precode_Result Precode_Matrix<IS_OFFLINE>::intermediate (DenseMtx &D,
+                                        DenseMtx &C, const Bitmask &mask,
                                         const std::vector<uint32_t> &repair_esi,
                                         Op_Vec &ops, bool &keep_working,
                                         const Work_State *thread_keep_working)
 {
+    const uint64_t start = stats_clock();
+    RQ_TRACE3 (decode_phase_entry, 0, D.rows(), D.cols());
     decode_phase0 (mask, repair_esi);
-    return intermediate (D, ops, keep_working, thread_keep_working);
+    _stats.phase[0] = stats_clock() - start;
+    RQ_TRACE2 (decode_phase_exit, 0, _stats.phase[0]);
+    return intermediate (D, C, ops, keep_working, thread_keep_working);
 }
 
 template <Save_Computation IS_OFFLINE>
-DenseMtx Precode_Matrix<IS_OFFLINE>::get_missing (const DenseMtx &C,
-                                                      const Bitmask &mask) const
+uint16_t Precode_Matrix<IS_OFFLINE>::get_missing (const DenseMtx &C,
+                                                    const Bitmask &mask,
+                                                    DenseMtx &missing) const
 {
     if (C.rows() == 0)
-        return C;
-    DenseMtx missing = DenseMtx (mask.get_holes(), C.cols());
+        return 0;
     uint16_t holes = mask.get_holes();
+    if (missing.rows() < holes || missing.cols() != C.cols())
+        missing.resize (holes, C.cols());
     uint16_t row = 0;
     for (uint16_t hole = 0; hole < mask._max_nonrepair && holes > 0; ++hole) {
         if (mask.exists (hole))
             continue;
-        DenseMtx ret = encode (C, hole);
-        missing.row (row) = ret.row (0);
+        encode_row (C, hole, missing.row (row));
         ++row;
         --holes;
     }
-    return missing;
+    return row;
 }
 
 template <Save_Computation IS_OFFLINE>
@@ -223,14 +276,16 @@ std::tuple<bool, uint16_t, uint16_t>
 {
     // rfc6330, page 33
 
-    std::vector<std::pair<bool, size_t>> tracking;  // is_hdpc, row_degree
+    // is_hdpc, row_degree
+    std::vector<std::pair<bool, size_t>> &tracking = _tracking;
 
     // optimization: r_rows tracks the rows that can be chosen, and if the row
     // is added to the graph, track also the id of one of the nodes with "1",
     // so that it will be easy to verify it. The row represents an edge
     // between nodes (1) of a maximum component (see rfc 6330, pg 33-34)
-    std::vector<std::pair<uint16_t, uint16_t>> r_rows;
+    std::vector<std::pair<uint16_t, uint16_t>> &r_rows = _r_rows;
 
+    tracking.clear();
     tracking.reserve (static_cast<size_t> (A.rows()));
 
     uint16_t i = 0;
@@ -256,7 +311,8 @@ std::tuple<bool, uint16_t, uint16_t>
         uint16_t non_zero = static_cast<uint16_t> (V.cols()) + 1;
         bool only_two_ones = false;
         r_rows.clear();
-        Graph G = Graph (static_cast<uint16_t> (V.cols()));
+        Graph &G = _graph;
+        G.reset (static_cast<uint16_t> (V.cols()));
 
         // build graph, get minimum non_zero and track rows that
         // will be needed later
@@ -323,7 +379,9 @@ std::tuple<bool, uint16_t, uint16_t>
         if (non_zero == V.cols() + 1)
             return std::tuple<bool,uint16_t,uint16_t> (false, 0, 0); // failure
         // search for r.
-        if (non_zero != 2) {
+        if (_pivot == Pivot::LOOKAHEAD && non_zero > 1) {
+            chosen = phase1_lookahead (i, u);
+        } else if (non_zero != 2) {
             // search for row with minimum original degree.
             // Precedence to non-hdpc
             uint16_t min_row = static_cast<uint16_t> (V.rows());
@@ -373,7 +431,7 @@ std::tuple<bool, uint16_t, uint16_t>
             D.row (i).swap (D.row (chosen + i));
             std::swap (tracking[i], tracking[chosen + i]);
             if (IS_OFFLINE == Save_Computation::ON)
-                ops.emplace_back (Operation::_t::SWAP, i, chosen + i);
+                ops.swap (i, static_cast<uint16_t> (chosen + i));
         }
         // column swap in A. looking at the first V row,
         // the first column must be nonzero, and the other non-zero must be
@@ -416,8 +474,7 @@ std::tuple<bool, uint16_t, uint16_t>
                 A.row (row + i) += A.row (i) * multiple;
                 D.row (row + i) += D.row (i) * multiple;    //rfc6330, pg32
                 if (IS_OFFLINE == Save_Computation::ON) {
-                    ops.emplace_back (Operation::_t::ADD_MUL, row + i, i,
-                                                                    multiple);
+                    ops.add_mul (static_cast<uint16_t> (row + i), i, multiple);
                 }
             }
         }
@@ -430,6 +487,125 @@ std::tuple<bool, uint16_t, uint16_t>
     return std::make_tuple (true, i, u);
 }
 
+template <Save_Computation IS_OFFLINE>
+uint16_t Precode_Matrix<IS_OFFLINE>::phase1_lookahead (const uint16_t i,
+                                                        const uint16_t u)
+{
+    // Pivot::LOOKAHEAD: all the "r" non-zero columns of the chosen row leave
+    // V. After that, every row left with a single non-zero is a pivot that
+    // needs no inactivation, and removes one more column (peeling).
+    // From r_rows choose the row whose columns start the longest peeling.
+    // Non-HDPC rows still come first, ties go to the lowest original degree.
+    // Each simulation costs as much as the non-zeros of V, so only the
+    // first "lookahead_candidates" rows in that order are simulated.
+    const auto V = A.block (i, i, A.rows() - i, (A.cols() - i) - u);
+    const uint16_t rows = static_cast<uint16_t> (V.rows());
+    const uint16_t cols = static_cast<uint16_t> (V.cols());
+    const auto &tracking = _tracking;
+    Lookahead &la = _lookahead;
+
+    bool have_non_hdpc = false;
+    for (const auto &row_pair : _r_rows)
+        have_non_hdpc = have_non_hdpc || !tracking[row_pair.first + i].first;
+    la.candidates.clear();
+    for (const auto &row_pair : _r_rows) {
+        if (!have_non_hdpc || !tracking[row_pair.first + i].first)
+            la.candidates.push_back (row_pair.first);
+    }
+    auto by_degree = [&tracking, i] (const uint16_t a, const uint16_t b) {
+        return tracking[a + i].second < tracking[b + i].second;
+    };
+    if (la.candidates.size() > lookahead_candidates) {
+        std::partial_sort (la.candidates.begin(),
+                            la.candidates.begin() + lookahead_candidates,
+                            la.candidates.end(), by_degree);
+        la.candidates.resize (lookahead_candidates);
+    }
+    if (la.candidates.size() == 1)
+        return la.candidates[0];
+
+    // V as lists: the non-zero columns of each row, the rows of each column
+    la.row_first.assign (rows + 1, 0);
+    la.col_first.assign (cols + 1, 0);
+    la.row_cols.clear();
+    for (uint16_t row = 0; row < rows; ++row) {
+        const uint8_t *v = row_ptr (A, row + i) + i;
+        uint16_t col = 0;
+        while (col < cols) {
+            // V is sparse: skip the zeros 8 at a time
+            if (cols - col >= 8) {
+                uint64_t word;
+                std::memcpy (&word, v + col, sizeof(word));
+                if (word == 0) {
+                    col += 8;
+                    continue;
+                }
+            }
+            if (v[col] != 0) {
+                la.row_cols.push_back (col);
+                ++la.col_first[col + 1];
+            }
+            ++col;
+        }
+        la.row_first[row + 1] = static_cast<uint32_t> (la.row_cols.size());
+    }
+    for (uint16_t col = 0; col < cols; ++col)
+        la.col_first[col + 1] += la.col_first[col];
+    la.col_rows.resize (la.row_cols.size());
+    la.degree.assign (cols, 0);   // fill position for each column
+    for (uint16_t row = 0; row < rows; ++row) {
+        for (uint32_t idx = la.row_first[row]; idx < la.row_first[row + 1];
+                                                                        ++idx) {
+            const uint16_t col = la.row_cols[idx];
+            la.col_rows[la.col_first[col] + la.degree[col]++] = row;
+        }
+    }
+    la.degree.resize (rows);   // from now on: non-zeros of each row
+
+    auto remove_col = [&la] (const uint16_t col) {
+        if (la.col_gone[col] != 0)
+            return;
+        la.col_gone[col] = 1;
+        for (uint32_t idx = la.col_first[col]; idx < la.col_first[col + 1];
+                                                                        ++idx) {
+            const uint16_t row = la.col_rows[idx];
+            if (--la.degree[row] == 1)
+                la.queue.push_back (row);
+        }
+    };
+    uint16_t chosen = rows;
+    size_t best_score = 0;
+    for (const uint16_t candidate : la.candidates) {
+        for (uint16_t row = 0; row < rows; ++row) {
+            la.degree[row] = static_cast<uint16_t> (la.row_first[row + 1] -
+                                                        la.row_first[row]);
+        }
+        la.col_gone.assign (cols, 0);
+        la.queue.clear();
+        for (uint32_t idx = la.row_first[candidate];
+                                idx < la.row_first[candidate + 1]; ++idx) {
+            remove_col (la.row_cols[idx]);
+        }
+        size_t score = 0;
+        for (size_t next = 0; next < la.queue.size(); ++next) {
+            const uint16_t row = la.queue[next];
+            if (la.degree[row] != 1)
+                continue;   // its last column went with another row
+            uint32_t idx = la.row_first[row];
+            while (la.col_gone[la.row_cols[idx]] != 0)
+                ++idx;
+            remove_col (la.row_cols[idx]);
+            ++score;
+        }
+        if (chosen == rows || score > best_score ||
+                    (score == best_score && by_degree (candidate, chosen))) {
+            chosen = candidate;
+            best_score = score;
+        }
+    }
+    return chosen;
+}
+
 template<Save_Computation IS_OFFLINE>
 bool Precode_Matrix<IS_OFFLINE>::decode_phase2 (DenseMtx &D, const uint16_t i,
                                         const uint16_t u, Op_Vec &ops,
@@ -443,57 +619,77 @@ bool Precode_Matrix<IS_OFFLINE>::decode_phase2 (DenseMtx &D, const uint16_t i,
     const uint16_t col_start = static_cast<uint16_t> (A.cols() - u);
     // try to bring U_Lower to Identity with gaussian elimination.
     // remember that all row swaps affect A as well, not just U_Lower
-
-    for (uint16_t row = row_start; row < row_end; ++row) {
-        if (stop (keep_working, thread_keep_working))
-            return false; // stop
-        // make sure the considered row has nonzero on the diagonal
-        uint16_t row_nonzero = row;
-        const uint16_t col_diag = col_start + (row - row_start);
-        if (col_diag >= _params.L)
-            break;
-        for (; row_nonzero < row_end; ++row_nonzero) {
-            if (static_cast<uint8_t> (A (row_nonzero, col_diag)) != 0) {
-                break;
+    //
+    // Blocked elimination: pivots are taken "phase2_panel" columns at a time.
+    // Only the columns of the panel are eliminated right away, so the pivots,
+    // the swaps and the saved operations are the same of the plain
+    // row-by-row elimination. The multipliers are kept, and the rest of
+    // each row (A right of the panel, and D) is updated once per panel.
+    // Everything left of U_Lower is already zero.
+    if (col_start >= _params.L)
+        return true;
+    const uint16_t rows = row_end - row_start;
+    const uint16_t pivots = std::min<uint16_t> (rows, _params.L - col_start);
+
+    std::vector<uint8_t> mult;
+    std::array<uint8_t, phase2_panel> divisor;
+    for (uint16_t first = 0; first < pivots; first += phase2_panel) {
+        const uint16_t width = std::min<uint16_t> (phase2_panel,
+                                                            pivots - first);
+        const uint16_t panel_col = col_start + first;
+        const uint16_t panel_row = row_start + first;
+        // mult[(row - row_start) * width + j]: multiple of pivot "j"
+        // subtracted from "row". Moved together with the rows.
+        mult.assign (static_cast<size_t> (rows) * width, 0);
+        for (uint16_t j = 0; j < width; ++j) {
+            if (stop (keep_working, thread_keep_working))
+                return false; // stop
+            // make sure the considered row has nonzero on the diagonal
+            const uint16_t row = panel_row + j;
+            const uint16_t col_diag = panel_col + j;
+            uint16_t row_nonzero = row;
+            for (; row_nonzero < row_end; ++row_nonzero) {
+                if (static_cast<uint8_t> (A (row_nonzero, col_diag)) != 0)
+                    break;
+            }
+            if (row_nonzero == row_end) {
+                // U_Lower is square, return early (rank < u, not solvable)
+                return false;
+            } else if (row != row_nonzero) {
+                A.row (row).swap (A.row (row_nonzero));
+                D.row (row).swap (D.row (row_nonzero));
+                uint8_t *m = mult.data() + (row - row_start) * width;
+                std::swap_ranges (m, m + width, mult.data() +
+                                            (row_nonzero - row_start) * width);
+                if (IS_OFFLINE == Save_Computation::ON)
+                    ops.swap (row, row_nonzero);
             }
-        }
-        if (row_nonzero == row_end) {
-            // U_Lower is square, we can return early (rank < u, not solvable)
-            return false;
-        } else if (row != row_nonzero) {
-            A.row (row).swap (A.row (row_nonzero));
-            D.row (row).swap (D.row (row_nonzero));
-            if (IS_OFFLINE == Save_Computation::ON)
-                ops.emplace_back (Operation::_t::SWAP, row, row_nonzero);
-        }
-
-        // U_Lower (row, row) != 0. make it 1.
-        if (static_cast<uint8_t> (A (row, col_diag)) > 1) {
-            const auto divisor = A (row, col_diag);
-            A.row (row) /= divisor;
-            D.row (row) /= divisor;
-            if (IS_OFFLINE == Save_Computation::ON)
-                ops.emplace_back (Operation::_t::DIV, row, divisor);
-        }
 
-        // make U_Lower and identity up to row
-        for (uint16_t del_row = row_start; del_row < row_end; ++del_row) {
-            if (stop (keep_working, thread_keep_working))
-                return false;   // stop
-            if (del_row == row)
-                continue;
-            // subtract row "row" to "del_row" enough times to make
-            // row "del_row" start with zero. but row "row" now starts
-            // with "1", so this is easy.
-            const auto multiple = A (del_row, col_diag);
-            if (static_cast<uint8_t> (multiple) != 0) {
-                A.row (del_row) -= A.row (row) * multiple;
-                D.row (del_row) -= D.row (row) * multiple;
+            // U_Lower (row, row) != 0. make it 1.
+            uint8_t *pivot = row_ptr (A, row) + panel_col;
+            divisor[j] = pivot[j];
+            if (divisor[j] > 1) {
+                row_div (pivot, width, divisor[j]);
                 if (IS_OFFLINE == Save_Computation::ON)
-                    ops.emplace_back (Operation::_t::ADD_MUL, del_row, row,
-                                                                    multiple);
+                    ops.div (row, Octet (divisor[j]));
+            }
+
+            // make U_Lower and identity up to row, in the panel only
+            for (uint16_t del_row = row_start; del_row < row_end; ++del_row) {
+                if (del_row == row)
+                    continue;
+                uint8_t *dst = row_ptr (A, del_row) + panel_col;
+                const uint8_t multiple = dst[j];
+                if (multiple != 0) {
+                    row_add_mul (dst, pivot, width, multiple);
+                    mult[(del_row - row_start) * width + j] = multiple;
+                    if (IS_OFFLINE == Save_Computation::ON)
+                        ops.add_mul (del_row, row, Octet (multiple));
+                }
             }
         }
+        phase2_update (D, row_start, row_end, panel_row, panel_col, width,
+                                                            divisor, mult);
     }
     // A should be resized to LxL.
     // we don't really care, as we should not gain that much.
@@ -501,6 +697,132 @@ bool Precode_Matrix<IS_OFFLINE>::decode_phase2 (DenseMtx &D, const uint16_t i,
     return true;
 }
 
+template<Save_Computation IS_OFFLINE>
+void Precode_Matrix<IS_OFFLINE>::phase2_update (DenseMtx &D,
+                            const uint16_t row_start, const uint16_t row_end,
+                            const uint16_t panel_row, const uint16_t panel_col,
+                            const uint16_t width,
+                            const std::array<uint8_t, phase2_panel> &divisor,
+                            const std::vector<uint8_t> &mult)
+{
+    // rest of the rows: A right of the panel, and D.
+    // P_j is the row of the "j" pivot, "m" the kept multipliers.
+    const uint16_t a_from = panel_col + width;
+    const size_t a_len = static_cast<size_t> (A.cols()) - a_from;
+    const size_t d_len = static_cast<size_t> (D.cols());
+    const Gf256_Kernel kernel = gf256_kernel();
+
+    // dst ^= sum (m[dst][j] * P_j), for j in [from, to)
+    // the source rows are read 4 at a time.
+    auto add_pivots = [&] (const uint16_t dst, const uint16_t from,
+                                                        const uint16_t to) {
+        const uint8_t *m = mult.data() + (dst - row_start) * width;
+        const uint8_t *src_a[4], *src_d[4];
+        uint8_t scalar[4];
+        size_t queued = 0;
+        for (uint16_t j = from; j <= to; ++j) {
+            if (queued == 4 || (j == to && queued != 0)) {
+                kernel (row_ptr (A, dst) + a_from, src_a, scalar, queued,
+                                                                        a_len);
+                kernel (row_ptr (D, dst), src_d, scalar, queued, d_len);
+                queued = 0;
+            }
+            if (j == to || m[j] == 0)
+                continue;
+            src_a[queued] = row_ptr (A, panel_row + j) + a_from;
+            src_d[queued] = row_ptr (D, panel_row + j);
+            scalar[queued++] = m[j];
+        }
+    };
+
+    // 1: the pivots as they were when they were used:
+    //      P_j = (P_j - sum (m[P_j][j'] * P_j')) / divisor[j], j' < j
+    for (uint16_t j = 0; j < width; ++j) {
+        add_pivots (panel_row + j, 0, j);
+        row_div (row_ptr (A, panel_row + j) + a_from, a_len, divisor[j]);
+        row_div (row_ptr (D, panel_row + j), d_len, divisor[j]);
+    }
+
+    // 2: all other rows. Most multipliers are 0/1 (GF(2)): for groups of 4
+    // pivots we precompute all 16 xor combinations (Gray code, one xor each)
+    // if enough rows can use them, so each of those rows needs one xor
+    // per group (M4RI). The others get the GF(256) kernel.
+    constexpr uint16_t group = 4;
+    const size_t stride = a_len + d_len;
+    std::vector<uint8_t> table;
+    std::array<bool, phase2_panel / group> use_table;
+    auto binary = [&] (const uint16_t row, const uint16_t g) -> uint16_t {
+        // bitmask of the group multipliers, or 0 if not all 0/1
+        const uint8_t *m = mult.data() + (row - row_start) * width;
+        uint16_t mask = 0;
+        for (uint16_t j = g * group; j < std::min<uint16_t> (width,
+                                                    (g + 1) * group); ++j) {
+            if (m[j] > 1)
+                return 0;
+            mask |= static_cast<uint16_t> (m[j] << (j - g * group));
+        }
+        return mask;
+    };
+    const uint16_t groups = (width + group - 1) / group;
+    bool any_table = false;
+    for (uint16_t g = 0; g < groups; ++g) {
+        size_t users = 0;
+        for (uint16_t row = row_start; row < row_end; ++row) {
+            if (row >= panel_row && row < panel_row + width)
+                continue;
+            const uint16_t mask = binary (row, g);
+            if (mask != 0 && (mask & (mask - 1)) != 0)
+                ++users;
+        }
+        use_table[g] = users >= _phase2_table_rows;
+        any_table = any_table || use_table[g];
+    }
+    if (any_table)
+        table.resize (groups * (size_t (1) << group) * stride);
+    for (uint16_t g = 0; g < groups; ++g) {
+        if (!use_table[g])
+            continue;
+        uint8_t *tbl = table.data() + g * (size_t (1) << group) * stride;
+        const uint16_t size = std::min<uint16_t> (group, width - g * group);
+        std::fill (tbl, tbl + stride, 0);
+        for (uint16_t mask = 1; mask < (1 << size); ++mask) {
+            // gray code: entry = previous entry ^ one pivot
+            const uint16_t gray = mask ^ (mask >> 1);
+            const uint16_t prev = (mask - 1) ^ ((mask - 1) >> 1);
+            uint16_t bit = 0;
+            while (((gray ^ prev) >> bit) != 1)
+                ++bit;
+            const uint16_t pivot = panel_row + g * group + bit;
+            uint8_t *dst = tbl + gray * stride;
+            std::memcpy (dst, tbl + prev * stride, stride);
+            row_add_mul (dst, row_ptr (A, pivot) + a_from, a_len, 1);
+            row_add_mul (dst + a_len, row_ptr (D, pivot), d_len, 1);
+        }
+    }
+    for (uint16_t row = row_start; row < row_end; ++row) {
+        if (row >= panel_row && row < panel_row + width)
+            continue;
+        uint16_t from = 0;
+        for (uint16_t g = 0; g < groups; ++g) {
+            const uint16_t mask = use_table[g] ? binary (row, g) : 0;
+            if (mask == 0)
+                continue;
+            // table for this group: do the kernel for the ones before it
+            add_pivots (row, from, g * group);
+            from = std::min<uint16_t> (width, (g + 1) * group);
+            const uint8_t *entry = table.data() +
+                        (g * (size_t (1) << group) + mask) * stride;
+            row_add_mul (row_ptr (A, row) + a_from, entry, a_len, 1);
+            row_add_mul (row_ptr (D, row), entry + a_len, d_len, 1);
+        }
+        add_pivots (row, from, width);
+    }
+
+    // 3: the pivots get the pivots that came after them.
+    for (uint16_t j = 0; j < width; ++j)
+        add_pivots (panel_row + j, j + 1, width);
+}
+
 template<Save_Computation IS_OFFLINE>
 void Precode_Matrix<IS_OFFLINE>::decode_phase3 (const DenseMtx &X, DenseMtx &D,
                                                 const uint16_t i, Op_Vec &ops)
@@ -513,17 +835,25 @@ void Precode_Matrix<IS_OFFLINE>::decode_phase3 (const DenseMtx &X, DenseMtx &D,
     //  matrix U_upper is transformed to a sparse form.
     const auto sub_X = X.block (0, 0, i, i);
     if (IS_OFFLINE == Save_Computation::ON)
-        ops.emplace_back (Operation::_t::BLOCK, sub_X);
-
-    auto sub_A = A.block (0, 0, i, A.cols());
-    sub_A = sub_X * sub_A;
-
-    // Now fix D, too
-    DenseMtx D_2 = D;
-
-    D.block (0, 0, sub_X.cols(), D.cols()) = sub_X *
-                                        D_2.block (0,0, sub_X.cols(), D.cols());
-
+        ops.block (sub_X);
+
+    // first i rows of A (and D) become X * (first i rows of A)
+    const uint8_t *x = reinterpret_cast<const uint8_t *> (X.data());
+    const size_t ldx = static_cast<size_t> (X.cols());
+    const DenseMtx sub_A = A.topRows (i);
+    gf256_gemm (reinterpret_cast<uint8_t *> (A.data()),
+                            static_cast<size_t> (A.cols()), x, ldx,
+                            reinterpret_cast<const uint8_t *> (sub_A.data()),
+                            static_cast<size_t> (sub_A.cols()), i, i,
+                            static_cast<size_t> (A.cols()));
+
+    // Now fix D, too. only the first i rows are read.
+    _D_2 = D.topRows (i);
+    gf256_gemm (reinterpret_cast<uint8_t *> (D.data()),
+                            static_cast<size_t> (D.cols()), x, ldx,
+                            reinterpret_cast<const uint8_t *> (_D_2.data()),
+                            static_cast<size_t> (_D_2.cols()), i, i,
+                            static_cast<size_t> (D.cols()));
 }
 
 template<Save_Computation IS_OFFLINE>
@@ -555,8 +885,7 @@ void Precode_Matrix<IS_OFFLINE>::decode_phase4 (DenseMtx &D, const uint16_t i,
                 uint16_t row_2 = static_cast<uint16_t> (U_upper.rows()) + col;
                 D.row (row) += D.row (row_2) * multiple;
                 if (IS_OFFLINE == Save_Computation::ON) {
-                    ops.emplace_back (Operation::_t::ADD_MUL, row, row_2,
-                                                                    multiple);
+                    ops.add_mul (row, row_2, multiple);
                 }
             }
         }
@@ -587,7 +916,7 @@ void Precode_Matrix<IS_OFFLINE>::decode_phase5 (DenseMtx &D, const uint16_t i,
             A.row (j) /= multiple;
             D.row (j) /= multiple;
             if (IS_OFFLINE == Save_Computation::ON)
-                ops.emplace_back (Operation::_t::DIV, j, multiple);
+                ops.div (j, multiple);
         }
         for (uint16_t col = 0; col < j; ++col) {    // col == "l" in rfc6330
             const auto multiple = A (j, col);
@@ -597,7 +926,7 @@ void Precode_Matrix<IS_OFFLINE>::decode_phase5 (DenseMtx &D, const uint16_t i,
                 // A.row (j) += A.row (col) * multiple;
                 D.row (j) += D.row (col) * multiple;
                 if (IS_OFFLINE == Save_Computation::ON)
-                    ops.emplace_back (Operation::_t::ADD_MUL, j, col, multiple);
+                    ops.add_mul (j, col, multiple);
             }
         }
     }
@@ -606,33 +935,39 @@ void Precode_Matrix<IS_OFFLINE>::decode_phase5 (DenseMtx &D, const uint16_t i,
 template<Save_Computation IS_OFFLINE>
 DenseMtx Precode_Matrix<IS_OFFLINE>::encode (const DenseMtx &C,
                                                     const uint32_t ISI) const
+{
+    DenseMtx ret = DenseMtx (1, C.cols());
+    encode_row (C, ISI, ret.row (0));
+    return ret;
+}
+
+template<Save_Computation IS_OFFLINE>
+template<typename Row>
+void Precode_Matrix<IS_OFFLINE>::encode_row (const DenseMtx &C,
+                                                    const uint32_t ISI,
+                                                    Row &&out) const
 {
     // Generate repair symbols. same algorithm as "get_idxs"
     // rfc6330, pg29
 
-    DenseMtx ret;
-
-    ret = DenseMtx (1, C.cols());
     Tuple t = _params.tuple (ISI);
 
-    ret.row (0) = C.row (t.b);
+    out = C.row (t.b);
 
     for (uint16_t j = 1; j < t.d; ++j) {
         t.b = (t.b + t.a) % _params.W;
-        ret.row (0) += C.row (t.b);
+        out += C.row (t.b);
     }
     while (t.b1 >= _params.P)
         t.b1 = (t.b1 + t.a1) % _params.P1;
 
-    ret.row (0) += C.row (_params.W + t.b1);
+    out += C.row (_params.W + t.b1);
     for (uint16_t j = 1; j < t.d1; ++j) {
         t.b1 = (t.b1 + t.a1) % _params.P1;
         while (t.b1 >= _params.P)
             t.b1 = (t.b1 + t.a1) % _params.P1;
-        ret.row (0) += C.row (_params.W + t.b1);
+        out += C.row (_params.W + t.b1);
     }
-
-    return ret;
 }
 
 }   // namespace RaptorQ
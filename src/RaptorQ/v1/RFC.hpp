@@ -36,12 +36,14 @@
 #include "RaptorQ/v1/Encoder.hpp"
 #include "RaptorQ/v1/RFC_Iterators.hpp"
 #include "RaptorQ/v1/Shared_Computation/Decaying_LF.hpp"
+#include "RaptorQ/v1/Shared_Computation/Decoder_Pool.hpp"
 #include "RaptorQ/v1/Thread_Pool.hpp"
+#include "RaptorQ/v1/util/Block_Slots.hpp"
 #include "RaptorQ/v1/util/endianess.hpp"
 #include <algorithm>
+#include <array>
 #include <cassert>
 #include <future>
-#include <map>
 #include <memory>
 #include <mutex>
 #include <limits>
@@ -49,6 +51,7 @@
 #include <tuple>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 namespace RFC6330__v1 {
 
@@ -87,43 +90,36 @@ public:
                                             const size_t max_sub_block)
         : _max_sub_blk (max_sub_block), _data_from (data_from),
                                             _data_to (data_to),
+                                            _size (static_cast<uint64_t> (
+                                                data_to - data_from) * sizeof(
+                                                typename std::iterator_traits<
+                                                    Rnd_It>::value_type)),
                                             _symbol_size (symbol_size),
                                             _min_subsymbol (min_subsymbol_size),
+                                            _streaming (false),
                                             interleave (_data_from,
                                                         _data_to,
                                                         _min_subsymbol,
                                                         _max_sub_blk,
                                                         _symbol_size)
+        { init(); }
+    // streaming: the object is "size" bytes long, and the data of
+    // each source block is given with feed() when it is available.
+    Encoder (const uint64_t size, const uint16_t min_subsymbol_size,
+                                            const uint16_t symbol_size,
+                                            const size_t max_sub_block)
+        : _max_sub_blk (max_sub_block), _data_from(), _data_to(),
+                                            _size (size),
+                                            _symbol_size (symbol_size),
+                                            _min_subsymbol (min_subsymbol_size),
+                                            _streaming (true),
+                                            interleave (_size,
+                                                        _min_subsymbol,
+                                                        _max_sub_blk,
+                                                        _symbol_size)
     {
-        IS_RANDOM(Rnd_It, "RFC6330__v1::Encoder");
-        IS_FORWARD(Fwd_It, "RFC6330__v1::Encoder");
-        auto _alignment = sizeof(typename
-                                    std::iterator_traits<Rnd_It>::value_type);
-        RQ_UNUSED(_alignment);  // used only for asserts
-        assert(_symbol_size >= _alignment &&
-                        "RaptorQ: symbol_size must be >= alignment");
-        assert((_symbol_size % _alignment) == 0 &&
-                        "RaptorQ: symbol_size must be multiple of alignment");
-        assert(min_subsymbol_size >= _alignment &&
-                        "RaptorQ: minimum subsymbol must be at least aligment");
-        assert(min_subsymbol_size <= _symbol_size &&
-                    "RaptorQ: minimum subsymbol must be at most symbol_size");
-        assert((min_subsymbol_size % _alignment) == 0 &&
-                    "RaptorQ: minimum subsymbol must be multiple of alignment");
-        assert((_symbol_size % min_subsymbol_size == 0) &&
-                    "RaptorQ: symbol size must be multiple of subsymbol size");
-        // max size: ~881 GB
-        if (static_cast<uint64_t> (data_to - data_from) *
-                    sizeof(typename std::iterator_traits<Rnd_It>::value_type)
-                                                                > max_data) {
-            return;
-        }
-
-        _pool_notify = std::make_shared<std::condition_variable>();
-        _pool_mtx = std::make_shared<std::mutex>();
-        pool_last_reported = -1;
-        use_pool = true;
-        exiting = false;
+        init();
+        _released.resize (blocks(), 0);
     }
 
     It::Encoder::Block_Iterator<Rnd_It, Fwd_It> begin ()
@@ -143,6 +139,25 @@ public:
     // id: 8-bit sbn + 24 bit esi
     size_t encode (Fwd_It &output, const Fwd_It end, const uint32_t id);
     size_t encode_packet (Fwd_It &output, const Fwd_It end, const uint32_t id);
+    // one RFC packet (4-byte payload ID + one whole symbol) per symbol
+    // in "ranges", back to back in "buffer", each one starting at a
+    // multiple of packet_stride() bytes. "packets" gets where each one is.
+    // Ranges with an invalid sbn, with an esi that does not fit in 24 bits
+    // or of a block that is not ready (or already freed) are skipped.
+    // A range is cut at esi 2^24 and at its first symbol that can not be
+    // encoded. Stops when "buffer" or "packets" are full.
+    // returns the packets written: the payload IDs tell which ones.
+    size_t encode_packets (const Packet_Range *ranges, const size_t n_ranges,
+                                                uint8_t *buffer,
+                                                const size_t buffer_size,
+                                                Packet *packets,
+                                                const size_t max_packets);
+    size_t packet_stride() const;
+    // streaming only: the data of block "sbn", which must stay valid
+    // until the block is freed. The block is freed automatically
+    // after "repair_budget" repair symbols (0: only with free())
+    Error feed (const uint8_t sbn, const Rnd_It from, const Rnd_It to,
+                                                const uint32_t repair_budget);
 
     void free (const uint8_t sbn);
     uint8_t blocks() const;
@@ -151,8 +166,20 @@ public:
     uint16_t symbols (const uint8_t sbn) const;
     Block_Size extended_symbols (const uint8_t sbn) const;
     uint32_t max_repair (const uint8_t sbn) const;
+    // the last computation of block "sbn". All zeros if there was none,
+    // or if the block was freed.
+    Stats stats (const uint8_t sbn) const;
 private:
 
+    using Raw_Enc = RaptorQ__v1::Impl::Raw_Encoder<Rnd_It, Fwd_It,
+                                        RaptorQ__v1::Impl::with_interleaver>;
+
+    void init();
+    // the encoder of block "sbn", if it is ready.
+    std::shared_ptr<Raw_Enc> get_encoder (const uint8_t sbn);
+    // streaming: "repairs" repair symbols of block "sbn" were sent.
+    // Frees the block when its budget is used up.
+    void charge_repairs (const uint8_t sbn, const uint32_t repairs);
     static void wait_threads (Encoder<Rnd_It, Fwd_It> *obj, const Compute flags,
                                     std::promise<std::pair<Error, uint8_t>> p);
 
@@ -175,10 +202,28 @@ private:
                                 Fwd_It, RaptorQ__v1::Impl::with_interleaver>> (
                                                             interleaver, sbn);
             reported = false;
+            repair_budget = 0;
+            repair_sent = 0;
+        }
+        // streaming: the encoder owns the view on its block data
+        Enc (Impl::Interleaver<Rnd_It> *block_view, const uint8_t sbn,
+                                                        const uint32_t budget)
+        {
+            using Raw = RaptorQ__v1::Impl::Raw_Encoder<Rnd_It, Fwd_It,
+                                        RaptorQ__v1::Impl::with_interleaver>;
+            enc = std::shared_ptr<Raw> (new Raw (block_view, sbn),
+                                                    [block_view] (Raw *ptr) {
+                                                        delete ptr;
+                                                        delete block_view;
+                                                    });
+            reported = false;
+            repair_budget = budget;
+            repair_sent = 0;
         }
         std::shared_ptr<RaptorQ__v1::Impl::Raw_Encoder<Rnd_It, Fwd_It,
                                     RaptorQ__v1::Impl::with_interleaver>> enc;
         bool reported;
+        uint32_t repair_budget, repair_sent;
     };
 
     std::pair<Error, uint8_t> get_report (const Compute flags);
@@ -186,14 +231,17 @@ private:
     std::shared_ptr<std::mutex> _pool_mtx;
     std::deque<std::thread> pool_wait;
 
-    std::map<uint8_t, Enc> encoders;
-    std::mutex _mtx;
+    RaptorQ__v1::Impl::Block_Slots<Enc> encoders;
 
     const size_t _max_sub_blk;
     const Rnd_It _data_from, _data_to;
+    const uint64_t _size;
     const uint16_t _symbol_size;
     const uint16_t _min_subsymbol;
+    const bool _streaming;
     Impl::Interleaver<Rnd_It> interleave;
+    // streaming: blocks already freed. Each one under its block lock.
+    std::vector<uint8_t> _released;
     bool use_pool, exiting;
     int16_t pool_last_reported;
 
@@ -255,8 +303,8 @@ public:
             _size = std::numeric_limits<uint64_t>::max();
             return;
         }
-        _sub_blocks = Impl::Partition (_symbol_size / _alignment,
-                                                                tot_sub_blocks);
+        _sub_plan = Impl::Sub_Block_Plan (Impl::Partition (
+                                    _symbol_size / _alignment, tot_sub_blocks));
 
         const uint64_t total_symbols = static_cast<uint64_t> (ceil (
                                 _size / static_cast<double> (_symbol_size)));
@@ -288,7 +336,8 @@ public:
 
         const uint64_t total_symbols = static_cast<uint64_t> (ceil (
                                 _size / static_cast<double> (_symbol_size)));
-        _sub_blocks = Impl::Partition (_symbol_size / _alignment, sub_blocks);
+        _sub_plan = Impl::Sub_Block_Plan (Impl::Partition (
+                                        _symbol_size / _alignment, sub_blocks));
 
         part = Impl::Partition (total_symbols, static_cast<uint8_t> (_blocks));
         _pool_notify = std::make_shared<std::condition_variable>();
@@ -336,6 +385,21 @@ public:
     Error add_symbol (In_It &start, const In_It end, const uint32_t esi,
                                                             const uint8_t sbn);
     Error add_packet (In_It &start, const In_It end);
+    // many RFC packets (sbn, esi, then whole symbols), e.g. from recvmmsg.
+    // symbols are grouped by block, and each block is locked and
+    // scheduled for decoding once per call.
+    // "status" (optional, n elements) gets the result of each packet.
+    // returns the number of packets with at least one useful symbol.
+    size_t add_packets (const Packet *packets, const size_t n, Error *status);
+
+    // streaming: every decoded block is given to "sink" in SBN order, then
+    // freed. Symbols are accepted only for the next "max_blocks" blocks,
+    // the others get Error::OUT_OF_WINDOW, and can be added again once
+    // the stream gets there. Must be set before adding symbols.
+    // Blocks are streamed by add_symbol and by the thread started
+    // by compute(), which must use COMPLETE or PARTIAL_FROM_BEGINNING.
+    Error stream (const Block_Sink sink, void *user_data,
+                                                    const uint8_t max_blocks);
 
     uint8_t blocks_ready();
     bool is_ready();
@@ -347,6 +411,9 @@ public:
     uint16_t symbol_size() const;
     uint16_t symbols (const uint8_t sbn) const;
     Block_Size extended_symbols (const uint8_t sbn) const;
+    // the last decoding of block "sbn". All zeros if there was none,
+    // or if the block was freed.
+    Stats stats (const uint8_t sbn) const;
 private:
     // using shared pointers to avoid locking too much or
     // worrying about deleting used stuff.
@@ -365,7 +432,7 @@ private:
         Dec (const RaptorQ__v1::Block_Size symbols, const uint16_t symbol_size,
                                                 const uint16_t padding_symbols)
         {
-            dec = std::make_shared<RaptorQ__v1::Impl::Raw_Decoder<In_It>> (
+            dec = RaptorQ__v1::Impl::Decoder_Pool<In_It>::get()->acquire (
                                         symbols, symbol_size, padding_symbols);
             reported = false;
         }
@@ -373,17 +440,39 @@ private:
         bool reported;
     };
 
+    class RAPTORQ_LOCAL Stream {
+    public:
+        Stream()
+            : sink (nullptr), user_data (nullptr), max_blocks (0), next (0),
+                                            requested (false), failed (false)
+        {}
+        Block_Sink sink;
+        void *user_data;
+        uint16_t max_blocks;
+        std::atomic<uint16_t> next;     // next sbn to give to the sink
+        std::atomic<bool> requested, failed;
+        std::mutex mtx;                 // held by the streaming thread
+        std::vector<uint8_t> buffer;    // for interleaved blocks
+    };
+
     static void wait_threads (Decoder<In_It, Fwd_It> *obj, const Compute flags,
                                     std::promise<std::pair<Error, uint8_t>> p);
     std::pair<Error, uint8_t> get_report (const Compute flags);
+    // "res": n elements, always written
+    size_t add_packets_to (const Packet *packets, const size_t n, Error *res);
+    void stream_blocks();
+    bool stream_pending();
+    bool streamed (const uint8_t sbn) const
+        { return _stream.sink != nullptr && sbn < _stream.next; }
     std::shared_ptr<std::condition_variable> _pool_notify;
     std::shared_ptr<std::mutex> _pool_mtx;
     std::deque<std::thread> pool_wait;
+    Stream _stream;
 
     uint64_t _size;
-    Impl::Partition part, _sub_blocks;
-    std::map<uint8_t, Dec> decoders;
-    std::mutex _mtx;
+    Impl::Partition part;
+    Impl::Sub_Block_Plan _sub_plan;
+    RaptorQ__v1::Impl::Block_Slots<Dec> decoders;
     uint16_t _symbol_size;
     int16_t pool_last_reported;
     uint8_t _blocks, _alignment;
@@ -401,17 +490,48 @@ private:
 /////////////////
 
 
+template <typename Rnd_It, typename Fwd_It>
+void Encoder<Rnd_It, Fwd_It>::init()
+{
+    IS_RANDOM(Rnd_It, "RFC6330__v1::Encoder");
+    IS_FORWARD(Fwd_It, "RFC6330__v1::Encoder");
+    auto _alignment = sizeof(typename
+                                std::iterator_traits<Rnd_It>::value_type);
+    RQ_UNUSED(_alignment);  // used only for asserts
+    assert(_symbol_size >= _alignment &&
+                    "RaptorQ: symbol_size must be >= alignment");
+    assert((_symbol_size % _alignment) == 0 &&
+                    "RaptorQ: symbol_size must be multiple of alignment");
+    assert(_min_subsymbol >= _alignment &&
+                    "RaptorQ: minimum subsymbol must be at least aligment");
+    assert(_min_subsymbol <= _symbol_size &&
+                "RaptorQ: minimum subsymbol must be at most symbol_size");
+    assert((_min_subsymbol % _alignment) == 0 &&
+                "RaptorQ: minimum subsymbol must be multiple of alignment");
+    assert((_symbol_size % _min_subsymbol == 0) &&
+                "RaptorQ: symbol size must be multiple of subsymbol size");
+    // max size: ~881 GB
+    if (_size > max_data)
+        return;
+
+    _pool_notify = std::make_shared<std::condition_variable>();
+    _pool_mtx = std::make_shared<std::mutex>();
+    pool_last_reported = -1;
+    use_pool = true;
+    exiting = false;
+}
+
 template <typename Rnd_It, typename Fwd_It>
 Encoder<Rnd_It, Fwd_It>::~Encoder()
 {
     exiting = true; // stop notifying thread
-    std::unique_lock<std::mutex> enc_lock (_mtx);
-    for (auto &it : encoders) { // stop existing computations
-        auto ptr = it.second.enc;
-        if (ptr != nullptr)
-            ptr->stop();
+    for (uint16_t sbn = 0; sbn < blocks(); ++sbn) { // stop computations
+        auto enc_lock = encoders.lock (static_cast<uint8_t> (sbn));
+        RQ_UNUSED(enc_lock);
+        const Enc *enc = encoders.get (static_cast<uint8_t> (sbn));
+        if (enc != nullptr && enc->enc != nullptr)
+            enc->enc->stop();
     }
-    enc_lock.unlock();
     _pool_notify->notify_all();
     while (pool_wait.size() != 0) {
         std::unique_lock<std::mutex> lock (*_pool_mtx);
@@ -427,8 +547,7 @@ RFC6330_OTI_Common_Data Encoder<Rnd_It, Fwd_It>::OTI_Common() const
         return 0;
     RFC6330_OTI_Common_Data ret;
     // first 40 bits: data length.
-    ret = (static_cast<uint64_t> (_data_to - _data_from) *
-            sizeof(typename std::iterator_traits<Rnd_It>::value_type)) << 24;
+    ret = _size << 24;
     // 8 bits: reserved
     // last 16 bits: symbol size
     ret += _symbol_size;
@@ -550,8 +669,6 @@ std::future<std::pair<Error, uint8_t>> Encoder<Rnd_It, Fwd_It>::compute (
     }
 
     if (Compute::NONE != (flags & Compute::NO_POOL)) {
-        std::unique_lock<std::mutex> lock (_mtx);
-        RQ_UNUSED(lock);
         if (encoders.size() != 0) {
             // You can only say you won't use the pool *before* you start
             // decoding something!
@@ -569,25 +686,20 @@ std::future<std::pair<Error, uint8_t>> Encoder<Rnd_It, Fwd_It>::compute (
     }
 
     // flags are fine, add work to pool
-    std::unique_lock<std::mutex> lock (_mtx);
-    for (uint8_t block = 0; block < blocks(); ++block) {
-        auto enc = encoders.find (block);
-        if (enc == encoders.end()) {
-            bool success;
-            std::tie (enc, success) = encoders.emplace (
-                                    std::piecewise_construct,
-                                    std::forward_as_tuple (block),
-                                    std::forward_as_tuple (&interleave, block));
-            assert (success == true);
+    // (when streaming, blocks are added as they are fed)
+    for (uint8_t block = 0; !_streaming && block < blocks(); ++block) {
+        auto lock = encoders.lock (block);
+        if (encoders.get (block) == nullptr) {
+            Enc *enc = encoders.emplace (block, &interleave, block);
             std::unique_ptr<Block_Work> work = std::unique_ptr<Block_Work>(
                                                             new Block_Work());
-            work->work = enc->second.enc;
+            work->work = enc->enc;
             work->notify = _pool_notify;
             work->lock = _pool_mtx;
+            lock.unlock();
             Thread_Pool::get().add_work (std::move(work));
         }
     }
-    lock.unlock();
 
     // spawn thread waiting for other thread exit.
     // this way we can set_value to the future when needed.
@@ -641,42 +753,49 @@ template <typename Rnd_It, typename Fwd_It>
 std::pair<Error, uint8_t> Encoder<Rnd_It, Fwd_It>::get_report (
                                                             const Compute flags)
 {
-    if (encoders.size() == 0)
+    if (encoders.size() == 0 && !_streaming)
         return {Error::WORKING, 0};
     if (Compute::NONE != (flags & Compute::COMPLETE) ||
                 Compute::NONE != (flags & Compute::PARTIAL_FROM_BEGINNING)) {
-        auto it = encoders.begin();
-        for (; it != encoders.end(); ++it) {
-            auto ptr = it->second.enc;
-            if (ptr != nullptr) {
-                if (!ptr->ready()) {
-                    if (ptr->is_stopped())
+        int16_t working = -1;   // first block still being computed
+        for (uint16_t sbn = 0; sbn < blocks(); ++sbn) {
+            auto lock = encoders.lock (static_cast<uint8_t> (sbn));
+            RQ_UNUSED(lock);
+            const Enc *enc = encoders.get (static_cast<uint8_t> (sbn));
+            if (_streaming && enc == nullptr && _released[sbn] == 0) {
+                working = static_cast<int16_t> (sbn);   // not fed yet
+                break;
+            }
+            if (enc != nullptr && enc->enc != nullptr) {
+                if (!enc->enc->ready()) {
+                    if (enc->enc->is_stopped())
                         return{Error::EXITING, 0};
+                    working = static_cast<int16_t> (sbn);
                     break;
                 }
             }
         }
-        if (it == encoders.end()) {
-            pool_last_reported = static_cast<int16_t> (encoders.size() - 1);
+        if (working == -1) {
+            pool_last_reported = static_cast<int16_t> (blocks() - 1);
             return {Error::NONE, static_cast<uint8_t>(pool_last_reported)};
         }
         if (Compute::NONE != (flags & Compute::PARTIAL_FROM_BEGINNING) &&
-                                    (pool_last_reported < (it->first - 1))) {
-            pool_last_reported = it->first - 1;
+                                    (pool_last_reported < (working - 1))) {
+            pool_last_reported = working - 1;
             return {Error::NONE, static_cast<uint8_t>(pool_last_reported)};
         }
         return {Error::WORKING, 0};
     }
     if (Compute::NONE != (flags & Compute::PARTIAL_ANY)) {
-        for (auto &it : encoders) {
-            if (!it.second.reported) {
-                auto ptr = it.second.enc;
-                if (ptr != nullptr) {
-                    if (ptr->ready())
-                        return {Error::NONE, it.first};
-                    if (ptr->is_stopped())
-                        return{Error::EXITING, 0};
-                }
+        for (uint16_t sbn = 0; sbn < blocks(); ++sbn) {
+            auto lock = encoders.lock (static_cast<uint8_t> (sbn));
+            RQ_UNUSED(lock);
+            const Enc *enc = encoders.get (static_cast<uint8_t> (sbn));
+            if (enc != nullptr && !enc->reported && enc->enc != nullptr) {
+                if (enc->enc->ready())
+                    return {Error::NONE, static_cast<uint8_t> (sbn)};
+                if (enc->enc->is_stopped())
+                    return{Error::EXITING, 0};
             }
         }
     }
@@ -707,35 +826,128 @@ size_t Encoder<Rnd_It, Fwd_It>::encode (Fwd_It &output, const Fwd_It end,
                                                                         - syms;
     const uint32_t real_esi = esi < syms ? esi : esi + padding;
 
-    std::unique_lock<std::mutex> lock (_mtx);
-    auto it = encoders.find (sbn);
-    if (use_pool) {
-        if (it == encoders.end())
-            return 0;
-        auto shared_enc = it->second.enc;
+    auto shared_enc = get_encoder (sbn);
+    if (shared_enc == nullptr)
+        return 0;
+    const size_t written = shared_enc->Enc (real_esi, output, end);
+    if (written != 0 && esi >= syms)
+        charge_repairs (sbn, 1);
+    return written;
+}
+
+template <typename Rnd_It, typename Fwd_It>
+std::shared_ptr<typename Encoder<Rnd_It, Fwd_It>::Raw_Enc>
+                            Encoder<Rnd_It, Fwd_It>::get_encoder (
+                                                        const uint8_t sbn)
+{
+    auto lock = encoders.lock (sbn);
+    Enc *enc = encoders.get (sbn);
+    if (_streaming) {
+        if (enc == nullptr)
+            return nullptr; // not fed yet, or already freed
+        auto shared_enc = enc->enc;
         if (!shared_enc->ready())
-            return 0;
+            return nullptr;
+        return shared_enc;
+    }
+    if (enc == nullptr) {
+        if (use_pool)
+            return nullptr;
+        auto shared_enc = encoders.emplace (sbn, &interleave, sbn)->enc;
         lock.unlock();
-        return shared_enc->Enc (real_esi, output, end);
-    } else {
-        if (it == encoders.end()) {
-            bool success;
-            std::tie (it, success) = encoders.emplace (std::make_pair (sbn,
-                                                    Enc (&interleave, sbn)));
-            auto shared_enc = it->second.enc;
-            lock.unlock();
-            RaptorQ__v1::Work_State state =
-                                        RaptorQ__v1::Work_State::KEEP_WORKING;
-            shared_enc->generate_symbols (&state);
-            return shared_enc->Enc (real_esi, output, end);
-        } else {
-            auto shared_enc = it->second.enc;
-            lock.unlock();
-            if (!shared_enc->ready())
-                return 0;
-            return shared_enc->Enc (real_esi, output, end);
+        RaptorQ__v1::Work_State state = RaptorQ__v1::Work_State::KEEP_WORKING;
+        shared_enc->generate_symbols (&state);
+        return shared_enc;
+    }
+    auto shared_enc = enc->enc;
+    lock.unlock();
+    if (!shared_enc->ready())
+        return nullptr;
+    return shared_enc;
+}
+
+template <typename Rnd_It, typename Fwd_It>
+void Encoder<Rnd_It, Fwd_It>::charge_repairs (const uint8_t sbn,
+                                                        const uint32_t repairs)
+{
+    if (!_streaming || repairs == 0)
+        return;
+    auto lock = encoders.lock (sbn);
+    RQ_UNUSED(lock);
+    Enc *enc = encoders.get (sbn);
+    if (enc == nullptr || enc->repair_budget == 0)
+        return;
+    enc->repair_sent += repairs;
+    if (enc->repair_sent >= enc->repair_budget) {
+        // last repair symbols: only the callers keep the encoder
+        _released[sbn] = 1;
+        encoders.erase (sbn);
+    }
+}
+
+template <typename Rnd_It, typename Fwd_It>
+size_t Encoder<Rnd_It, Fwd_It>::packet_stride() const
+{
+    // keep every packet 16-bytes aligned
+    constexpr size_t alignment = 16;
+    return (sizeof(uint32_t) + _symbol_size + alignment - 1) &
+                                                            ~(alignment - 1);
+}
+
+template <typename Rnd_It, typename Fwd_It>
+size_t Encoder<Rnd_It, Fwd_It>::encode_packets (const Packet_Range *ranges,
+                                                const size_t n_ranges,
+                                                uint8_t *buffer,
+                                                const size_t buffer_size,
+                                                Packet *packets,
+                                                const size_t max_packets)
+{
+    if (!interleave || ranges == nullptr || buffer == nullptr ||
+                                                        packets == nullptr) {
+        return 0;
+    }
+    // the FEC payload ID only has 24 bits for the ESI
+    constexpr uint32_t esi_limit = 1u << 24;
+    const size_t stride = packet_stride();
+    const size_t max_written = std::min (max_packets, buffer_size / stride);
+    size_t written = 0;
+    for (size_t idx = 0; idx < n_ranges && written < max_written; ++idx) {
+        const Packet_Range &range = ranges[idx];
+        if (range.sbn >= blocks() || range.esi >= esi_limit)
+            continue;
+        const uint32_t syms = symbols (range.sbn);
+        const uint32_t padding = static_cast<uint16_t> (
+                                    extended_symbols (range.sbn)) - syms;
+        const uint32_t count = static_cast<uint32_t> (std::min<size_t> ({
+                                        range.symbols, max_written - written,
+                                        esi_limit - range.esi}));
+        // one lookup and one budget update for the whole range
+        auto shared_enc = get_encoder (range.sbn);
+        if (shared_enc == nullptr)
+            continue;
+        uint32_t repairs = 0;
+        for (uint32_t esi = range.esi; esi < range.esi + count; ++esi) {
+            uint8_t *pkt = buffer + written * stride;
+            // FEC payload ID: 8 bit SBN, 24 bit ESI. big endian
+            pkt[0] = range.sbn;
+            pkt[1] = static_cast<uint8_t> (esi >> 16);
+            pkt[2] = static_cast<uint8_t> (esi >> 8);
+            pkt[3] = static_cast<uint8_t> (esi);
+            const uint32_t real_esi = esi < syms ? esi : esi + padding;
+            const size_t bytes = shared_enc->Enc_bytes (real_esi,
+                                                    pkt + sizeof(uint32_t));
+            if (bytes == 0)
+                break;
+            packets[written].data = pkt;
+            packets[written].size = sizeof(uint32_t) + bytes;
+            ++written;
+            if (esi >= syms)
+                ++repairs;
         }
+        // only the repair symbols really written use the budget
+        charge_repairs (range.sbn, repairs);
     }
+    return written;
 }
 
 template <typename Rnd_It, typename Fwd_It>
@@ -842,14 +1054,48 @@ size_t Encoder<Rnd_It, Fwd_It>::encode_packet (Fwd_It &output, const Fwd_It end,
     return written;
 }
 
+template <typename Rnd_It, typename Fwd_It>
+Error Encoder<Rnd_It, Fwd_It>::feed (const uint8_t sbn, const Rnd_It from,
+                                                const Rnd_It to,
+                                                const uint32_t repair_budget)
+{
+    if (!interleave)
+        return Error::INITIALIZATION;
+    if (!_streaming || sbn >= blocks() || to < from ||
+            static_cast<size_t> (to - from) != interleave.block_data (sbn)) {
+        return Error::WRONG_INPUT;
+    }
+    auto lock = encoders.lock (sbn);
+    if (_released[sbn] != 0 || encoders.get (sbn) != nullptr)
+        return Error::NOT_NEEDED;
+    Enc *enc = encoders.emplace (sbn, new Impl::Interleaver<Rnd_It> (
+                                        interleave.block_view (sbn, from, to)),
+                                                        sbn, repair_budget);
+    auto shared_enc = enc->enc;
+    lock.unlock();
+
+    if (use_pool) {
+        std::unique_ptr<Block_Work> work = std::unique_ptr<Block_Work>(
+                                                            new Block_Work());
+        work->work = shared_enc;
+        work->notify = _pool_notify;
+        work->lock = _pool_mtx;
+        Thread_Pool::get().add_work (std::move(work));
+    } else {
+        RaptorQ__v1::Work_State state = RaptorQ__v1::Work_State::KEEP_WORKING;
+        shared_enc->generate_symbols (&state);
+    }
+    return Error::NONE;
+}
+
 template <typename Rnd_It, typename Fwd_It>
 void Encoder<Rnd_It, Fwd_It>::free (const uint8_t sbn)
 {
-    std::unique_lock<std::mutex> lock (_mtx);
+    auto lock = encoders.lock (sbn);
     RQ_UNUSED(lock);
-    auto it = encoders.find (sbn);
-    if (it != encoders.end())
-        encoders.erase (it);
+    encoders.erase (sbn);
+    if (_streaming && sbn < blocks())
+        _released[sbn] = 1;
 }
 
 template <typename Rnd_It, typename Fwd_It>
@@ -903,6 +1149,19 @@ uint32_t Encoder<Rnd_It, Fwd_It>::max_repair (const uint8_t sbn) const
                                                 interleave.source_symbols (sbn);
 }
 
+template <typename Rnd_It, typename Fwd_It>
+Stats Encoder<Rnd_It, Fwd_It>::stats (const uint8_t sbn) const
+{
+    if (sbn >= blocks())
+        return Stats();
+    auto lock = encoders.lock (sbn);
+    RQ_UNUSED(lock);
+    const Enc *enc = encoders.get (sbn);
+    if (enc == nullptr || enc->enc == nullptr)
+        return Stats();
+    return enc->enc->stats();
+}
+
 /////////////////
 //
 // Decoder
@@ -913,13 +1172,13 @@ template <typename In_It, typename Fwd_It>
 Decoder<In_It, Fwd_It>::~Decoder()
 {
     exiting = true; // stop notifying thread
-    _mtx.lock();
-    for (auto &it : decoders) { // stop existing computations
-        auto ptr = it.second.dec;
-        if (ptr != nullptr)
-            ptr->stop();
+    for (uint16_t sbn = 0; sbn < blocks(); ++sbn) { // stop computations
+        auto dec_lock = decoders.lock (static_cast<uint8_t> (sbn));
+        RQ_UNUSED(dec_lock);
+        const Dec *dec = decoders.get (static_cast<uint8_t> (sbn));
+        if (dec != nullptr && dec->dec != nullptr)
+            dec->dec->stop();
     }
-    _mtx.unlock();
     _pool_notify->notify_all();
     while (pool_wait.size() != 0) {
         std::unique_lock<std::mutex> lock (*_pool_mtx);
@@ -931,11 +1190,9 @@ Decoder<In_It, Fwd_It>::~Decoder()
 template <typename In_It, typename Fwd_It>
 void Decoder<In_It, Fwd_It>::free (const uint8_t sbn)
 {
-    _mtx.lock();
-    auto it = decoders.find(sbn);
-    if (it != decoders.end())
-        decoders.erase(it);
-    _mtx.unlock();
+    auto dec_lock = decoders.lock (sbn);
+    decoders.erase (sbn);
+    dec_lock.unlock();
     _pool_notify->notify_all();
 }
 
@@ -966,18 +1223,15 @@ Error Decoder<In_It, Fwd_It>::add_symbol (In_It &start, const In_It end,
     const uint16_t padding = static_cast<uint16_t> (b_size) - syms;
     const uint32_t real_esi = esi < syms ? esi : esi + padding;
 
-    bool added_decoder = false;
-
-    std::unique_lock<std::mutex> lock (_mtx);
-    auto it = decoders.find (sbn);
-    if (it == decoders.end()) {
-        bool success;
-        std::tie (it, success) = decoders.emplace (std::make_pair(sbn,
-                                        Dec (b_size, _symbol_size, padding)));
-        assert (success);
-        added_decoder = true;
-    }
-    auto dec = it->second.dec;
+    if (_stream.sink != nullptr && sbn >= _stream.next + _stream.max_blocks)
+        return Error::OUT_OF_WINDOW;
+    auto lock = decoders.lock (sbn);
+    if (streamed (sbn))
+        return Error::NOT_NEEDED;
+    const Dec *slot = decoders.get (sbn);
+    if (slot == nullptr)
+        slot = decoders.emplace (sbn, b_size, _symbol_size, padding);
+    auto dec = slot->dec;
     lock.unlock();
 
     // the last symbol in a block can have less size than the symbol size,
@@ -989,7 +1243,6 @@ Error Decoder<In_It, Fwd_It>::add_symbol (In_It &start, const In_It end,
         return err;
     // automatically add work to pool if we use it and have enough data
     std::unique_lock<std::mutex> pool_lock (*_pool_mtx);
-    RQ_UNUSED(pool_lock);
     if (use_pool && dec->can_decode()) {
         bool add_work = dec->add_concurrent (max_block_decoder_concurrency);
         if (add_work) {
@@ -1001,9 +1254,111 @@ Error Decoder<In_It, Fwd_It>::add_symbol (In_It &start, const In_It end,
             Impl::Thread_Pool::get().add_work (std::move(work));
         }
     }
+    pool_lock.unlock();
+    stream_blocks();
     return Error::NONE;
 }
 
+template <typename In_It, typename Fwd_It>
+Error Decoder<In_It, Fwd_It>::stream (const Block_Sink sink, void *user_data,
+                                                    const uint8_t max_blocks)
+{
+    if (!operator bool())
+        return Error::INITIALIZATION;
+    if (sink == nullptr || max_blocks == 0 || decoders.size() != 0 ||
+                                                    _stream.sink != nullptr) {
+        return Error::WRONG_INPUT;
+    }
+    _stream.user_data = user_data;
+    _stream.max_blocks = max_blocks;
+    _stream.sink = sink;
+    return Error::NONE;
+}
+
+template <typename In_It, typename Fwd_It>
+void Decoder<In_It, Fwd_It>::stream_blocks()
+{
+    if (_stream.sink == nullptr)
+        return;
+    // only one thread gives blocks to the sink. If it is busy,
+    // leave it a note to check again before it stops.
+    _stream.requested = true;
+    bool sent = false;
+    while (_stream.requested) {
+        std::unique_lock<std::mutex> stream_lock (_stream.mtx,
+                                                            std::try_to_lock);
+        if (!stream_lock.owns_lock())
+            break;
+        _stream.requested = false;
+        while (!_stream.failed && _stream.next < blocks()) {
+            const uint8_t sbn = static_cast<uint8_t> (_stream.next.load());
+            auto lock = decoders.lock (sbn);
+            const Dec *slot = decoders.get (sbn);
+            if (slot == nullptr)
+                break;
+            auto dec = slot->dec;
+            lock.unlock();
+            if (!dec->ready()) {
+                if (use_pool || !dec->can_decode())
+                    break;
+                RaptorQ__v1::Work_State keep_working =
+                                        RaptorQ__v1::Work_State::KEEP_WORKING;
+                dec->decode (&keep_working);
+                if (!dec->ready())
+                    break;
+            }
+            const size_t bytes = block_size (sbn);
+            const uint8_t *data;
+            if (_sub_plan.runs().size() == 1) {
+                // no sub-blocks: the symbols are already in order
+                data = RaptorQ__v1::Impl::row_ptr (*dec->get_symbols(), 0);
+            } else {
+                _stream.buffer.resize (bytes);
+                uint8_t *out = _stream.buffer.data();
+                Impl::De_Interleaver<uint8_t*> de_interleaving (
+                                                            dec->get_symbols(),
+                                                            &_sub_plan,
+                                                            symbols (sbn),
+                                                            _alignment);
+                de_interleaving (out, out + bytes, bytes, 0);
+                data = _stream.buffer.data();
+            }
+            if (!_stream.sink (_stream.user_data, sbn, data, bytes)) {
+                _stream.failed = true;
+                break;
+            }
+            // advance under the block lock, so that add_symbol
+            // can not create the block again.
+            lock.lock();
+            ++_stream.next;
+            decoders.erase (sbn);
+            lock.unlock();
+            sent = true;
+        }
+    }
+    if (sent || _stream.failed) {
+        std::unique_lock<std::mutex> pool_lock (*_pool_mtx);
+        RQ_UNUSED(pool_lock);
+        _pool_notify->notify_all();
+    }
+}
+
+template <typename In_It, typename Fwd_It>
+bool Decoder<In_It, Fwd_It>::stream_pending()
+{
+    // is the next block ready, with nobody streaming it?
+    if (_stream.sink == nullptr || _stream.failed || _stream.next >= blocks())
+        return false;
+    std::unique_lock<std::mutex> stream_lock (_stream.mtx, std::try_to_lock);
+    if (!stream_lock.owns_lock())
+        return false;   // the streaming thread will notify us
+    const uint8_t sbn = static_cast<uint8_t> (_stream.next.load());
+    auto lock = decoders.lock (sbn);
+    RQ_UNUSED(lock);
+    const Dec *slot = decoders.get (sbn);
+    return slot != nullptr && slot->dec->ready();
+}
+
 template <typename In_It, typename Fwd_It>
 Error Decoder<In_It, Fwd_It>::add_packet (In_It &start, const In_It end)
 {
@@ -1095,6 +1450,130 @@ Error Decoder<In_It, Fwd_It>::add_packet (In_It &start, const In_It end)
     return Error::WRONG_INPUT;
 }
 
+template <typename In_It, typename Fwd_It>
+size_t Decoder<In_It, Fwd_It>::add_packets (const Packet *packets,
+                                                    const size_t n,
+                                                    Error *status)
+{
+    if (!operator bool()) {
+        if (status != nullptr)
+            std::fill (status, status + n, Error::INITIALIZATION);
+        return 0;
+    }
+    if (status != nullptr)
+        return add_packets_to (packets, n, status);
+    std::vector<Error> res (n);
+    return add_packets_to (packets, n, res.data());
+}
+
+template <typename In_It, typename Fwd_It>
+size_t Decoder<In_It, Fwd_It>::add_packets_to (const Packet *packets,
+                                                    const size_t n,
+                                                    Error *res)
+{
+    // symbols in each packet. 0: bad packet
+    std::vector<uint32_t> count (n, 0);
+    // count the symbols of each block, then sort them by block.
+    std::array<uint32_t, 257> first;
+    first.fill (0);
+    for (size_t idx = 0; idx < n; ++idx) {
+        res[idx] = Error::WRONG_INPUT;
+        const uint8_t *p = static_cast<const uint8_t*> (packets[idx].data);
+        if (p == nullptr || packets[idx].size < sizeof(uint32_t) ||
+                                                            p[0] >= blocks()) {
+            continue;
+        }
+        count[idx] = static_cast<uint32_t> (
+                    (packets[idx].size - sizeof(uint32_t)) / _symbol_size);
+        first[p[0] + 1u] += count[idx];
+    }
+    for (uint16_t sbn = 1; sbn < first.size(); ++sbn)
+        first[sbn] += first[sbn - 1u];
+
+    std::vector<RaptorQ__v1::Impl::Symbol_Ref> syms (first[256]);
+    std::vector<uint32_t> owner (first[256]);  // packet of each symbol
+    std::array<uint32_t, 256> next;
+    std::copy (first.begin(), first.end() - 1, next.begin());
+    for (size_t idx = 0; idx < n; ++idx) {
+        if (count[idx] == 0)
+            continue;
+        res[idx] = Error::NOT_NEEDED;
+        // RFC packet, section 4.4.2 page 11: 8 bit sbn, 24 bit esi
+        const uint8_t *p = static_cast<const uint8_t*> (packets[idx].data);
+        const uint8_t sbn = p[0];
+        uint32_t esi = (static_cast<uint32_t> (p[1]) << 16) |
+                        (static_cast<uint32_t> (p[2]) << 8) | p[3];
+        const uint16_t syms_in_block = symbols (sbn);
+        const uint32_t padding = static_cast<uint32_t> (
+                                extended_symbols (sbn)) - syms_in_block;
+        p += sizeof(uint32_t);
+        for (uint32_t sym = 0; sym < count[idx]; ++sym) {
+            // we might have padding symbols. add these to the esi.
+            const uint32_t pos = next[sbn]++;
+            syms[pos].data = p;
+            syms[pos].esi = esi < syms_in_block ? esi : esi + padding;
+            syms[pos].err = Error::NOT_NEEDED;
+            owner[pos] = static_cast<uint32_t> (idx);
+            p += _symbol_size;
+            ++esi;
+        }
+    }
+
+    for (uint16_t sbn = 0; sbn < blocks(); ++sbn) {
+        const uint32_t from = first[sbn], to = first[sbn + 1u];
+        if (from == to)
+            continue;
+        if (_stream.sink != nullptr &&
+                                    sbn >= _stream.next + _stream.max_blocks) {
+            for (uint32_t pos = from; pos < to; ++pos)
+                syms[pos].err = Error::OUT_OF_WINDOW;
+            continue;
+        }
+        const uint8_t sbn8 = static_cast<uint8_t> (sbn);
+        auto lock = decoders.lock (sbn8);
+        if (streamed (sbn8))
+            continue;
+        const Dec *slot = decoders.get (sbn8);
+        if (slot == nullptr) {
+            const Block_Size b_size = extended_symbols (sbn8);
+            slot = decoders.emplace (sbn8, b_size, _symbol_size,
+                        static_cast<uint16_t> (b_size) - symbols (sbn8));
+        }
+        auto dec = slot->dec;
+        lock.unlock();
+
+        if (dec->add_symbols (syms.data() + from, to - from) == 0)
+            continue;
+        // at most one new decoding task per block
+        std::unique_lock<std::mutex> pool_lock (*_pool_mtx);
+        if (use_pool && dec->can_decode() &&
+                        dec->add_concurrent (max_block_decoder_concurrency)) {
+            std::unique_ptr<Block_Work> work = std::unique_ptr<Block_Work>(
+                                                            new Block_Work());
+            work->work = dec;
+            work->notify = _pool_notify;
+            work->lock = _pool_mtx;
+            Impl::Thread_Pool::get().add_work (std::move(work));
+        }
+    }
+    stream_blocks();
+
+    // a packet is useful if at least one of its symbols was added.
+    // otherwise report the first error, if any.
+    size_t useful = 0;
+    for (size_t pos = 0; pos < syms.size(); ++pos) {
+        Error &err = res[owner[pos]];
+        if (syms[pos].err == Error::NONE) {
+            if (err != Error::NONE)
+                ++useful;
+            err = Error::NONE;
+        } else if (err == Error::NOT_NEEDED) {
+            err = syms[pos].err;
+        }
+    }
+    return useful;
+}
+
 template <typename In_It, typename Fwd_It>
 std::vector<bool> Decoder<In_It, Fwd_It>::end_of_input (
                                                     const Fill_With_Zeros fill)
@@ -1111,26 +1590,31 @@ std::vector<bool> Decoder<In_It, Fwd_It>::end_of_input (
     size_t ret_idx = 0;
 
     std::unique_lock<std::mutex> pool_lock (*_pool_mtx);
-    std::unique_lock<std::mutex> dec_lock (_mtx);
     for (uint8_t sbn = 0; sbn < blocks(); ++sbn) {
-        auto it = decoders.find (sbn);
+        auto dec_lock = decoders.lock (sbn);
+        if (streamed (sbn)) {
+            // already given to the sink: we had all of it.
+            if (fill == Fill_With_Zeros::YES) {
+                for (uint32_t byte = 0; byte < block_size (sbn); ++byte)
+                    ret[ret_idx++] = true;
+            }
+            continue;
+        }
+        Dec *it = decoders.get (sbn);
 
         if (fill == Fill_With_Zeros::YES) {
-            if (it == decoders.end()) {
+            if (it == nullptr) {
                 // we might not even have he block for our end_of_input
-                bool success;
                 const uint16_t syms = this->symbols (sbn);
                 const Block_Size b_size = this->extended_symbols (sbn);
                 // we might have padding symbols. add thse to the esi.
                 const uint16_t padding = static_cast<uint16_t> (b_size) - syms;
-                std::tie (it, success) = decoders.emplace (std::make_pair(sbn,
-                                        Dec (b_size, _symbol_size, padding)));
-                assert (success);
+                it = decoders.emplace (sbn, b_size, _symbol_size, padding);
             }
-            auto real_symbols = it->second.dec->fill_with_zeros();
+            auto real_symbols = it->dec->fill_with_zeros();
             Impl::De_Interleaver<Fwd_It> de_interleaving (
-                                                it->second.dec->get_symbols(),
-                                                _sub_blocks,
+                                                it->dec->get_symbols(),
+                                                &_sub_plan,
                                                 symbols (sbn),
                                                 _alignment);
             uint32_t block_bytes = block_size (sbn);
@@ -1140,10 +1624,9 @@ std::vector<bool> Decoder<In_It, Fwd_It>::end_of_input (
             for (const auto block_bit : block_bitmask)
                 ret[ret_idx++] = block_bit;
         }
-        if (it != decoders.end())
-            it->second.dec->end_of_input = true;
+        if (it != nullptr)
+            it->dec->end_of_input = true;
     }
-    dec_lock.unlock();
     pool_lock.unlock();
     _pool_notify->notify_all();
 
@@ -1161,26 +1644,28 @@ std::vector<bool> Decoder<In_It, Fwd_It>::end_of_input (
         return ret;
     }
     std::unique_lock<std::mutex> pool_lock (*_pool_mtx);
-    std::unique_lock<std::mutex> dec_lock (_mtx);
-    auto it = decoders.find(block);
-    if (it == decoders.end()) {
+    auto dec_lock = decoders.lock (block);
+    if (streamed (block)) {
+        if (fill == Fill_With_Zeros::YES)
+            ret.resize (block_size (block), true);
+        return ret;
+    }
+    Dec *it = decoders.get (block);
+    if (it == nullptr) {
         // we might not even have he block for our end_of_input
-        bool success;
         const uint16_t syms = this->symbols (block);
         const Block_Size b_size = this->extended_symbols (block);
         // we might have padding symbols. add thse to the esi.
         const uint16_t padding = static_cast<uint16_t> (b_size) - syms;
-        std::tie (it, success) = decoders.emplace (std::make_pair(block,
-                                        Dec (b_size, _symbol_size, padding)));
-        assert (success);
+        it = decoders.emplace (block, b_size, _symbol_size, padding);
     }
     std::vector<bool> symbol_bitmask;
     if (fill == Fill_With_Zeros::YES)
-        symbol_bitmask = it->second.dec->fill_with_zeros();
-    it->second.dec->end_of_input = true;
+        symbol_bitmask = it->dec->fill_with_zeros();
+    it->dec->end_of_input = true;
     Impl::De_Interleaver<Fwd_It> de_interleaving (
-                                                it->second.dec->get_symbols(),
-                                                _sub_blocks,
+                                                it->dec->get_symbols(),
+                                                &_sub_plan,
                                                 symbols (block),
                                                 _alignment);
     uint32_t block_bytes = block_size (block);
@@ -1286,10 +1771,13 @@ std::future<std::pair<Error, uint8_t>> Decoder<In_It, Fwd_It>::compute (
                                                 Compute::NO_POOL))) {
         error = true;
     }
+    // blocks are freed once streamed, always in order.
+    if (_stream.sink != nullptr &&
+                            Compute::NONE != (flags & Compute::PARTIAL_ANY)) {
+        error = true;
+    }
 
     if (Compute::NONE != (flags & Compute::NO_POOL)) {
-        std::unique_lock<std::mutex> lock (_mtx);
-        RQ_UNUSED(lock);
         if (decoders.size() != 0) {
             // You can only say you won't use the pool *before* you start
             // decoding something!
@@ -1329,11 +1817,14 @@ void Decoder<In_It, Fwd_It>::wait_threads (Decoder<In_It, Fwd_It> *obj,
 {
     auto _notify = obj->_pool_notify;
     while (true) {
+        obj->stream_blocks();
         std::unique_lock<std::mutex> lock (*obj->_pool_mtx);
         if (obj->exiting) { // make sure we can exit
             p.set_value ({Error::EXITING, 0});
             break;
         }
+        if (obj->stream_pending())
+            continue;   // decoded while we were streaming
         auto status = obj->get_report (flags);
         if (Error::WORKING != status.first) {
             p.set_value (status);
@@ -1361,22 +1852,29 @@ template <typename In_It, typename Fwd_It>
 std::pair<Error, uint8_t> Decoder<In_It, Fwd_It>::get_report (
                                                             const Compute flags)
 {
-    if (decoders.size() == 0)
+    if (_stream.failed)
+        return {Error::EXITING, 0};
+    if (decoders.size() == 0 && _stream.next == 0)
         return {Error::WORKING, 0};
     if (Compute::COMPLETE == (flags & Compute::COMPLETE) ||
             Compute::PARTIAL_FROM_BEGINNING ==
                                     (flags & Compute::PARTIAL_FROM_BEGINNING)) {
         uint16_t reportable = 0;
         uint16_t next_expected = static_cast<uint16_t> (pool_last_reported + 1);
-        std::unique_lock<std::mutex> dec_lock (_mtx);
-        auto it = decoders.lower_bound (static_cast<uint8_t> (next_expected));
 
         // get last reportable block
-        for (; it != decoders.end(); ++it) {
-            auto id = it->first;
-            if (id != next_expected)
+        for (; next_expected < blocks(); ++next_expected) {
+            const uint8_t sbn = static_cast<uint8_t> (next_expected);
+            auto dec_lock = decoders.lock (sbn);
+            if (streamed (sbn)) {
+                ++reportable;
+                continue;
+            }
+            const Dec *it = decoders.get (sbn);
+            if (it == nullptr)
                 break; // not consecutive
-            auto ptr = it->second.dec;
+            auto ptr = it->dec;
+            dec_lock.unlock();
             if (ptr == nullptr) {
                 assert(false && "RFC6330: decoder should never be nullptr.");
                 break;
@@ -1388,10 +1886,10 @@ std::pair<Error, uint8_t> Decoder<In_It, Fwd_It>::get_report (
                     return {Error::NEED_DATA, 0};
                 break; // still working
             }
+            if (_stream.sink != nullptr)
+                break; // report it only once it has been streamed
             ++reportable;
-            ++next_expected;
         }
-        dec_lock.unlock();
         if (reportable > 0) {
             pool_last_reported += reportable;
             if (Compute::PARTIAL_FROM_BEGINNING ==
@@ -1405,32 +1903,37 @@ std::pair<Error, uint8_t> Decoder<In_It, Fwd_It>::get_report (
             }
         }
     } else if (Compute::PARTIAL_ANY == (flags & Compute::PARTIAL_ANY)) {
-        // invalidate other pointers.
-        auto undecodable = decoders.end();
-        std::unique_lock<std::mutex> dec_lock (_mtx);
-        RQ_UNUSED(dec_lock);
-        for (auto it = decoders.begin(); it != decoders.end(); ++it) {
-            if (!it->second.reported) {
-                auto ptr = it->second.dec;
+        int16_t undecodable = -1;
+        for (uint16_t sbn = 0; sbn < blocks(); ++sbn) {
+            auto dec_lock = decoders.lock (static_cast<uint8_t> (sbn));
+            RQ_UNUSED(dec_lock);
+            Dec *it = decoders.get (static_cast<uint8_t> (sbn));
+            if (it != nullptr && !it->reported) {
+                auto ptr = it->dec;
                 if (ptr == nullptr) {
                     assert(false && "RFC6330: decoder should never be nullptr");
                     break;
                 }
                 if (ptr->ready()) {
-                    it->second.reported = true;
-                    return {Error::NONE, it->first};
+                    it->reported = true;
+                    return {Error::NONE, static_cast<uint8_t> (sbn)};
                 }
                 if (ptr->is_stopped())
                     return {Error::EXITING, 0};
                 // first return all decodable blocks
                 // then return the ones we can not decode.
                 if (ptr->end_of_input && ptr->threads() == 0)
-                    undecodable = it;
+                    undecodable = static_cast<int16_t> (sbn);
             }
         }
-        if (undecodable != decoders.end()) {
-            undecodable->second.reported = true;
-            return {Error::NEED_DATA, undecodable->first};
+        if (undecodable != -1) {
+            const uint8_t sbn = static_cast<uint8_t> (undecodable);
+            auto dec_lock = decoders.lock (sbn);
+            RQ_UNUSED(dec_lock);
+            Dec *it = decoders.get (sbn);
+            if (it != nullptr)
+                it->reported = true;
+            return {Error::NEED_DATA, sbn};
         }
     }
     // can be reached if computing thread was stopped
@@ -1447,19 +1950,19 @@ uint64_t Decoder<In_It, Fwd_It>::decode_symbol (Fwd_It &start, const Fwd_It end,
 
 
     std::shared_ptr<RaptorQ__v1::Impl::Raw_Decoder<In_It>> dec_ptr = nullptr;
-    std::unique_lock<std::mutex> lock (_mtx);
-    auto it = decoders.find (sbn);
+    auto lock = decoders.lock (sbn);
+    const Dec *it = decoders.get (sbn);
 
-    if (it == decoders.end())
+    if (it == nullptr)
         return 0;   // did not receiveany data yet.
 
     if (use_pool) {
-        dec_ptr = it->second.dec;
+        dec_ptr = it->dec;
         lock.unlock();
         if (!dec_ptr->ready())
             return 0;   // did not receive enough data, or could not decode yet.
     } else {
-        dec_ptr = it->second.dec;
+        dec_ptr = it->dec;
         lock.unlock();
         if (!dec_ptr->ready()) {
             if (!dec_ptr->can_decode())
@@ -1474,7 +1977,7 @@ uint64_t Decoder<In_It, Fwd_It>::decode_symbol (Fwd_It &start, const Fwd_It end,
     // decoder has decoded the block
 
     Impl::De_Interleaver<Fwd_It> de_interleaving (dec_ptr->get_symbols(),
-                                                                _sub_blocks,
+                                                                &_sub_plan,
                                                                 symbols (sbn),
                                                                 _alignment);
     size_t max_bytes = block_size (sbn);
@@ -1512,11 +2015,11 @@ uint64_t Decoder<In_It, Fwd_It>::decode_bytes (Fwd_It &start, const Fwd_It end,
     uint64_t written = 0;
     uint8_t new_skip = skip;
     for (uint8_t sbn = 0; sbn < blocks(); ++sbn) {
-        std::unique_lock<std::mutex> block_lock (_mtx);
-        auto it = decoders.find (sbn);
-        if (it == decoders.end())
+        auto block_lock = decoders.lock (sbn);
+        const Dec *it = decoders.get (sbn);
+        if (it == nullptr)
             return written;
-        auto dec_ptr = it->second.dec;
+        auto dec_ptr = it->dec;
         block_lock.unlock();
 
         if (!dec_ptr->ready()) {
@@ -1533,7 +2036,7 @@ uint64_t Decoder<In_It, Fwd_It>::decode_bytes (Fwd_It &start, const Fwd_It end,
         }
 
         Impl::De_Interleaver<Fwd_It> de_interleaving (dec_ptr->get_symbols(),
-                                                                _sub_blocks,
+                                                                &_sub_plan,
                                                                 symbols (sbn),
                                                                 _alignment);
 
@@ -1572,19 +2075,19 @@ size_t Decoder<In_It, Fwd_It>::decode_block_bytes (Fwd_It &start,
         return 0;
 
     std::shared_ptr<RaptorQ__v1::Impl::Raw_Decoder<In_It>> dec_ptr = nullptr;
-    std::unique_lock<std::mutex> lock (_mtx);
-    auto it = decoders.find (sbn);
+    auto lock = decoders.lock (sbn);
+    const Dec *it = decoders.get (sbn);
 
-    if (it == decoders.end())
+    if (it == nullptr)
         return 0;   // did not receive any data yet.
 
     if (use_pool) {
-        dec_ptr = it->second.dec;
+        dec_ptr = it->dec;
         lock.unlock();
         if (!dec_ptr->ready())
             return 0;   // did not receive enough data, or could not decode yet.
     } else {
-        dec_ptr = it->second.dec;
+        dec_ptr = it->dec;
         lock.unlock();
         if (!dec_ptr->ready()) {
             if (!dec_ptr->can_decode())
@@ -1599,7 +2102,7 @@ size_t Decoder<In_It, Fwd_It>::decode_block_bytes (Fwd_It &start,
     // decoder has decoded the block
 
     Impl::De_Interleaver<Fwd_It> de_interleaving (dec_ptr->get_symbols(),
-                                                                _sub_blocks,
+                                                                &_sub_plan,
                                                                 symbols (sbn),
                                                                 _alignment);
     size_t max_bytes = block_size (sbn);
@@ -1655,11 +2158,13 @@ bool Decoder<In_It, Fwd_It>::is_ready()
 template <typename In_It, typename Fwd_It>
 bool Decoder<In_It, Fwd_It>::is_block_ready (const uint8_t block)
 {
-    std::unique_lock<std::mutex> block_lock (_mtx);
-    auto it = decoders.find (block);
-    if (it == decoders.end())
+    auto block_lock = decoders.lock (block);
+    if (streamed (block))
+        return true;
+    const Dec *it = decoders.get (block);
+    if (it == nullptr)
         return false;
-    auto dec_ptr = it->second.dec;
+    auto dec_ptr = it->dec;
     block_lock.unlock();
 
     if (dec_ptr->ready())
@@ -1752,6 +2257,19 @@ Block_Size Decoder<Rnd_It, Fwd_It>::extended_symbols (const uint8_t sbn) const
     return (*RFC6330__v1::blocks)[idx];
 }
 
+template <typename Rnd_It, typename Fwd_It>
+Stats Decoder<Rnd_It, Fwd_It>::stats (const uint8_t sbn) const
+{
+    if (sbn >= blocks())
+        return Stats();
+    auto lock = decoders.lock (sbn);
+    RQ_UNUSED(lock);
+    const Dec *dec = decoders.get (sbn);
+    if (dec == nullptr || dec->dec == nullptr)
+        return Stats();
+    return dec->dec->stats();
+}
+
 }   // namespace Impl
 }   // namespace RFC6330__v1
 
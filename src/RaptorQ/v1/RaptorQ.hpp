@@ -28,10 +28,11 @@
 #include "RaptorQ/v1/Encoder.hpp"
 #include "RaptorQ/v1/Decoder.hpp"
 #include "RaptorQ/v1/Parameters.hpp"
+#include "RaptorQ/v1/util/Symbol_Tracker.hpp"
 #include <algorithm>
 #include <atomic>
 #include <cmath>
-#include <deque>
+#include <cstring>
 #include <future>
 #include <limits>
 #include <memory>
@@ -98,8 +99,18 @@ public:
     bool compute_sync();
     std::shared_future<Error> precompute();
     std::shared_future<Error> compute();
+    // threads for the final matrix product when the precomputation is
+    // cached. default: 1
+    void set_max_concurrency (const uint16_t max_threads);
+    // the last computation of the encoder
+    Stats stats() const;
 
     size_t encode (Fwd_It &output, const Fwd_It end, const uint32_t id);
+    // many symbols, back to back in "output" ("size" bytes).
+    // returns the number of symbols written.
+    size_t encode_symbols (uint8_t *output, const size_t size,
+                                                        const uint32_t *esi,
+                                                        const size_t n);
 
 private:
     enum class Enc_State : uint8_t {
@@ -110,9 +121,10 @@ private:
 
     const size_t _symbol_size;
     const uint16_t _symbols;
+    uint16_t _max_threads;
     Enc_State _state;
     Raw_Encoder<Rnd_It, Fwd_It, without_interleaver> encoder;
-    DenseMtx precomputed;
+    Precomputed precomputed;
     Rnd_It _from, _to;
     // avoid launching multiple computations for the encoder.
     // it is guaranteed to succeed anyway.
@@ -150,6 +162,11 @@ public:
 #endif
 
     Error add_symbol (In_It &from, const In_It to, const uint32_t esi);
+    // many symbols, back to back in "data" ("size" bytes), added under a
+    // single lock. returns the number of symbols added.
+    size_t add_symbols (const uint8_t *data, const size_t size,
+                                                        const uint32_t *esi,
+                                                        const size_t n);
     std::vector<bool> end_of_input (const Fill_With_Zeros fill);
 
     bool can_decode() const;
@@ -159,6 +176,13 @@ public:
     uint16_t needed_symbols() const;
 
     void set_max_concurrency (const uint16_t max_threads);
+    // how the rows are chosen while decoding. default: Pivot::RFC
+    void set_pivot (const Pivot strategy);
+    // inactivated columns ("u") of the last decoding: the size of the
+    // dense part of the system. 0 if the operations came from the cache.
+    uint16_t inactivated() const;
+    // timings, cache usage and sizes of the last decoding
+    Stats stats() const;
     Decoder_Result decode_once();
 
     struct Decoder_wait_res poll();
@@ -170,7 +194,17 @@ public:
     // return number of bytes written
     struct Decoder_written decode_bytes (Fwd_It &start, const Fwd_It end,
                                     const size_t from_byte, const size_t skip);
+    // bytes written, up to the first missing symbol.
+    size_t decode_range (uint8_t *output, const size_t size,
+                                                    const size_t from_byte);
 private:
+    // contiguous output is filled with decode_range
+    Decoder_written decode_bytes (Fwd_It &start, const Fwd_It end,
+                                    const size_t from_byte, const size_t skip,
+                                    const std::true_type);
+    Decoder_written decode_bytes (Fwd_It &start, const Fwd_It end,
+                                    const size_t from_byte, const size_t skip,
+                                    const std::false_type);
     uint16_t _max_threads;
     const uint16_t _symbols;
     const size_t _symbol_size;
@@ -178,9 +212,8 @@ private:
     const Dec_Report _type;
     RaptorQ__v1::Work_State work;
     Raw_Decoder<In_It> dec;
-    // 2* symbols. Actually tracks available and reported symbols.
-    // each symbol gets 2 bool: 1= available, 2=reported
-    std::deque<std::atomic<bool>> symbols_tracker;
+    // available and reported source symbols. size 0 => not initialized
+    Impl::Symbol_Tracker symbols_tracker;
     std::mutex _mtx;
     std::condition_variable _cond;
     std::vector<std::thread> waiting;
@@ -206,7 +239,7 @@ template <typename Rnd_It, typename Fwd_It>
 Encoder<Rnd_It, Fwd_It>::Encoder (const Block_Size symbols,
                                                     const size_t symbol_size)
     : _symbol_size (symbol_size), _symbols (static_cast<uint16_t> (symbols)),
-                                                encoder (symbols, _symbol_size)
+                            _max_threads (1), encoder (symbols, _symbol_size)
 {
     IS_RANDOM(Rnd_It, "RaptorQ__v1::Encoder");
     IS_FORWARD(Fwd_It, "RaptorQ__v1::Encoder");
@@ -342,6 +375,14 @@ template <typename Rnd_It, typename Fwd_It>
 void Encoder<Rnd_It, Fwd_It>::stop()
     { encoder.stop(); }
 
+template <typename Rnd_It, typename Fwd_It>
+Stats Encoder<Rnd_It, Fwd_It>::stats() const
+{
+    if (_state == Enc_State::INIT_ERROR)
+        return Stats();
+    return encoder.stats();
+}
+
 template <typename Rnd_It, typename Fwd_It>
 bool Encoder<Rnd_It, Fwd_It>::precompute_sync()
 {
@@ -372,8 +413,11 @@ bool Encoder<Rnd_It, Fwd_It>::compute_sync()
     if (_single_wait.valid())
         _single_wait.wait();
     std::unique_lock<std::mutex> lock (_mtx);
-    if (_single_wait.valid() && _single_wait.get() == Error::NONE)
+    // a finished precompute() did not generate the symbols of new data
+    if (_single_wait.valid() && _single_wait.get() == Error::NONE &&
+                            (_state != Enc_State::FULL || encoder.ready())) {
         return true;
+    }
     stop();
     if (_waiting.joinable())
         _waiting.join();
@@ -392,9 +436,9 @@ void Encoder<Rnd_It, Fwd_It>::compute_thread (
     static RaptorQ__v1::Work_State work = RaptorQ__v1::Work_State::KEEP_WORKING;
 
     if (force_precomputation) {
-        if (obj->precomputed.rows() == 0)
+        if (obj->precomputed == nullptr)
             obj->precomputed = obj->encoder.get_precomputed (&work);
-        if (obj->precomputed.rows() == 0) {
+        if (obj->precomputed == nullptr) {
             // encoder always works. only possible reason:
             p.set_value (Error::EXITING);
             return;
@@ -402,8 +446,8 @@ void Encoder<Rnd_It, Fwd_It>::compute_thread (
         // if we finished getting data by the time the computation
         // finished, update it all.
         if (obj->_state == Enc_State::FULL && !obj->encoder.ready())
-            obj->encoder.generate_symbols (obj->precomputed,
-                                                    &obj->_from, &obj->_to);
+            obj->encoder.generate_symbols (*obj->precomputed,
+                                &obj->_from, &obj->_to, obj->_max_threads);
         p.set_value (Error::NONE);
     } else {
         if (obj->encoder.ready()) {
@@ -420,9 +464,9 @@ void Encoder<Rnd_It, Fwd_It>::compute_thread (
                 return;
             }
         } else {
-            if (obj->precomputed.rows() == 0) {
+            if (obj->precomputed == nullptr) {
                 obj->precomputed = obj->encoder.get_precomputed (&work);
-                if (obj->precomputed.rows() == 0) {
+                if (obj->precomputed == nullptr) {
                     // only possible reason:
                     p.set_value (Error::EXITING);
                     return;
@@ -431,8 +475,8 @@ void Encoder<Rnd_It, Fwd_It>::compute_thread (
             if (obj->_state == Enc_State::FULL) {
                 // if we finished getting data by the time the computation
                 // finished, update it all.
-                obj->encoder.generate_symbols (obj->precomputed,
-                                                    &obj->_from, &obj->_to);
+                obj->encoder.generate_symbols (*obj->precomputed,
+                                &obj->_from, &obj->_to, obj->_max_threads);
             }
             p.set_value (Error::NONE);
             return;
@@ -440,6 +484,13 @@ void Encoder<Rnd_It, Fwd_It>::compute_thread (
     }
 }
 
+template <typename Rnd_It, typename Fwd_It>
+void Encoder<Rnd_It, Fwd_It>::set_max_concurrency (const uint16_t max_threads)
+{
+    if (_state != Enc_State::INIT_ERROR)
+        _max_threads = std::max<uint16_t> (1, max_threads);
+}
+
 template <typename Rnd_It, typename Fwd_It>
 std::shared_future<Error> Encoder<Rnd_It, Fwd_It>::precompute()
 {
@@ -494,6 +545,9 @@ size_t Encoder<Rnd_It, Fwd_It>::encode (Fwd_It &output, const Fwd_It end,
                 if (!_single_wait.valid())
                     _single_wait = compute();
                 _single_wait.wait();
+                // the future might have been from precompute()
+                if (!encoder.ready())
+                    compute_sync();
             }
         }
         return encoder.Enc (id, output, end);
@@ -501,6 +555,27 @@ size_t Encoder<Rnd_It, Fwd_It>::encode (Fwd_It &output, const Fwd_It end,
     return 0;
 }
 
+template <typename Rnd_It, typename Fwd_It>
+size_t Encoder<Rnd_It, Fwd_It>::encode_symbols (uint8_t *output,
+                                                        const size_t size,
+                                                        const uint32_t *esi,
+                                                        const size_t n)
+{
+    if (_state != Enc_State::FULL)
+        return 0;
+    size_t done = 0;
+    for (; done < n && (done + 1) * _symbol_size <= size; ++done) {
+        if (esi[done] >= _symbols && !encoder.ready()) {
+            compute_sync();
+            if (!encoder.ready())
+                break;
+        }
+        if (encoder.Enc_bytes (esi[done], output + done * _symbol_size) == 0)
+            break;
+    }
+    return done;
+}
+
 ///////////////////
 //// Decoder
 ///////////////////
@@ -551,9 +626,7 @@ Decoder<In_It, Fwd_It>::Decoder (const Block_Size symbols,
     }
 
     last_reported.store (0);
-    symbols_tracker = std::deque<std::atomic<bool>> (2 * _symbols);
-    for (idx = 0; idx < 2 * _symbols; ++idx)
-        symbols_tracker[idx] = false;
+    symbols_tracker.init (_symbols);
     work = RaptorQ__v1::Work_State::KEEP_WORKING;
     _max_threads = 1;
 }
@@ -612,38 +685,52 @@ Error Decoder<In_It, Fwd_It>::add_symbol (In_It &from, const In_It to,
     auto ret = dec.add_symbol (from, to, esi, false);
     if (ret == Error::NONE) {
         if (esi < _symbols)
-            symbols_tracker [2 * esi].store (true);
+            symbols_tracker.set_available (static_cast<uint16_t> (esi));
         std::unique_lock<std::mutex> lock (_mtx);
         _cond.notify_all();
     }
     return ret;
 }
 
+template <typename In_It, typename Fwd_It>
+size_t Decoder<In_It, Fwd_It>::add_symbols (const uint8_t *data,
+                                                        const size_t size,
+                                                        const uint32_t *esi,
+                                                        const size_t n)
+{
+    if (symbols_tracker.size() == 0)
+        return 0;
+    const size_t whole = std::min (n, size / _symbol_size);
+    std::vector<Symbol_Ref> syms (whole);
+    for (size_t idx = 0; idx < whole; ++idx)
+        syms[idx] = {data + idx * _symbol_size, esi[idx], Error::NONE};
+    const uint32_t added = dec.add_symbols (syms.data(),
+                                                static_cast<uint32_t> (whole));
+    if (added == 0)
+        return 0;
+    for (const auto &sym : syms) {
+        if (sym.err == Error::NONE && sym.esi < _symbols)
+            symbols_tracker.set_available (static_cast<uint16_t> (sym.esi));
+    }
+    std::unique_lock<std::mutex> lock (_mtx);
+    _cond.notify_all();
+    return added;
+}
+
 template <typename In_It, typename Fwd_It>
 Decoder_wait_res Decoder<In_It, Fwd_It>::poll ()
 {
     if (symbols_tracker.size() == 0)
         return {Error::INITIALIZATION, 0};
-    uint32_t idx;
+    uint16_t idx;
     uint32_t last;
-    bool expected = false;
     switch (_type) {
     case Dec_Report::PARTIAL_FROM_BEGINNING:
         // report the number of symbols that are known, starting from
         // the beginning.
         last = last_reported.load();
-        idx = last;
-        for (; idx < symbols_tracker.size(); idx += 2) {
-            if (symbols_tracker[idx].load() == true) {
-                ++idx;
-                if (symbols_tracker[idx].load() == false)
-                    symbols_tracker[idx].store (true);
-                --idx;
-            } else {
-                break;
-            }
-        }
-        idx /= 2;
+        idx = symbols_tracker.first_missing (
+                    static_cast<uint16_t> (std::min<uint32_t> (last, _symbols)));
         if (idx > last) {
             while (!last_reported.compare_exchange_weak (last, idx)) {
                 // expected is now "last_reported.load()"
@@ -660,7 +747,7 @@ Decoder_wait_res Decoder<In_It, Fwd_It>::poll ()
                 }
                 // else we can report the new stuff
             }
-            return {Error::NONE, static_cast<uint16_t>(idx)};
+            return {Error::NONE, idx};
         }
         // nothing to report
         if (dec.ready()) {
@@ -675,37 +762,25 @@ Decoder_wait_res Decoder<In_It, Fwd_It>::poll ()
         // or return {NONE, _symbols} if all have been reported
         if (dec.ready())
             return {Error::NONE, _symbols};
-        for (idx = 0; idx < static_cast<uint32_t> (symbols_tracker.size());
-                                                                    idx += 2) {
-            if (symbols_tracker[idx].load() == true) {
-                ++idx;
-                if (symbols_tracker[idx].load() == false) {
-                    expected = false;
-                    if (symbols_tracker[idx].
-                                    compare_exchange_strong (expected, true)) {
-                        return {Error::NONE, static_cast<uint16_t> (idx / 2)};
-                    }   // else some other thread raced us, keep trying other
-                        // symbols
-                }
-            }
-        }
+        idx = symbols_tracker.claim_unreported();
+        if (idx < _symbols)
+            return {Error::NONE, idx};
         if (dec.ready())
             return {Error::NONE, _symbols};
         if (dec.threads() > 0)
             return {Error::WORKING, 0};
         return {Error::NEED_DATA, 0};
     case Dec_Report::COMPLETE:
-        auto init = last_reported.load();
-        idx = init * 2;
-        for (; idx < symbols_tracker.size(); idx += 2) {
-            if (symbols_tracker[idx].load() == false) {
-                idx /= 2;
-                while (!last_reported.compare_exchange_weak(init, idx))
-                    idx = std::max(init, idx);
-                if (dec.threads() > 0)
-                    return {Error::WORKING, 0};
-                return {Error::NEED_DATA, 0};
-            }
+        last = last_reported.load();
+        idx = symbols_tracker.first_missing (
+                    static_cast<uint16_t> (std::min<uint32_t> (last, _symbols)));
+        if (idx < _symbols) {
+            uint32_t missing = idx;
+            while (!last_reported.compare_exchange_weak (last, missing))
+                missing = std::max (last, missing);
+            if (dec.threads() > 0)
+                return {Error::WORKING, 0};
+            return {Error::NEED_DATA, 0};
         }
         last_reported.store (_symbols);
         return {Error::NONE, 0};
@@ -813,6 +888,29 @@ void Decoder<In_It, Fwd_It>::set_max_concurrency (const uint16_t max_threads)
         _max_threads = max_threads;
 }
 
+template <typename In_It, typename Fwd_It>
+void Decoder<In_It, Fwd_It>::set_pivot (const Pivot strategy)
+{
+    if (symbols_tracker.size() != 0)
+        dec.set_pivot (strategy);
+}
+
+template <typename In_It, typename Fwd_It>
+uint16_t Decoder<In_It, Fwd_It>::inactivated() const
+{
+    if (symbols_tracker.size() == 0)
+        return 0;
+    return dec.inactivated();
+}
+
+template <typename In_It, typename Fwd_It>
+Stats Decoder<In_It, Fwd_It>::stats() const
+{
+    if (symbols_tracker.size() == 0)
+        return Stats();
+    return dec.stats();
+}
+
 template <typename In_It, typename Fwd_It>
 Decoder_Result Decoder<In_It, Fwd_It>::decode_once()
 {
@@ -822,11 +920,8 @@ Decoder_Result Decoder<In_It, Fwd_It>::decode_once()
     if (res == Decoder_Result::DECODED) {
         std::unique_lock<std::mutex> lock (_mtx);
         RQ_UNUSED (lock);
-        if (_type != Dec_Report::COMPLETE) {
-            uint32_t id = last_reported.load();
-            for (; id < symbols_tracker.size(); id += 2)
-                symbols_tracker[id].store (true);
-        }
+        if (_type != Dec_Report::COMPLETE)
+            symbols_tracker.set_all_available();
         last_reported.store(_symbols);
         lock.unlock();
     }
@@ -861,8 +956,7 @@ void Decoder<In_It, Fwd_It>::clear_data()
     RQ_UNUSED (lock);
     dec.clear_data();
     last_reported.store(0);
-    for (auto it = symbols_tracker.begin(); it != symbols_tracker.end(); ++it)
-        *it = false;
+    symbols_tracker.clear();
 }
 
 template <typename In_It, typename Fwd_It>
@@ -877,6 +971,37 @@ Decoder_written Decoder<In_It, Fwd_It>::decode_bytes (Fwd_It &start,
                             static_cast<size_t> (_symbols * _symbol_size)) {
         return {0, 0};
     }
+    return decode_bytes (start, end, from_byte, skip, is_contiguous<Fwd_It>());
+}
+
+template <typename In_It, typename Fwd_It>
+Decoder_written Decoder<In_It, Fwd_It>::decode_bytes (Fwd_It &start,
+                                                        const Fwd_It end,
+                                                        const size_t from_byte,
+                                                        const size_t skip,
+                                                        const std::true_type)
+{
+    using T = typename std::iterator_traits<Fwd_It>::value_type;
+    if (start == end)
+        return {0, skip};
+    // keep the first "skip" bytes of "start", and do not overwrite
+    // anything past the last decoded byte.
+    const size_t room = static_cast<size_t> (end - start) * sizeof(T) - skip;
+    uint8_t *out = reinterpret_cast<uint8_t *> (&*start) + skip;
+    const size_t written = skip + decode_range (out, room, from_byte);
+    start += static_cast<typename std::iterator_traits<Fwd_It>::
+                                    difference_type> (written / sizeof(T));
+    return {written, written % sizeof(T)};
+}
+
+template <typename In_It, typename Fwd_It>
+Decoder_written Decoder<In_It, Fwd_It>::decode_bytes (Fwd_It &start,
+                                                        const Fwd_It end,
+                                                        const size_t from_byte,
+                                                        const size_t skip,
+                                                        const std::false_type)
+{
+    using T = typename std::iterator_traits<Fwd_It>::value_type;
 
     auto decoded = dec.get_symbols();
 
@@ -923,6 +1048,30 @@ Decoder_written Decoder<In_It, Fwd_It>::decode_bytes (Fwd_It &start,
     return {written, offset_al};
 }
 
+template <typename In_It, typename Fwd_It>
+size_t Decoder<In_It, Fwd_It>::decode_range (uint8_t *output,
+                                                    const size_t size,
+                                                    const size_t from_byte)
+{
+    if (symbols_tracker.size() == 0)
+        return 0;
+    const size_t end = std::min (static_cast<size_t> (_symbols) * _symbol_size,
+                                                            from_byte + size);
+    DenseMtx *decoded = dec.get_symbols();
+    size_t pos = from_byte;
+    while (pos < end) {
+        const uint16_t esi = static_cast<uint16_t> (pos / _symbol_size);
+        if (!dec.has_symbol (esi))
+            break;
+        const size_t in_symbol = pos % _symbol_size;
+        const size_t len = std::min (_symbol_size - in_symbol, end - pos);
+        std::memcpy (output + (pos - from_byte),
+                                    row_ptr (*decoded, esi) + in_symbol, len);
+        pos += len;
+    }
+    return pos > from_byte ? pos - from_byte : 0;
+}
+
 template <typename In_It, typename Fwd_It>
 Error Decoder<In_It, Fwd_It>::decode_symbol (Fwd_It &start, const Fwd_It end,
                                                             const uint16_t esi)
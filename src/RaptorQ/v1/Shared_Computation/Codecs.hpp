@@ -0,0 +1,319 @@
+/*
+ * Copyright (c) 2018, Luca Fulchir<luca@fulchir.it>, All rights reserved.
+ *
+ * This file is part of "libRaptorQ".
+ *
+ * libRaptorQ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * libRaptorQ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * and a copy of the GNU Lesser General Public License
+ * along with libRaptorQ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "RaptorQ/v1/common.hpp"
+#include "RaptorQ/v1/caches.hpp"
+#ifdef RQ_USE_LZ4
+    #include "RaptorQ/v1/Shared_Computation/LZ4_Wrapper.hpp"
+#endif
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace RaptorQ__v1 {
+namespace Impl {
+
+// Sparse codec: most bytes of the cached operations are zero
+// (padding, small row indexes, 0/1 coefficients).
+// Format: uint32_t original size, then for each group of 8 bytes
+// one bitmask byte (bit i => byte i is not zero) followed by the
+// non-zero bytes of the group.
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wweak-vtables"
+class RAPTORQ_LOCAL Sparse_Codec final : public Codec
+{
+public:
+    Compress id() const override
+        { return Compress::SPARSE; }
+    std::vector<uint8_t> encode (const std::vector<uint8_t> &in)
+                                                            const override;
+    using Codec::decode;
+    std::vector<uint8_t> decode (const uint8_t *in, const size_t size)
+                                                            const override;
+};
+
+#ifdef RQ_USE_LZ4
+template<LZ4_t enc_type, Compress codec_id>
+class RAPTORQ_LOCAL LZ4_Codec final : public Codec
+{
+public:
+    Compress id() const override
+        { return codec_id; }
+    std::vector<uint8_t> encode (const std::vector<uint8_t> &in)
+                                                            const override
+    {
+        LZ4<enc_type> lz4;
+        return lz4.encode (in);
+    }
+    using Codec::decode;
+    std::vector<uint8_t> decode (const uint8_t *in, const size_t size)
+                                                            const override
+    {
+        LZ4<LZ4_t::DECODER> lz4;
+        return lz4.decode (in, size);
+    }
+};
+#endif
+#pragma clang diagnostic pop
+
+inline std::vector<uint8_t> Sparse_Codec::encode (
+                                        const std::vector<uint8_t> &in) const
+{
+    std::vector<uint8_t> ret;
+    if (in.size() == 0 || in.size() > std::numeric_limits<uint32_t>::max())
+        return ret;
+    // worst case: one mask byte every 8 bytes
+    ret.resize (sizeof(uint32_t) + in.size() + (in.size() + 7) / 8);
+    const uint32_t size = static_cast<uint32_t> (in.size());
+    std::memcpy (ret.data(), &size, sizeof(size));
+    uint8_t *out = ret.data() + sizeof(size);
+    for (size_t group = 0; group < in.size(); group += 8) {
+        const size_t group_end = std::min<size_t> (group + 8, in.size());
+        uint8_t *mask = out++;
+        *mask = 0;
+        for (size_t idx = group; idx < group_end; ++idx) {
+            if (in[idx] == 0)
+                continue;
+            *mask = static_cast<uint8_t> (*mask | (1 << (idx - group)));
+            *(out++) = in[idx];
+        }
+    }
+    ret.resize (static_cast<size_t> (out - ret.data()));
+    return ret;
+}
+
+inline std::vector<uint8_t> Sparse_Codec::decode (const uint8_t *in,
+                                                    const size_t size) const
+{
+    uint32_t out_size;
+    if (size < sizeof(out_size))
+        return std::vector<uint8_t>();
+    std::memcpy (&out_size, in, sizeof(out_size));
+    // each mask byte covers at most 8 output bytes: do not trust the
+    // header for the allocation
+    if (out_size > 8 * (size - sizeof(out_size)))
+        return std::vector<uint8_t>();
+    std::vector<uint8_t> ret (out_size, 0);
+    const uint8_t *data = in + sizeof(out_size);
+    const uint8_t *const end = in + size;
+    for (size_t group = 0; group < ret.size(); group += 8) {
+        if (data == end)
+            return std::vector<uint8_t>();
+        uint8_t mask = *(data++);
+        const size_t group_size = std::min<size_t> (8, ret.size() - group);
+        if (group_size < 8 && (mask >> group_size) != 0)
+            return std::vector<uint8_t>();
+        uint8_t *out = ret.data() + group;
+        for (; mask != 0; ++out, mask = static_cast<uint8_t> (mask >> 1)) {
+            if ((mask & 1) == 0)
+                continue;
+            if (data == end)
+                return std::vector<uint8_t>();
+            *out = *(data++);
+        }
+    }
+    if (data != end)
+        return std::vector<uint8_t>();
+    return ret;
+}
+
+
+// when compressing with more than one codec, keep the fastest to decode
+// between the ones that are at most 1/codec_size_slack bigger than the
+// smallest result.
+constexpr size_t codec_size_slack = 8;
+
+class RAPTORQ_LOCAL Codec_Registry
+{
+public:
+    Codec_Registry (const Codec_Registry&) = delete;
+    Codec_Registry& operator= (const Codec_Registry&) = delete;
+    Codec_Registry (Codec_Registry&&) = delete;
+    Codec_Registry& operator= (Codec_Registry&&) = delete;
+    ~Codec_Registry() = default;
+
+    static Codec_Registry& get()
+    {
+        #pragma clang diagnostic push
+        #pragma clang diagnostic ignored "-Wexit-time-destructors"
+        #pragma clang diagnostic ignored "-Wglobal-constructors"
+        static Codec_Registry registry;
+        #pragma clang diagnostic pop
+        return registry;
+    }
+
+    bool add (std::unique_ptr<Codec> codec);
+    // nullptr if not registered
+    const Codec* find (const Compress id) const;
+
+    Compress supported() const
+        { return static_cast<Compress> (_supported.load()); }
+    Compress enabled() const
+        { return static_cast<Compress> (_enabled.load()); }
+    bool enable (const Compress codecs);
+
+    // NONE + the original data if no codec helps
+    std::pair<Compress, std::vector<uint8_t>> compress (
+                                    const std::vector<uint8_t> &data) const;
+    std::vector<uint8_t> decompress (const Compress id,
+                                    const uint8_t *data,
+                                    const size_t size) const;
+private:
+    Codec_Registry();
+    static int32_t slot (const Compress id);
+
+    std::mutex _mtx;
+    // codecs are never removed, so the pointers can be read without locks
+    std::array<std::unique_ptr<Codec>, 8> _codecs;
+    std::array<std::atomic<const Codec*>, 8> _lookup;
+    std::atomic<uint8_t> _supported, _enabled;
+};
+
+inline Codec_Registry::Codec_Registry()
+    : _supported (static_cast<uint8_t> (Compress::NONE)),
+      _enabled (static_cast<uint8_t> (Compress::NONE))
+{
+    for (auto &ptr : _lookup)
+        ptr.store (nullptr);
+    add (std::unique_ptr<Codec> (new Sparse_Codec()));
+#ifdef RQ_USE_LZ4
+    add (std::unique_ptr<Codec> (
+                        new LZ4_Codec<LZ4_t::ENCODER, Compress::LZ4>()));
+    add (std::unique_ptr<Codec> (
+                        new LZ4_Codec<LZ4_t::ENCODER_HC, Compress::LZ4HC>()));
+#endif
+}
+
+inline int32_t Codec_Registry::slot (const Compress id)
+{
+    const uint8_t bits = static_cast<uint8_t> (id);
+    if (bits == 0 || (bits & (bits - 1)) != 0)
+        return -1;
+    int32_t ret = 0;
+    while ((bits >> ret) != 1)
+        ++ret;
+    return ret;
+}
+
+inline bool Codec_Registry::add (std::unique_ptr<Codec> codec)
+{
+    if (codec == nullptr)
+        return false;
+    const int32_t idx = slot (codec->id());
+    if (idx < 0)
+        return false;
+    std::lock_guard<std::mutex> guard (_mtx);
+    RQ_UNUSED (guard);
+    const size_t pos = static_cast<size_t> (idx);
+    if (_codecs[pos] != nullptr)
+        return false;
+    _codecs[pos] = std::move (codec);
+    _lookup[pos].store (_codecs[pos].get());
+    _supported |= static_cast<uint8_t> (1 << idx);
+    return true;
+}
+
+inline const Codec* Codec_Registry::find (const Compress id) const
+{
+    const int32_t idx = slot (id);
+    if (idx < 0)
+        return nullptr;
+    return _lookup[static_cast<size_t> (idx)].load();
+}
+
+inline bool Codec_Registry::enable (const Compress codecs)
+{
+    const uint8_t bits = static_cast<uint8_t> (codecs);
+    if ((bits & _supported.load()) != bits)
+        return false;
+    _enabled.store (bits);
+    return true;
+}
+
+inline std::pair<Compress, std::vector<uint8_t>> Codec_Registry::compress (
+                                        const std::vector<uint8_t> &data) const
+{
+    const uint8_t enabled_bits = _enabled.load();
+    if (enabled_bits == 0)
+        return {Compress::NONE, data};
+
+    struct Candidate {
+        Compress id;
+        std::vector<uint8_t> data;
+        std::chrono::steady_clock::duration decode_time;
+    };
+    std::vector<Candidate> candidates;
+    for (uint8_t bit = 0; bit < 8; ++bit) {
+        if ((enabled_bits & (1 << bit)) == 0)
+            continue;
+        const Codec *codec = _lookup[bit].load();
+        if (codec == nullptr)
+            continue;
+        auto encoded = codec->encode (data);
+        if (encoded.size() == 0 || encoded.size() >= data.size())
+            continue;
+        // decode it once: measure it and make sure the codec works
+        const auto start = std::chrono::steady_clock::now();
+        const auto decoded = codec->decode (encoded);
+        const auto time = std::chrono::steady_clock::now() - start;
+        if (decoded != data)
+            continue;
+        candidates.push_back ({codec->id(), std::move (encoded), time});
+    }
+    if (candidates.size() == 0)
+        return {Compress::NONE, data};
+
+    size_t smallest = candidates[0].data.size();
+    for (const auto &cand : candidates)
+        smallest = std::min (smallest, cand.data.size());
+    const size_t max_size = smallest + smallest / codec_size_slack;
+    Candidate *best = nullptr;
+    for (auto &cand : candidates) {
+        if (cand.data.size() > max_size)
+            continue;
+        if (best == nullptr || cand.decode_time < best->decode_time)
+            best = &cand;
+    }
+    return {best->id, std::move (best->data)};
+}
+
+inline std::vector<uint8_t> Codec_Registry::decompress (const Compress id,
+                                                    const uint8_t *data,
+                                                    const size_t size) const
+{
+    if (id == Compress::NONE)
+        return std::vector<uint8_t> (data, data + size);
+    const Codec *codec = find (id);
+    if (codec == nullptr)
+        return std::vector<uint8_t>();
+    return codec->decode (data, size);
+}
+
+} // namespace Impl
+} // namespace RaptorQ__v1
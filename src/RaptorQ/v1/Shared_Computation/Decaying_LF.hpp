@@ -21,10 +21,14 @@
 #pragma once
 
 #include "RaptorQ/v1/common.hpp"
+#include "RaptorQ/v1/caches.hpp"
 #include "RaptorQ/v1/Operation.hpp"
+#include "RaptorQ/v1/Shared_Computation/Stats_Registry.hpp"
+#include "RaptorQ/v1/util/tracepoints.hpp"
 #include <algorithm>
 #include <atomic>
 #include <cmath>
+#include <cstring>
 #include <deque>
 #include <limits>
 #include <memory>
@@ -37,35 +41,6 @@ namespace RaptorQ__v1 {
 namespace Impl {
 
 
-// easy compress from/to eigen matrix
-std::vector<uint8_t> RAPTORQ_API Mtx_to_raw (const DenseMtx &mtx);
-inline std::vector<uint8_t> RAPTORQ_API Mtx_to_raw (const DenseMtx &mtx)
-{
-    std::vector<uint8_t> ret;
-    ret.reserve (static_cast<size_t> (mtx.rows() * mtx.cols()));
-    for (uint32_t row = 0; row < static_cast<uint32_t> (mtx.rows()); ++row) {
-        for (uint32_t col = 0; col < static_cast<uint32_t> (mtx.cols()); ++col)
-            ret.emplace_back (static_cast<uint8_t> (mtx (row, col)));
-    }
-    return ret;
-}
-
-DenseMtx RAPTORQ_API raw_to_Mtx (const std::vector<uint8_t> &raw,
-                                                        const uint32_t cols);
-inline DenseMtx RAPTORQ_API raw_to_Mtx (const std::vector<uint8_t> &raw,
-                                                        const uint32_t cols)
-{
-    uint16_t rows = static_cast<uint16_t> (raw.size() / cols);
-    DenseMtx ret (rows, cols);
-    auto raw_it = raw.begin();
-    for (uint32_t row = 0; row < rows; ++row) {
-        for (uint32_t col = 0; col < cols; ++col, ++raw_it)
-            ret (row, col) = *raw_it;
-    }
-    return ret;
-}
-
-
 // TODO: keys and search: we might be able to decode things without using
 // all repair symbols! so the cached mtx could have less symbols than the
 // working one
@@ -156,6 +131,35 @@ public:
 
     uint32_t out_size() const
         { return (_mt_size - _lost) + _repair; }
+
+    // flat representation: matrix size, lost, repair, bitmask sizes,
+    // then the packed bitmasks. Used by the shared cache.
+    std::vector<uint8_t> serialize() const
+    {
+        const uint32_t sizes[3] = {
+                            static_cast<uint32_t> (_mt_size) |
+                                        (static_cast<uint32_t> (_lost) << 16),
+                            static_cast<uint32_t> (_lost_bitmask.size()),
+                            static_cast<uint32_t> (_repair_bitmask.size()) };
+        std::vector<uint8_t> ret (sizeof(sizes) + sizeof(_repair) +
+                                        (_lost_bitmask.size() + 7) / 8 +
+                                        (_repair_bitmask.size() + 7) / 8, 0);
+        std::memcpy (ret.data(), sizes, sizeof(sizes));
+        std::memcpy (ret.data() + sizeof(sizes), &_repair, sizeof(_repair));
+        uint8_t *bits = ret.data() + sizeof(sizes) + sizeof(_repair);
+        for (size_t idx = 0; idx < _lost_bitmask.size(); ++idx) {
+            if (_lost_bitmask[idx])
+                bits[idx / 8] = static_cast<uint8_t> (bits[idx / 8] |
+                                                            (1 << (idx % 8)));
+        }
+        bits += (_lost_bitmask.size() + 7) / 8;
+        for (size_t idx = 0; idx < _repair_bitmask.size(); ++idx) {
+            if (_repair_bitmask[idx])
+                bits[idx / 8] = static_cast<uint8_t> (bits[idx / 8] |
+                                                            (1 << (idx % 8)));
+        }
+        return ret;
+    }
 };
 
 
@@ -200,8 +204,11 @@ public:
 
     size_t get_size() const;
     size_t resize (const size_t new_size);
-    bool add (const Compress algo, User_Data &raw, const Key &key);
+    // "uncompressed": size before compression, only for the statistics
+    bool add (const Compress algo, User_Data &raw, const Key &key,
+                                                const size_t uncompressed = 0);
     std::pair<Compress, User_Data> get (const Key &key);
+    std::vector<Cache_Entry_Stats> stats();
 private:
     DLF ();
     // keep everything in a linked list, ordered by score.
@@ -215,13 +222,17 @@ private:
     public:
         DLF_Data (const DLF_Data &d);
         DLF_Data (const Key k, const uint32_t _score, const uint32_t _tick,
-                                        User_Data &_raw, const Compress alg)
-            : key (k), score (_score), tick(_tick), raw(std::move(_raw)),
-              algorithm (alg)
+                                        User_Data &_raw, const Compress alg,
+                                        const size_t _uncompressed)
+            : key (k), score (_score), tick(_tick), hits (0),
+              uncompressed (_uncompressed == 0 ? _raw.size() : _uncompressed),
+              raw(std::move(_raw)), algorithm (alg)
         {}
         Key key;
         uint32_t score;
         uint32_t tick;
+        uint32_t hits;
+        size_t uncompressed;
         User_Data raw;
         Compress algorithm;
 
@@ -238,6 +249,8 @@ private:
 
     void test_and_reset_scores();
     void update_element (DLF_Data &el);
+    // needs the lock
+    void update_metrics (const uint64_t evicted) const;
 };
 
 
@@ -248,6 +261,8 @@ DLF<User_Data, Key>::DLF_Data::DLF_Data (const DLF_Data &d)
     algorithm = d.algorithm;
     score = d.score;
     tick = d.tick;
+    hits = d.hits;
+    uncompressed = d.uncompressed;
     raw = d.raw;
 }
 
@@ -259,6 +274,8 @@ typename DLF<User_Data, Key>::DLF_Data&
     algorithm = d.algorithm;
     score = d.score;
     tick = d.tick;
+    hits = d.hits;
+    uncompressed = d.uncompressed;
     raw = d.raw;
 
     return *this;
@@ -285,16 +302,33 @@ size_t DLF<User_Data, Key>::resize (const size_t new_size)
 {
     std::lock_guard<std::mutex> guard (biglock);
     RQ_UNUSED (guard);
+    uint64_t evicted = 0;
+    const size_t old_size = actual_size;
     while (actual_size > new_size) {
         auto r_it = data.rbegin();
         assert (r_it != data.rend() && "RQ: DLF: r_it should have data.");
         actual_size -= (sizeof(DLF_Data) + r_it->raw.size());
         data.pop_back();
+        ++evicted;
     }
+    if (evicted != 0)
+        RQ_TRACE2 (cache_evict, evicted, old_size - actual_size);
     max_size = new_size;
+    update_metrics (evicted);
     return max_size;
 }
 
+template<typename User_Data, typename Key>
+void DLF<User_Data, Key>::update_metrics (const uint64_t evicted) const
+{
+    auto &metrics = Metrics_Registry::get();
+    metrics.cache_max_bytes.store (max_size, std::memory_order_relaxed);
+    metrics.cache_bytes.store (actual_size, std::memory_order_relaxed);
+    metrics.cache_entries.store (data.size(), std::memory_order_relaxed);
+    if (evicted != 0)
+        metrics.cache_evictions.fetch_add (evicted, std::memory_order_relaxed);
+}
+
 template<typename User_Data, typename Key>
 void DLF<User_Data, Key>::test_and_reset_scores()
 {
@@ -344,16 +378,41 @@ std::pair<Compress, User_Data> DLF<User_Data, Key>::get (const Key &key)
     for (auto &tmp : data) {
         if (tmp.key == key) {
             std::pair<Compress, User_Data> ret_data = {tmp.algorithm, tmp.raw};
+            ++tmp.hits;
             update_element (tmp);
+            Metrics_Registry::get().cache_hits.fetch_add (1,
+                                                    std::memory_order_relaxed);
+            RQ_TRACE2 (cache_get, 1, tmp.raw.size());
             return ret_data;
         }
     }
+    Metrics_Registry::get().cache_misses.fetch_add (1,
+                                                    std::memory_order_relaxed);
+    RQ_TRACE2 (cache_get, 0, 0);
     return {Compress::NONE, User_Data ()};
 }
 
+template<typename User_Data, typename Key>
+std::vector<Cache_Entry_Stats> DLF<User_Data, Key>::stats()
+{
+    std::lock_guard<std::mutex> guard (biglock);
+    RQ_UNUSED(guard);
+    std::vector<Cache_Entry_Stats> ret;
+    ret.reserve (data.size());
+    for (const auto &tmp : data) {
+        Cache_Entry_Stats entry;
+        entry.algorithm = tmp.algorithm;
+        entry.uncompressed = tmp.uncompressed;
+        entry.compressed = tmp.raw.size();
+        entry.hits = tmp.hits;
+        ret.push_back (entry);
+    }
+    return ret;
+}
+
 template<typename User_Data, typename Key>
 bool DLF<User_Data, Key>::add (const Compress algorithm, User_Data &raw,
-                                                                const Key &key)
+                                    const Key &key, const size_t uncompressed)
 {
     std::lock_guard<std::mutex> guard (biglock);
     RQ_UNUSED(guard);
@@ -364,13 +423,21 @@ bool DLF<User_Data, Key>::add (const Compress algorithm, User_Data &raw,
         }
     }
     // key not present.
-    if (max_size - actual_size > sizeof(DLF_Data) + raw.size()) {
+    // "raw" is moved in the cache, keep its size
+    const size_t raw_bytes = raw.size();
+    const size_t entry_bytes = sizeof(DLF_Data) + raw_bytes;
+    if (max_size - actual_size > entry_bytes) {
         // free space is the best
         auto g_tick = ++global_tick;
         test_and_reset_scores();
-        data.emplace_back (key, g_tick + data.size(), g_tick, raw, algorithm);
+        data.emplace_back (key, g_tick + data.size(), g_tick, raw, algorithm,
+                                                                uncompressed);
         std::sort (data.begin(), data.end());
-        actual_size += sizeof(DLF_Data) + raw.size();
+        actual_size += entry_bytes;
+        Metrics_Registry::get().cache_adds.fetch_add (1,
+                                                    std::memory_order_relaxed);
+        update_metrics (0);
+        RQ_TRACE3 (cache_add, 1, raw_bytes, 0);
         return true;
     } else {
         // need to delete some element?
@@ -378,30 +445,43 @@ bool DLF<User_Data, Key>::add (const Compress algorithm, User_Data &raw,
         test_and_reset_scores();
         size_t usable_bytes = max_size - actual_size;
         size_t delete_from_end = 0;
+        size_t deleted_bytes = 0;
         for (auto r_it = data.rbegin(); r_it != data.rend() &&
-                                usable_bytes < (sizeof(DLF_Data) + raw.size());
+                                usable_bytes < entry_bytes;
                                                                     ++r_it) {
             // score is less than tick. check for overflows
             if ((g_tick - r_it->tick) > (r_it->score - r_it->tick)) {
                 ++delete_from_end;
                 usable_bytes +=  sizeof(DLF_Data) + r_it->raw.size();
+                deleted_bytes +=  sizeof(DLF_Data) + r_it->raw.size();
             } else {
                 break;
             }
         }
-        if (usable_bytes < (sizeof(DLF_Data) + raw.size())) {
+        if (usable_bytes < entry_bytes) {
             // can't delete enough cached items, the new item requires
             // too much space, and fresher elements are present.
+            Metrics_Registry::get().cache_rejects.fetch_add (1,
+                                                    std::memory_order_relaxed);
+            RQ_TRACE3 (cache_add, 0, raw_bytes, 0);
             return false;
         }
+        const uint64_t evicted = delete_from_end;
+        if (evicted != 0)
+            RQ_TRACE2 (cache_evict, evicted, deleted_bytes);
         while (delete_from_end > 0) {
             data.pop_back();
             --delete_from_end;
         }
-        data.emplace_back (key, g_tick + data.size(), g_tick, raw, algorithm);
+        data.emplace_back (key, g_tick + data.size(), g_tick, raw, algorithm,
+                                                                uncompressed);
         std::sort (data.begin(), data.end());
-        actual_size -= usable_bytes;
-        actual_size += sizeof(DLF_Data) + raw.size();
+        actual_size -= deleted_bytes;
+        actual_size += entry_bytes;
+        Metrics_Registry::get().cache_adds.fetch_add (1,
+                                                    std::memory_order_relaxed);
+        update_metrics (evicted);
+        RQ_TRACE3 (cache_add, 1, raw_bytes, evicted);
         return true;
     }
 }
@@ -0,0 +1,210 @@
+/*
+ * Copyright (c) 2018, Luca Fulchir<luca@fulchir.it>, All rights reserved.
+ *
+ * This file is part of "libRaptorQ".
+ *
+ * libRaptorQ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * libRaptorQ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * and a copy of the GNU Lesser General Public License
+ * along with libRaptorQ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "RaptorQ/v1/common.hpp"
+#include "RaptorQ/v1/Decoder.hpp"
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace RaptorQ__v1 {
+namespace Impl {
+
+// Finished RFC block decoders are kept here and reused for the next block
+// with the same number of symbols and symbol size, so that the source
+// symbols matrix, the bitmask and the repair storage are not reallocated.
+// The memory of the idle decoders is limited by a process-wide budget,
+// shared between all the iterator types. Budget 0 (default): no pooling.
+
+class RAPTORQ_LOCAL Decoder_Pool_Budget
+{
+public:
+    Decoder_Pool_Budget (const Decoder_Pool_Budget&) = delete;
+    Decoder_Pool_Budget& operator= (const Decoder_Pool_Budget&) = delete;
+    Decoder_Pool_Budget (Decoder_Pool_Budget&&) = delete;
+    Decoder_Pool_Budget& operator= (Decoder_Pool_Budget&&) = delete;
+    ~Decoder_Pool_Budget() = default;
+
+    static Decoder_Pool_Budget& get()
+    {
+        #pragma clang diagnostic push
+        #pragma clang diagnostic ignored "-Wexit-time-destructors"
+        #pragma clang diagnostic ignored "-Wglobal-constructors"
+        static Decoder_Pool_Budget budget;
+        #pragma clang diagnostic pop
+        return budget;
+    }
+
+    size_t get_size() const
+        { return _max.load(); }
+    // memory of the idle decoders
+    size_t get_used() const
+        { return _used.load(); }
+    // shrinking drops all the idle decoders
+    size_t resize (const size_t max_bytes);
+    // account for an idle decoder. false if over budget.
+    bool take (const size_t bytes);
+    void give_back (const size_t bytes)
+        { _used -= bytes; }
+    void add_flush (void (*flush)());
+private:
+    Decoder_Pool_Budget()
+        : _max (0), _used (0)
+    {}
+    std::atomic<size_t> _max, _used;
+    std::mutex _mtx;
+    std::vector<void (*)()> _flush;
+};
+
+template <typename In_It>
+class RAPTORQ_LOCAL Decoder_Pool
+{
+public:
+    static Decoder_Pool *get()
+    {
+        // never destroyed: decoders might be released at exit time.
+        static Decoder_Pool<In_It> *instance = new Decoder_Pool<In_It>();
+        return instance;
+    }
+
+    std::shared_ptr<Raw_Decoder<In_It>> acquire (const Block_Size symbols,
+                                                const uint16_t symbol_size,
+                                                const uint16_t padding_symbols);
+    void flush();
+private:
+    // symbols, symbol_size
+    using Key = std::pair<uint16_t, uint16_t>;
+    struct Idle
+    {
+        std::unique_ptr<Raw_Decoder<In_It>> dec;
+        size_t bytes;
+    };
+
+    Decoder_Pool()
+        { Decoder_Pool_Budget::get().add_flush (&Decoder_Pool::flush_all); }
+    static void flush_all()
+        { get()->flush(); }
+    void release (const Key key, Raw_Decoder<In_It> *dec);
+
+    std::mutex _mtx;
+    std::map<Key, std::vector<Idle>> _idle;
+};
+
+
+///////////////////////////////////
+//
+// IMPLEMENTATION OF ABOVE CLASSES
+//
+///////////////////////////////////
+
+inline size_t Decoder_Pool_Budget::resize (const size_t max_bytes)
+{
+    const size_t old_max = _max.exchange (max_bytes);
+    if (max_bytes < old_max) {
+        std::lock_guard<std::mutex> guard (_mtx);
+        RQ_UNUSED (guard);
+        for (auto flush : _flush)
+            flush();
+    }
+    return max_bytes;
+}
+
+inline bool Decoder_Pool_Budget::take (const size_t bytes)
+{
+    size_t used = _used.load();
+    do {
+        if (used + bytes > _max.load())
+            return false;
+    } while (!_used.compare_exchange_weak (used, used + bytes));
+    return true;
+}
+
+inline void Decoder_Pool_Budget::add_flush (void (*flush)())
+{
+    std::lock_guard<std::mutex> guard (_mtx);
+    RQ_UNUSED (guard);
+    _flush.push_back (flush);
+}
+
+template <typename In_It>
+std::shared_ptr<Raw_Decoder<In_It>> Decoder_Pool<In_It>::acquire (
+                                                const Block_Size symbols,
+                                                const uint16_t symbol_size,
+                                                const uint16_t padding_symbols)
+{
+    const Key key (static_cast<uint16_t> (symbols), symbol_size);
+    std::unique_ptr<Raw_Decoder<In_It>> dec;
+    std::unique_lock<std::mutex> guard (_mtx);
+    auto it = _idle.find (key);
+    if (it != _idle.end() && it->second.size() != 0) {
+        dec = std::move (it->second.back().dec);
+        Decoder_Pool_Budget::get().give_back (it->second.back().bytes);
+        it->second.pop_back();
+    }
+    guard.unlock();
+
+    if (dec != nullptr) {
+        dec->reset (padding_symbols);
+    } else if (Decoder_Pool_Budget::get().get_size() == 0) {
+        return std::make_shared<Raw_Decoder<In_It>> (symbols, symbol_size,
+                                                            padding_symbols);
+    } else {
+        dec.reset (new Raw_Decoder<In_It> (symbols, symbol_size,
+                                                            padding_symbols));
+        dec->keep_memory();
+    }
+    return std::shared_ptr<Raw_Decoder<In_It>> (dec.release(),
+                                        [key] (Raw_Decoder<In_It> *ptr)
+                                            { get()->release (key, ptr); });
+}
+
+template <typename In_It>
+void Decoder_Pool<In_It>::release (const Key key, Raw_Decoder<In_It> *dec)
+{
+    std::unique_ptr<Raw_Decoder<In_It>> owned (dec);
+    owned->stop();
+    const size_t bytes = owned->bytes();
+    if (!Decoder_Pool_Budget::get().take (bytes))
+        return;
+    std::lock_guard<std::mutex> guard (_mtx);
+    RQ_UNUSED (guard);
+    _idle[key].push_back ({std::move (owned), bytes});
+}
+
+template <typename In_It>
+void Decoder_Pool<In_It>::flush()
+{
+    std::map<Key, std::vector<Idle>> dropped;
+    std::unique_lock<std::mutex> guard (_mtx);
+    dropped.swap (_idle);
+    guard.unlock();
+    for (const auto &key_idle : dropped) {
+        for (const auto &idle : key_idle.second)
+            Decoder_Pool_Budget::get().give_back (idle.bytes);
+    }
+}
+
+}   // namespace Impl
+}   // namespace RaptorQ__v1
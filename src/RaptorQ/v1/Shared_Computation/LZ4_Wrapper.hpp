@@ -21,114 +21,315 @@
 #pragma once
 
 #include "RaptorQ/v1/common.hpp"
+#include "RaptorQ/v1/Thread_Pool.hpp"
 #include <lz4.h>
+#include <lz4hc.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
 #include <vector>
 
 namespace RaptorQ__v1 {
 namespace Impl {
 
-enum class LZ4_t : uint8_t { ENCODER=0, DECODER=1 };
+// Framed LZ4:
+//   uint32_t original size, uint32_t frames,
+//   frames x uint32_t compressed frame size, then the compressed frames.
+// Each frame holds up to "lz4_frame_size" bytes of input and is compressed
+// independently, so everything is decompressed straight in the
+// destination buffer, and big entries are compressed by the thread pool.
+constexpr uint32_t lz4_frame_size = 64 * 1024;
+// don't ask the pool for help with less than this many frames per thread
+constexpr uint32_t lz4_frames_per_thread = 8;
+constexpr int32_t lz4hc_level = 9;
+// an LZ4 block can not expand more than this: each byte of a match length
+// extension adds at most 255 bytes of output.
+constexpr size_t lz4_max_ratio = 255;
+
+// ENCODER_HC: slower, better compression. same format, same DECODER.
+enum class LZ4_t : uint8_t { ENCODER=0, DECODER=1, ENCODER_HC=2 };
 
 template<LZ4_t type>
 class RAPTORQ_LOCAL LZ4
 {
 public:
-    LZ4();
-    ~LZ4();
+    LZ4() = default;
+    ~LZ4() = default;
     LZ4 (const LZ4&) = delete;
     LZ4& operator= (const LZ4&) = delete;
     LZ4 (LZ4&&) = default;
     LZ4& operator= (LZ4&&) = default;
 
-    std::vector<uint8_t> encode (const std::vector<uint8_t> &in);
-    std::vector<uint8_t> decode (const std::vector<uint8_t> &in);
+    // threads == 0: as many as the thread pool has
+    std::vector<uint8_t> encode (const uint8_t *in, const size_t size,
+                                                    const uint16_t threads = 0);
+    std::vector<uint8_t> encode (const std::vector<uint8_t> &in,
+                                                    const uint16_t threads = 0)
+        { return encode (in.data(), in.size(), threads); }
+
+    // 0 on error. Checks the whole header and frame table, so the result
+    // can be safely allocated even for untrusted input.
+    static size_t decoded_size (const uint8_t *in, const size_t size);
+    // decode everything into "out", which must have "decoded_size" bytes
+    bool decode (const uint8_t *in, const size_t size, uint8_t *out,
+                                                const size_t out_size) const;
+    std::vector<uint8_t> decode (const uint8_t *in, const size_t size) const;
+    std::vector<uint8_t> decode (const std::vector<uint8_t> &in) const
+        { return decode (in.data(), in.size()); }
+};
+
+// The frames of one entry. Like the gemm tiles, the caller and the pool
+// threads all take the next free frame, so the caller only waits for frames
+// that are already being compressed: it works from inside pool work too.
+// Each frame goes in its own slot of "out", "lz4_frame_bound" bytes apart.
+template<LZ4_t type>
+class RAPTORQ_LOCAL LZ4_Frames
+{
+public:
+    LZ4_Frames (const uint8_t *in, const size_t size, uint8_t *out,
+                                                        const uint32_t frames)
+        : _in (in), _out (out), _size (size), _frames (frames),
+            _sizes (frames, 0), _next (0), _done (0), _failed (false)
+    {}
+    LZ4_Frames() = delete;
+    LZ4_Frames (const LZ4_Frames&) = delete;
+    LZ4_Frames& operator= (const LZ4_Frames&) = delete;
+    LZ4_Frames (LZ4_Frames&&) = delete;
+    LZ4_Frames& operator= (LZ4_Frames&&) = delete;
+    ~LZ4_Frames() = default;
+
+    static size_t frame_bound()
+        { return static_cast<size_t> (LZ4_compressBound (lz4_frame_size)); }
+
+    // compress frames until none is left
+    void work();
+    // wait for the frames taken by the others
+    void wait();
+    // only after wait(). 0 if any frame failed
+    uint32_t frame_size (const uint32_t frame) const
+        { return _failed.load() ? 0 : _sizes[frame]; }
 private:
-    void *stream;
+    const uint8_t *const _in;
+    uint8_t *const _out;
+    const size_t _size;
+    const uint32_t _frames;
+    std::vector<uint32_t> _sizes;
+    std::atomic<uint32_t> _next, _done;
+    std::atomic<bool> _failed;
+    std::mutex _mtx;
+    std::condition_variable _cond;
 };
 
 template<LZ4_t type>
-LZ4<type>::LZ4()
+void LZ4_Frames<type>::work()
 {
-    if (type == LZ4_t::ENCODER) {
-        stream = static_cast<void *> (LZ4_createStream());
-    } else {
-        stream = static_cast<void *> (LZ4_createStreamDecode());
+    std::vector<uint8_t> state;
+    for (uint32_t frame = _next++; frame < _frames; frame = _next++) {
+        if (state.size() == 0) {
+            state.resize (static_cast<size_t> (type == LZ4_t::ENCODER_HC ?
+                                                    LZ4_sizeofStateHC() :
+                                                    LZ4_sizeofState()));
+        }
+        const size_t start = static_cast<size_t> (frame) * lz4_frame_size;
+        const int32_t frame_bytes = static_cast<int32_t> (
+                            std::min<size_t> (_size - start, lz4_frame_size));
+        const int32_t max_size = LZ4_compressBound (frame_bytes);
+        const char *src = reinterpret_cast<const char *> (_in + start);
+        char *dst = reinterpret_cast<char *> (_out + frame * frame_bound());
+        int32_t written;
+        if (type == LZ4_t::ENCODER_HC) {
+            written = LZ4_compress_HC_extStateHC (state.data(), src, dst,
+                                        frame_bytes, max_size, lz4hc_level);
+        } else {
+            written = LZ4_compress_fast_extState (state.data(), src, dst,
+                                                frame_bytes, max_size, 1);
+        }
+        if (written <= 0)
+            _failed = true;
+        else
+            _sizes[frame] = static_cast<uint32_t> (written);
+        if (++_done == _frames) {
+            std::lock_guard<std::mutex> guard (_mtx);
+            RQ_UNUSED (guard);
+            _cond.notify_all();
+        }
     }
 }
 
 template<LZ4_t type>
-LZ4<type>::~LZ4()
+void LZ4_Frames<type>::wait()
 {
-    if (type == LZ4_t::ENCODER) {
-        LZ4_freeStream (static_cast<LZ4_stream_t *> (stream));
-    } else {
-        LZ4_freeStreamDecode (static_cast<LZ4_streamDecode_t *> (stream));
-    }
+    std::unique_lock<std::mutex> lock (_mtx);
+    while (_done.load() != _frames)
+        _cond.wait (lock);
 }
 
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wweak-vtables"
 template<LZ4_t type>
-std::vector<uint8_t> LZ4<type>::encode (const std::vector<uint8_t> &in)
+class RAPTORQ_LOCAL LZ4_Work final : public RFC6330__v1::Impl::Pool_Work
 {
-    std::vector<uint8_t> ret;
-    if (type == LZ4_t::DECODER || in.size() == 0 ||
-                                            in.size() >= LZ4_MAX_INPUT_SIZE) {
-        return ret;
+public:
+    explicit LZ4_Work (const std::shared_ptr<LZ4_Frames<type>> &frames)
+        : _frames (frames) {}
+    LZ4_Work() = delete;
+    LZ4_Work (const LZ4_Work&) = delete;
+    LZ4_Work& operator= (const LZ4_Work&) = delete;
+    LZ4_Work (LZ4_Work&&) = delete;
+    LZ4_Work& operator= (LZ4_Work&&) = delete;
+    ~LZ4_Work() override {}
+
+    RFC6330__v1::Work_Exit_Status do_work (RaptorQ__v1::Work_State *state)
+                                                                    override
+    {
+        RQ_UNUSED (state);
+        _frames->work();
+        return RFC6330__v1::Work_Exit_Status::DONE;
     }
+private:
+    // keeps the frames alive if we start after the caller returned
+    const std::shared_ptr<LZ4_Frames<type>> _frames;
+};
+#pragma clang diagnostic pop
 
-    auto max_size = LZ4_compressBound (static_cast<int32_t> (in.size()));
-    if (stream == nullptr || max_size == 0)
-        return ret;
+template<LZ4_t type>
+std::vector<uint8_t> LZ4<type>::encode (const uint8_t *in, const size_t size,
+                                                        const uint16_t threads)
+{
+    if (type == LZ4_t::DECODER || size == 0 || size >= LZ4_MAX_INPUT_SIZE)
+        return std::vector<uint8_t>();
 
-    ret.resize (static_cast<size_t> (max_size) + sizeof(uint32_t), 0);
+    const uint32_t frames = static_cast<uint32_t> (
+                                (size + lz4_frame_size - 1) / lz4_frame_size);
+    size_t helpers = threads;
+    if (helpers == 0)
+        helpers = RFC6330__v1::Impl::Thread_Pool::get().size();
+    helpers = std::min<size_t> (helpers, frames / lz4_frames_per_thread);
 
-    // put original size in the first 4 bytes, for decoding.
-    // int32 is fine, LZ4 has a limit of 2^31 bytes.
-    int32_t *size = reinterpret_cast<int32_t *> (ret.data());
-    *size = static_cast<int32_t> (in.size());
+    // every frame in its worst case slot, then the used part is copied
+    // after the header, so the result does not keep the worst case capacity
+    const size_t last_frame = size - static_cast<size_t> (frames - 1) *
+                                                                lz4_frame_size;
+    std::vector<uint8_t> slots (static_cast<size_t> (frames - 1) *
+                            LZ4_Frames<type>::frame_bound() +
+                            static_cast<size_t> (LZ4_compressBound (
+                                        static_cast<int32_t> (last_frame))));
+    auto shared = std::make_shared<LZ4_Frames<type>> (in, size, slots.data(),
+                                                                    frames);
+    for (size_t helper = 1; helper < helpers; ++helper) {
+        RFC6330__v1::Impl::Thread_Pool::get().add_work (
+                            std::unique_ptr<RFC6330__v1::Impl::Pool_Work> (
+                                            new LZ4_Work<type> (shared)));
+    }
+    shared->work();
+    shared->wait();
 
-    // now the compressed data.
-    auto written = LZ4_compress_fast_continue (
-                    static_cast<LZ4_stream_t *> (stream),
-                    reinterpret_cast<const char *> (in.data()),
-                    reinterpret_cast<char *> (ret.data()) + sizeof(int32_t),
-                    static_cast<int32_t> (in.size()),
-                    max_size, 1);
+    const size_t head_size = (2 + static_cast<size_t> (frames)) *
+                                                            sizeof(uint32_t);
+    size_t used = head_size;
+    for (uint32_t frame = 0; frame < frames; ++frame) {
+        if (shared->frame_size (frame) == 0)
+            return std::vector<uint8_t>();
+        used += shared->frame_size (frame);
+    }
+    std::vector<uint8_t> ret (used);
+    const uint32_t header[2] = { static_cast<uint32_t> (size), frames };
+    std::memcpy (ret.data(), header, sizeof(header));
+    uint8_t *sizes = ret.data() + sizeof(header);
+    used = head_size;
+    for (uint32_t frame = 0; frame < frames; ++frame) {
+        const uint32_t frame_size = shared->frame_size (frame);
+        std::memcpy (sizes + frame * sizeof(uint32_t), &frame_size,
+                                                        sizeof(frame_size));
+        std::memcpy (ret.data() + used,
+                        slots.data() + frame * LZ4_Frames<type>::frame_bound(),
+                                                                frame_size);
+        used += frame_size;
+    }
+    return ret;
+}
 
-    ret.resize (static_cast<size_t> (written) + sizeof(int32_t));
+template<LZ4_t type>
+size_t LZ4<type>::decoded_size (const uint8_t *in, const size_t size)
+{
+    uint32_t header[2];
+    if (size < sizeof(header))
+        return 0;
+    std::memcpy (header, in, sizeof(header));
+    const size_t frames = header[1];
+    if (frames == 0 || (size - sizeof(header)) / sizeof(uint32_t) < frames)
+        return 0;
+    const size_t head_size = sizeof(header) + frames * sizeof(uint32_t);
+    const size_t payload = size - head_size;
+    // original size must fill exactly "frames" frames
+    if (header[0] > frames * lz4_frame_size ||
+                        header[0] <= (frames - 1) * lz4_frame_size ||
+                        header[0] / lz4_max_ratio > payload) {
+        return 0;
+    }
+    const uint8_t *sizes = in + sizeof(header);
+    size_t total = 0;
+    for (size_t frame = 0; frame < frames; ++frame) {
+        uint32_t frame_size;
+        std::memcpy (&frame_size, sizes + frame * sizeof(uint32_t),
+                                                            sizeof(frame_size));
+        if (frame_size == 0 || payload - total < frame_size)
+            return 0;
+        total += frame_size;
+    }
+    if (total != payload)
+        return 0;
+    return header[0];
+}
 
-    return ret;
+template<LZ4_t type>
+bool LZ4<type>::decode (const uint8_t *in, const size_t size, uint8_t *out,
+                                                    const size_t out_size) const
+{
+    if (type != LZ4_t::DECODER || out_size == 0 ||
+                                        decoded_size (in, size) != out_size) {
+        return false;
+    }
+    uint32_t header[2];
+    std::memcpy (header, in, sizeof(header));
+    const uint32_t frames = header[1];
+    const uint8_t *sizes = in + sizeof(header);
+    const uint8_t *data = sizes + frames * sizeof(uint32_t);
+    const uint8_t *const end = in + size;
+    for (uint32_t frame = 0; frame < frames; ++frame) {
+        uint32_t frame_size;
+        std::memcpy (&frame_size, sizes + frame * sizeof(uint32_t),
+                                                            sizeof(frame_size));
+        if (static_cast<size_t> (end - data) < frame_size)
+            return false;
+        const size_t start = static_cast<size_t> (frame) * lz4_frame_size;
+        const int32_t expected = static_cast<int32_t> (
+                        std::min<size_t> (out_size - start, lz4_frame_size));
+        const int32_t written = LZ4_decompress_safe (
+                                    reinterpret_cast<const char *> (data),
+                                    reinterpret_cast<char *> (out + start),
+                                    static_cast<int32_t> (frame_size),
+                                    expected);
+        if (written != expected)
+            return false;
+        data += frame_size;
+    }
+    return data == end;
 }
 
 template<LZ4_t type>
-std::vector<uint8_t> LZ4<type>::decode (const std::vector<uint8_t> &in)
+std::vector<uint8_t> LZ4<type>::decode (const uint8_t *in, const size_t size)
+                                                                        const
 {
-    std::vector<uint8_t> ret;
-    if (type == LZ4_t::ENCODER || in.size() < sizeof(uint32_t))
-        return ret;
-
-    if (stream == nullptr)
-        return ret;
-
-    // get the original uncompresseed size:
-    int32_t *orig_size = reinterpret_cast<int32_t *> (
-                                            const_cast<uint8_t *> (in.data()));
-    // now the compressed data.
-    ret.reserve (static_cast<size_t> (*orig_size));
-    ret.resize (static_cast<size_t> (*orig_size), 0);
-    auto written = LZ4_decompress_safe_continue (
-                static_cast<LZ4_streamDecode_t *> (stream),
-                reinterpret_cast<const char *> (in.data()) + sizeof(uint32_t),
-                reinterpret_cast<char *> (ret.data()),
-                static_cast<int32_t> (in.size() - sizeof(uint32_t)),
-                *orig_size);
-    if (written <= 0) {
+    std::vector<uint8_t> ret (decoded_size (in, size));
+    if (ret.size() == 0 || !decode (in, size, ret.data(), ret.size())) {
         return std::vector<uint8_t>();
     }
-    ret.resize (static_cast<size_t> (written));
-
     return ret;
 }
 
-
 } // namepace Impl
 } // namespace RaptorQ__v1
@@ -0,0 +1,159 @@
+/*
+ * Copyright (c) 2018, Luca Fulchir<luca@fulchir.it>, All rights reserved.
+ *
+ * This file is part of "libRaptorQ".
+ *
+ * libRaptorQ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * libRaptorQ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * and a copy of the GNU Lesser General Public License
+ * along with libRaptorQ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "RaptorQ/v1/common.hpp"
+#include "RaptorQ/v1/caches.hpp"
+#include "RaptorQ/v1/Operation.hpp"
+#include "RaptorQ/v1/Shared_Computation/Decaying_LF.hpp"
+#include "RaptorQ/v1/Shared_Computation/Shared_Cache.hpp"
+#include "RaptorQ/v1/Thread_Pool.hpp"
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace RaptorQ__v1 {
+namespace Impl {
+
+// The cache does not hold the LxL matrix that the operations would build,
+// but the operations themselves (serialized Op_Log).
+// Using them means replaying the log on the new "D" matrix, which is what
+// "precomputed * D" was doing, without ever building the precomputed matrix.
+
+// true if either the local or the shared cache is in use
+bool RAPTORQ_LOCAL caching_enabled();
+// look up the operations for "key", first in the shared cache
+// (no copies if uncompressed), then in the local one.
+// "rows": rows of the matrix the operations will be replayed on.
+// false if not found or invalid.
+bool RAPTORQ_LOCAL get_cached_ops (const Cache_Key &key, const size_t rows,
+                                                                Op_Log &ops);
+// same, and report the size of the cache entry that was used
+bool RAPTORQ_LOCAL get_cached_ops (const Cache_Key &key, const size_t rows,
+                                Op_Log &ops, size_t &compressed,
+                                                        size_t &uncompressed);
+// serialize now, compress and save in the cache in a pool thread.
+// "ops" can be reused as soon as this returns.
+void RAPTORQ_LOCAL cache_ops_async (const Op_Log &ops, const Cache_Key &key);
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wweak-vtables"
+class RAPTORQ_LOCAL Cache_Ops_Work final :
+                                        public RFC6330__v1::Impl::Pool_Work
+{
+public:
+    Cache_Ops_Work (std::vector<uint8_t> &&raw, const Cache_Key &key)
+        : _raw (std::move (raw)), _key (key) {}
+    Cache_Ops_Work() = delete;
+    Cache_Ops_Work (const Cache_Ops_Work&) = delete;
+    Cache_Ops_Work& operator= (const Cache_Ops_Work&) = delete;
+    Cache_Ops_Work (Cache_Ops_Work&&) = delete;
+    Cache_Ops_Work& operator= (Cache_Ops_Work&&) = delete;
+    ~Cache_Ops_Work() override {}
+
+    RFC6330__v1::Work_Exit_Status do_work (RaptorQ__v1::Work_State *state)
+                                                                    override
+    {
+        RQ_UNUSED (state);
+        auto compressed = compress (_raw);
+        const size_t uncompressed = _raw.size();
+        _raw = std::vector<uint8_t>();
+        if (compressed.second.size() == 0)
+            return RFC6330__v1::Work_Exit_Status::DONE;
+        if (Shared_Cache::get().add (compressed.first, compressed.second,
+                                                                        _key)) {
+            return RFC6330__v1::Work_Exit_Status::DONE;
+        }
+        DLF<std::vector<uint8_t>, Cache_Key>::get()->add (compressed.first,
+                                        compressed.second, _key, uncompressed);
+        return RFC6330__v1::Work_Exit_Status::DONE;
+    }
+private:
+    std::vector<uint8_t> _raw;
+    const Cache_Key _key;
+};
+#pragma clang diagnostic pop
+
+inline bool caching_enabled()
+{
+    return DLF<std::vector<uint8_t>, Cache_Key>::get()->get_size() != 0 ||
+                                            Shared_Cache::get().attached();
+}
+
+inline bool get_cached_ops (const Cache_Key &key, const size_t rows,
+                                                                Op_Log &ops)
+{
+    size_t compressed, uncompressed;
+    return get_cached_ops (key, rows, ops, compressed, uncompressed);
+}
+
+inline bool get_cached_ops (const Cache_Key &key, const size_t rows,
+                                Op_Log &ops, size_t &compressed,
+                                                        size_t &uncompressed)
+{
+    compressed = 0;
+    uncompressed = 0;
+    const auto shared = Shared_Cache::get().get (key);
+    if (shared.data != nullptr) {
+        bool valid;
+        if (shared.algorithm == Compress::NONE) {
+            valid = ops.deserialize (shared.data, shared.size, rows);
+            uncompressed = shared.size;
+        } else {
+            const auto raw = decompress (shared.algorithm, shared.data,
+                                                                shared.size);
+            valid = ops.deserialize (raw, rows);
+            uncompressed = raw.size();
+        }
+        if (valid && !ops.empty()) {
+            compressed = shared.size;
+            return true;
+        }
+        ops.clear();
+        uncompressed = 0;
+    }
+    auto cached = DLF<std::vector<uint8_t>, Cache_Key>::get()->get (key);
+    if (cached.second.size() == 0)
+        return false;
+    auto raw = decompress (cached.first, cached.second.data(),
+                                                        cached.second.size());
+    const size_t cached_size = cached.second.size();
+    cached.second = std::vector<uint8_t>();
+    if (ops.deserialize (raw, rows) && !ops.empty()) {
+        compressed = cached_size;
+        uncompressed = raw.size();
+        return true;
+    }
+    ops.clear();
+    return false;
+}
+
+inline void cache_ops_async (const Op_Log &ops, const Cache_Key &key)
+{
+    if (ops.empty())
+        return;
+    RFC6330__v1::Impl::Thread_Pool::get().add_work (
+                        std::unique_ptr<RFC6330__v1::Impl::Pool_Work> (
+                                new Cache_Ops_Work (ops.serialize(), key)));
+}
+
+}   // namespace Impl
+}   // namespace RaptorQ__v1
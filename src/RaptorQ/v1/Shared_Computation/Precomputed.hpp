@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2018, Luca Fulchir<luca@fulchir.it>, All rights reserved.
+ *
+ * This file is part of "libRaptorQ".
+ *
+ * libRaptorQ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * libRaptorQ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * and a copy of the GNU Lesser General Public License
+ * along with libRaptorQ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "RaptorQ/v1/common.hpp"
+#include "RaptorQ/v1/Precode_Matrix.hpp"
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+namespace RaptorQ__v1 {
+namespace Impl {
+
+// The precomputed encoding matrix (LxL) depends only on K', and is never
+// modified once built. All the encoders with the same K' share the same
+// one, for as long as at least one of them is holding it.
+using Precomputed = std::shared_ptr<const DenseMtx>;
+
+class RAPTORQ_LOCAL Precomputed_Registry
+{
+public:
+    Precomputed_Registry (const Precomputed_Registry&) = delete;
+    Precomputed_Registry& operator= (const Precomputed_Registry&) = delete;
+    Precomputed_Registry (Precomputed_Registry&&) = delete;
+    Precomputed_Registry& operator= (Precomputed_Registry&&) = delete;
+    ~Precomputed_Registry() = default;
+
+    static Precomputed_Registry& get()
+    {
+        #pragma clang diagnostic push
+        #pragma clang diagnostic ignored "-Wexit-time-destructors"
+        #pragma clang diagnostic ignored "-Wglobal-constructors"
+        static Precomputed_Registry registry;
+        #pragma clang diagnostic pop
+        return registry;
+    }
+
+    // nullptr if nobody is using the matrix for K'
+    Precomputed find (const uint16_t K_prime);
+    // if someone else published the same K' first, return that one.
+    Precomputed publish (const uint16_t K_prime, DenseMtx &&precomputed);
+private:
+    Precomputed_Registry() = default;
+
+    std::mutex _mtx;
+    std::map<uint16_t, std::weak_ptr<const DenseMtx>> _matrices;
+};
+
+inline Precomputed Precomputed_Registry::find (const uint16_t K_prime)
+{
+    std::lock_guard<std::mutex> guard (_mtx);
+    RQ_UNUSED (guard);
+    auto it = _matrices.find (K_prime);
+    if (it == _matrices.end())
+        return nullptr;
+    return it->second.lock();
+}
+
+inline Precomputed Precomputed_Registry::publish (const uint16_t K_prime,
+                                                    DenseMtx &&precomputed)
+{
+    if (precomputed.rows() == 0)
+        return nullptr;
+    std::lock_guard<std::mutex> guard (_mtx);
+    RQ_UNUSED (guard);
+    auto &weak = _matrices[K_prime];
+    Precomputed ret = weak.lock();
+    if (ret != nullptr)
+        return ret;
+    // not make_shared: the weak_ptr would keep the whole matrix allocated
+    ret = Precomputed (new DenseMtx (std::move (precomputed)));
+    weak = ret;
+    return ret;
+}
+
+}   // namespace Impl
+}   // namespace RaptorQ__v1
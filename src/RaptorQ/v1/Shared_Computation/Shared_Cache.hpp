@@ -0,0 +1,459 @@
+/*
+ * Copyright (c) 2018, Luca Fulchir<luca@fulchir.it>, All rights reserved.
+ *
+ * This file is part of "libRaptorQ".
+ *
+ * libRaptorQ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * libRaptorQ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * and a copy of the GNU Lesser General Public License
+ * along with libRaptorQ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "RaptorQ/v1/common.hpp"
+#include "RaptorQ/v1/Shared_Computation/Decaying_LF.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#ifndef _WIN32
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+namespace RaptorQ__v1 {
+namespace Impl {
+
+// Cache shared between processes, in a memory-mapped file.
+// (a file in a tmpfs like /dev/shm is a POSIX shared memory segment)
+//
+// Entries are immutable and never evicted:
+//  * space is taken with an atomic bump allocator
+//  * the entry is written
+//  * the entry is published with a CAS on its hash bucket
+// so readers never lock, and always see complete entries.
+// Once the segment is full new entries go to the local cache only.
+//
+// Layout: Shm_Header, "buckets" x atomic<uint64_t> (entry offset, 0 = empty),
+// then the entries: Shm_Entry, key, data, padded to 8 bytes.
+
+static_assert (ATOMIC_LLONG_LOCK_FREE == 2,
+                        "RQ: shared cache needs address-free 64-bit atomics");
+
+constexpr uint64_t shm_magic = 0x5251434143484531;  // "RQCACHE1"
+constexpr uint32_t shm_version = 1;
+// one bucket every "shm_bucket_bytes" bytes of segment
+constexpr uint64_t shm_bucket_bytes = 1024;
+constexpr uint64_t shm_min_size = 64 * 1024;
+
+struct RAPTORQ_LOCAL Shm_Header
+{
+    std::atomic<uint64_t> magic;    // written last, when ready
+    uint32_t version;
+    uint32_t buckets;
+    uint64_t size;
+    std::atomic<uint64_t> used;
+    std::atomic<uint32_t> entries;
+    uint32_t _reserved;
+};
+
+struct RAPTORQ_LOCAL Shm_Entry
+{
+    uint64_t key_hash;
+    uint32_t key_size;
+    uint32_t data_size;
+    uint8_t algorithm;
+    uint8_t _reserved[7];
+};
+
+class RAPTORQ_LOCAL Shm_Mapping
+{
+public:
+    Shm_Mapping (uint8_t *mem, const size_t size)
+        : _mem (mem), _size (size) {}
+    Shm_Mapping() = delete;
+    Shm_Mapping (const Shm_Mapping&) = delete;
+    Shm_Mapping& operator= (const Shm_Mapping&) = delete;
+    Shm_Mapping (Shm_Mapping&&) = delete;
+    Shm_Mapping& operator= (Shm_Mapping&&) = delete;
+    ~Shm_Mapping()
+    {
+#ifndef _WIN32
+        munmap (_mem, _size);
+#endif
+    }
+
+    uint8_t* mem() const
+        { return _mem; }
+    size_t size() const
+        { return _size; }
+    Shm_Header* header() const
+        { return reinterpret_cast<Shm_Header*> (_mem); }
+    std::atomic<uint64_t>* buckets() const
+    {
+        return reinterpret_cast<std::atomic<uint64_t>*> (
+                                                    _mem + sizeof(Shm_Header));
+    }
+private:
+    uint8_t *const _mem;
+    const size_t _size;
+};
+
+// a cached entry. keeps the mapping alive while in use.
+struct RAPTORQ_LOCAL Shm_Lookup
+{
+    std::shared_ptr<Shm_Mapping> map;
+    Compress algorithm;
+    const uint8_t *data;
+    size_t size;
+};
+
+class RAPTORQ_LOCAL Shared_Cache
+{
+public:
+    Shared_Cache (const Shared_Cache&) = delete;
+    Shared_Cache& operator= (const Shared_Cache&) = delete;
+    Shared_Cache (Shared_Cache&&) = delete;
+    Shared_Cache& operator= (Shared_Cache&&) = delete;
+    ~Shared_Cache() = default;
+
+    static Shared_Cache& get()
+    {
+        #pragma clang diagnostic push
+        #pragma clang diagnostic ignored "-Wexit-time-destructors"
+        #pragma clang diagnostic ignored "-Wglobal-constructors"
+        static Shared_Cache cache;
+        #pragma clang diagnostic pop
+        return cache;
+    }
+
+    bool attach (const std::string &path, const size_t size);
+    void detach();
+    bool attached() const
+        { return _attached.load(); }
+
+    // false if it could not be saved (not attached, full)
+    bool add (const Compress algorithm, const std::vector<uint8_t> &data,
+                                                        const Cache_Key &key);
+    // data == nullptr if not found
+    Shm_Lookup get (const Cache_Key &key) const;
+private:
+    Shared_Cache() : _attached (false) {}
+
+    mutable std::mutex _mtx;    // only protects "_map" replacement
+    std::shared_ptr<Shm_Mapping> _map;
+    std::atomic<bool> _attached;
+
+    std::shared_ptr<Shm_Mapping> mapping() const
+    {
+        std::lock_guard<std::mutex> guard (_mtx);
+        RQ_UNUSED (guard);
+        return _map;
+    }
+    static uint64_t hash (const std::vector<uint8_t> &key);
+    static const Shm_Entry* entry_at (const Shm_Mapping &map,
+                                                        const uint64_t offset);
+    static bool same_key (const Shm_Entry *entry, const uint64_t key_hash,
+                                            const std::vector<uint8_t> &key);
+    static std::shared_ptr<Shm_Mapping> open_segment (const std::string &path,
+                                                            const size_t size);
+#ifndef _WIN32
+    // nullptr if it could not be created, or someone else created it first
+    static std::shared_ptr<Shm_Mapping> create_segment (
+                                                    const std::string &path,
+                                                    const size_t size);
+    // "stale": the file was left uninitialized by a dead process
+    static std::shared_ptr<Shm_Mapping> map_segment (const int fd,
+                                                                bool &stale);
+#endif
+};
+
+inline uint64_t Shared_Cache::hash (const std::vector<uint8_t> &key)
+{
+    // FNV-1a. never 0, so it can't be mistaken for an empty entry
+    uint64_t ret = 0xcbf29ce484222325;
+    for (const uint8_t byte : key) {
+        ret ^= byte;
+        ret *= 0x100000001b3;
+    }
+    return ret == 0 ? 1 : ret;
+}
+
+inline const Shm_Entry* Shared_Cache::entry_at (const Shm_Mapping &map,
+                                                        const uint64_t offset)
+{
+    if (offset == 0 || offset > map.size() ||
+                                    map.size() - offset < sizeof(Shm_Entry)) {
+        return nullptr;
+    }
+    const Shm_Entry *entry = reinterpret_cast<const Shm_Entry*> (
+                                                            map.mem() + offset);
+    if (map.size() - offset - sizeof(Shm_Entry) <
+                        static_cast<uint64_t> (entry->key_size) +
+                                                            entry->data_size) {
+        return nullptr;
+    }
+    return entry;
+}
+
+inline bool Shared_Cache::same_key (const Shm_Entry *entry,
+                                            const uint64_t key_hash,
+                                            const std::vector<uint8_t> &key)
+{
+    return entry->key_hash == key_hash && entry->key_size == key.size() &&
+                std::memcmp (reinterpret_cast<const uint8_t*> (entry + 1),
+                                                key.data(), key.size()) == 0;
+}
+
+#ifndef _WIN32
+inline std::shared_ptr<Shm_Mapping> Shared_Cache::create_segment (
+                                    const std::string &path, const size_t size)
+{
+    if (size < shm_min_size)
+        return nullptr;
+    // unique between the processes and the threads of this process
+    static std::atomic<uint32_t> counter (0);
+    const std::string tmp = path + "." + std::to_string (getpid()) + "." +
+                                        std::to_string (counter++) + ".tmp";
+    int fd = open (tmp.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0)
+        return nullptr;
+    void *mem = MAP_FAILED;
+    if (ftruncate (fd, static_cast<off_t> (size)) == 0) {
+        mem = mmap (nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close (fd);
+    if (mem == MAP_FAILED) {
+        unlink (tmp.c_str());
+        return nullptr;
+    }
+    auto map = std::make_shared<Shm_Mapping> (static_cast<uint8_t*> (mem),
+                                                                        size);
+    Shm_Header *head = map->header();
+    // ftruncate zeroed everything: buckets are already empty.
+    head->version = shm_version;
+    head->buckets = static_cast<uint32_t> (std::max<uint64_t> (64,
+                                                    size / shm_bucket_bytes));
+    head->size = size;
+    head->entries.store (0);
+    const uint64_t start = sizeof(Shm_Header) +
+                            head->buckets * sizeof(std::atomic<uint64_t>);
+    head->used.store ((start + 7) & ~static_cast<uint64_t> (7));
+    head->magic.store (shm_magic, std::memory_order_release);
+    // publish. fails if someone else was faster.
+    const bool published = link (tmp.c_str(), path.c_str()) == 0;
+    unlink (tmp.c_str());
+    if (!published)
+        return nullptr;
+    return map;
+}
+
+inline std::shared_ptr<Shm_Mapping> Shared_Cache::map_segment (const int fd,
+                                                                    bool &stale)
+{
+    stale = false;
+    struct stat info;
+    if (fstat (fd, &info) != 0)
+        return nullptr;
+    const size_t map_size = static_cast<size_t> (info.st_size);
+    if (map_size == 0) {
+        stale = true;
+        return nullptr;
+    }
+    if (map_size < shm_min_size)
+        return nullptr;
+    void *mem = mmap (nullptr, map_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                                                                        fd, 0);
+    if (mem == MAP_FAILED)
+        return nullptr;
+    auto map = std::make_shared<Shm_Mapping> (static_cast<uint8_t*> (mem),
+                                                                    map_size);
+    const Shm_Header *head = map->header();
+    const uint64_t magic = head->magic.load (std::memory_order_acquire);
+    if (magic != shm_magic) {
+        // all zero: a segment that was never initialized.
+        // anything else is not ours, leave it alone.
+        stale = magic == 0 && head->version == 0 && head->size == 0;
+        return nullptr;
+    }
+    if (head->version != shm_version || head->size != map_size ||
+                                                        head->buckets == 0 ||
+                    sizeof(Shm_Header) + head->buckets *
+                            sizeof(std::atomic<uint64_t>) >= map_size) {
+        return nullptr;
+    }
+    return map;
+}
+#endif
+
+inline std::shared_ptr<Shm_Mapping> Shared_Cache::open_segment (
+                                    const std::string &path, const size_t size)
+{
+#ifdef _WIN32
+    RQ_UNUSED (path);
+    RQ_UNUSED (size);
+    return nullptr;
+#else
+    // The segment is initialized in a temporary file, then linked to "path":
+    // "path" never holds a half-initialized segment from a live process.
+    // An empty one can only be left by a process that died (or by older
+    // versions of the library), so it is removed and created again.
+    for (uint32_t tries = 0; tries < 3; ++tries) {
+        const int fd = open (path.c_str(), O_RDWR);
+        if (fd < 0) {
+            if (errno != ENOENT)
+                return nullptr;
+            auto map = create_segment (path, size);
+            if (map != nullptr)
+                return map;
+            continue;   // someone else created it. attach to that.
+        }
+        bool stale;
+        auto map = map_segment (fd, stale);
+        if (map != nullptr || !stale) {
+            close (fd);
+            return map;
+        }
+        // only remove it if nobody has replaced it in the meantime
+        struct stat ours, current;
+        if (fstat (fd, &ours) == 0 && stat (path.c_str(), &current) == 0 &&
+                                            ours.st_dev == current.st_dev &&
+                                            ours.st_ino == current.st_ino) {
+            unlink (path.c_str());
+        }
+        close (fd);
+    }
+    return nullptr;
+#endif
+}
+
+inline bool Shared_Cache::attach (const std::string &path, const size_t size)
+{
+    auto map = open_segment (path, size);
+    if (map == nullptr)
+        return false;
+    std::lock_guard<std::mutex> guard (_mtx);
+    RQ_UNUSED (guard);
+    _map = std::move (map);
+    _attached.store (true);
+    return true;
+}
+
+inline void Shared_Cache::detach()
+{
+    std::lock_guard<std::mutex> guard (_mtx);
+    RQ_UNUSED (guard);
+    // lookups still in use keep the old mapping alive
+    _map = nullptr;
+    _attached.store (false);
+}
+
+inline bool Shared_Cache::add (const Compress algorithm,
+                                            const std::vector<uint8_t> &data,
+                                            const Cache_Key &key)
+{
+    auto map = mapping();
+    if (map == nullptr || data.size() > std::numeric_limits<uint32_t>::max())
+        return false;
+    Shm_Header *head = map->header();
+    std::atomic<uint64_t> *buckets = map->buckets();
+    const auto flat_key = key.serialize();
+    const uint64_t key_hash = hash (flat_key);
+
+    // don't waste space if it's already there
+    const uint32_t first = static_cast<uint32_t> (key_hash % head->buckets);
+    uint32_t idx = first;
+    do {
+        const uint64_t offset = buckets[idx].load (std::memory_order_acquire);
+        if (offset == 0)
+            break;
+        const Shm_Entry *entry = entry_at (*map, offset);
+        if (entry != nullptr && same_key (entry, key_hash, flat_key))
+            return true;
+        idx = (idx + 1) % head->buckets;
+    } while (idx != first);
+
+    const uint64_t bytes = (sizeof(Shm_Entry) + flat_key.size() +
+                                data.size() + 7) & ~static_cast<uint64_t> (7);
+    if (head->used.load() + bytes > map->size())
+        return false;
+    const uint64_t offset = head->used.fetch_add (bytes);
+    if (offset + bytes > map->size())
+        return false;   // someone else got there first. we are full.
+
+    Shm_Entry *entry = reinterpret_cast<Shm_Entry*> (map->mem() + offset);
+    entry->key_hash = key_hash;
+    entry->key_size = static_cast<uint32_t> (flat_key.size());
+    entry->data_size = static_cast<uint32_t> (data.size());
+    entry->algorithm = static_cast<uint8_t> (algorithm);
+    uint8_t *out = reinterpret_cast<uint8_t*> (entry + 1);
+    std::memcpy (out, flat_key.data(), flat_key.size());
+    std::memcpy (out + flat_key.size(), data.data(), data.size());
+
+    // publish
+    idx = first;
+    do {
+        uint64_t expected = 0;
+        if (buckets[idx].compare_exchange_strong (expected, offset,
+                                                std::memory_order_acq_rel)) {
+            ++head->entries;
+            return true;
+        }
+        const Shm_Entry *other = entry_at (*map, expected);
+        if (other != nullptr && same_key (other, key_hash, flat_key))
+            return true;    // same entry published concurrently
+        idx = (idx + 1) % head->buckets;
+    } while (idx != first);
+    return false;
+}
+
+inline Shm_Lookup Shared_Cache::get (const Cache_Key &key) const
+{
+    Shm_Lookup ret {nullptr, Compress::NONE, nullptr, 0};
+    auto map = mapping();
+    if (map == nullptr)
+        return ret;
+    const Shm_Header *head = map->header();
+    const std::atomic<uint64_t> *buckets = map->buckets();
+    const auto flat_key = key.serialize();
+    const uint64_t key_hash = hash (flat_key);
+
+    const uint32_t first = static_cast<uint32_t> (key_hash % head->buckets);
+    uint32_t idx = first;
+    do {
+        const uint64_t offset = buckets[idx].load (std::memory_order_acquire);
+        if (offset == 0)
+            return ret;
+        const Shm_Entry *entry = entry_at (*map, offset);
+        if (entry != nullptr && same_key (entry, key_hash, flat_key)) {
+            ret.algorithm = static_cast<Compress> (entry->algorithm);
+            ret.data = reinterpret_cast<const uint8_t*> (entry + 1) +
+                                                                entry->key_size;
+            ret.size = entry->data_size;
+            ret.map = std::move (map);
+            return ret;
+        }
+        idx = (idx + 1) % head->buckets;
+    } while (idx != first);
+    return ret;
+}
+
+} // namespace Impl
+} // namespace RaptorQ__v1
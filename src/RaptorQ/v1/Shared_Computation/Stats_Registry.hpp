@@ -0,0 +1,290 @@
+/*
+ * Copyright (c) 2016-2017, Luca Fulchir<luca@fulchir.it>, All rights reserved.
+ *
+ * This file is part of "libRaptorQ".
+ *
+ * libRaptorQ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * libRaptorQ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * and a copy of the GNU Lesser General Public License
+ * along with libRaptorQ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "RaptorQ/v1/common.hpp"
+#include "RaptorQ/v1/stats.hpp"
+#include <atomic>
+#include <chrono>
+
+namespace RaptorQ__v1 {
+namespace Impl {
+
+// nanoseconds, for the Stats timings
+inline uint64_t stats_clock()
+{
+    using namespace std::chrono;
+    return static_cast<uint64_t> (duration_cast<nanoseconds> (
+                            steady_clock::now().time_since_epoch()).count());
+}
+
+// histogram that can be updated by multiple threads without locks.
+// a snapshot taken while someone is adding values might be off by the
+// values being added.
+class RAPTORQ_LOCAL Atomic_Histogram
+{
+public:
+    Atomic_Histogram()
+        { reset(); }
+    Atomic_Histogram (const Atomic_Histogram&) = delete;
+    Atomic_Histogram& operator= (const Atomic_Histogram&) = delete;
+    Atomic_Histogram (Atomic_Histogram&&) = delete;
+    Atomic_Histogram& operator= (Atomic_Histogram&&) = delete;
+    ~Atomic_Histogram() = default;
+
+    void add (const uint64_t value)
+    {
+        _count.fetch_add (1, std::memory_order_relaxed);
+        _sum.fetch_add (value, std::memory_order_relaxed);
+        _bucket[bucket (value)].fetch_add (1, std::memory_order_relaxed);
+    }
+    Stats_Histogram snapshot() const
+    {
+        Stats_Histogram ret;
+        ret.count = _count.load (std::memory_order_relaxed);
+        ret.sum = _sum.load (std::memory_order_relaxed);
+        for (size_t idx = 0; idx < RQ_STATS_BUCKETS; ++idx)
+            ret.bucket[idx] = _bucket[idx].load (std::memory_order_relaxed);
+        return ret;
+    }
+    void reset()
+    {
+        _count.store (0, std::memory_order_relaxed);
+        _sum.store (0, std::memory_order_relaxed);
+        for (auto &bucket : _bucket)
+            bucket.store (0, std::memory_order_relaxed);
+    }
+    // bucket 0: zero. bucket "b": [2^(b-1), 2^b)
+    static size_t bucket (uint64_t value)
+    {
+        size_t ret = 0;
+        for (; value != 0; value >>= 1)
+            ++ret;
+        return ret;
+    }
+private:
+    std::atomic<uint64_t> _count, _sum;
+    std::atomic<uint64_t> _bucket[RQ_STATS_BUCKETS];
+};
+
+// aggregates the Stats of every encoder and decoder of the process
+class RAPTORQ_LOCAL Stats_Registry
+{
+public:
+    Stats_Registry (const Stats_Registry&) = delete;
+    Stats_Registry& operator= (const Stats_Registry&) = delete;
+    Stats_Registry (Stats_Registry&&) = delete;
+    Stats_Registry& operator= (Stats_Registry&&) = delete;
+    ~Stats_Registry() = default;
+
+    static Stats_Registry& get()
+    {
+        #pragma clang diagnostic push
+        #pragma clang diagnostic ignored "-Wexit-time-destructors"
+        #pragma clang diagnostic ignored "-Wglobal-constructors"
+        static Stats_Registry registry;
+        #pragma clang diagnostic pop
+        return registry;
+    }
+
+    void add (const Stats_Source source, const Stats &stats);
+    Stats_Summary summary (const Stats_Source source) const;
+    void reset();
+private:
+    Stats_Registry() = default;
+
+    struct Source_Histograms
+    {
+        std::atomic<uint64_t> cache_probes {0}, cache_hits {0};
+        Atomic_Histogram total, gen, phase[6], get_missing, bytes_allocated,
+                                                    overhead, operations, u;
+    };
+    Source_Histograms _sources[2];
+
+    const Source_Histograms& from (const Stats_Source source) const
+        { return _sources[static_cast<uint8_t> (source)]; }
+    Source_Histograms& from (const Stats_Source source)
+        { return _sources[static_cast<uint8_t> (source)]; }
+};
+
+inline void Stats_Registry::add (const Stats_Source source,
+                                                        const Stats &stats)
+{
+    auto &src = from (source);
+    if (stats.cache_probed != 0)
+        src.cache_probes.fetch_add (1, std::memory_order_relaxed);
+    if (stats.cache_hit != 0)
+        src.cache_hits.fetch_add (1, std::memory_order_relaxed);
+    src.total.add (stats.total);
+    src.gen.add (stats.gen);
+    for (size_t idx = 0; idx < 6; ++idx)
+        src.phase[idx].add (stats.phase[idx]);
+    src.get_missing.add (stats.get_missing);
+    src.bytes_allocated.add (stats.bytes_allocated);
+    src.overhead.add (stats.overhead);
+    src.operations.add (stats.operations);
+    src.u.add (stats.u);
+}
+
+inline Stats_Summary Stats_Registry::summary (const Stats_Source source)
+                                                                        const
+{
+    const auto &src = from (source);
+    Stats_Summary ret;
+    ret.cache_probes = src.cache_probes.load (std::memory_order_relaxed);
+    ret.cache_hits = src.cache_hits.load (std::memory_order_relaxed);
+    ret.total = src.total.snapshot();
+    ret.gen = src.gen.snapshot();
+    for (size_t idx = 0; idx < 6; ++idx)
+        ret.phase[idx] = src.phase[idx].snapshot();
+    ret.get_missing = src.get_missing.snapshot();
+    ret.bytes_allocated = src.bytes_allocated.snapshot();
+    ret.overhead = src.overhead.snapshot();
+    ret.operations = src.operations.snapshot();
+    ret.u = src.u.snapshot();
+    return ret;
+}
+
+inline void Stats_Registry::reset()
+{
+    for (auto &src : _sources) {
+        src.cache_probes.store (0, std::memory_order_relaxed);
+        src.cache_hits.store (0, std::memory_order_relaxed);
+        src.total.reset();
+        src.gen.reset();
+        for (auto &phase : src.phase)
+            phase.reset();
+        src.get_missing.reset();
+        src.bytes_allocated.reset();
+        src.overhead.reset();
+        src.operations.reset();
+        src.u.reset();
+    }
+}
+
+// process-wide counters and gauges of the thread pool, the local cache
+// and the live encoders/decoders. Updated without locks.
+// Never destroyed: detached pool threads might use it at exit time.
+struct RAPTORQ_LOCAL Metrics_Registry
+{
+    Metrics_Registry (const Metrics_Registry&) = delete;
+    Metrics_Registry& operator= (const Metrics_Registry&) = delete;
+    Metrics_Registry (Metrics_Registry&&) = delete;
+    Metrics_Registry& operator= (Metrics_Registry&&) = delete;
+    ~Metrics_Registry() = default;
+
+    static Metrics_Registry& get()
+    {
+        static Metrics_Registry *instance = new Metrics_Registry();
+        return *instance;
+    }
+
+    // thread pool
+    std::atomic<uint64_t> pool_threads {0}, pool_queue_depth {0},
+                                            pool_busy_threads {0};
+    std::atomic<uint64_t> pool_enqueued {0}, pool_done {0}, pool_stopped {0},
+                                            pool_requeued {0}, pool_busy {0};
+    Atomic_Histogram pool_work;
+    // local cache
+    std::atomic<uint64_t> cache_max_bytes {0}, cache_bytes {0},
+                                                        cache_entries {0};
+    std::atomic<uint64_t> cache_hits {0}, cache_misses {0}, cache_adds {0},
+                                        cache_evictions {0}, cache_rejects {0};
+    // live encoders/decoders
+    std::atomic<uint64_t> encoders {0}, decoders {0}, encoder_bytes {0},
+                                                            decoder_bytes {0};
+
+    Metrics snapshot() const;
+private:
+    Metrics_Registry() = default;
+};
+
+inline Metrics Metrics_Registry::snapshot() const
+{
+    Metrics ret;
+    ret.pool_threads = pool_threads.load (std::memory_order_relaxed);
+    ret.pool_queue_depth = pool_queue_depth.load (std::memory_order_relaxed);
+    ret.pool_busy_threads = pool_busy_threads.load (
+                                                    std::memory_order_relaxed);
+    ret.pool_enqueued = pool_enqueued.load (std::memory_order_relaxed);
+    ret.pool_done = pool_done.load (std::memory_order_relaxed);
+    ret.pool_stopped = pool_stopped.load (std::memory_order_relaxed);
+    ret.pool_requeued = pool_requeued.load (std::memory_order_relaxed);
+    ret.pool_busy = pool_busy.load (std::memory_order_relaxed);
+    ret.pool_work = pool_work.snapshot();
+    ret.cache_max_bytes = cache_max_bytes.load (std::memory_order_relaxed);
+    ret.cache_bytes = cache_bytes.load (std::memory_order_relaxed);
+    ret.cache_entries = cache_entries.load (std::memory_order_relaxed);
+    ret.cache_hits = cache_hits.load (std::memory_order_relaxed);
+    ret.cache_misses = cache_misses.load (std::memory_order_relaxed);
+    ret.cache_adds = cache_adds.load (std::memory_order_relaxed);
+    ret.cache_evictions = cache_evictions.load (std::memory_order_relaxed);
+    ret.cache_rejects = cache_rejects.load (std::memory_order_relaxed);
+    ret.encoders = encoders.load (std::memory_order_relaxed);
+    ret.decoders = decoders.load (std::memory_order_relaxed);
+    ret.encoder_bytes = encoder_bytes.load (std::memory_order_relaxed);
+    ret.decoder_bytes = decoder_bytes.load (std::memory_order_relaxed);
+    return ret;
+}
+
+// member of every Raw_Encoder/Raw_Decoder: counts it as live, and
+// tracks the memory it reported last.
+class RAPTORQ_LOCAL Live_Object
+{
+public:
+    explicit Live_Object (const Stats_Source source)
+        : _source (source), _bytes (0)
+        { count().fetch_add (1, std::memory_order_relaxed); }
+    Live_Object() = delete;
+    Live_Object (const Live_Object&) = delete;
+    Live_Object& operator= (const Live_Object&) = delete;
+    Live_Object (Live_Object&&) = delete;
+    Live_Object& operator= (Live_Object&&) = delete;
+    ~Live_Object()
+    {
+        count().fetch_sub (1, std::memory_order_relaxed);
+        bytes().fetch_sub (_bytes.load(), std::memory_order_relaxed);
+    }
+
+    void update (const size_t new_bytes)
+    {
+        const uint64_t old = _bytes.exchange (new_bytes);
+        bytes().fetch_add (new_bytes - old, std::memory_order_relaxed);
+    }
+private:
+    const Stats_Source _source;
+    std::atomic<uint64_t> _bytes;
+
+    std::atomic<uint64_t>& count() const
+    {
+        auto &reg = Metrics_Registry::get();
+        return _source == Stats_Source::ENCODER ? reg.encoders : reg.decoders;
+    }
+    std::atomic<uint64_t>& bytes() const
+    {
+        auto &reg = Metrics_Registry::get();
+        return _source == Stats_Source::ENCODER ? reg.encoder_bytes :
+                                                            reg.decoder_bytes;
+    }
+};
+
+}   // namespace Impl
+}   // namespace RaptorQ__v1
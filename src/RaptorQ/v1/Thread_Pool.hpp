@@ -21,6 +21,8 @@
 #pragma once
 
 #include "RaptorQ/v1/common.hpp"
+#include "RaptorQ/v1/Shared_Computation/Stats_Registry.hpp"
+#include "RaptorQ/v1/util/tracepoints.hpp"
 #include <condition_variable>
 #include <deque>
 #include <functional>
@@ -87,6 +89,7 @@ public:
     ~Thread_Pool()
     {
         std::unique_lock<std::mutex> _data_lock (_data_mtx);
+        metrics().pool_queue_depth.fetch_sub (_queue.size());
         _queue.clear();
         _data_lock.unlock();
 
@@ -176,6 +179,7 @@ public:
             _pool.emplace_back (std::thread (working_thread, this, state),
                                     std::weak_ptr<Work_State_Overlay> (state));
         }
+        metrics().pool_threads.store (_pool.size());
         _lock_pool.unlock();
         _cond.notify_all();
     }
@@ -186,7 +190,10 @@ public:
         if (_pool.size() == 0)
             resize_pool (1, RaptorQ__v1::Work_State::KEEP_WORKING);
 
+        RQ_TRACE2 (pool_enqueue, work.get(), _queue.size());
         _queue.emplace_back (std::move(work));
+        metrics().pool_enqueued.fetch_add (1, std::memory_order_relaxed);
+        metrics().pool_queue_depth.fetch_add (1, std::memory_order_relaxed);
         _lock_data.unlock();
         _cond.notify_all();
 
@@ -204,6 +211,9 @@ private:
     std::list<th_state> _pool, _exiting;
     std::deque<std::unique_ptr<Pool_Work>> _queue;
 
+    static RaptorQ__v1::Impl::Metrics_Registry& metrics()
+        { return RaptorQ__v1::Impl::Metrics_Registry::get(); }
+
     static void working_thread (Thread_Pool *obj,
                                     std::shared_ptr<Work_State_Overlay> state)
     {
@@ -228,24 +238,43 @@ private:
             std::unique_ptr<Pool_Work> my_work;
             my_work.swap (obj->_queue.front());
             obj->_queue.pop_front();
+            metrics().pool_queue_depth.fetch_sub (1, std::memory_order_relaxed);
+            RQ_TRACE2 (pool_dequeue, my_work.get(), obj->_queue.size());
             lock_data.unlock();
             if (my_work == nullptr) {
                 assert (false && "thread null work");
                 continue; // should never happen
             }
+            metrics().pool_busy_threads.fetch_add (1,
+                                                    std::memory_order_relaxed);
+            const uint64_t start = RaptorQ__v1::Impl::stats_clock();
             auto exit_stat = my_work->do_work (
                     reinterpret_cast<RaptorQ__v1::Work_State *> (state.get()));
+            const uint64_t busy = RaptorQ__v1::Impl::stats_clock() - start;
+            metrics().pool_busy.fetch_add (busy, std::memory_order_relaxed);
+            metrics().pool_work.add (busy);
+            metrics().pool_busy_threads.fetch_sub (1,
+                                                    std::memory_order_relaxed);
+            RQ_TRACE3 (pool_done, my_work.get(),
+                                    static_cast<uint8_t> (exit_stat), busy);
 
             switch (exit_stat) {
             case Work_Exit_Status::DONE:
+                metrics().pool_done.fetch_add (1, std::memory_order_relaxed);
                 break;
             case Work_Exit_Status::STOPPED:
+                metrics().pool_stopped.fetch_add (1,
+                                                    std::memory_order_relaxed);
                 lock_data.lock();
                 obj->_queue.push_front (std::move(my_work));
+                metrics().pool_queue_depth.fetch_add (1,
+                                                    std::memory_order_relaxed);
                 lock_data.unlock();
                 obj->_cond.notify_all();
                 break;
             case Work_Exit_Status::REQUEUE:
+                metrics().pool_requeued.fetch_add (1,
+                                                    std::memory_order_relaxed);
                 Thread_Pool::get().add_work (std::move(my_work));
                 break;
             }
@@ -21,24 +21,85 @@
 #pragma once
 
 #include "RaptorQ/v1/common.hpp"
+#include <memory>
+#include <string>
 #include <vector>
 #include <utility>
 
 namespace RaptorQ__v1 {
 
+// cache compression codec.
+// encode/decode can be called by multiple threads at the same time.
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wweak-vtables"
+class RAPTORQ_API Codec
+{
+public:
+    virtual ~Codec() {}
+    // a single bit, different from all other registered codecs
+    virtual Compress id() const = 0;
+    // empty vector on error
+    virtual std::vector<uint8_t> encode (const std::vector<uint8_t> &in)
+                                                                    const = 0;
+    // "in" might point straight into the shared cache: no copies needed
+    virtual std::vector<uint8_t> decode (const uint8_t *in, const size_t size)
+                                                                    const = 0;
+    std::vector<uint8_t> decode (const std::vector<uint8_t> &in) const
+        { return decode (in.data(), in.size()); }
+};
+#pragma clang diagnostic pop
+
+// false if the id is not a single bit or is already taken.
+// codecs can not be unregistered.
+RAPTORQ_API bool     register_codec (std::unique_ptr<Codec> codec);
 RAPTORQ_API Compress supported_compressions();
 RAPTORQ_API Compress get_compression();
+// more than one codec: each cache entry is compressed with all of them,
+// and the best one (size, then decoding time) is kept.
 RAPTORQ_API bool     set_compression (const Compress compression);
 
 RAPTORQ_API size_t local_cache_size (const size_t local_cache);
 RAPTORQ_API size_t get_local_cache_size();
 
+// share the cached computations between all the processes of the host
+// through a memory-mapped file (use a tmpfs, like /dev/shm, for POSIX
+// shared memory). The first process creates it with "size" bytes, the
+// others just attach to it. Entries are immutable and never evicted:
+// once full, only the local cache will get new entries.
+// A file left uninitialized by a process that died is replaced.
+// Delete the file to drop the cache.
+RAPTORQ_API bool shared_cache_attach (const std::string &path,
+                                                            const size_t size);
+RAPTORQ_API void shared_cache_detach();
+
+// per-entry statistics of the local cache
+struct RAPTORQ_API Cache_Entry_Stats
+{
+    Compress algorithm;
+    size_t uncompressed;    // bytes
+    size_t compressed;      // bytes
+    uint32_t hits;
+
+    double ratio() const
+    {
+        return uncompressed == 0 ? 0 : static_cast<double> (compressed) /
+                                        static_cast<double> (uncompressed);
+    }
+};
+RAPTORQ_API std::vector<Cache_Entry_Stats> local_cache_stats();
+
+// keep up to "bytes" of finished RFC block decoders, to reuse them for the
+// next blocks with the same number of symbols and symbol size.
+// 0 (default) disables it.
+RAPTORQ_API size_t decoder_pool_size (const size_t bytes);
+RAPTORQ_API size_t get_decoder_pool_size();
+
 namespace Impl {
 
 RAPTORQ_API std::pair<Compress, std::vector<uint8_t>> compress (
                                             const std::vector<uint8_t> &data);
 RAPTORQ_API std::vector<uint8_t> decompress (const Compress algorithm,
-                                            const std::vector<uint8_t> &data);
+                                    const uint8_t *data, const size_t size);
 
 } // namespace Impl
 
@@ -46,10 +107,18 @@ RAPTORQ_API std::vector<uint8_t> decompress (const Compress algorithm,
 
 namespace RFC6330__v1 {
 
+using RaptorQ__v1::Codec;
+using RaptorQ__v1::register_codec;
 using RaptorQ__v1::supported_compressions;
 using RaptorQ__v1::get_compression;
 using RaptorQ__v1::set_compression;
 using RaptorQ__v1::local_cache_size;
 using RaptorQ__v1::get_local_cache_size;
+using RaptorQ__v1::shared_cache_attach;
+using RaptorQ__v1::shared_cache_detach;
+using RaptorQ__v1::Cache_Entry_Stats;
+using RaptorQ__v1::local_cache_stats;
+using RaptorQ__v1::decoder_pool_size;
+using RaptorQ__v1::get_decoder_pool_size;
 
 } // namespace RFC6330__v1
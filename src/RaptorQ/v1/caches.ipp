@@ -21,44 +21,24 @@
 #pragma once
 
 #include "RaptorQ/v1/caches.hpp"
+#include "RaptorQ/v1/Shared_Computation/Codecs.hpp"
 #include "RaptorQ/v1/Shared_Computation/Decaying_LF.hpp"
-#ifdef RQ_USE_LZ4
-    #include "RaptorQ/v1/Shared_Computation/LZ4_Wrapper.hpp"
-#endif
+#include "RaptorQ/v1/Shared_Computation/Decoder_Pool.hpp"
+#include "RaptorQ/v1/Shared_Computation/Shared_Cache.hpp"
 
 namespace RaptorQ__v1 {
-namespace Impl {
-static Compress compression = Compress::NONE;
-} // namespace Impl
+
+RQ_HDR_INLINE bool register_codec (std::unique_ptr<Codec> codec)
+    { return Impl::Codec_Registry::get().add (std::move (codec)); }
 
 RQ_HDR_INLINE Compress supported_compressions()
-{
-#ifdef RQ_USE_LZ4
-    return Compress::NONE | Compress::LZ4;
-#else
-    return Compress::NONE;
-#endif
-}
+    { return Impl::Codec_Registry::get().supported(); }
 
 RQ_HDR_INLINE Compress get_compression()
-    { return Impl::compression; }
+    { return Impl::Codec_Registry::get().enabled(); }
 
 RQ_HDR_INLINE bool set_compression (const Compress _compression)
-{
-    switch (_compression) {
-    case Compress::NONE:
-        Impl::compression = Compress::NONE;
-        return true;
-    case Compress::LZ4:
-#ifdef RQ_USE_LZ4
-        Impl::compression = Compress::LZ4;
-        return true;
-#else
-        return false;
-#endif
-    }
-    return false;
-}
+    { return Impl::Codec_Registry::get().enable (_compression); }
 
 RQ_HDR_INLINE size_t local_cache_size (const size_t local_cache)
 {
@@ -74,34 +54,34 @@ RQ_HDR_INLINE size_t get_local_cache_size()
                                                             get()->get_size();
 }
 
+RQ_HDR_INLINE bool shared_cache_attach (const std::string &path,
+                                                            const size_t size)
+    { return Impl::Shared_Cache::get().attach (path, size); }
+
+RQ_HDR_INLINE void shared_cache_detach()
+    { Impl::Shared_Cache::get().detach(); }
+
+RQ_HDR_INLINE std::vector<Cache_Entry_Stats> local_cache_stats()
+{
+    return RaptorQ__v1::Impl::DLF<std::vector<uint8_t>,
+                                    RaptorQ__v1::Impl::Cache_Key>::
+                                                            get()->stats();
+}
+
+RQ_HDR_INLINE size_t decoder_pool_size (const size_t bytes)
+    { return Impl::Decoder_Pool_Budget::get().resize (bytes); }
+
+RQ_HDR_INLINE size_t get_decoder_pool_size()
+    { return Impl::Decoder_Pool_Budget::get().get_size(); }
+
 namespace Impl {
 RQ_HDR_INLINE std::pair<Compress, std::vector<uint8_t>> compress (
                                             const std::vector<uint8_t> &data)
-{
-    if (Impl::compression == Compress::NONE)
-        return {Compress::NONE, data};
-#ifdef RQ_USE_LZ4
-    if (Impl::compression == Compress::LZ4) {
-        LZ4<LZ4_t::ENCODER> lz4;
-        return {Compress::LZ4, lz4.encode (data)};
-    }
-#endif
-    return {Compress::NONE, std::vector<uint8_t>()};
-}
+    { return Codec_Registry::get().compress (data); }
 
 RQ_HDR_INLINE std::vector<uint8_t> decompress (const Compress algorithm,
-                                            const std::vector<uint8_t> &data)
-{
-    if (algorithm == Compress::NONE)
-        return data;
-#ifdef RQ_USE_LZ4
-    if (algorithm == Compress::LZ4) {
-        LZ4<LZ4_t::DECODER> lz4;
-        return lz4.decode (data);
-    }
-#endif
-    return std::vector<uint8_t>();
-}
+                                    const uint8_t *data, const size_t size)
+    { return Codec_Registry::get().decompress (algorithm, data, size); }
 
 } // namespace Impl
 } // namespace RaptorQ__v1
@@ -132,8 +132,11 @@ enum class Decoder_Result : uint8_t {
     NEED_DATA = RQ_DEC_NEED_DATA
 };
 
+// bitmask. each codec is a single bit, see "register_codec"
 enum class Compress : uint8_t { NONE = RQ_COMPRESS_NONE,
-                                LZ4 = RQ_COMPRESS_LZ4
+                                LZ4 = RQ_COMPRESS_LZ4,
+                                LZ4HC = RQ_COMPRESS_LZ4HC,
+                                SPARSE = RQ_COMPRESS_SPARSE
                                 };
 
 inline Compress operator| (const Compress a, const Compress b)
@@ -153,7 +156,8 @@ enum class Error : uint8_t {
                         NEED_DATA = RQ_ERR_NEED_DATA,
                         WORKING = RQ_ERR_WORKING,
                         INITIALIZATION = RQ_ERR_INITIALIZATION,
-                        EXITING = RQ_ERR_EXITING
+                        EXITING = RQ_ERR_EXITING,
+                        OUT_OF_WINDOW = RQ_ERR_OUT_OF_WINDOW
                         };
 enum class Work_State : uint8_t {
     KEEP_WORKING = RQ_WORK_KEEP_WORKING,
@@ -194,6 +198,10 @@ enum class Compute : uint8_t {
 enum class Fill_With_Zeros : uint8_t { NO  = RQ_NO_FILL,
                                        YES = RQ_FILL_WITH_ZEROS };
 
+// tracks C_common.h/RaptorQ_Pivot
+enum class Pivot : uint8_t { RFC = RQ_PIVOT_RFC,
+                             LOOKAHEAD = RQ_PIVOT_LOOKAHEAD };
+
 inline Compute operator| (const Compute a, const Compute b)
 {
     return static_cast<Compute> (static_cast<uint8_t> (a) |
@@ -221,8 +229,32 @@ using Compute = RaptorQ__v1::Compute;
 using Compress = RaptorQ__v1::Compress;
 using Error = RaptorQ__v1::Error;
 using Fill_With_Zeros = RaptorQ__v1::Fill_With_Zeros;
+using Pivot = RaptorQ__v1::Pivot;
 using Work_State = RaptorQ__v1::Work_State;
 
+// streaming decoder: gets each decoded block, in SBN order.
+// "data" is valid only during the call. Return false to stop the stream.
+// tracks C_RFC_API.h/RFC6330_Block_Sink
+using Block_Sink = bool (*) (void *user_data, const uint8_t sbn,
+                                    const uint8_t *data, const size_t bytes);
+
+// batched packets: one packet for each of the "symbols" symbols
+// of block "sbn", starting from "esi".
+// tracks C_RFC_API.h/RFC6330_Packet_Range
+struct RAPTORQ_API Packet_Range
+{
+    uint32_t esi;
+    uint32_t symbols;
+    uint8_t sbn;
+};
+// where a packet was written. Same layout as the POSIX "struct iovec".
+// tracks C_RFC_API.h/RFC6330_Packet
+struct RAPTORQ_API Packet
+{
+    void *data;
+    size_t size;
+};
+
 // dieffrent than RaptorQ_v1::Decoder_written
 // the sizes are forced from the RFC
 // tracked by C_RFC.h/RFC6330_Dec_Result
@@ -0,0 +1,375 @@
+/*
+ * Copyright (c) 2018, Luca Fulchir<luca@fulchir.it>, All rights reserved.
+ *
+ * This file is part of "libRaptorQ".
+ *
+ * libRaptorQ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * libRaptorQ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * and a copy of the GNU Lesser General Public License
+ * along with libRaptorQ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "RaptorQ/v1/common.hpp"
+#include "RaptorQ/v1/multiplication.hpp"
+#include "RaptorQ/v1/Thread_Pool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
+
+// x86 with gcc/clang: the SIMD kernels are compiled with per-function
+// target attributes and chosen at runtime, so that the library does not
+// need to be built with -mavx2 & co.
+#if (defined(__GNUC__) || defined(__clang__)) && \
+                                    (defined(__x86_64__) || defined(__i386__))
+    #define RQ_GF256_X86 1
+    #include <immintrin.h>
+#else
+    #define RQ_GF256_X86 0
+#endif
+
+namespace RaptorQ__v1 {
+namespace Impl {
+
+// GF(256) products without the log/exp lookups and the zero checks.
+// mul[a][b] = a * b. The nibble tables are for the SIMD shuffles:
+//   a * x = mul[a][x & 0x0f] ^ nib_hi[a][x >> 4]
+struct RAPTORQ_LOCAL Gf256_Tables
+{
+    uint8_t mul[256][256];
+    uint8_t nib_hi[256][16];
+
+    Gf256_Tables()
+    {
+        for (uint16_t a = 0; a < 256; ++a) {
+            for (uint16_t b = 0; b < 256; ++b) {
+                if (a == 0 || b == 0) {
+                    mul[a][b] = 0;
+                } else {
+                    mul[a][b] = oct_exp[oct_log[a - 1] + oct_log[b - 1]];
+                }
+            }
+            for (uint16_t x = 0; x < 16; ++x)
+                nib_hi[a][x] = mul[a][x << 4];
+        }
+    }
+};
+
+inline const Gf256_Tables& gf256_tables()
+{
+    #pragma clang diagnostic push
+    #pragma clang diagnostic ignored "-Wexit-time-destructors"
+    static const Gf256_Tables tables;
+    #pragma clang diagnostic pop
+    return tables;
+}
+
+// output columns done at once: the destination stays in L1
+constexpr size_t gemm_col_tile = 4096;
+// rows of "b" done at once: "b" panel stays in L2
+constexpr size_t gemm_panel_bytes = 128 * 1024;
+// below this many multiplications the pool only adds overhead
+constexpr size_t gemm_min_thread_work = size_t(1) << 24;
+
+// dst ^= sum (scalar[i] * src[i]), i < "rows" (1 to 4)
+using Gf256_Kernel = void (*) (uint8_t *dst, const uint8_t *const *src,
+                                const uint8_t *scalar, const size_t rows,
+                                                            const size_t len);
+
+inline void gf256_add_mul_plain (uint8_t *dst, const uint8_t *const *src,
+                                const uint8_t *scalar, const size_t rows,
+                                                            const size_t len)
+{
+    const Gf256_Tables &tbl = gf256_tables();
+    if (rows == 4) {
+        const uint8_t *t0 = tbl.mul[scalar[0]], *t1 = tbl.mul[scalar[1]];
+        const uint8_t *t2 = tbl.mul[scalar[2]], *t3 = tbl.mul[scalar[3]];
+        const uint8_t *s0 = src[0], *s1 = src[1], *s2 = src[2], *s3 = src[3];
+        for (size_t i = 0; i < len; ++i)
+            dst[i] ^= t0[s0[i]] ^ t1[s1[i]] ^ t2[s2[i]] ^ t3[s3[i]];
+        return;
+    }
+    for (size_t row = 0; row < rows; ++row) {
+        const uint8_t *t = tbl.mul[scalar[row]];
+        const uint8_t *s = src[row];
+        if (scalar[row] == 1) {
+            for (size_t i = 0; i < len; ++i)
+                dst[i] ^= s[i];
+        } else {
+            for (size_t i = 0; i < len; ++i)
+                dst[i] ^= t[s[i]];
+        }
+    }
+}
+
+#if RQ_GF256_X86
+__attribute__ ((target ("ssse3")))
+inline void gf256_add_mul_ssse3 (uint8_t *dst, const uint8_t *const *src,
+                                const uint8_t *scalar, const size_t rows,
+                                                            const size_t len)
+{
+    const Gf256_Tables &tbl = gf256_tables();
+    const __m128i mask = _mm_set1_epi8 (0x0f);
+    __m128i lo[4], hi[4];
+    for (size_t row = 0; row < rows; ++row) {
+        lo[row] = _mm_loadu_si128 (reinterpret_cast<const __m128i*> (
+                                                    tbl.mul[scalar[row]]));
+        hi[row] = _mm_loadu_si128 (reinterpret_cast<const __m128i*> (
+                                                    tbl.nib_hi[scalar[row]]));
+    }
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i acc = _mm_loadu_si128 (reinterpret_cast<__m128i*> (dst + i));
+        for (size_t row = 0; row < rows; ++row) {
+            const __m128i x = _mm_loadu_si128 (
+                            reinterpret_cast<const __m128i*> (src[row] + i));
+            const __m128i l = _mm_shuffle_epi8 (lo[row],
+                                                _mm_and_si128 (x, mask));
+            const __m128i h = _mm_shuffle_epi8 (hi[row],
+                            _mm_and_si128 (_mm_srli_epi64 (x, 4), mask));
+            acc = _mm_xor_si128 (acc, _mm_xor_si128 (l, h));
+        }
+        _mm_storeu_si128 (reinterpret_cast<__m128i*> (dst + i), acc);
+    }
+    for (; i < len; ++i) {
+        for (size_t row = 0; row < rows; ++row)
+            dst[i] ^= tbl.mul[scalar[row]][src[row][i]];
+    }
+}
+
+__attribute__ ((target ("avx2")))
+inline void gf256_add_mul_avx2 (uint8_t *dst, const uint8_t *const *src,
+                                const uint8_t *scalar, const size_t rows,
+                                                            const size_t len)
+{
+    const Gf256_Tables &tbl = gf256_tables();
+    const __m256i mask = _mm256_set1_epi8 (0x0f);
+    __m256i lo[4], hi[4];
+    for (size_t row = 0; row < rows; ++row) {
+        lo[row] = _mm256_broadcastsi128_si256 (_mm_loadu_si128 (
+                reinterpret_cast<const __m128i*> (tbl.mul[scalar[row]])));
+        hi[row] = _mm256_broadcastsi128_si256 (_mm_loadu_si128 (
+                reinterpret_cast<const __m128i*> (tbl.nib_hi[scalar[row]])));
+    }
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i acc = _mm256_loadu_si256 (
+                                    reinterpret_cast<__m256i*> (dst + i));
+        for (size_t row = 0; row < rows; ++row) {
+            const __m256i x = _mm256_loadu_si256 (
+                            reinterpret_cast<const __m256i*> (src[row] + i));
+            const __m256i l = _mm256_shuffle_epi8 (lo[row],
+                                                _mm256_and_si256 (x, mask));
+            const __m256i h = _mm256_shuffle_epi8 (hi[row],
+                        _mm256_and_si256 (_mm256_srli_epi64 (x, 4), mask));
+            acc = _mm256_xor_si256 (acc, _mm256_xor_si256 (l, h));
+        }
+        _mm256_storeu_si256 (reinterpret_cast<__m256i*> (dst + i), acc);
+    }
+    for (; i < len; ++i) {
+        for (size_t row = 0; row < rows; ++row)
+            dst[i] ^= tbl.mul[scalar[row]][src[row][i]];
+    }
+}
+#endif
+
+// best kernel for this cpu, checked only once
+inline Gf256_Kernel gf256_kernel()
+{
+    #pragma clang diagnostic push
+    #pragma clang diagnostic ignored "-Wexit-time-destructors"
+    #pragma clang diagnostic ignored "-Wglobal-constructors"
+    static const Gf256_Kernel kernel = []() -> Gf256_Kernel {
+    #if RQ_GF256_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports ("avx2"))
+            return &gf256_add_mul_avx2;
+        if (__builtin_cpu_supports ("ssse3"))
+            return &gf256_add_mul_ssse3;
+    #endif
+        return &gf256_add_mul_plain;
+    }();
+    #pragma clang diagnostic pop
+    return kernel;
+}
+
+// dst ^= scalar * src
+inline void gf256_add_mul (uint8_t *dst, const uint8_t *src,
+                                        const size_t len, const uint8_t scalar)
+{
+    if (scalar == 0)
+        return;
+    gf256_kernel() (dst, &src, &scalar, 1, len);
+}
+
+// rows [row_from, row_to) of c = a * b. "c" must already be zero.
+inline void gf256_gemm_rows (uint8_t *c, const size_t ldc,
+                                const uint8_t *a, const size_t lda,
+                                const uint8_t *b, const size_t ldb,
+                                const size_t row_from, const size_t row_to,
+                                const size_t k, const size_t n,
+                                const Gf256_Kernel kernel)
+{
+    const uint8_t *src[4];
+    uint8_t scalar[4];
+    for (size_t col = 0; col < n; col += gemm_col_tile) {
+        const size_t len = std::min (gemm_col_tile, n - col);
+        const size_t panel = std::max<size_t> (4, gemm_panel_bytes / len);
+        for (size_t p_from = 0; p_from < k; p_from += panel) {
+            const size_t p_to = std::min (k, p_from + panel);
+            for (size_t row = row_from; row < row_to; ++row) {
+                uint8_t *dst = c + row * ldc + col;
+                const uint8_t *a_row = a + row * lda;
+                // skip the zeros, and do 4 rows of "b" for each
+                // load/store of "dst"
+                size_t queued = 0;
+                for (size_t p = p_from; p < p_to; ++p) {
+                    if (a_row[p] == 0)
+                        continue;
+                    src[queued] = b + p * ldb + col;
+                    scalar[queued] = a_row[p];
+                    if (++queued == 4) {
+                        kernel (dst, src, scalar, queued, len);
+                        queued = 0;
+                    }
+                }
+                if (queued != 0)
+                    kernel (dst, src, scalar, queued, len);
+            }
+        }
+    }
+}
+
+// A big product split in tiles of rows of "c". The caller and the pool
+// threads all take the next free tile, so the caller only waits for tiles
+// that are already running: it works from inside pool work too, and never
+// uses more threads than the pool has.
+class RAPTORQ_LOCAL Gemm_Tiles
+{
+public:
+    Gemm_Tiles (uint8_t *c, const size_t ldc, const uint8_t *a,
+                                const size_t lda, const uint8_t *b,
+                                const size_t ldb, const size_t m,
+                                const size_t k, const size_t n,
+                                const size_t tiles, const Gf256_Kernel kernel)
+        : _c (c), _a (a), _b (b), _ldc (ldc), _lda (lda), _ldb (ldb),
+            _m (m), _k (k), _n (n), _rows ((m + tiles - 1) / tiles),
+            _tiles (tiles), _kernel (kernel), _next (0), _done (0)
+    {}
+    Gemm_Tiles() = delete;
+    Gemm_Tiles (const Gemm_Tiles&) = delete;
+    Gemm_Tiles& operator= (const Gemm_Tiles&) = delete;
+    Gemm_Tiles (Gemm_Tiles&&) = delete;
+    Gemm_Tiles& operator= (Gemm_Tiles&&) = delete;
+    ~Gemm_Tiles() = default;
+
+    // do tiles until none is left
+    void work();
+    // wait for the tiles taken by the others
+    void wait();
+private:
+    uint8_t *const _c;
+    const uint8_t *const _a, *const _b;
+    const size_t _ldc, _lda, _ldb, _m, _k, _n, _rows, _tiles;
+    const Gf256_Kernel _kernel;
+    std::atomic<size_t> _next, _done;
+    std::mutex _mtx;
+    std::condition_variable _cond;
+};
+
+inline void Gemm_Tiles::work()
+{
+    for (size_t tile = _next++; tile < _tiles; tile = _next++) {
+        const size_t from = tile * _rows;
+        gf256_gemm_rows (_c, _ldc, _a, _lda, _b, _ldb, from,
+                                std::min (_m, from + _rows), _k, _n, _kernel);
+        if (++_done == _tiles) {
+            std::lock_guard<std::mutex> guard (_mtx);
+            RQ_UNUSED (guard);
+            _cond.notify_all();
+        }
+    }
+}
+
+inline void Gemm_Tiles::wait()
+{
+    std::unique_lock<std::mutex> lock (_mtx);
+    while (_done.load() != _tiles)
+        _cond.wait (lock);
+}
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wweak-vtables"
+class RAPTORQ_LOCAL Gemm_Work final : public RFC6330__v1::Impl::Pool_Work
+{
+public:
+    explicit Gemm_Work (const std::shared_ptr<Gemm_Tiles> &tiles)
+        : _tiles (tiles) {}
+    Gemm_Work() = delete;
+    Gemm_Work (const Gemm_Work&) = delete;
+    Gemm_Work& operator= (const Gemm_Work&) = delete;
+    Gemm_Work (Gemm_Work&&) = delete;
+    Gemm_Work& operator= (Gemm_Work&&) = delete;
+    ~Gemm_Work() override {}
+
+    RFC6330__v1::Work_Exit_Status do_work (RaptorQ__v1::Work_State *state)
+                                                                    override
+    {
+        RQ_UNUSED (state);
+        _tiles->work();
+        return RFC6330__v1::Work_Exit_Status::DONE;
+    }
+private:
+    // keeps the tiles alive if we start after the caller returned
+    const std::shared_ptr<Gemm_Tiles> _tiles;
+};
+#pragma clang diagnostic pop
+
+// c = a * b. row-major, "ld*" are the row strides, in bytes.
+// a: m x k, b: k x n, c: m x n. "c" must not overlap "a" or "b".
+// with "threads" > 1 big products are split by rows of "c", and the
+// thread pool helps with them.
+// "kernel": nullptr for the best one for this cpu.
+inline void gf256_gemm (uint8_t *c, const size_t ldc,
+                                const uint8_t *a, const size_t lda,
+                                const uint8_t *b, const size_t ldb,
+                                const size_t m, const size_t k, const size_t n,
+                                const uint16_t threads = 1,
+                                Gf256_Kernel kernel = nullptr)
+{
+    if (kernel == nullptr)
+        kernel = gf256_kernel();
+    for (size_t row = 0; row < m; ++row)
+        std::memset (c + row * ldc, 0, n);
+    const size_t tiles = std::min<size_t> (threads,
+                                        (m * k * n) / gemm_min_thread_work);
+    if (tiles <= 1 || m < 2 * tiles) {
+        gf256_gemm_rows (c, ldc, a, lda, b, ldb, 0, m, k, n, kernel);
+        return;
+    }
+    auto shared = std::make_shared<Gemm_Tiles> (c, ldc, a, lda, b, ldb,
+                                                    m, k, n, tiles, kernel);
+    for (size_t helper = 1; helper < tiles; ++helper) {
+        RFC6330__v1::Impl::Thread_Pool::get().add_work (
+                            std::unique_ptr<RFC6330__v1::Impl::Pool_Work> (
+                                                new Gemm_Work (shared)));
+    }
+    shared->work();
+    shared->wait();
+}
+
+}   // namespace Impl
+}   // namespace RaptorQ__v1
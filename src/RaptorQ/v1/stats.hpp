@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2016-2017, Luca Fulchir<luca@fulchir.it>, All rights reserved.
+ *
+ * This file is part of "libRaptorQ".
+ *
+ * libRaptorQ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * libRaptorQ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * and a copy of the GNU Lesser General Public License
+ * along with libRaptorQ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "RaptorQ/v1/common.hpp"
+#include <string>
+
+namespace RaptorQ__v1 {
+
+// tracks C_common.h/RaptorQ_Stats
+// what happened in the last decoding (or encoder computation).
+// all times are in nanoseconds.
+struct RAPTORQ_API Stats
+{
+    uint64_t total = 0;
+    uint64_t gen = 0;               // precode matrix generation
+    uint64_t phase[6] = {};         // decode_phase0 .. decode_phase5
+    uint64_t get_missing = 0;       // rebuilding the missing source symbols
+    uint64_t bytes_allocated = 0;   // growth of the decoder scratch space
+    uint64_t cache_compressed = 0;  // size of the cached operations, if any
+    uint64_t cache_uncompressed = 0;
+    uint32_t overhead = 0;          // repair symbols used
+    uint32_t operations = 0;        // recorded operations
+    uint16_t i = 0;                 // columns solved by phase 1
+    uint16_t u = 0;                 // columns inactivated by phase 1
+    uint8_t cache_probed = 0;       // the operation cache was looked up
+    uint8_t cache_hit = 0;          // ...and had the computation
+};
+
+// tracks C_common.h/RaptorQ_Stats_Histogram
+// bucket 0 counts the zeros, bucket "b" counts the values in [2^(b-1), 2^b)
+struct RAPTORQ_API Stats_Histogram
+{
+    uint64_t count = 0;
+    uint64_t sum = 0;
+    uint64_t bucket[RQ_STATS_BUCKETS] = {};
+};
+
+// tracks C_common.h/RaptorQ_Stats_Summary
+struct RAPTORQ_API Stats_Summary
+{
+    uint64_t cache_probes = 0;
+    uint64_t cache_hits = 0;
+    Stats_Histogram total;
+    Stats_Histogram gen;
+    Stats_Histogram phase[6];
+    Stats_Histogram get_missing;
+    Stats_Histogram bytes_allocated;
+    Stats_Histogram overhead;
+    Stats_Histogram operations;
+    Stats_Histogram u;
+};
+
+// tracks C_common.h/RaptorQ_Stats_Source
+enum class Stats_Source : uint8_t {
+    ENCODER = RQ_STATS_ENCODER,
+    DECODER = RQ_STATS_DECODER
+};
+
+// tracks C_common.h/RaptorQ_Metrics
+// gauges are the current value, the rest only grows.
+// times are in nanoseconds, sizes in bytes.
+struct RAPTORQ_API Metrics
+{
+    // thread pool
+    uint64_t pool_threads = 0;          // gauge
+    uint64_t pool_queue_depth = 0;      // gauge: work waiting for a thread
+    uint64_t pool_busy_threads = 0;     // gauge
+    uint64_t pool_enqueued = 0;
+    uint64_t pool_done = 0;
+    uint64_t pool_stopped = 0;          // put back in the queue
+    uint64_t pool_requeued = 0;
+    uint64_t pool_busy = 0;             // time spent working, all threads
+    Stats_Histogram pool_work;          // time of each work item
+    // local cache
+    uint64_t cache_max_bytes = 0;       // gauge
+    uint64_t cache_bytes = 0;           // gauge
+    uint64_t cache_entries = 0;         // gauge
+    uint64_t cache_hits = 0;
+    uint64_t cache_misses = 0;
+    uint64_t cache_adds = 0;
+    uint64_t cache_evictions = 0;
+    uint64_t cache_rejects = 0;         // too big, or fresher entries
+    // live block encoders/decoders (RAW objects and RFC blocks)
+    uint64_t encoders = 0;              // gauge
+    uint64_t decoders = 0;              // gauge
+    uint64_t encoder_bytes = 0;         // gauge
+    uint64_t decoder_bytes = 0;         // gauge
+};
+
+// every finished decoding and encoder computation of the process
+// (RAW and RFC) is added here.
+RAPTORQ_API Stats_Summary stats_summary (const Stats_Source source);
+RAPTORQ_API void stats_reset();
+// not reset by stats_reset()
+RAPTORQ_API Metrics metrics();
+// metrics() and stats_summary() of both sources, in the
+// Prometheus text exposition format. Every name starts with "prefix_".
+RAPTORQ_API std::string metrics_prometheus (
+                                    const std::string &prefix = "raptorq");
+
+}   // namespace RaptorQ__v1
+
+namespace RFC6330__v1 {
+
+using RaptorQ__v1::Stats;
+using RaptorQ__v1::Stats_Histogram;
+using RaptorQ__v1::Stats_Summary;
+using RaptorQ__v1::Stats_Source;
+using RaptorQ__v1::stats_summary;
+using RaptorQ__v1::stats_reset;
+using RaptorQ__v1::Metrics;
+using RaptorQ__v1::metrics;
+using RaptorQ__v1::metrics_prometheus;
+
+} // namespace RFC6330__v1
@@ -0,0 +1,202 @@
+/*
+ * Copyright (c) 2016-2017, Luca Fulchir<luca@fulchir.it>, All rights reserved.
+ *
+ * This file is part of "libRaptorQ".
+ *
+ * libRaptorQ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * libRaptorQ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * and a copy of the GNU Lesser General Public License
+ * along with libRaptorQ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "RaptorQ/v1/stats.hpp"
+#include "RaptorQ/v1/Shared_Computation/Stats_Registry.hpp"
+#include <string>
+
+namespace RaptorQ__v1 {
+
+RQ_HDR_INLINE Stats_Summary stats_summary (const Stats_Source source)
+    { return Impl::Stats_Registry::get().summary (source); }
+
+RQ_HDR_INLINE void stats_reset()
+    { Impl::Stats_Registry::get().reset(); }
+
+RQ_HDR_INLINE Metrics metrics()
+    { return Impl::Metrics_Registry::get().snapshot(); }
+
+namespace Impl {
+
+// finite buckets written by the Prometheus renderer. Anything bigger
+// (2^47 ns is more than a day) only shows up in "+Inf".
+constexpr size_t prometheus_buckets = 48;
+
+inline void prometheus_head (std::string &out, const std::string &name,
+                                const char *type, const char *help)
+{
+    out += "# HELP " + name + " " + help + "\n";
+    out += "# TYPE " + name + " " + type + "\n";
+}
+
+inline void prometheus_value (std::string &out, const std::string &name,
+                                const char *type, const char *help,
+                                                        const uint64_t value)
+{
+    prometheus_head (out, name, type, help);
+    out += name + " " + std::to_string (value) + "\n";
+}
+
+inline void prometheus_histogram (std::string &out, const std::string &name,
+                                                    const std::string &labels,
+                                                    const Stats_Histogram &hist)
+{
+    const std::string first = labels.empty() ? labels : labels + ",";
+    uint64_t cumulative = 0;
+    for (size_t idx = 0; idx < prometheus_buckets; ++idx) {
+        cumulative += hist.bucket[idx];
+        const uint64_t le = (uint64_t (1) << idx) - 1;
+        out += name + "_bucket{" + first + "le=\"" + std::to_string (le) +
+                                "\"} " + std::to_string (cumulative) + "\n";
+    }
+    out += name + "_bucket{" + first + "le=\"+Inf\"} " +
+                                        std::to_string (hist.count) + "\n";
+    const std::string braces = labels.empty() ? labels : "{" + labels + "}";
+    out += name + "_sum" + braces + " " + std::to_string (hist.sum) + "\n";
+    out += name + "_count" + braces + " " + std::to_string (hist.count) +"\n";
+}
+
+} // namespace Impl
+
+RQ_HDR_INLINE std::string metrics_prometheus (const std::string &prefix)
+{
+    using Impl::prometheus_head;
+    using Impl::prometheus_value;
+    using Impl::prometheus_histogram;
+    const Metrics met = metrics();
+    const std::string pre = prefix.empty() ? std::string() : prefix + "_";
+    std::string out;
+
+    prometheus_value (out, pre + "pool_threads", "gauge",
+                            "Threads of the pool.", met.pool_threads);
+    prometheus_value (out, pre + "pool_queue_depth", "gauge",
+                            "Work waiting for a thread.", met.pool_queue_depth);
+    prometheus_value (out, pre + "pool_busy_threads", "gauge",
+                            "Threads doing some work.", met.pool_busy_threads);
+    prometheus_value (out, pre + "pool_enqueued_total", "counter",
+                            "Work added to the pool.", met.pool_enqueued);
+    prometheus_value (out, pre + "pool_done_total", "counter",
+                            "Work completed.", met.pool_done);
+    prometheus_value (out, pre + "pool_stopped_total", "counter",
+                            "Work stopped and put back in the queue.",
+                                                            met.pool_stopped);
+    prometheus_value (out, pre + "pool_requeued_total", "counter",
+                            "Work that asked to be queued again.",
+                                                            met.pool_requeued);
+    prometheus_value (out, pre + "pool_busy_nanoseconds_total", "counter",
+                            "Time spent working, all threads.", met.pool_busy);
+    prometheus_head (out, pre + "pool_work_nanoseconds", "histogram",
+                                                "Time of each work item.");
+    prometheus_histogram (out, pre + "pool_work_nanoseconds", "",
+                                                                met.pool_work);
+
+    prometheus_value (out, pre + "cache_max_bytes", "gauge",
+                            "Size limit of the local cache.",
+                                                        met.cache_max_bytes);
+    prometheus_value (out, pre + "cache_bytes", "gauge",
+                            "Bytes used by the local cache.", met.cache_bytes);
+    prometheus_value (out, pre + "cache_entries", "gauge",
+                            "Entries in the local cache.", met.cache_entries);
+    prometheus_value (out, pre + "cache_hits_total", "counter",
+                            "Local cache lookups that found the entry.",
+                                                            met.cache_hits);
+    prometheus_value (out, pre + "cache_misses_total", "counter",
+                            "Local cache lookups that did not.",
+                                                            met.cache_misses);
+    prometheus_value (out, pre + "cache_adds_total", "counter",
+                            "Entries added to the local cache.",
+                                                            met.cache_adds);
+    prometheus_value (out, pre + "cache_evictions_total", "counter",
+                            "Entries dropped to make space.",
+                                                        met.cache_evictions);
+    prometheus_value (out, pre + "cache_rejects_total", "counter",
+                            "Entries that could not be added.",
+                                                        met.cache_rejects);
+
+    prometheus_head (out, pre + "live_objects", "gauge",
+                                        "Live block encoders and decoders.");
+    out += pre + "live_objects{kind=\"encoder\"} " +
+                                    std::to_string (met.encoders) + "\n";
+    out += pre + "live_objects{kind=\"decoder\"} " +
+                                    std::to_string (met.decoders) + "\n";
+    prometheus_head (out, pre + "live_object_bytes", "gauge",
+                                "Memory of the live encoders and decoders.");
+    out += pre + "live_object_bytes{kind=\"encoder\"} " +
+                                std::to_string (met.encoder_bytes) + "\n";
+    out += pre + "live_object_bytes{kind=\"decoder\"} " +
+                                std::to_string (met.decoder_bytes) + "\n";
+
+    const Stats_Summary sum[2] = { stats_summary (Stats_Source::ENCODER),
+                                    stats_summary (Stats_Source::DECODER) };
+    const std::string source[2] = { "source=\"encoder\"",
+                                    "source=\"decoder\"" };
+    prometheus_head (out, pre + "run_cache_probes_total", "counter",
+                                    "Runs that looked up the operation cache.");
+    for (size_t src = 0; src < 2; ++src) {
+        out += pre + "run_cache_probes_total{" + source[src] + "} " +
+                                std::to_string (sum[src].cache_probes) + "\n";
+    }
+    prometheus_head (out, pre + "run_cache_hits_total", "counter",
+                                    "Runs that replayed cached operations.");
+    for (size_t src = 0; src < 2; ++src) {
+        out += pre + "run_cache_hits_total{" + source[src] + "} " +
+                                std::to_string (sum[src].cache_hits) + "\n";
+    }
+    struct Family {
+        const char *name, *help;
+        const Stats_Histogram Stats_Summary::*hist;
+    };
+    const Family families[] = {
+        {"run_total_nanoseconds", "Time of each run.", &Stats_Summary::total},
+        {"run_gen_nanoseconds", "Precode matrix generation.",
+                                                        &Stats_Summary::gen},
+        {"run_get_missing_nanoseconds", "Rebuilding the missing symbols.",
+                                                &Stats_Summary::get_missing},
+        {"run_allocated_bytes", "Memory allocated by each run.",
+                                            &Stats_Summary::bytes_allocated},
+        {"run_overhead_symbols", "Repair symbols used.",
+                                                    &Stats_Summary::overhead},
+        {"run_operations", "Recorded operations.",
+                                                    &Stats_Summary::operations},
+        {"run_inactivated_columns", "Columns inactivated by phase 1.",
+                                                            &Stats_Summary::u}
+    };
+    for (const auto &family : families) {
+        prometheus_head (out, pre + family.name, "histogram", family.help);
+        for (size_t src = 0; src < 2; ++src) {
+            prometheus_histogram (out, pre + family.name, source[src],
+                                                    sum[src].*(family.hist));
+        }
+    }
+    prometheus_head (out, pre + "run_phase_nanoseconds", "histogram",
+                                        "Time of each decoding phase.");
+    for (size_t src = 0; src < 2; ++src) {
+        for (size_t phase = 0; phase < 6; ++phase) {
+            prometheus_histogram (out, pre + "run_phase_nanoseconds",
+                        source[src] + ",phase=\"" + std::to_string (phase) +
+                                            "\"", sum[src].phase[phase]);
+        }
+    }
+    return out;
+}
+
+}   // namespace RaptorQ__v1
@@ -77,6 +77,12 @@ public:
     const std::vector<bool>& get_bitmask () const
         { return _mask; }
 
+    // back to "nothing received", keeping the memory
+    void reset()
+    {
+        _mask.assign (_max_nonrepair, false);
+        _holes = _max_nonrepair;
+    }
     void free()
     {
         _mask.clear();
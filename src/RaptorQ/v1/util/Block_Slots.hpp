@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2018, Luca Fulchir<luca@fulchir.it>, All rights reserved.
+ *
+ * This file is part of "libRaptorQ".
+ *
+ * libRaptorQ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * libRaptorQ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * and a copy of the GNU Lesser General Public License
+ * along with libRaptorQ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include "RaptorQ/v1/common.hpp"
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+namespace RaptorQ__v1 {
+namespace Impl {
+
+// Per-block state of the RFC encoder/decoder. The RFC allows at most 256
+// source blocks, so every SBN gets its own slot with its own lock:
+// threads working on different blocks never contend with each other.
+// get/emplace/erase require the slot lock.
+template <typename T>
+class RAPTORQ_LOCAL Block_Slots
+{
+public:
+    Block_Slots()
+        : _used (0)
+    {}
+    Block_Slots (const Block_Slots&) = delete;
+    Block_Slots& operator= (const Block_Slots&) = delete;
+    Block_Slots (Block_Slots&&) = delete;
+    Block_Slots& operator= (Block_Slots&&) = delete;
+    ~Block_Slots() = default;
+
+    std::unique_lock<std::mutex> lock (const uint8_t sbn) const
+        { return std::unique_lock<std::mutex> (_slots[sbn].mtx); }
+
+    // nullptr if the slot is empty
+    T* get (const uint8_t sbn) const
+        { return _slots[sbn].value.get(); }
+    template <typename... Args>
+    T* emplace (const uint8_t sbn, Args&&... args);
+    void erase (const uint8_t sbn);
+
+    // number of non-empty slots
+    uint16_t size() const
+        { return _used.load(); }
+private:
+    struct Slot
+    {
+        mutable std::mutex mtx;
+        std::unique_ptr<T> value;
+    };
+    std::array<Slot, 256> _slots;
+    std::atomic<uint16_t> _used;
+};
+
+template <typename T>
+template <typename... Args>
+T* Block_Slots<T>::emplace (const uint8_t sbn, Args&&... args)
+{
+    auto &slot = _slots[sbn];
+    if (slot.value == nullptr)
+        ++_used;
+    slot.value.reset (new T (std::forward<Args> (args)...));
+    return slot.value.get();
+}
+
+template <typename T>
+void Block_Slots<T>::erase (const uint8_t sbn)
+{
+    auto &slot = _slots[sbn];
+    if (slot.value == nullptr)
+        return;
+    slot.value.reset();
+    --_used;
+}
+
+}   // namespace Impl
+}   // namespace RaptorQ__v1
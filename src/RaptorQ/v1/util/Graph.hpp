@@ -30,10 +30,16 @@ class RAPTORQ_LOCAL Graph
 {
 public:
     explicit Graph (const uint16_t size)
+        { reset (size); }
+
+    // disconnect everything, but keep the memory
+    void reset (const uint16_t size)
     {
+        _connections.clear();
         _connections.reserve(size);
         for (uint16_t i = 0; i < size; ++i)
             _connections.emplace_back(1, i);
+        _max_connections = 1;
     }
 
     void connect (const uint16_t node_a, const uint16_t node_b)
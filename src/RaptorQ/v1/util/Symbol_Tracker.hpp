@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2016-2017, Luca Fulchir<luca@fulchir.it>, All rights reserved.
+ *
+ * This file is part of "libRaptorQ".
+ *
+ * libRaptorQ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * libRaptorQ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * and a copy of the GNU Lesser General Public License
+ * along with libRaptorQ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "RaptorQ/v1/common.hpp"
+#include <atomic>
+#include <vector>
+
+namespace RaptorQ__v1 {
+namespace Impl {
+
+// index of the lowest bit set. "word" must not be zero
+inline uint32_t RAPTORQ_LOCAL lowest_bit (const uint64_t word)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return static_cast<uint32_t> (__builtin_ctzll (word));
+#else
+    uint32_t bit = 0;
+    for (uint64_t tmp = word; (tmp & 1) == 0; tmp >>= 1)
+        ++bit;
+    return bit;
+#endif
+}
+
+// Lock-free tracking of the source symbols of a block: which ones are
+// available, and which ones were already reported to the user.
+// 64 symbols per atomic word. The "available" and "reported" words of the
+// same symbols are next to each other, so they share the cache line.
+class RAPTORQ_LOCAL Symbol_Tracker
+{
+public:
+    Symbol_Tracker()
+        : _symbols (0), _first_unreported (0) {}
+    ~Symbol_Tracker() = default;
+    Symbol_Tracker (const Symbol_Tracker&) = delete;
+    Symbol_Tracker& operator= (const Symbol_Tracker&) = delete;
+    Symbol_Tracker (Symbol_Tracker&&) = delete;
+    Symbol_Tracker& operator= (Symbol_Tracker&&) = delete;
+
+    // 0 symbols: not initialized
+    void init (const uint16_t symbols)
+    {
+        _symbols = symbols;
+        _bits = std::vector<std::atomic<uint64_t>> (2 * words());
+        clear();
+    }
+    uint16_t size() const
+        { return _symbols; }
+
+    void clear()
+    {
+        for (auto &word : _bits)
+            word.store (0, std::memory_order_relaxed);
+        _first_unreported.store (0);
+    }
+
+    void set_available (const uint16_t symbol)
+    {
+        _bits[2 * (symbol / 64u)].fetch_or (uint64_t(1) << (symbol % 64u));
+    }
+    void set_all_available()
+    {
+        for (uint32_t word = 0; word < words(); ++word)
+            _bits[2 * word].fetch_or (valid (word));
+    }
+
+    // first symbol not available, starting from "from".
+    // size() if all are available
+    uint16_t first_missing (const uint16_t from) const
+    {
+        for (uint32_t word = from / 64u; word < words(); ++word) {
+            uint64_t missing = ~_bits[2 * word].load() & valid (word);
+            if (word == from / 64u)
+                missing &= ~uint64_t(0) << (from % 64u);
+            if (missing != 0)
+                return static_cast<uint16_t> (word * 64 +
+                                                        lowest_bit (missing));
+        }
+        return _symbols;
+    }
+
+    // mark as reported the first symbol that is available but was not
+    // reported yet, and return it. size() if there is none.
+    // only one caller gets each symbol.
+    uint16_t claim_unreported()
+    {
+        // the words before "_first_unreported" are all reported,
+        // we do not need to scan them again.
+        for (uint32_t word = _first_unreported.load(); word < words();
+                                                                    ++word) {
+            uint64_t reported = _bits[2 * word + 1].load();
+            uint64_t todo = _bits[2 * word].load() & ~reported;
+            while (todo != 0) {
+                const uint32_t bit = lowest_bit (todo);
+                const uint64_t mask = uint64_t(1) << bit;
+                const uint64_t before = _bits[2 * word + 1].fetch_or (mask);
+                reported = before | mask;
+                if ((before & mask) == 0) {
+                    if (reported == valid (word))
+                        skip_reported (word);
+                    return static_cast<uint16_t> (word * 64 + bit);
+                }
+                // some other thread got it first
+                todo &= ~reported;
+            }
+            if (reported == valid (word))
+                skip_reported (word);
+        }
+        return _symbols;
+    }
+
+private:
+    uint16_t _symbols;
+    std::atomic<uint32_t> _first_unreported;
+    // pairs of (available, reported)
+    std::vector<std::atomic<uint64_t>> _bits;
+
+    uint32_t words() const
+        { return (_symbols + 63u) / 64u; }
+    // bits of the word that are real symbols
+    uint64_t valid (const uint32_t word) const
+    {
+        const uint32_t left = _symbols - word * 64u;
+        return left >= 64 ? ~uint64_t(0) : (uint64_t(1) << left) - 1;
+    }
+    // "word" is now fully reported: move the scan start after it
+    void skip_reported (const uint32_t word)
+    {
+        uint32_t expected = word;
+        _first_unreported.compare_exchange_strong (expected, word + 1);
+    }
+};
+
+} // namespace Impl
+} // namespace RaptorQ__v1
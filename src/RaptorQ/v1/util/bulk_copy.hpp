@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2018, Luca Fulchir<luca@fulchir.it>, All rights reserved.
+ *
+ * This file is part of "libRaptorQ".
+ *
+ * libRaptorQ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * libRaptorQ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * and a copy of the GNU Lesser General Public License
+ * along with libRaptorQ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "RaptorQ/v1/common.hpp"
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <type_traits>
+#include <vector>
+
+namespace RaptorQ__v1 {
+namespace Impl {
+
+// iterators whose elements are contiguous in memory: we can memcpy them.
+template <typename It>
+struct RAPTORQ_LOCAL is_contiguous : std::integral_constant<bool,
+    std::is_pointer<It>::value ||
+    (!std::is_same<typename std::iterator_traits<It>::value_type,
+                                                            bool>::value &&
+        (std::is_same<It, typename std::vector<typename
+                    std::iterator_traits<It>::value_type>::iterator>::value ||
+        std::is_same<It, typename std::vector<typename
+            std::iterator_traits<It>::value_type>::const_iterator>::value))>
+{};
+
+// Copy at most "bytes" bytes from the elements in [it, end) to "dst".
+// "it" is advanced past every element that was read, even partially.
+// returns the number of bytes copied.
+template <typename It>
+inline size_t RAPTORQ_LOCAL copy_bytes (It &it, const It end, uint8_t *dst,
+                                const size_t bytes, const std::true_type)
+{
+    using T = typename std::iterator_traits<It>::value_type;
+    if (it == end)
+        return 0;
+    const size_t elements = std::min<size_t> (static_cast<size_t> (end - it),
+                                        (bytes + sizeof(T) - 1) / sizeof(T));
+    const size_t copied = std::min<size_t> (bytes, elements * sizeof(T));
+    std::memcpy (dst, &*it, copied);
+    it += static_cast<typename std::iterator_traits<It>::difference_type> (
+                                                                    elements);
+    return copied;
+}
+
+template <typename It>
+inline size_t RAPTORQ_LOCAL copy_bytes (It &it, const It end, uint8_t *dst,
+                                const size_t bytes, const std::false_type)
+{
+    using T = typename std::iterator_traits<It>::value_type;
+    size_t copied = 0;
+    for (; it != end && copied < bytes; ++it) {
+        const T val = *it;
+        const size_t len = std::min<size_t> (sizeof(T), bytes - copied);
+        std::memcpy (dst + copied, &val, len);
+        copied += len;
+    }
+    return copied;
+}
+
+template <typename It>
+inline size_t RAPTORQ_LOCAL copy_bytes (It &it, const It end, uint8_t *dst,
+                                                            const size_t bytes)
+    { return copy_bytes (it, end, dst, bytes, is_contiguous<It>()); }
+
+// Write "bytes" bytes from "src" to the elements in [it, end), zero padding
+// the last element. "it" is advanced past every element written.
+// returns the number of elements written.
+template <typename It>
+inline size_t RAPTORQ_LOCAL put_bytes (It &it, const It end,
+                                                        const uint8_t *src,
+                                                        const size_t bytes,
+                                                        const std::true_type)
+{
+    using T = typename std::iterator_traits<It>::value_type;
+    if (it == end)
+        return 0;
+    const size_t elements = std::min<size_t> (static_cast<size_t> (end - it),
+                                        (bytes + sizeof(T) - 1) / sizeof(T));
+    const size_t copied = std::min<size_t> (bytes, elements * sizeof(T));
+    uint8_t *dst = reinterpret_cast<uint8_t*> (&*it);
+    std::memcpy (dst, src, copied);
+    std::memset (dst + copied, 0, elements * sizeof(T) - copied);
+    it += static_cast<typename std::iterator_traits<It>::difference_type> (
+                                                                    elements);
+    return elements;
+}
+
+template <typename It>
+inline size_t RAPTORQ_LOCAL put_bytes (It &it, const It end,
+                                                        const uint8_t *src,
+                                                        const size_t bytes,
+                                                        const std::false_type)
+{
+    using T = typename std::iterator_traits<It>::value_type;
+    size_t elements = 0;
+    for (size_t done = 0; it != end && done < bytes; ++it, ++elements) {
+        T val = static_cast<T> (0);
+        const size_t len = std::min<size_t> (sizeof(T), bytes - done);
+        std::memcpy (&val, src + done, len);
+        *it = val;
+        done += len;
+    }
+    return elements;
+}
+
+template <typename It>
+inline size_t RAPTORQ_LOCAL put_bytes (It &it, const It end,
+                                                        const uint8_t *src,
+                                                        const size_t bytes)
+    { return put_bytes (it, end, src, bytes, is_contiguous<It>()); }
+
+} // namespace Impl
+} // namespace RaptorQ__v1
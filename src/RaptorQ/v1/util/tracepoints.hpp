@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2016-2017, Luca Fulchir<luca@fulchir.it>, All rights reserved.
+ *
+ * This file is part of "libRaptorQ".
+ *
+ * libRaptorQ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * libRaptorQ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * and a copy of the GNU Lesser General Public License
+ * along with libRaptorQ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+// Static tracepoints for perf/bpftrace/systemtap, provider "raptorq".
+// Built only with RQ_USDT (cmake option "USDT"): they are then a nop
+// instruction until a tracer attaches. Without it, they are nothing.
+// e.g.: bpftrace -e 'usdt:libRaptorQ.so:raptorq:decode_phase_exit
+//                                      { @[arg0] = hist (arg1); }'
+//
+// probes and arguments:
+//  decode_phase_entry  (phase, rows, symbol_size)
+//  decode_phase_exit   (phase, nanoseconds)
+//  pool_enqueue        (work, queue_depth)
+//  pool_dequeue        (work, queue_depth)
+//  pool_done           (work, Work_Exit_Status, nanoseconds)
+//  cache_get           (found, compressed_size)
+//  cache_add           (added, compressed_size, evicted)
+//  cache_evict         (entries, bytes)
+//  decoder_add_symbol  (decoder, esi, Error)
+//
+// arguments must be integers or pointers.
+
+#ifdef RQ_USDT
+    #include <sys/sdt.h>
+    #define RQ_TRACE2(name, a1, a2) DTRACE_PROBE2 (raptorq, name, a1, a2)
+    #define RQ_TRACE3(name, a1, a2, a3) \
+                                    DTRACE_PROBE3 (raptorq, name, a1, a2, a3)
+#else
+    // sizeof: the arguments are never evaluated, but are still "used"
+    #define RQ_TRACE2(name, a1, a2) ((void) sizeof (a1), (void) sizeof (a2))
+    #define RQ_TRACE3(name, a1, a2, a3) \
+                ((void) sizeof (a1), (void) sizeof (a2), (void) sizeof (a3))
+#endif
@@ -22,6 +22,7 @@
 
 #include "RaptorQ/v1/block_sizes.hpp"
 #include "RaptorQ/v1/common.hpp"
+#include "RaptorQ/v1/stats.hpp"
 #include "RaptorQ/v1/wrapper/CPP_RAW_API_void.hpp"
 #include "RaptorQ/v1/RaptorQ_Iterators.hpp"
 #include <vector>
@@ -81,6 +82,11 @@ public:
     std::shared_future<Error> precompute();
     std::shared_future<Error> compute();
     #endif
+    // threads for the final matrix product when the precomputation is
+    // cached. default: 1
+    void set_max_concurrency (const uint16_t max_threads);
+    // timings and cache usage of the last computation
+    Stats stats() const;
 
     size_t encode (Fwd_It &output, const Fwd_It end, const uint32_t id);
 
@@ -120,6 +126,13 @@ public:
     uint16_t needed_symbols() const;
 
     void set_max_concurrency (const uint16_t max_threads);
+    // how the rows are chosen while decoding. default: Pivot::RFC
+    void set_pivot (const Pivot strategy);
+    // inactivated columns ("u") of the last decoding.
+    // 0 if the operations came from the cache.
+    uint16_t inactivated() const;
+    // timings, cache usage and sizes of the last decoding
+    Stats stats() const;
     Decoder_Result decode_once();
 
     Decoder_wait_res poll();
@@ -250,6 +263,14 @@ template <typename Rnd_It, typename Fwd_It>
 bool Encoder<Rnd_It, Fwd_It>::compute_sync()
     { return _encoder.compute_sync(); }
 
+template <typename Rnd_It, typename Fwd_It>
+void Encoder<Rnd_It, Fwd_It>::set_max_concurrency (const uint16_t max_threads)
+    { return _encoder.set_max_concurrency (max_threads); }
+
+template <typename Rnd_It, typename Fwd_It>
+Stats Encoder<Rnd_It, Fwd_It>::stats() const
+    { return _encoder.stats(); }
+
 #if __cplusplus >= 201103L
 template <typename Rnd_It, typename Fwd_It>
 std::shared_future<Error> Encoder<Rnd_It, Fwd_It>::precompute()
@@ -363,6 +384,18 @@ template <typename In_It, typename Fwd_It>
 void Decoder<In_It, Fwd_It>::set_max_concurrency (const uint16_t max_threads)
     { return _decoder.set_max_concurrency (max_threads); }
 
+template <typename In_It, typename Fwd_It>
+void Decoder<In_It, Fwd_It>::set_pivot (const Pivot strategy)
+    { return _decoder.set_pivot (strategy); }
+
+template <typename In_It, typename Fwd_It>
+uint16_t Decoder<In_It, Fwd_It>::inactivated() const
+    { return _decoder.inactivated(); }
+
+template <typename In_It, typename Fwd_It>
+Stats Decoder<In_It, Fwd_It>::stats() const
+    { return _decoder.stats(); }
+
 template <typename In_It, typename Fwd_It>
 Decoder_Result Decoder<In_It, Fwd_It>::decode_once()
     { return _decoder.decode_once(); }
@@ -376,6 +376,49 @@ bool Encoder_void::compute_sync()
     return false;
 }
 
+void Encoder_void::set_max_concurrency (const uint16_t max_threads)
+{
+    const cast_enc _enc (_encoder);
+    switch (_type) {
+    case RaptorQ_type::RQ_ENC_8:
+        return _enc._8->set_max_concurrency (max_threads);
+    case RaptorQ_type::RQ_ENC_16:
+        return _enc._16->set_max_concurrency (max_threads);
+    case RaptorQ_type::RQ_ENC_32:
+        return _enc._32->set_max_concurrency (max_threads);
+    case RaptorQ_type::RQ_ENC_64:
+        return _enc._64->set_max_concurrency (max_threads);
+    case RaptorQ_type::RQ_DEC_8:
+    case RaptorQ_type::RQ_DEC_16:
+    case RaptorQ_type::RQ_DEC_32:
+    case RaptorQ_type::RQ_DEC_64:
+    case RaptorQ_type::RQ_NONE:
+        break;
+    }
+}
+
+Stats Encoder_void::stats() const
+{
+    const cast_enc _enc (_encoder);
+    switch (_type) {
+    case RaptorQ_type::RQ_ENC_8:
+        return _enc._8->stats();
+    case RaptorQ_type::RQ_ENC_16:
+        return _enc._16->stats();
+    case RaptorQ_type::RQ_ENC_32:
+        return _enc._32->stats();
+    case RaptorQ_type::RQ_ENC_64:
+        return _enc._64->stats();
+    case RaptorQ_type::RQ_DEC_8:
+    case RaptorQ_type::RQ_DEC_16:
+    case RaptorQ_type::RQ_DEC_32:
+    case RaptorQ_type::RQ_DEC_64:
+    case RaptorQ_type::RQ_NONE:
+        break;
+    }
+    return Stats();
+}
+
 std::shared_future<Error> Encoder_void::precompute()
 {
     const cast_enc _enc (_encoder);
@@ -798,6 +841,71 @@ void Decoder_void::set_max_concurrency (const uint16_t max_threads)
     }
 }
 
+void Decoder_void::set_pivot (const Pivot strategy)
+{
+    const cast_dec _dec (_decoder);
+    switch (_type) {
+    case RaptorQ_type::RQ_DEC_8:
+        return _dec._8->set_pivot (strategy);
+    case RaptorQ_type::RQ_DEC_16:
+        return _dec._16->set_pivot (strategy);
+    case RaptorQ_type::RQ_DEC_32:
+        return _dec._32->set_pivot (strategy);
+    case RaptorQ_type::RQ_DEC_64:
+        return _dec._64->set_pivot (strategy);
+    case RaptorQ_type::RQ_ENC_8:
+    case RaptorQ_type::RQ_ENC_16:
+    case RaptorQ_type::RQ_ENC_32:
+    case RaptorQ_type::RQ_ENC_64:
+    case RaptorQ_type::RQ_NONE:
+        break;
+    }
+}
+
+uint16_t Decoder_void::inactivated() const
+{
+    const cast_dec _dec (_decoder);
+    switch (_type) {
+    case RaptorQ_type::RQ_DEC_8:
+        return _dec._8->inactivated();
+    case RaptorQ_type::RQ_DEC_16:
+        return _dec._16->inactivated();
+    case RaptorQ_type::RQ_DEC_32:
+        return _dec._32->inactivated();
+    case RaptorQ_type::RQ_DEC_64:
+        return _dec._64->inactivated();
+    case RaptorQ_type::RQ_ENC_8:
+    case RaptorQ_type::RQ_ENC_16:
+    case RaptorQ_type::RQ_ENC_32:
+    case RaptorQ_type::RQ_ENC_64:
+    case RaptorQ_type::RQ_NONE:
+        break;
+    }
+    return 0;
+}
+
+Stats Decoder_void::stats() const
+{
+    const cast_dec _dec (_decoder);
+    switch (_type) {
+    case RaptorQ_type::RQ_DEC_8:
+        return _dec._8->stats();
+    case RaptorQ_type::RQ_DEC_16:
+        return _dec._16->stats();
+    case RaptorQ_type::RQ_DEC_32:
+        return _dec._32->stats();
+    case RaptorQ_type::RQ_DEC_64:
+        return _dec._64->stats();
+    case RaptorQ_type::RQ_ENC_8:
+    case RaptorQ_type::RQ_ENC_16:
+    case RaptorQ_type::RQ_ENC_32:
+    case RaptorQ_type::RQ_ENC_64:
+    case RaptorQ_type::RQ_NONE:
+        break;
+    }
+    return Stats();
+}
+
 Decoder_Result Decoder_void::decode_once()
 {
     const cast_dec _dec (_decoder);
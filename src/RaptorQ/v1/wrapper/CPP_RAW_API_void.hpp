@@ -22,6 +22,7 @@
 
 #include "RaptorQ/v1/block_sizes.hpp"
 #include "RaptorQ/v1/common.hpp"
+#include "RaptorQ/v1/stats.hpp"
 #include "RaptorQ/v1/wrapper/C_common.h"
 #include <vector>
 #if __cplusplus >= 201103L || _MSC_VER > 1900
@@ -76,6 +77,8 @@ public:
     std::shared_future<Error> precompute();
     std::shared_future<Error> compute();
     #endif
+    void set_max_concurrency (const uint16_t max_threads);
+    Stats stats() const;
 
     // void* will be casted to the right type depending on RaptorQ_type
     size_t encode (void** output, const void* end, const uint32_t id);
@@ -112,6 +115,12 @@ public:
     uint16_t needed_symbols() const;
 
     void set_max_concurrency (const uint16_t max_threads);
+    // how the rows are chosen while decoding. default: Pivot::RFC
+    void set_pivot (const Pivot strategy);
+    // inactivated columns ("u") of the last decoding.
+    // 0 if the operations came from the cache.
+    uint16_t inactivated() const;
+    Stats stats() const;
     Decoder_Result decode_once();
 
     struct Decoder_wait_res poll();
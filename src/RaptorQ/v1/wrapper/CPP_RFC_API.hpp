@@ -52,6 +52,10 @@ public:
                                             const uint16_t min_subsymbol_size,
                                             const uint16_t symbol_size,
                                             const size_t max_sub_block);
+    // streaming: give the data of each block later, with feed()
+    Encoder (const uint64_t size, const uint16_t min_subsymbol_size,
+                                            const uint16_t symbol_size,
+                                            const size_t max_sub_block);
     Encoder() = delete;
     Encoder (const Encoder&) = delete;
     Encoder& operator= (const Encoder&) = delete;
@@ -74,6 +78,14 @@ public:
     size_t encode (Fwd_It &output, const Fwd_It end, const uint32_t esi,
                                                             const uint8_t sbn);
     size_t encode (Fwd_It &output, const Fwd_It end, const uint32_t id);
+    size_t encode_packets (const Packet_Range *ranges, const size_t n_ranges,
+                                                uint8_t *buffer,
+                                                const size_t buffer_size,
+                                                Packet *packets,
+                                                const size_t max_packets);
+    size_t packet_stride() const;
+    Error feed (const uint8_t sbn, const Rnd_It from, const Rnd_It to,
+                                                const uint32_t repair_budget);
     void free (const uint8_t sbn);
     uint8_t blocks() const;
     uint32_t block_size (const uint8_t sbn) const;
@@ -81,6 +93,9 @@ public:
     uint16_t symbols (const uint8_t sbn) const;
     Block_Size extended_symbols (const uint8_t sbn) const;
     uint32_t max_repair (const uint8_t sbn) const;
+    // the last computation of block "sbn". All zeros if there was none,
+    // or if the block was freed.
+    Stats stats (const uint8_t sbn) const;
 private:
     Impl::Encoder_void _encoder;
 };
@@ -139,6 +154,15 @@ public:
     Error add_symbol (In_It &start, const In_It end, const uint32_t id);
     Error add_symbol (In_It &start, const In_It end, const uint32_t esi,
                                                             const uint8_t sbn);
+    // many RFC packets at once. "status" (optional) gets one result
+    // per packet. returns the number of packets with useful symbols.
+    size_t add_packets (const Packet *packets, const size_t n,
+                                                            Error *status);
+    // give each decoded block to "sink" in order, then free it.
+    // at most "max_blocks" blocks are decoded at the same time: symbols
+    // of the blocks after those get Error::OUT_OF_WINDOW.
+    Error stream (const Block_Sink sink, void *user_data,
+                                                    const uint8_t max_blocks);
     uint8_t blocks_ready();
     bool is_ready();
     bool is_block_ready (const uint8_t block);
@@ -149,6 +173,9 @@ public:
     uint16_t symbol_size() const;
     uint16_t symbols (const uint8_t sbn) const;
     Block_Size extended_symbols (const uint8_t sbn) const;
+    // the last decoding of block "sbn". All zeros if there was none,
+    // or if the block was freed.
+    Stats stats (const uint8_t sbn) const;
 private:
     Impl::Decoder_void _decoder;
 };
@@ -199,6 +226,42 @@ inline Encoder<uint64_t*, uint64_t*>::Encoder (uint64_t* const data_from,
                                                     symbol_size, max_sub_block)
     {}
 
+template <>
+inline Encoder<uint8_t*, uint8_t*>::Encoder (const uint64_t size,
+                                            const uint16_t min_subsymbol_size,
+                                            const uint16_t symbol_size,
+                                            const size_t max_sub_block)
+    : _encoder (RaptorQ_type::RQ_ENC_8, size, min_subsymbol_size, symbol_size,
+                                                                max_sub_block)
+    {}
+
+template <>
+inline Encoder<uint16_t*, uint16_t*>::Encoder (const uint64_t size,
+                                            const uint16_t min_subsymbol_size,
+                                            const uint16_t symbol_size,
+                                            const size_t max_sub_block)
+    : _encoder (RaptorQ_type::RQ_ENC_16, size, min_subsymbol_size, symbol_size,
+                                                                max_sub_block)
+    {}
+
+template <>
+inline Encoder<uint32_t*, uint32_t*>::Encoder (const uint64_t size,
+                                            const uint16_t min_subsymbol_size,
+                                            const uint16_t symbol_size,
+                                            const size_t max_sub_block)
+    : _encoder (RaptorQ_type::RQ_ENC_32, size, min_subsymbol_size, symbol_size,
+                                                                max_sub_block)
+    {}
+
+template <>
+inline Encoder<uint64_t*, uint64_t*>::Encoder (const uint64_t size,
+                                            const uint16_t min_subsymbol_size,
+                                            const uint16_t symbol_size,
+                                            const size_t max_sub_block)
+    : _encoder (RaptorQ_type::RQ_ENC_64, size, min_subsymbol_size, symbol_size,
+                                                                max_sub_block)
+    {}
+
 template <typename Rnd_It, typename Fwd_It>
 inline Encoder<Rnd_It, Fwd_It>::~Encoder()
     {}
@@ -262,6 +325,33 @@ inline size_t Encoder<Rnd_It, Fwd_It>::encode (Fwd_It &output, const Fwd_It end,
     return ret;
 }
 
+template <typename Rnd_It, typename Fwd_It>
+inline size_t Encoder<Rnd_It, Fwd_It>::encode_packets (
+                                                const Packet_Range *ranges,
+                                                const size_t n_ranges,
+                                                uint8_t *buffer,
+                                                const size_t buffer_size,
+                                                Packet *packets,
+                                                const size_t max_packets)
+{
+    return _encoder.encode_packets (ranges, n_ranges, buffer, buffer_size,
+                                                        packets, max_packets);
+}
+
+template <typename Rnd_It, typename Fwd_It>
+inline size_t Encoder<Rnd_It, Fwd_It>::packet_stride() const
+    { return _encoder.packet_stride(); }
+
+template <typename Rnd_It, typename Fwd_It>
+inline Error Encoder<Rnd_It, Fwd_It>::feed (const uint8_t sbn,
+                                                const Rnd_It from,
+                                                const Rnd_It to,
+                                                const uint32_t repair_budget)
+{
+    return _encoder.feed (sbn, reinterpret_cast<void*> (from),
+                                reinterpret_cast<void*> (to), repair_budget);
+}
+
 template <typename Rnd_It, typename Fwd_It>
 inline void Encoder<Rnd_It, Fwd_It>::free (const uint8_t sbn)
     { return _encoder.free (sbn); }
@@ -291,6 +381,10 @@ template <typename Rnd_It, typename Fwd_It>
 inline uint32_t Encoder<Rnd_It, Fwd_It>::max_repair (const uint8_t sbn) const
     { return _encoder.max_repair (sbn); }
 
+template <typename Rnd_It, typename Fwd_It>
+inline Stats Encoder<Rnd_It, Fwd_It>::stats (const uint8_t sbn) const
+    { return _encoder.stats (sbn); }
+
 
 
 ////////////////////
@@ -500,6 +594,18 @@ inline Error Decoder<In_It, Fwd_It>::add_symbol (In_It &start, const In_It end,
     return ret;
 }
 
+template <typename In_It, typename Fwd_It>
+inline size_t Decoder<In_It, Fwd_It>::add_packets (const Packet *packets,
+                                                            const size_t n,
+                                                            Error *status)
+    { return _decoder.add_packets (packets, n, status); }
+
+template <typename In_It, typename Fwd_It>
+inline Error Decoder<In_It, Fwd_It>::stream (const Block_Sink sink,
+                                                    void *user_data,
+                                                    const uint8_t max_blocks)
+    { return _decoder.stream (sink, user_data, max_blocks); }
+
 template <typename In_It, typename Fwd_It>
 inline uint8_t Decoder<In_It, Fwd_It>::blocks_ready()
     { return _decoder.blocks_ready(); }
@@ -541,5 +647,9 @@ inline Block_Size Decoder<In_It, Fwd_It>::extended_symbols (const uint8_t sbn)
                                                                         const
     { return _decoder.extended_symbols (sbn); }
 
+template <typename In_It, typename Fwd_It>
+inline Stats Decoder<In_It, Fwd_It>::stats (const uint8_t sbn) const
+    { return _decoder.stats (sbn); }
+
 
 }   // namespace RFC6330__v1
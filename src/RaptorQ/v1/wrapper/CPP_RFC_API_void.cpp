@@ -157,6 +157,39 @@ Encoder_void::Encoder_void (const RaptorQ_type type, const void* data_from,
     }
 }
 
+Encoder_void::Encoder_void (const RaptorQ_type type, const uint64_t size,
+                                            const uint16_t min_subsymbol_size,
+                                            const uint16_t symbol_size,
+                                            const size_t max_sub_block)
+    : _type (init_t (type, true))
+{
+    _encoder = nullptr;
+    switch (_type) {
+    case RaptorQ_type::RQ_ENC_8:
+        _encoder = new Impl::Encoder<uint8_t*, uint8_t*> (size,
+                                min_subsymbol_size, symbol_size, max_sub_block);
+        break;
+    case RaptorQ_type::RQ_ENC_16:
+        _encoder = new Impl::Encoder<uint16_t*, uint16_t*> (size,
+                                min_subsymbol_size, symbol_size, max_sub_block);
+        break;
+    case RaptorQ_type::RQ_ENC_32:
+        _encoder = new Impl::Encoder<uint32_t*, uint32_t*> (size,
+                                min_subsymbol_size, symbol_size, max_sub_block);
+        break;
+    case RaptorQ_type::RQ_ENC_64:
+        _encoder = new Impl::Encoder<uint64_t*, uint64_t*> (size,
+                                min_subsymbol_size, symbol_size, max_sub_block);
+        break;
+    case RaptorQ_type::RQ_DEC_8:
+    case RaptorQ_type::RQ_DEC_16:
+    case RaptorQ_type::RQ_DEC_32:
+    case RaptorQ_type::RQ_DEC_64:
+    case RaptorQ_type::RQ_NONE:
+        break;
+    }
+}
+
 Encoder_void::operator bool() const
 {
     const cast_enc _enc (_encoder);
@@ -278,6 +311,59 @@ std::future<std::pair<Error, uint8_t>> Encoder_void::compute (
     return p.get_future();
 }
 
+size_t Encoder_void::encode_packets (const Packet_Range *ranges,
+                                                const size_t n_ranges,
+                                                uint8_t *buffer,
+                                                const size_t buffer_size,
+                                                Packet *packets,
+                                                const size_t max_packets)
+{
+    const cast_enc _enc (_encoder);
+    switch (_type) {
+    case RaptorQ_type::RQ_ENC_8:
+        return _enc._8->encode_packets (ranges, n_ranges, buffer,
+                                    buffer_size, packets, max_packets);
+    case RaptorQ_type::RQ_ENC_16:
+        return _enc._16->encode_packets (ranges, n_ranges, buffer,
+                                    buffer_size, packets, max_packets);
+    case RaptorQ_type::RQ_ENC_32:
+        return _enc._32->encode_packets (ranges, n_ranges, buffer,
+                                    buffer_size, packets, max_packets);
+    case RaptorQ_type::RQ_ENC_64:
+        return _enc._64->encode_packets (ranges, n_ranges, buffer,
+                                    buffer_size, packets, max_packets);
+    case RaptorQ_type::RQ_DEC_8:
+    case RaptorQ_type::RQ_DEC_16:
+    case RaptorQ_type::RQ_DEC_32:
+    case RaptorQ_type::RQ_DEC_64:
+    case RaptorQ_type::RQ_NONE:
+        break;
+    }
+    return 0;
+}
+
+size_t Encoder_void::packet_stride() const
+{
+    const cast_enc _enc (_encoder);
+    switch (_type) {
+    case RaptorQ_type::RQ_ENC_8:
+        return _enc._8->packet_stride();
+    case RaptorQ_type::RQ_ENC_16:
+        return _enc._16->packet_stride();
+    case RaptorQ_type::RQ_ENC_32:
+        return _enc._32->packet_stride();
+    case RaptorQ_type::RQ_ENC_64:
+        return _enc._64->packet_stride();
+    case RaptorQ_type::RQ_DEC_8:
+    case RaptorQ_type::RQ_DEC_16:
+    case RaptorQ_type::RQ_DEC_32:
+    case RaptorQ_type::RQ_DEC_64:
+    case RaptorQ_type::RQ_NONE:
+        break;
+    }
+    return 0;
+}
+
 size_t Encoder_void::precompute_max_memory ()
 {
     const cast_enc _enc (_encoder);
@@ -406,6 +492,43 @@ size_t Encoder_void::encode (void** output, const void* end, const uint32_t id)
     return ret;
 }
 
+Error Encoder_void::feed (const uint8_t sbn, const void* from, const void* to,
+                                                const uint32_t repair_budget)
+{
+    const cast_enc _enc (_encoder);
+    if (from == nullptr || to == nullptr)
+        return Error::WRONG_INPUT;
+    switch (_type) {
+    case RaptorQ_type::RQ_ENC_8:
+        return _enc._8->feed (sbn,
+                        reinterpret_cast<uint8_t*> (const_cast<void*> (from)),
+                        reinterpret_cast<uint8_t*> (const_cast<void*> (to)),
+                                                                repair_budget);
+    case RaptorQ_type::RQ_ENC_16:
+        return _enc._16->feed (sbn,
+                        reinterpret_cast<uint16_t*> (const_cast<void*> (from)),
+                        reinterpret_cast<uint16_t*> (const_cast<void*> (to)),
+                                                                repair_budget);
+    case RaptorQ_type::RQ_ENC_32:
+        return _enc._32->feed (sbn,
+                        reinterpret_cast<uint32_t*> (const_cast<void*> (from)),
+                        reinterpret_cast<uint32_t*> (const_cast<void*> (to)),
+                                                                repair_budget);
+    case RaptorQ_type::RQ_ENC_64:
+        return _enc._64->feed (sbn,
+                        reinterpret_cast<uint64_t*> (const_cast<void*> (from)),
+                        reinterpret_cast<uint64_t*> (const_cast<void*> (to)),
+                                                                repair_budget);
+    case RaptorQ_type::RQ_DEC_8:
+    case RaptorQ_type::RQ_DEC_16:
+    case RaptorQ_type::RQ_DEC_32:
+    case RaptorQ_type::RQ_DEC_64:
+    case RaptorQ_type::RQ_NONE:
+        break;
+    }
+    return Error::INITIALIZATION;
+}
+
 void Encoder_void::free (const uint8_t sbn)
 {
     const cast_enc _enc (_encoder);
@@ -559,6 +682,28 @@ uint32_t Encoder_void::max_repair (const uint8_t sbn) const
     return 0;
 }
 
+Stats Encoder_void::stats (const uint8_t sbn) const
+{
+    const cast_enc _enc (_encoder);
+    switch (_type) {
+    case RaptorQ_type::RQ_ENC_8:
+        return _enc._8->stats (sbn);
+    case RaptorQ_type::RQ_ENC_16:
+        return _enc._16->stats (sbn);
+    case RaptorQ_type::RQ_ENC_32:
+        return _enc._32->stats (sbn);
+    case RaptorQ_type::RQ_ENC_64:
+        return _enc._64->stats (sbn);
+    case RaptorQ_type::RQ_DEC_8:
+    case RaptorQ_type::RQ_DEC_16:
+    case RaptorQ_type::RQ_DEC_32:
+    case RaptorQ_type::RQ_DEC_64:
+    case RaptorQ_type::RQ_NONE:
+        break;
+    }
+    return Stats();
+}
+
 ////////////////////
 //// Decoder
 ////////////////////
@@ -1087,6 +1232,54 @@ Error Decoder_void::add_symbol (void** start, const void* end,
     return err;
 }
 
+size_t Decoder_void::add_packets (const Packet *packets, const size_t n,
+                                                            Error *status)
+{
+    const cast_dec _dec (_decoder);
+    switch (_type) {
+    case RaptorQ_type::RQ_DEC_8:
+        return _dec._8->add_packets (packets, n, status);
+    case RaptorQ_type::RQ_DEC_16:
+        return _dec._16->add_packets (packets, n, status);
+    case RaptorQ_type::RQ_DEC_32:
+        return _dec._32->add_packets (packets, n, status);
+    case RaptorQ_type::RQ_DEC_64:
+        return _dec._64->add_packets (packets, n, status);
+    case RaptorQ_type::RQ_ENC_8:
+    case RaptorQ_type::RQ_ENC_16:
+    case RaptorQ_type::RQ_ENC_32:
+    case RaptorQ_type::RQ_ENC_64:
+    case RaptorQ_type::RQ_NONE:
+        break;
+    }
+    for (size_t idx = 0; status != nullptr && idx < n; ++idx)
+        status[idx] = Error::INITIALIZATION;
+    return 0;
+}
+
+Error Decoder_void::stream (const Block_Sink sink, void *user_data,
+                                                    const uint8_t max_blocks)
+{
+    const cast_dec _dec (_decoder);
+    switch (_type) {
+    case RaptorQ_type::RQ_DEC_8:
+        return _dec._8->stream (sink, user_data, max_blocks);
+    case RaptorQ_type::RQ_DEC_16:
+        return _dec._16->stream (sink, user_data, max_blocks);
+    case RaptorQ_type::RQ_DEC_32:
+        return _dec._32->stream (sink, user_data, max_blocks);
+    case RaptorQ_type::RQ_DEC_64:
+        return _dec._64->stream (sink, user_data, max_blocks);
+    case RaptorQ_type::RQ_ENC_8:
+    case RaptorQ_type::RQ_ENC_16:
+    case RaptorQ_type::RQ_ENC_32:
+    case RaptorQ_type::RQ_ENC_64:
+    case RaptorQ_type::RQ_NONE:
+        break;
+    }
+    return Error::INITIALIZATION;
+}
+
 uint8_t Decoder_void::blocks_ready ()
 {
     const cast_dec _dec (_decoder);
@@ -1306,5 +1499,27 @@ Block_Size Decoder_void::extended_symbols (const uint8_t sbn) const
     return static_cast<Block_Size> (0);
 }
 
+Stats Decoder_void::stats (const uint8_t sbn) const
+{
+    const cast_dec _dec (_decoder);
+    switch (_type) {
+    case RaptorQ_type::RQ_DEC_8:
+        return _dec._8->stats (sbn);
+    case RaptorQ_type::RQ_DEC_16:
+        return _dec._16->stats (sbn);
+    case RaptorQ_type::RQ_DEC_32:
+        return _dec._32->stats (sbn);
+    case RaptorQ_type::RQ_DEC_64:
+        return _dec._64->stats (sbn);
+    case RaptorQ_type::RQ_ENC_8:
+    case RaptorQ_type::RQ_ENC_16:
+    case RaptorQ_type::RQ_ENC_32:
+    case RaptorQ_type::RQ_ENC_64:
+    case RaptorQ_type::RQ_NONE:
+        break;
+    }
+    return Stats();
+}
+
 } // namespace Impl
 } // namespace RFC6330__v1
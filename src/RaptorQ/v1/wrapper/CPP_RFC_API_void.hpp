@@ -23,6 +23,7 @@
 #include "RaptorQ/v1/common.hpp"
 #include "RaptorQ/v1/wrapper/C_common.h"
 #include "RaptorQ/v1/block_sizes.hpp"
+#include "RaptorQ/v1/stats.hpp"
 #include <vector>
 #if __cplusplus >= 201103L || _MSC_VER > 1900
 #include <future>
@@ -53,6 +54,10 @@ public:
                                             const uint16_t min_subsymbol_size,
                                             const uint16_t symbol_size,
                                             const size_t max_sub_block);
+    Encoder_void (const RaptorQ_type type, const uint64_t size,
+                                            const uint16_t min_subsymbol_size,
+                                            const uint16_t symbol_size,
+                                            const size_t max_sub_block);
     Encoder_void() = delete;
     Encoder_void (const Encoder_void&) = delete;
     Encoder_void& operator= (const Encoder_void&) = delete;
@@ -80,6 +85,14 @@ public:
     size_t encode (void** output, const void* end, const uint32_t esi,
                                                             const uint8_t sbn);
     size_t encode (void** output, const void* end, const uint32_t id);
+    size_t encode_packets (const Packet_Range *ranges, const size_t n_ranges,
+                                                uint8_t *buffer,
+                                                const size_t buffer_size,
+                                                Packet *packets,
+                                                const size_t max_packets);
+    size_t packet_stride() const;
+    Error feed (const uint8_t sbn, const void* from, const void* to,
+                                                const uint32_t repair_budget);
     void free (const uint8_t sbn);
     uint8_t blocks() const;
     uint32_t block_size (const uint8_t sbn) const;
@@ -87,6 +100,7 @@ public:
     uint16_t symbols (const uint8_t sbn) const;
     Block_Size extended_symbols (const uint8_t sbn) const;
     uint32_t max_repair (const uint8_t sbn) const;
+    Stats stats (const uint8_t sbn) const;
 private:
     RaptorQ_type _type;
     void *_encoder;
@@ -138,6 +152,14 @@ public:
     Error add_symbol (void** start, const void* end, const uint32_t id);
     Error add_symbol (void** start, const void* end, const uint32_t esi,
                                                             const uint8_t sbn);
+    // many RFC packets at once. "status" (optional) gets one result
+    // per packet. returns the number of packets with useful symbols.
+    size_t add_packets (const Packet *packets, const size_t n,
+                                                            Error *status);
+    // give each decoded block to "sink" in order, then free it.
+    // at most "max_blocks" blocks are decoded at the same time.
+    Error stream (const Block_Sink sink, void *user_data,
+                                                    const uint8_t max_blocks);
     uint8_t blocks_ready();
     bool is_ready();
     bool is_block_ready (const uint8_t block);
@@ -148,6 +170,7 @@ public:
     uint16_t symbol_size() const;
     uint16_t symbols (const uint8_t sbn) const;
     Block_Size extended_symbols (const uint8_t sbn) const;
+    Stats stats (const uint8_t sbn) const;
 private:
     RaptorQ_type _type;
     void *_decoder;
@@ -21,7 +21,10 @@
 
 #include "RaptorQ/v1/wrapper/C_RAW_API.h"
 #include "RaptorQ/v1/RaptorQ.hpp"
+#include <algorithm>
+#include <cstring>
 #include <future>
+#include <string>
 #include <utility>
 
 struct RAPTORQ_LOCAL RaptorQ_ptr
@@ -136,6 +139,26 @@ static RaptorQ_Dec_Written v1_decode_bytes (struct RaptorQ_ptr *dec,
                                                         const size_t size,
                                                         const size_t from_byte,
                                                         const size_t skip);
+static size_t v1_encode_symbols (const struct RaptorQ_ptr *enc, void *output,
+                                                        const size_t size,
+                                                        const uint32_t *esi,
+                                                        const size_t n);
+static size_t v1_add_symbols (const struct RaptorQ_ptr *dec, const void *data,
+                                                        const size_t size,
+                                                        const uint32_t *esi,
+                                                        const size_t n);
+static size_t v1_decode_range (const struct RaptorQ_ptr *dec, void *output,
+                                                        const size_t size,
+                                                        const size_t from_byte);
+static void v1_set_pivot (const struct RaptorQ_ptr *dec,
+                                                const RaptorQ_Pivot strategy);
+static uint16_t v1_inactivated (const struct RaptorQ_ptr *dec);
+static struct RaptorQ_Stats v1_stats (const struct RaptorQ_ptr *ptr);
+static bool v1_stats_summary (const RaptorQ_Stats_Source source,
+                                        struct RaptorQ_Stats_Summary *summary);
+static void v1_stats_reset (void);
+static bool v1_metrics (struct RaptorQ_Metrics *metrics);
+static size_t v1_metrics_prometheus (char *out, const size_t size);
 
 
 void RaptorQ_free_api (struct RaptorQ_base_api **api)
@@ -204,7 +227,17 @@ RaptorQ_v1::RaptorQ_v1()
     end_of_input (&v1_end_of_input),
     decode_once (&v1_decode_once),
     decode_symbol (&v1_decode_symbol),
-    decode_bytes (&v1_decode_bytes)
+    decode_bytes (&v1_decode_bytes),
+    encode_symbols (&v1_encode_symbols),
+    add_symbols (&v1_add_symbols),
+    decode_range (&v1_decode_range),
+    set_pivot (&v1_set_pivot),
+    inactivated (&v1_inactivated),
+    stats (&v1_stats),
+    stats_summary (&v1_stats_summary),
+    stats_reset (&v1_stats_reset),
+    metrics (&v1_metrics),
+    metrics_prometheus (&v1_metrics_prometheus)
 {}
 
 ///////////////////////////
@@ -1536,3 +1569,270 @@ static RaptorQ_Dec_Written v1_decode_bytes (struct RaptorQ_ptr *dec,
     }
     return {out.written, out.offset};
 }
+
+static size_t v1_encode_symbols (const struct RaptorQ_ptr *enc, void *output,
+                                                        const size_t size,
+                                                        const uint32_t *esi,
+                                                        const size_t n)
+{
+    if (enc == nullptr || enc->ptr == nullptr || output == nullptr ||
+                                                            esi == nullptr) {
+        return 0;
+    }
+    uint8_t *out = reinterpret_cast<uint8_t*> (output);
+    // the type is only checked once for the whole batch
+    switch (enc->type) {
+    case RaptorQ_type::RQ_ENC_8:
+        return (reinterpret_cast<RaptorQ__v1::Impl::Encoder<uint8_t*,
+                                                        uint8_t*>*> (
+                            enc->ptr))->encode_symbols (out, size, esi, n);
+    case RaptorQ_type::RQ_ENC_16:
+        return (reinterpret_cast<RaptorQ__v1::Impl::Encoder<uint16_t*,
+                                                        uint16_t*>*> (
+                            enc->ptr))->encode_symbols (out, size, esi, n);
+    case RaptorQ_type::RQ_ENC_32:
+        return (reinterpret_cast<RaptorQ__v1::Impl::Encoder<uint32_t*,
+                                                        uint32_t*>*> (
+                            enc->ptr))->encode_symbols (out, size, esi, n);
+    case RaptorQ_type::RQ_ENC_64:
+        return (reinterpret_cast<RaptorQ__v1::Impl::Encoder<uint64_t*,
+                                                        uint64_t*>*> (
+                            enc->ptr))->encode_symbols (out, size, esi, n);
+    case RaptorQ_type::RQ_DEC_8:
+    case RaptorQ_type::RQ_DEC_16:
+    case RaptorQ_type::RQ_DEC_32:
+    case RaptorQ_type::RQ_DEC_64:
+    case RaptorQ_type::RQ_NONE:
+        break;
+    }
+    return 0;
+}
+
+static size_t v1_add_symbols (const struct RaptorQ_ptr *dec, const void *data,
+                                                        const size_t size,
+                                                        const uint32_t *esi,
+                                                        const size_t n)
+{
+    if (dec == nullptr || dec->ptr == nullptr || data == nullptr ||
+                                                            esi == nullptr) {
+        return 0;
+    }
+    const uint8_t *in = reinterpret_cast<const uint8_t*> (data);
+    switch (dec->type) {
+    case RaptorQ_type::RQ_DEC_8:
+        return (reinterpret_cast<RaptorQ__v1::Impl::Decoder<uint8_t*,
+                                                        uint8_t*>*> (
+                                dec->ptr))->add_symbols (in, size, esi, n);
+    case RaptorQ_type::RQ_DEC_16:
+        return (reinterpret_cast<RaptorQ__v1::Impl::Decoder<uint16_t*,
+                                                        uint16_t*>*> (
+                                dec->ptr))->add_symbols (in, size, esi, n);
+    case RaptorQ_type::RQ_DEC_32:
+        return (reinterpret_cast<RaptorQ__v1::Impl::Decoder<uint32_t*,
+                                                        uint32_t*>*> (
+                                dec->ptr))->add_symbols (in, size, esi, n);
+    case RaptorQ_type::RQ_DEC_64:
+        return (reinterpret_cast<RaptorQ__v1::Impl::Decoder<uint64_t*,
+                                                        uint64_t*>*> (
+                                dec->ptr))->add_symbols (in, size, esi, n);
+    case RaptorQ_type::RQ_ENC_8:
+    case RaptorQ_type::RQ_ENC_16:
+    case RaptorQ_type::RQ_ENC_32:
+    case RaptorQ_type::RQ_ENC_64:
+    case RaptorQ_type::RQ_NONE:
+        break;
+    }
+    return 0;
+}
+
+static size_t v1_decode_range (const struct RaptorQ_ptr *dec, void *output,
+                                                        const size_t size,
+                                                        const size_t from_byte)
+{
+    if (dec == nullptr || dec->ptr == nullptr || output == nullptr)
+        return 0;
+    uint8_t *out = reinterpret_cast<uint8_t*> (output);
+    switch (dec->type) {
+    case RaptorQ_type::RQ_DEC_8:
+        return (reinterpret_cast<RaptorQ__v1::Impl::Decoder<uint8_t*,
+                                                        uint8_t*>*> (
+                            dec->ptr))->decode_range (out, size, from_byte);
+    case RaptorQ_type::RQ_DEC_16:
+        return (reinterpret_cast<RaptorQ__v1::Impl::Decoder<uint16_t*,
+                                                        uint16_t*>*> (
+                            dec->ptr))->decode_range (out, size, from_byte);
+    case RaptorQ_type::RQ_DEC_32:
+        return (reinterpret_cast<RaptorQ__v1::Impl::Decoder<uint32_t*,
+                                                        uint32_t*>*> (
+                            dec->ptr))->decode_range (out, size, from_byte);
+    case RaptorQ_type::RQ_DEC_64:
+        return (reinterpret_cast<RaptorQ__v1::Impl::Decoder<uint64_t*,
+                                                        uint64_t*>*> (
+                            dec->ptr))->decode_range (out, size, from_byte);
+    case RaptorQ_type::RQ_ENC_8:
+    case RaptorQ_type::RQ_ENC_16:
+    case RaptorQ_type::RQ_ENC_32:
+    case RaptorQ_type::RQ_ENC_64:
+    case RaptorQ_type::RQ_NONE:
+        break;
+    }
+    return 0;
+}
+
+static void v1_set_pivot (const struct RaptorQ_ptr *dec,
+                                                const RaptorQ_Pivot strategy)
+{
+    if (dec == nullptr || dec->ptr == nullptr)
+        return;
+    const auto pivot = static_cast<RaptorQ__v1::Pivot> (strategy);
+    switch (dec->type) {
+    case RaptorQ_type::RQ_DEC_8:
+        return (reinterpret_cast<RaptorQ__v1::Impl::Decoder<uint8_t*,
+                                                        uint8_t*>*> (
+                                            dec->ptr))->set_pivot (pivot);
+    case RaptorQ_type::RQ_DEC_16:
+        return (reinterpret_cast<RaptorQ__v1::Impl::Decoder<uint16_t*,
+                                                        uint16_t*>*> (
+                                            dec->ptr))->set_pivot (pivot);
+    case RaptorQ_type::RQ_DEC_32:
+        return (reinterpret_cast<RaptorQ__v1::Impl::Decoder<uint32_t*,
+                                                        uint32_t*>*> (
+                                            dec->ptr))->set_pivot (pivot);
+    case RaptorQ_type::RQ_DEC_64:
+        return (reinterpret_cast<RaptorQ__v1::Impl::Decoder<uint64_t*,
+                                                        uint64_t*>*> (
+                                            dec->ptr))->set_pivot (pivot);
+    case RaptorQ_type::RQ_ENC_8:
+    case RaptorQ_type::RQ_ENC_16:
+    case RaptorQ_type::RQ_ENC_32:
+    case RaptorQ_type::RQ_ENC_64:
+    case RaptorQ_type::RQ_NONE:
+        break;
+    }
+}
+
+static uint16_t v1_inactivated (const struct RaptorQ_ptr *dec)
+{
+    if (dec == nullptr || dec->ptr == nullptr)
+        return 0;
+    switch (dec->type) {
+    case RaptorQ_type::RQ_DEC_8:
+        return (reinterpret_cast<RaptorQ__v1::Impl::Decoder<uint8_t*,
+                                                        uint8_t*>*> (
+                                                    dec->ptr))->inactivated();
+    case RaptorQ_type::RQ_DEC_16:
+        return (reinterpret_cast<RaptorQ__v1::Impl::Decoder<uint16_t*,
+                                                        uint16_t*>*> (
+                                                    dec->ptr))->inactivated();
+    case RaptorQ_type::RQ_DEC_32:
+        return (reinterpret_cast<RaptorQ__v1::Impl::Decoder<uint32_t*,
+                                                        uint32_t*>*> (
+                                                    dec->ptr))->inactivated();
+    case RaptorQ_type::RQ_DEC_64:
+        return (reinterpret_cast<RaptorQ__v1::Impl::Decoder<uint64_t*,
+                                                        uint64_t*>*> (
+                                                    dec->ptr))->inactivated();
+    case RaptorQ_type::RQ_ENC_8:
+    case RaptorQ_type::RQ_ENC_16:
+    case RaptorQ_type::RQ_ENC_32:
+    case RaptorQ_type::RQ_ENC_64:
+    case RaptorQ_type::RQ_NONE:
+        break;
+    }
+    return 0;
+}
+
+///////////////////////////
+// Statistics
+///////////////////////////
+
+// the C structs track the C++ ones, field by field
+static_assert (sizeof(struct RaptorQ_Stats) == sizeof(RaptorQ__v1::Stats),
+                                        "RaptorQ: C and C++ Stats differ");
+static_assert (sizeof(struct RaptorQ_Stats_Summary) ==
+                                        sizeof(RaptorQ__v1::Stats_Summary),
+                                "RaptorQ: C and C++ Stats_Summary differ");
+static_assert (sizeof(struct RaptorQ_Metrics) == sizeof(RaptorQ__v1::Metrics),
+                                        "RaptorQ: C and C++ Metrics differ");
+
+static struct RaptorQ_Stats v1_stats (const struct RaptorQ_ptr *ptr)
+{
+    struct RaptorQ_Stats ret;
+    RaptorQ__v1::Stats stats;
+    if (ptr != nullptr && ptr->ptr != nullptr) {
+        switch (ptr->type) {
+        case RaptorQ_type::RQ_ENC_8:
+            stats = (reinterpret_cast<RaptorQ__v1::Impl::Encoder<uint8_t*,
+                                        uint8_t*>*> (ptr->ptr))->stats();
+            break;
+        case RaptorQ_type::RQ_ENC_16:
+            stats = (reinterpret_cast<RaptorQ__v1::Impl::Encoder<uint16_t*,
+                                        uint16_t*>*> (ptr->ptr))->stats();
+            break;
+        case RaptorQ_type::RQ_ENC_32:
+            stats = (reinterpret_cast<RaptorQ__v1::Impl::Encoder<uint32_t*,
+                                        uint32_t*>*> (ptr->ptr))->stats();
+            break;
+        case RaptorQ_type::RQ_ENC_64:
+            stats = (reinterpret_cast<RaptorQ__v1::Impl::Encoder<uint64_t*,
+                                        uint64_t*>*> (ptr->ptr))->stats();
+            break;
+        case RaptorQ_type::RQ_DEC_8:
+            stats = (reinterpret_cast<RaptorQ__v1::Impl::Decoder<uint8_t*,
+                                        uint8_t*>*> (ptr->ptr))->stats();
+            break;
+        case RaptorQ_type::RQ_DEC_16:
+            stats = (reinterpret_cast<RaptorQ__v1::Impl::Decoder<uint16_t*,
+                                        uint16_t*>*> (ptr->ptr))->stats();
+            break;
+        case RaptorQ_type::RQ_DEC_32:
+            stats = (reinterpret_cast<RaptorQ__v1::Impl::Decoder<uint32_t*,
+                                        uint32_t*>*> (ptr->ptr))->stats();
+            break;
+        case RaptorQ_type::RQ_DEC_64:
+            stats = (reinterpret_cast<RaptorQ__v1::Impl::Decoder<uint64_t*,
+                                        uint64_t*>*> (ptr->ptr))->stats();
+            break;
+        case RaptorQ_type::RQ_NONE:
+            break;
+        }
+    }
+    std::memcpy (&ret, &stats, sizeof(ret));
+    return ret;
+}
+
+static bool v1_stats_summary (const RaptorQ_Stats_Source source,
+                                        struct RaptorQ_Stats_Summary *summary)
+{
+    if (summary == nullptr || (source != RQ_STATS_ENCODER &&
+                                            source != RQ_STATS_DECODER)) {
+        return false;
+    }
+    const auto ret = RaptorQ__v1::stats_summary (
+                            static_cast<RaptorQ__v1::Stats_Source> (source));
+    std::memcpy (summary, &ret, sizeof(*summary));
+    return true;
+}
+
+static void v1_stats_reset (void)
+    { RaptorQ__v1::stats_reset(); }
+
+static bool v1_metrics (struct RaptorQ_Metrics *metrics)
+{
+    if (metrics == nullptr)
+        return false;
+    const auto ret = RaptorQ__v1::metrics();
+    std::memcpy (metrics, &ret, sizeof(*metrics));
+    return true;
+}
+
+static size_t v1_metrics_prometheus (char *out, const size_t size)
+{
+    const std::string text = RaptorQ__v1::metrics_prometheus();
+    if (out != nullptr && size > 0) {
+        const size_t len = std::min (size - 1, text.size());
+        std::memcpy (out, text.data(), len);
+        out[len] = '\0';
+    }
+    return text.size();
+}
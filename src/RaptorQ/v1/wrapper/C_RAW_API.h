@@ -159,6 +159,43 @@ extern "C"
                                                         const size_t from_byte,
                                                         const size_t skip);
 
+        // batched calls: symbols are back to back, "size" is in bytes.
+        // return the number of symbols (or bytes) handled.
+        size_t (*const encode_symbols) (const struct RaptorQ_ptr *enc,
+                                                        void *output,
+                                                        const size_t size,
+                                                        const uint32_t *esi,
+                                                        const size_t n);
+        size_t (*const add_symbols) (const struct RaptorQ_ptr *dec,
+                                                        const void *data,
+                                                        const size_t size,
+                                                        const uint32_t *esi,
+                                                        const size_t n);
+        size_t (*const decode_range) (const struct RaptorQ_ptr *dec,
+                                                        void *output,
+                                                        const size_t size,
+                                                        const size_t from_byte);
+
+        // how the decoder chooses its rows (default: RQ_PIVOT_RFC), and the
+        // inactivated columns ("u") of its last decoding. 0 if the
+        // operations came from the cache.
+        void (*const set_pivot) (const struct RaptorQ_ptr *dec,
+                                                const RaptorQ_Pivot strategy);
+        uint16_t (*const inactivated) (const struct RaptorQ_ptr *dec);
+
+        // timings, cache usage and sizes of the last computation of an
+        // encoder or decoder. All zeros if there was none.
+        struct RaptorQ_Stats (*const stats) (const struct RaptorQ_ptr *ptr);
+        // all the encoders (or decoders) of the process. false on wrong input
+        bool (*const stats_summary) (const RaptorQ_Stats_Source source,
+                                        struct RaptorQ_Stats_Summary *summary);
+        void (*const stats_reset) (void);
+        // thread pool, local cache and live encoders/decoders.
+        bool (*const metrics) (struct RaptorQ_Metrics *metrics);
+        // metrics and stats summaries, in the Prometheus text format.
+        // Writes up to "size" - 1 chars and a final '\0' (if size > 0),
+        // returns the length of the whole text, like snprintf.
+        size_t (*const metrics_prometheus) (char *out, const size_t size);
     };
 
 
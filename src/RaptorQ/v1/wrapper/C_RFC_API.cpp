@@ -21,9 +21,13 @@
 #include "RaptorQ/v1/wrapper/C_RFC_API.h"
 #include "RaptorQ/v1/caches.hpp"
 #include "RaptorQ/v1/RFC.hpp"
+#include <algorithm>
 #include <chrono>
+#include <cstring>
 #include <future>
 #include <memory>
+#include <string>
+#include <vector>
 
 struct RAPTORQ_LOCAL RFC6330_ptr
 {
@@ -158,6 +162,39 @@ static size_t v1_decode_block_bytes (const struct RFC6330_ptr *dec, void **data,
                                                             const size_t size,
                                                             const uint8_t skip,
                                                             const uint8_t sbn);
+static RFC6330_Error v1_stream (const struct RFC6330_ptr *dec,
+                                                const RFC6330_Block_Sink sink,
+                                                void *user_data,
+                                                const uint8_t max_blocks);
+static struct RFC6330_ptr* v1_Encoder_stream (RFC6330_type type,
+                                            const uint64_t size,
+                                            const uint16_t min_subsymbol_size,
+                                            const uint16_t symbol_size,
+                                            const size_t max_sub_block);
+static RFC6330_Error v1_feed (const struct RFC6330_ptr *enc,
+                                                const uint8_t sbn,
+                                                const void *data,
+                                                const size_t size,
+                                                const uint32_t repair_budget);
+static size_t v1_encode_packets (const struct RFC6330_ptr *enc,
+                                const struct RFC6330_Packet_Range *ranges,
+                                const size_t n_ranges,
+                                uint8_t *buffer,
+                                const size_t buffer_size,
+                                struct RFC6330_Packet *packets,
+                                const size_t max_packets);
+static size_t v1_packet_stride (const struct RFC6330_ptr *enc);
+static size_t v1_add_packets (const struct RFC6330_ptr *dec,
+                                        const struct RFC6330_Packet *packets,
+                                        const size_t n,
+                                        RFC6330_Error *status);
+static RFC6330_Stats v1_stats (const struct RFC6330_ptr *ptr,
+                                                            const uint8_t sbn);
+static bool v1_stats_summary (const RFC6330_Stats_Source source,
+                                        struct RaptorQ_Stats_Summary *summary);
+static void v1_stats_reset (void);
+static bool v1_metrics (RFC6330_Metrics *metrics);
+static size_t v1_metrics_prometheus (char *out, const size_t size);
 
 
 
@@ -230,7 +267,18 @@ RFC6330_v1::RFC6330_v1()
     decode_block_aligned (&v1_decode_block_aligned),
     decode_symbol (&v1_decode_symbol),
     decode_bytes (&v1_decode_bytes),
-    decode_block_bytes (&v1_decode_block_bytes)
+    decode_block_bytes (&v1_decode_block_bytes),
+    stream (&v1_stream),
+    Encoder_stream (&v1_Encoder_stream),
+    feed (&v1_feed),
+    encode_packets (&v1_encode_packets),
+    packet_stride (&v1_packet_stride),
+    add_packets (&v1_add_packets),
+    stats (&v1_stats),
+    stats_summary (&v1_stats_summary),
+    stats_reset (&v1_stats_reset),
+    metrics (&v1_metrics),
+    metrics_prometheus (&v1_metrics_prometheus)
 {}
 
 
@@ -1799,3 +1847,341 @@ static RFC6330_Error v1_add_symbol (const struct RFC6330_ptr *dec, void **data,
     }
     return ret;
 }
+
+static RFC6330_Error v1_stream (const struct RFC6330_ptr *dec,
+                                                const RFC6330_Block_Sink sink,
+                                                void *user_data,
+                                                const uint8_t max_blocks)
+{
+    if (dec == nullptr || dec->ptr == nullptr || sink == nullptr)
+        return RFC6330_Error::RQ_ERR_WRONG_INPUT;
+    switch (dec->type) {
+    case RFC6330_type::RQ_DEC_8:
+        return static_cast<RFC6330_Error> ((reinterpret_cast<
+                            RFC6330__v1::Impl::Decoder<uint8_t*, uint8_t*>*> (
+                                                        dec->ptr))->stream (
+                                                sink, user_data, max_blocks));
+    case RFC6330_type::RQ_DEC_16:
+        return static_cast<RFC6330_Error> ((reinterpret_cast<
+                            RFC6330__v1::Impl::Decoder<uint16_t*, uint16_t*>*> (
+                                                        dec->ptr))->stream (
+                                                sink, user_data, max_blocks));
+    case RFC6330_type::RQ_DEC_32:
+        return static_cast<RFC6330_Error> ((reinterpret_cast<
+                            RFC6330__v1::Impl::Decoder<uint32_t*, uint32_t*>*> (
+                                                        dec->ptr))->stream (
+                                                sink, user_data, max_blocks));
+    case RFC6330_type::RQ_DEC_64:
+        return static_cast<RFC6330_Error> ((reinterpret_cast<
+                            RFC6330__v1::Impl::Decoder<uint64_t*, uint64_t*>*> (
+                                                        dec->ptr))->stream (
+                                                sink, user_data, max_blocks));
+    case RFC6330_type::RQ_ENC_8:
+    case RFC6330_type::RQ_ENC_16:
+    case RFC6330_type::RQ_ENC_32:
+    case RFC6330_type::RQ_ENC_64:
+    case RFC6330_type::RQ_NONE:
+        break;
+    }
+    return RFC6330_Error::RQ_ERR_WRONG_INPUT;
+}
+
+static struct RFC6330_ptr* v1_Encoder_stream (RFC6330_type type,
+                                            const uint64_t size,
+                                            const uint16_t min_subsymbol_size,
+                                            const uint16_t symbol_size,
+                                            const size_t max_sub_block)
+{
+    void *raw_ptr = nullptr;
+    namespace RQ = RFC6330__v1::Impl;
+    switch (type) {
+    case RFC6330_type::RQ_ENC_8:
+        raw_ptr = reinterpret_cast<void *> (
+                            new RQ::Encoder<uint8_t*, uint8_t*> (size,
+                            min_subsymbol_size, symbol_size, max_sub_block));
+        break;
+    case RFC6330_type::RQ_ENC_16:
+        raw_ptr = reinterpret_cast<void *> (
+                            new RQ::Encoder<uint16_t*, uint16_t*> (size,
+                            min_subsymbol_size, symbol_size, max_sub_block));
+        break;
+    case RFC6330_type::RQ_ENC_32:
+        raw_ptr = reinterpret_cast<void *> (
+                            new RQ::Encoder<uint32_t*, uint32_t*> (size,
+                            min_subsymbol_size, symbol_size, max_sub_block));
+        break;
+    case RFC6330_type::RQ_ENC_64:
+        raw_ptr = reinterpret_cast<void *> (
+                            new RQ::Encoder<uint64_t*, uint64_t*> (size,
+                            min_subsymbol_size, symbol_size, max_sub_block));
+        break;
+    case RFC6330_type::RQ_DEC_8:
+    case RFC6330_type::RQ_DEC_16:
+    case RFC6330_type::RQ_DEC_32:
+    case RFC6330_type::RQ_DEC_64:
+    case RFC6330_type::RQ_NONE:
+        return nullptr;
+    }
+    if (raw_ptr == nullptr)
+        return nullptr;
+    return new RFC6330_ptr (type, raw_ptr);
+}
+
+static RFC6330_Error v1_feed (const struct RFC6330_ptr *enc,
+                                                const uint8_t sbn,
+                                                const void *data,
+                                                const size_t size,
+                                                const uint32_t repair_budget)
+{
+    uint8_t *p_8;
+    uint16_t *p_16;
+    uint32_t *p_32;
+    uint64_t *p_64;
+    if (enc == nullptr || enc->ptr == nullptr || data == nullptr)
+        return RFC6330_Error::RQ_ERR_WRONG_INPUT;
+    switch (enc->type) {
+    case RFC6330_type::RQ_ENC_8:
+        p_8 = reinterpret_cast<uint8_t*> (const_cast<void*> (data));
+        return static_cast<RFC6330_Error> ((reinterpret_cast<
+                            RFC6330__v1::Impl::Encoder<uint8_t*, uint8_t*>*> (
+                                                        enc->ptr))->feed (
+                                        sbn, p_8, p_8 + size, repair_budget));
+    case RFC6330_type::RQ_ENC_16:
+        p_16 = reinterpret_cast<uint16_t*> (const_cast<void*> (data));
+        return static_cast<RFC6330_Error> ((reinterpret_cast<
+                            RFC6330__v1::Impl::Encoder<uint16_t*, uint16_t*>*> (
+                                                        enc->ptr))->feed (
+                                        sbn, p_16, p_16 + size, repair_budget));
+    case RFC6330_type::RQ_ENC_32:
+        p_32 = reinterpret_cast<uint32_t*> (const_cast<void*> (data));
+        return static_cast<RFC6330_Error> ((reinterpret_cast<
+                            RFC6330__v1::Impl::Encoder<uint32_t*, uint32_t*>*> (
+                                                        enc->ptr))->feed (
+                                        sbn, p_32, p_32 + size, repair_budget));
+    case RFC6330_type::RQ_ENC_64:
+        p_64 = reinterpret_cast<uint64_t*> (const_cast<void*> (data));
+        return static_cast<RFC6330_Error> ((reinterpret_cast<
+                            RFC6330__v1::Impl::Encoder<uint64_t*, uint64_t*>*> (
+                                                        enc->ptr))->feed (
+                                        sbn, p_64, p_64 + size, repair_budget));
+    case RFC6330_type::RQ_DEC_8:
+    case RFC6330_type::RQ_DEC_16:
+    case RFC6330_type::RQ_DEC_32:
+    case RFC6330_type::RQ_DEC_64:
+    case RFC6330_type::RQ_NONE:
+        break;
+    }
+    return RFC6330_Error::RQ_ERR_WRONG_INPUT;
+}
+
+static size_t v1_encode_packets (const struct RFC6330_ptr *enc,
+                                const struct RFC6330_Packet_Range *ranges,
+                                const size_t n_ranges,
+                                uint8_t *buffer,
+                                const size_t buffer_size,
+                                struct RFC6330_Packet *packets,
+                                const size_t max_packets)
+{
+    if (enc == nullptr || enc->ptr == nullptr)
+        return 0;
+    const auto *r = reinterpret_cast<const RFC6330__v1::Packet_Range*> (ranges);
+    auto *p = reinterpret_cast<RFC6330__v1::Packet*> (packets);
+    switch (enc->type) {
+    case RFC6330_type::RQ_ENC_8:
+        return (reinterpret_cast<
+                    RFC6330__v1::Impl::Encoder<uint8_t*, uint8_t*>*> (
+                                            enc->ptr))->encode_packets (
+                            r, n_ranges, buffer, buffer_size, p, max_packets);
+    case RFC6330_type::RQ_ENC_16:
+        return (reinterpret_cast<
+                    RFC6330__v1::Impl::Encoder<uint16_t*, uint16_t*>*> (
+                                            enc->ptr))->encode_packets (
+                            r, n_ranges, buffer, buffer_size, p, max_packets);
+    case RFC6330_type::RQ_ENC_32:
+        return (reinterpret_cast<
+                    RFC6330__v1::Impl::Encoder<uint32_t*, uint32_t*>*> (
+                                            enc->ptr))->encode_packets (
+                            r, n_ranges, buffer, buffer_size, p, max_packets);
+    case RFC6330_type::RQ_ENC_64:
+        return (reinterpret_cast<
+                    RFC6330__v1::Impl::Encoder<uint64_t*, uint64_t*>*> (
+                                            enc->ptr))->encode_packets (
+                            r, n_ranges, buffer, buffer_size, p, max_packets);
+    case RFC6330_type::RQ_DEC_8:
+    case RFC6330_type::RQ_DEC_16:
+    case RFC6330_type::RQ_DEC_32:
+    case RFC6330_type::RQ_DEC_64:
+    case RFC6330_type::RQ_NONE:
+        break;
+    }
+    return 0;
+}
+
+static size_t v1_packet_stride (const struct RFC6330_ptr *enc)
+{
+    if (enc == nullptr || enc->ptr == nullptr)
+        return 0;
+    switch (enc->type) {
+    case RFC6330_type::RQ_ENC_8:
+        return (reinterpret_cast<
+                    RFC6330__v1::Impl::Encoder<uint8_t*, uint8_t*>*> (
+                                                enc->ptr))->packet_stride();
+    case RFC6330_type::RQ_ENC_16:
+        return (reinterpret_cast<
+                    RFC6330__v1::Impl::Encoder<uint16_t*, uint16_t*>*> (
+                                                enc->ptr))->packet_stride();
+    case RFC6330_type::RQ_ENC_32:
+        return (reinterpret_cast<
+                    RFC6330__v1::Impl::Encoder<uint32_t*, uint32_t*>*> (
+                                                enc->ptr))->packet_stride();
+    case RFC6330_type::RQ_ENC_64:
+        return (reinterpret_cast<
+                    RFC6330__v1::Impl::Encoder<uint64_t*, uint64_t*>*> (
+                                                enc->ptr))->packet_stride();
+    case RFC6330_type::RQ_DEC_8:
+    case RFC6330_type::RQ_DEC_16:
+    case RFC6330_type::RQ_DEC_32:
+    case RFC6330_type::RQ_DEC_64:
+    case RFC6330_type::RQ_NONE:
+        break;
+    }
+    return 0;
+}
+
+static size_t v1_add_packets (const struct RFC6330_ptr *dec,
+                                        const struct RFC6330_Packet *packets,
+                                        const size_t n,
+                                        RFC6330_Error *status)
+{
+    // no buffer for the statuses: they are written as bytes at the start
+    // of "status", then widened in place from the last one.
+    static_assert (sizeof(RFC6330_Error) >= sizeof(RFC6330__v1::Error),
+                                "RQ: RFC6330_Error smaller than Error");
+    auto *res = reinterpret_cast<RFC6330__v1::Error*> (status);
+    for (size_t idx = 0; res != nullptr && idx < n; ++idx)
+        res[idx] = RFC6330__v1::Error::INITIALIZATION;
+    const auto *p = reinterpret_cast<const RFC6330__v1::Packet*> (packets);
+    size_t ret = 0;
+    if (dec != nullptr && dec->ptr != nullptr) {
+        switch (dec->type) {
+        case RFC6330_type::RQ_DEC_8:
+            ret = (reinterpret_cast<
+                    RFC6330__v1::Impl::Decoder<uint8_t*, uint8_t*>*> (
+                            dec->ptr))->add_packets (p, n, res);
+            break;
+        case RFC6330_type::RQ_DEC_16:
+            ret = (reinterpret_cast<
+                    RFC6330__v1::Impl::Decoder<uint16_t*, uint16_t*>*> (
+                            dec->ptr))->add_packets (p, n, res);
+            break;
+        case RFC6330_type::RQ_DEC_32:
+            ret = (reinterpret_cast<
+                    RFC6330__v1::Impl::Decoder<uint32_t*, uint32_t*>*> (
+                            dec->ptr))->add_packets (p, n, res);
+            break;
+        case RFC6330_type::RQ_DEC_64:
+            ret = (reinterpret_cast<
+                    RFC6330__v1::Impl::Decoder<uint64_t*, uint64_t*>*> (
+                            dec->ptr))->add_packets (p, n, res);
+            break;
+        case RFC6330_type::RQ_ENC_8:
+        case RFC6330_type::RQ_ENC_16:
+        case RFC6330_type::RQ_ENC_32:
+        case RFC6330_type::RQ_ENC_64:
+        case RFC6330_type::RQ_NONE:
+            break;
+        }
+    }
+    for (size_t idx = n; status != nullptr && idx > 0; --idx) {
+        const RFC6330__v1::Error err = res[idx - 1];
+        status[idx - 1] = static_cast<RFC6330_Error> (err);
+    }
+    return ret;
+}
+
+///////////////////////////
+// Statistics
+///////////////////////////
+
+static RFC6330_Stats v1_stats (const struct RFC6330_ptr *ptr,
+                                                            const uint8_t sbn)
+{
+    RFC6330_Stats ret;
+    RFC6330__v1::Stats stats;
+    if (ptr != nullptr && ptr->ptr != nullptr) {
+        switch (ptr->type) {
+        case RFC6330_type::RQ_ENC_8:
+            stats = (reinterpret_cast<RFC6330__v1::Impl::Encoder<uint8_t*,
+                                        uint8_t*>*> (ptr->ptr))->stats (sbn);
+            break;
+        case RFC6330_type::RQ_ENC_16:
+            stats = (reinterpret_cast<RFC6330__v1::Impl::Encoder<uint16_t*,
+                                        uint16_t*>*> (ptr->ptr))->stats (sbn);
+            break;
+        case RFC6330_type::RQ_ENC_32:
+            stats = (reinterpret_cast<RFC6330__v1::Impl::Encoder<uint32_t*,
+                                        uint32_t*>*> (ptr->ptr))->stats (sbn);
+            break;
+        case RFC6330_type::RQ_ENC_64:
+            stats = (reinterpret_cast<RFC6330__v1::Impl::Encoder<uint64_t*,
+                                        uint64_t*>*> (ptr->ptr))->stats (sbn);
+            break;
+        case RFC6330_type::RQ_DEC_8:
+            stats = (reinterpret_cast<RFC6330__v1::Impl::Decoder<uint8_t*,
+                                        uint8_t*>*> (ptr->ptr))->stats (sbn);
+            break;
+        case RFC6330_type::RQ_DEC_16:
+            stats = (reinterpret_cast<RFC6330__v1::Impl::Decoder<uint16_t*,
+                                        uint16_t*>*> (ptr->ptr))->stats (sbn);
+            break;
+        case RFC6330_type::RQ_DEC_32:
+            stats = (reinterpret_cast<RFC6330__v1::Impl::Decoder<uint32_t*,
+                                        uint32_t*>*> (ptr->ptr))->stats (sbn);
+            break;
+        case RFC6330_type::RQ_DEC_64:
+            stats = (reinterpret_cast<RFC6330__v1::Impl::Decoder<uint64_t*,
+                                        uint64_t*>*> (ptr->ptr))->stats (sbn);
+            break;
+        case RFC6330_type::RQ_NONE:
+            break;
+        }
+    }
+    std::memcpy (&ret, &stats, sizeof(ret));
+    return ret;
+}
+
+static bool v1_stats_summary (const RFC6330_Stats_Source source,
+                                        struct RaptorQ_Stats_Summary *summary)
+{
+    if (summary == nullptr || (source != RQ_STATS_ENCODER &&
+                                            source != RQ_STATS_DECODER)) {
+        return false;
+    }
+    const auto ret = RFC6330__v1::stats_summary (
+                            static_cast<RFC6330__v1::Stats_Source> (source));
+    std::memcpy (summary, &ret, sizeof(*summary));
+    return true;
+}
+
+static void v1_stats_reset (void)
+    { RFC6330__v1::stats_reset(); }
+
+static bool v1_metrics (RFC6330_Metrics *metrics)
+{
+    if (metrics == nullptr)
+        return false;
+    const auto ret = RFC6330__v1::metrics();
+    std::memcpy (metrics, &ret, sizeof(*metrics));
+    return true;
+}
+
+static size_t v1_metrics_prometheus (char *out, const size_t size)
+{
+    const std::string text = RFC6330__v1::metrics_prometheus();
+    if (out != nullptr && size > 0) {
+        const size_t len = std::min (size - 1, text.size());
+        std::memcpy (out, text.data(), len);
+        out[len] = '\0';
+    }
+    return text.size();
+}
@@ -54,6 +54,25 @@ extern "C"
         uint8_t *bitmask;
     };
 
+    // tracks common.hpp/RFC6330__v1::Packet_Range
+    struct RAPTORQ_API RFC6330_Packet_Range {
+        uint32_t esi;
+        uint32_t symbols;
+        uint8_t sbn;
+    };
+    // tracks common.hpp/RFC6330__v1::Packet. Same layout as "struct iovec"
+    struct RAPTORQ_API RFC6330_Packet {
+        void *data;
+        size_t size;
+    };
+
+    // tracks common.hpp/RFC6330__v1::Block_Sink
+    // gets each decoded block in order. "data" is valid only during the call.
+    // return false to stop the stream.
+    typedef bool (*RFC6330_Block_Sink) (void *user_data, const uint8_t sbn,
+                                                        const uint8_t *data,
+                                                        const size_t bytes);
+
 
     RAPTORQ_API struct RFC6330_base_api* RFC6330_api (uint32_t version);
     RAPTORQ_API void RFC6330_free_api (struct RFC6330_base_api **api);
@@ -192,6 +211,56 @@ extern "C"
                                                             const size_t size,
                                                             const uint8_t skip,
                                                             const uint8_t sbn);
+        RFC6330_Error (*const stream) (const struct RFC6330_ptr *dec,
+                                                const RFC6330_Block_Sink sink,
+                                                void *user_data,
+                                                const uint8_t max_blocks);
+
+        // streaming encoder: "size" bytes in total, data given by feed().
+        // feed() takes the "size" elements of block "sbn", which must stay
+        // valid until the block is freed: after "repair_budget" repair
+        // symbols have been encoded, or with free_block if it is 0.
+        struct RFC6330_ptr* (*const Encoder_stream) (RFC6330_type type,
+                                            const uint64_t size,
+                                            const uint16_t min_subsymbol_size,
+                                            const uint16_t symbol_size,
+                                            const size_t max_sub_block);
+        RFC6330_Error (*const feed) (const struct RFC6330_ptr *enc,
+                                                const uint8_t sbn,
+                                                const void *data,
+                                                const size_t size,
+                                                const uint32_t repair_budget);
+
+        // batched RFC packets, see RFC.hpp
+        size_t (*const encode_packets) (const struct RFC6330_ptr *enc,
+                                const struct RFC6330_Packet_Range *ranges,
+                                const size_t n_ranges,
+                                uint8_t *buffer,
+                                const size_t buffer_size,
+                                struct RFC6330_Packet *packets,
+                                const size_t max_packets);
+        size_t (*const packet_stride) (const struct RFC6330_ptr *enc);
+        // "status" can be NULL. returns the packets with useful symbols.
+        size_t (*const add_packets) (const struct RFC6330_ptr *dec,
+                                        const struct RFC6330_Packet *packets,
+                                        const size_t n,
+                                        RFC6330_Error *status);
+
+        // timings, cache usage and sizes of the last computation of block
+        // "sbn" of an encoder or decoder. All zeros if there was none.
+        RFC6330_Stats (*const stats) (const struct RFC6330_ptr *ptr,
+                                                            const uint8_t sbn);
+        // same as the RAW API. All the encoders (or decoders) of the
+        // process, RAW and RFC. false on wrong input
+        bool (*const stats_summary) (const RFC6330_Stats_Source source,
+                                        struct RaptorQ_Stats_Summary *summary);
+        void (*const stats_reset) (void);
+        // thread pool, local cache and live encoders/decoders.
+        bool (*const metrics) (RFC6330_Metrics *metrics);
+        // metrics and stats summaries, in the Prometheus text format.
+        // Writes up to "size" - 1 chars and a final '\0' (if size > 0),
+        // returns the length of the whole text, like snprintf.
+        size_t (*const metrics_prometheus) (char *out, const size_t size);
     };
 
 
@@ -20,6 +20,8 @@
 
 #pragma once
 
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -54,7 +56,9 @@ typedef enum {  RQ_ERR_NONE = 0,
                 RQ_ERR_NEED_DATA = 3,
                 RQ_ERR_WORKING = 4,
                 RQ_ERR_INITIALIZATION = 5,
-                RQ_ERR_EXITING = 6
+                RQ_ERR_EXITING = 6,
+                RQ_ERR_OUT_OF_WINDOW = 7    // streaming decoder: block too
+                                            // far ahead, send it again later
             } RaptorQ_Error;
 typedef RaptorQ_Error RFC6330_Error;
 
@@ -82,6 +86,9 @@ typedef RaptorQ_Work RFC6330_Work;
 typedef enum {
     RQ_COMPRESS_NONE = 0x00,
     RQ_COMPRESS_LZ4 = 0x01,
+    RQ_COMPRESS_LZ4HC = 0x02,
+    RQ_COMPRESS_SPARSE = 0x04,
+    // 0x08 - 0x80: free for user-registered codecs (C++ API only)
 } RaptorQ_Compress;
 typedef RaptorQ_Compress RFC6330_Compress;
 
@@ -100,6 +107,96 @@ typedef enum {
 } RaptorQ_Fill_With_Zeros;
 typedef RaptorQ_Fill_With_Zeros RFC6330_Fill_With_Zeros;
 
+// tracked by RaptorQ__v1::Pivot
+// how the decoder chooses the rows to eliminate. Same results, but the
+// number of inactivated columns (dense work) changes.
+typedef enum {
+    RQ_PIVOT_RFC       = 0, // rfc 6330: minimum "r", graph for r == 2
+    RQ_PIVOT_LOOKAHEAD = 1  // minimum "r", most rows left with a single
+                            // non-zero
+} RaptorQ_Pivot;
+typedef RaptorQ_Pivot RFC6330_Pivot;
+
+// tracked by stats.hpp/RaptorQ__v1::Stats
+// what happened in the last decoding (or encoder computation).
+// all times are in nanoseconds.
+struct RaptorQ_Stats {
+    uint64_t total;
+    uint64_t gen;               // precode matrix generation
+    uint64_t phase[6];          // decode_phase0 .. decode_phase5
+    uint64_t get_missing;       // rebuilding the missing source symbols
+    uint64_t bytes_allocated;   // growth of the decoder scratch space
+    uint64_t cache_compressed;  // size of the cached operations, if any
+    uint64_t cache_uncompressed;
+    uint32_t overhead;          // repair symbols used
+    uint32_t operations;        // recorded operations
+    uint16_t i;                 // columns solved by phase 1
+    uint16_t u;                 // columns inactivated by phase 1
+    uint8_t cache_probed;       // the operation cache was looked up
+    uint8_t cache_hit;          // ...and had the computation
+};
+typedef struct RaptorQ_Stats RFC6330_Stats;
+
+// log2 buckets: bucket 0 counts the zeros, bucket "b" counts
+// the values in [2^(b-1), 2^b)
+#define RQ_STATS_BUCKETS 65
+// tracked by stats.hpp/RaptorQ__v1::Stats_Histogram
+struct RaptorQ_Stats_Histogram {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t bucket[RQ_STATS_BUCKETS];
+};
+
+// tracked by stats.hpp/RaptorQ__v1::Stats_Summary
+// all the runs of the process since the start (or the last reset)
+struct RaptorQ_Stats_Summary {
+    uint64_t cache_probes;
+    uint64_t cache_hits;
+    struct RaptorQ_Stats_Histogram total;
+    struct RaptorQ_Stats_Histogram gen;
+    struct RaptorQ_Stats_Histogram phase[6];
+    struct RaptorQ_Stats_Histogram get_missing;
+    struct RaptorQ_Stats_Histogram bytes_allocated;
+    struct RaptorQ_Stats_Histogram overhead;
+    struct RaptorQ_Stats_Histogram operations;
+    struct RaptorQ_Stats_Histogram u;
+};
+
+// tracked by stats.hpp/RaptorQ__v1::Stats_Source
+typedef enum {
+    RQ_STATS_ENCODER = 0,
+    RQ_STATS_DECODER = 1
+} RaptorQ_Stats_Source;
+typedef RaptorQ_Stats_Source RFC6330_Stats_Source;
+
+// tracked by stats.hpp/RaptorQ__v1::Metrics
+// gauges are the current value, the rest only grows.
+// times are in nanoseconds, sizes in bytes.
+struct RaptorQ_Metrics {
+    uint64_t pool_threads;          // gauge
+    uint64_t pool_queue_depth;      // gauge: work waiting for a thread
+    uint64_t pool_busy_threads;     // gauge
+    uint64_t pool_enqueued;
+    uint64_t pool_done;
+    uint64_t pool_stopped;          // put back in the queue
+    uint64_t pool_requeued;
+    uint64_t pool_busy;             // time spent working, all threads
+    struct RaptorQ_Stats_Histogram pool_work;   // time of each work item
+    uint64_t cache_max_bytes;       // gauge
+    uint64_t cache_bytes;           // gauge
+    uint64_t cache_entries;         // gauge
+    uint64_t cache_hits;
+    uint64_t cache_misses;
+    uint64_t cache_adds;
+    uint64_t cache_evictions;
+    uint64_t cache_rejects;         // too big, or fresher entries
+    uint64_t encoders;              // gauge: live block encoders
+    uint64_t decoders;              // gauge: live block decoders
+    uint64_t encoder_bytes;         // gauge
+    uint64_t decoder_bytes;         // gauge
+};
+typedef struct RaptorQ_Metrics RFC6330_Metrics;
+
 #ifdef __cplusplus
 }   // extern "C"
 #endif
@@ -35,6 +35,7 @@
 #pragma GCC diagnostic pop
 #include "RaptorQ/RaptorQ_v1_hdr.hpp"
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <chrono>
 #include <cstdlib>
@@ -44,8 +45,18 @@
 #include <iostream>
 #include <map>
 #include <memory>
+#include <thread>
 #include <utility>
 #include <vector>
+#if defined _WIN32
+    #define RQ_CLI_MMAP 0
+#else
+    #define RQ_CLI_MMAP 1
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
 
 
 //////
@@ -78,7 +89,8 @@ static option::ArgStatus Numeric (const option::Option& option, bool msg)
 }
 };
 
-enum  optionIndex { UNKNOWN, HELP, FORMAT, SYMBOLS, SYMBOL_SIZE, REPAIR, BYTES};
+enum  optionIndex { UNKNOWN, HELP, FORMAT, SYMBOLS, SYMBOL_SIZE, REPAIR, BYTES,
+                                                                    THREADS};
 const option::Descriptor usage[] =
 {
  {UNKNOWN, 0, "", "", Arg::Unknown, "USAGE: benchmark|blocks"},
@@ -100,6 +112,10 @@ const option::Descriptor usage[] =
  {UNKNOWN, 0, "", "", Arg::None, "DECODE only parameters:"},
  {BYTES, 0, "b", "bytes", Arg::Numeric, "  -b --bytes\t"
                                     "data size for each {en,de}coder block"},
+ {UNKNOWN, 0, "", "", Arg::None, "ENCODE/DECODE of files (not stdin/stdout):"},
+ {THREADS, 0, "t", "threads", Arg::Numeric, "  -t --threads\t"
+                                    "blocks worked on at the same time "
+                                                "(default: one per core)"},
  {0,0,nullptr,nullptr,nullptr,nullptr}
 };
 
@@ -115,6 +131,21 @@ static bool decode (const size_t bytes, const RaptorQ__v1::Block_Size symbols,
                                                     const int64_t symbol_size,
                                                     std::istream *input,
                                                     std::ostream *output);
+#if RQ_CLI_MMAP
+class Mapped_File;
+static bool encode_mapped (const size_t symbol_size,
+                                        const RaptorQ__v1::Block_Size symbols,
+                                        const uint32_t repair,
+                                        const Mapped_File &input,
+                                        const std::string &output_file,
+                                        const uint32_t threads);
+static bool decode_mapped (const size_t bytes,
+                                        const RaptorQ__v1::Block_Size symbols,
+                                        const size_t symbol_size,
+                                        const Mapped_File &input,
+                                        const std::string &output_file,
+                                        const uint32_t threads);
+#endif
 
 static void info (const char *prog_name)
 {
@@ -497,6 +528,289 @@ static bool encode (const int64_t symbol_size,
     }
 }
 
+#if RQ_CLI_MMAP
+//////
+/// Memory mapped files: blocks are {en,de}coded by multiple threads,
+/// straight from the input file and to the output file.
+//////
+
+class Mapped_File
+{
+public:
+    Mapped_File()
+        : _data (nullptr), _size (0), _fd (-1)
+    {}
+    ~Mapped_File();
+    Mapped_File (const Mapped_File&) = delete;
+    Mapped_File& operator= (const Mapped_File&) = delete;
+    Mapped_File (Mapped_File&&) = delete;
+    Mapped_File& operator= (Mapped_File&&) = delete;
+
+    // false if the file is not a regular file, or can not be mapped
+    bool open_read (const std::string &file);
+    // create/truncate the file with the given size
+    bool open_write (const std::string &file, const size_t size);
+    uint8_t *data() const
+        { return _data; }
+    size_t size() const
+        { return _size; }
+private:
+    bool map (const int prot);
+    uint8_t *_data;
+    size_t _size;
+    int _fd;
+};
+
+Mapped_File::~Mapped_File()
+{
+    if (_data != nullptr)
+        munmap (_data, _size);
+    if (_fd >= 0)
+        close (_fd);
+}
+
+bool Mapped_File::open_read (const std::string &file)
+{
+    _fd = open (file.c_str(), O_RDONLY);
+    if (_fd < 0)
+        return false;
+    struct stat info;
+    if (fstat (_fd, &info) != 0 || !S_ISREG (info.st_mode) ||
+                                                        info.st_size <= 0) {
+        return false;
+    }
+    _size = static_cast<size_t> (info.st_size);
+    // private, never written: the encoder only takes non-const iterators
+    if (!map (PROT_READ | PROT_WRITE))
+        return false;
+    madvise (_data, _size, MADV_SEQUENTIAL);
+    return true;
+}
+
+bool Mapped_File::open_write (const std::string &file, const size_t size)
+{
+    _fd = open (file.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (_fd < 0)
+        return false;
+    _size = size;
+    if (_size == 0)
+        return true;
+    if (ftruncate (_fd, static_cast<off_t> (_size)) != 0)
+        return false;
+    return map (PROT_READ | PROT_WRITE);
+}
+
+bool Mapped_File::map (const int prot)
+{
+    const int flags = (prot & PROT_WRITE) != 0 &&
+                        (fcntl (_fd, F_GETFL) & O_ACCMODE) == O_RDONLY ?
+                                                    MAP_PRIVATE : MAP_SHARED;
+    void *mem = mmap (nullptr, _size, prot, flags, _fd, 0);
+    if (mem == MAP_FAILED)
+        return false;
+    _data = static_cast<uint8_t*> (mem);
+    return true;
+}
+
+static uint32_t worker_threads (const uint32_t threads, const size_t blocks)
+{
+    uint32_t ret = threads;
+    if (ret == 0)
+        ret = std::max<uint32_t> (1, std::thread::hardware_concurrency());
+    return static_cast<uint32_t> (std::min<size_t> (ret, blocks));
+}
+
+// the output record of each symbol is: block, symbol, data
+static void write_record (uint8_t *out, const uint32_t block,
+                                                        const uint32_t symbol)
+{
+    std::memcpy (out, &block, sizeof(block));
+    std::memcpy (out + sizeof(block), &symbol, sizeof(symbol));
+}
+
+static bool encode_mapped (const size_t symbol_size,
+                                        const RaptorQ__v1::Block_Size symbols,
+                                        const uint32_t repair,
+                                        const Mapped_File &input,
+                                        const std::string &output_file,
+                                        const uint32_t threads)
+{
+    // false on error
+    const size_t block_bytes = static_cast<uint16_t> (symbols) * symbol_size;
+    const size_t blocks = (input.size() + block_bytes - 1) / block_bytes;
+    const size_t record = 2 * sizeof(uint32_t) + symbol_size;
+    // all blocks but the last are full, so we know where each one goes
+    const size_t block_out = (static_cast<uint16_t> (symbols) + repair) *
+                                                                        record;
+    const size_t last_bytes = input.size() - (blocks - 1) * block_bytes;
+    const size_t last_source = (last_bytes + symbol_size - 1) / symbol_size;
+    Mapped_File output;
+    if (!output.open_write (output_file, (blocks - 1) * block_out +
+                                            (last_source + repair) * record)) {
+        std::cerr << "ERR: can't open output file\n";
+        return false;
+    }
+
+    std::atomic<size_t> next_block (0);
+    std::atomic<bool> failed (false);
+    auto worker = [&]() {
+        // Since we do not change the number of symbols for each block,
+        // we can reuse the encoder.
+        RaptorQ__v1::Encoder<uint8_t*, uint8_t*> encoder (symbols,
+                                                                symbol_size);
+        for (size_t block = next_block++; block < blocks && !failed;
+                                                        block = next_block++) {
+            const size_t bytes = std::min (block_bytes,
+                                        input.size() - block * block_bytes);
+            uint8_t *in = input.data() + block * block_bytes;
+            uint8_t *out = output.data() + block * block_out;
+            // give the data to the encoder. It will pad it automatically.
+            if (encoder.set_data (in, in + bytes) != bytes ||
+                                                    !encoder.compute_sync()) {
+                std::cerr << "ERR: encoder should never fail!\n";
+                failed = true;
+                break;
+            }
+            const uint32_t block_num = static_cast<uint32_t> (block);
+            uint32_t sym_num = 0;
+            for (size_t done = 0; done < bytes; done += symbol_size) {
+                const size_t len = std::min (symbol_size, bytes - done);
+                write_record (out, block_num, sym_num++);
+                out += 2 * sizeof(uint32_t);
+                std::memcpy (out, in + done, len);
+                std::memset (out + len, 0, symbol_size - len);
+                out += symbol_size;
+            }
+            for (uint32_t rep_id = static_cast<uint16_t> (symbols);
+                rep_id < static_cast<uint16_t> (symbols) + repair; ++rep_id) {
+                write_record (out, block_num, rep_id);
+                out += 2 * sizeof(uint32_t);
+                uint8_t *rep_start = out;
+                if (encoder.encode (rep_start, out + symbol_size, rep_id) !=
+                                                                symbol_size) {
+                    std::cerr << "ERR: wrong repair symbol size\n";
+                    failed = true;
+                    break;
+                }
+                out += symbol_size;
+            }
+            encoder.clear_data();
+        }
+    };
+    std::vector<std::thread> workers;
+    const uint32_t max_workers = worker_threads (threads, blocks);
+    for (uint32_t idx = 1; idx < max_workers; ++idx)
+        workers.emplace_back (worker);
+    worker();
+    for (auto &thread : workers)
+        thread.join();
+    return !failed;
+}
+
+static bool decode_mapped (const size_t bytes,
+                                        const RaptorQ__v1::Block_Size symbols,
+                                        const size_t symbol_size,
+                                        const Mapped_File &input,
+                                        const std::string &output_file,
+                                        const uint32_t threads)
+{
+    // false on error
+    const size_t record = 2 * sizeof(uint32_t) + symbol_size;
+    if (input.size() % record != 0) {
+        std::cerr << "ERR: not enough data to fill the last symbol\n";
+        return false;
+    }
+    const size_t block_bytes = static_cast<uint16_t> (symbols) * symbol_size;
+    const size_t blocks = (bytes + block_bytes - 1) / block_bytes;
+    const size_t records = input.size() / record;
+
+    // group the records by block
+    std::vector<size_t> first (blocks + 1, 0);
+    for (size_t idx = 0; idx < records; ++idx) {
+        uint32_t block_number;
+        std::memcpy (&block_number, input.data() + idx * record,
+                                                        sizeof(block_number));
+        if (block_number >= blocks) {
+            std::cerr << "ERR: additional blocks found.\n";
+            return false;
+        }
+        ++first[block_number + 1];
+    }
+    for (size_t block = 1; block <= blocks; ++block)
+        first[block] += first[block - 1];
+    std::vector<uint8_t*> by_block (records);
+    std::vector<size_t> next (first.begin(), first.end() - 1);
+    for (size_t idx = 0; idx < records; ++idx) {
+        uint32_t block_number;
+        std::memcpy (&block_number, input.data() + idx * record,
+                                                        sizeof(block_number));
+        by_block[next[block_number]++] = input.data() + idx * record;
+    }
+
+    Mapped_File output;
+    if (!output.open_write (output_file, bytes)) {
+        std::cerr << "ERR: can't open output file\n";
+        return false;
+    }
+
+    using Dec_mapped = RaptorQ__v1::Decoder<uint8_t*, uint8_t*>;
+    std::atomic<size_t> next_block (0);
+    std::atomic<bool> failed (false);
+    auto worker = [&]() {
+        std::vector<uint8_t> zeros (symbol_size, 0);
+        for (size_t block = next_block++; block < blocks && !failed;
+                                                        block = next_block++) {
+            const size_t block_len = std::min (block_bytes,
+                                                bytes - block * block_bytes);
+            Dec_mapped dec (symbols, symbol_size, Dec_mapped::Report::COMPLETE);
+            for (size_t idx = first[block]; idx < first[block + 1]; ++idx) {
+                uint32_t symbol_number;
+                std::memcpy (&symbol_number, by_block[idx] + sizeof(uint32_t),
+                                                        sizeof(symbol_number));
+                uint8_t *sym = by_block[idx] + 2 * sizeof(uint32_t);
+                auto err = dec.add_symbol (sym, sym + symbol_size,
+                                                                symbol_number);
+                if (err != RaptorQ__v1::Error::NONE &&
+                                        err != RaptorQ__v1::Error::NOT_NEEDED) {
+                    std::cerr << "ERR: error adding symbol\n";
+                    failed = true;
+                    return;
+                }
+            }
+            // the last block was not filled to the end: the encoder
+            // padded it with zeros, which were not sent.
+            for (size_t esi = (block_len + symbol_size - 1) / symbol_size;
+                                esi < static_cast<uint16_t> (symbols); ++esi) {
+                uint8_t *sym = zeros.data();
+                dec.add_symbol (sym, sym + symbol_size,
+                                                static_cast<uint32_t> (esi));
+            }
+            if (!dec.ready() && dec.decode_once() !=
+                                        RaptorQ__v1::Decoder_Result::DECODED) {
+                std::cerr << "ERR: not all blocks could be decoded\n";
+                failed = true;
+                return;
+            }
+            uint8_t *out = output.data() + block * block_bytes;
+            auto written = dec.decode_bytes (out, out + block_len, 0, 0);
+            if (written.written != block_len) {
+                std::cerr << "ERR: partial or empty block from decoder\n";
+                failed = true;
+                return;
+            }
+        }
+    };
+    std::vector<std::thread> workers;
+    const uint32_t max_workers = worker_threads (threads, blocks);
+    for (uint32_t idx = 1; idx < max_workers; ++idx)
+        workers.emplace_back (worker);
+    worker();
+    for (auto &thread : workers)
+        thread.join();
+    return !failed;
+}
+#endif
+
 int main (int argc, char **argv)
 {
     // manually parse first argument as command.
@@ -560,6 +874,7 @@ int main (int argc, char **argv)
         if (options[SYMBOLS].count() != 0 || options[SYMBOL_SIZE].count() != 0
                                         || options[REPAIR].count() != 0
                                         || options[BYTES].count() != 0
+                                        || options[THREADS].count() != 0
                                         || parse.nonOptionsCount() != 1) {
             std::cerr << "ERR: \"benchmark\" does not use arguments\n";
             option::printUsage (std::cout, usage);
@@ -701,7 +1016,33 @@ int main (int argc, char **argv)
 
     const std::string input_file = parse.nonOption (0);
     const std::string output_file = parse.nonOption (1);
+    uint32_t threads = 0;
+    if (options[THREADS].count() != 0) {
+        threads = static_cast<uint32_t> (strtol(options[THREADS].last()->arg,
+                                                                nullptr, 10));
+    }
 
+#if RQ_CLI_MMAP
+    // regular files are mapped in memory, and multiple blocks are worked
+    // on at the same time. Everything else goes through the streams.
+    if (input_file.compare("-") != 0 && output_file.compare("-") != 0) {
+        Mapped_File in_map;
+        if (in_map.open_read (input_file)) {
+            bool ok;
+            if (command.compare ("encode") == 0) {
+                ok = encode_mapped (static_cast<size_t> (symbol_size), symbols,
+                                    repair, in_map, output_file, threads);
+            } else {
+                ok = decode_mapped (bytes, symbols,
+                                    static_cast<size_t> (symbol_size), in_map,
+                                                        output_file, threads);
+            }
+            return ok ? 0 : 1;
+        }
+    }
+#else
+    RQ_UNUSED (threads);
+#endif
 
     // try to open input/output files
     std::istream *input;
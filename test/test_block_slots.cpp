@@ -0,0 +1,201 @@
+/*
+ * Copyright (c) 2016-2017, Luca Fulchir<luca@fulchir.it>, All rights reserved.
+ *
+ * This file is part of "libRaptorQ".
+ *
+ * libRaptorQ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * libRaptorQ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * and a copy of the GNU Lesser General Public License
+ * along with libRaptorQ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Per-block slots of the RFC decoder, under concurrency:
+//  * threads adding symbols to their own blocks, decoding and freeing them
+//  * threads adding symbols to all the blocks at the same time, while
+//    another one decodes and frees the blocks as soon as they are ready.
+//    Symbols can arrive after the block was freed, and create it again.
+// both with the thread pool and with the decoding done by the caller.
+
+#include "../src/RaptorQ/RFC6330_v1_hdr.hpp"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace RFC6330 = RFC6330__v1;
+
+using Enc = RFC6330::Encoder<uint8_t*, uint8_t*>;
+using Dec = RFC6330::Decoder<uint8_t*, uint8_t*>;
+
+static const uint16_t symbol_bytes = 256;
+static const uint8_t threads = 4;
+
+// first byte of each block in the input
+static std::vector<size_t> block_offsets (Enc &enc)
+{
+    std::vector<size_t> ret (1, 0);
+    for (uint8_t sbn = 0; sbn < enc.blocks(); ++sbn)
+        ret.push_back (ret.back() + enc.block_size (sbn));
+    return ret;
+}
+
+// the symbols of "sbn" sent by thread "th" of "senders"
+static void send (Enc &enc, Dec &dec, const uint8_t sbn, const uint8_t th,
+                                                        const uint8_t senders)
+{
+    const uint32_t K = enc.symbols (sbn);
+    std::vector<uint8_t> sym (symbol_bytes);
+    for (uint32_t esi = th; esi < K + K / 6 + 20; esi += senders) {
+        if (esi % 7 == 3)
+            continue;   // lost
+        uint8_t *out = sym.data();
+        enc.encode (out, sym.data() + sym.size(), esi, sbn);
+        uint8_t *in = sym.data();
+        dec.add_symbol (in, sym.data() + sym.size(), esi, sbn);
+    }
+}
+
+// decode the block if ready, check it. 0: not ready, 1: ok, 2: wrong data
+static uint8_t check_block (Enc &enc, Dec &dec, const uint8_t sbn,
+                                        const std::vector<uint8_t> &input,
+                                        const std::vector<size_t> &offsets)
+{
+    std::vector<uint8_t> out (enc.block_size (sbn));
+    uint8_t *start = out.data();
+    const size_t written = dec.decode_block_bytes (start,
+                                            out.data() + out.size(), 0, sbn);
+    if (written == 0)
+        return 0;
+    // the last block is padded
+    const size_t expected = std::min (out.size(),
+                                                input.size() - offsets[sbn]);
+    const auto from = input.begin() + static_cast<std::ptrdiff_t> (
+                                                                offsets[sbn]);
+    if (written != expected || !std::equal (from, from +
+                    static_cast<std::ptrdiff_t> (expected), out.begin())) {
+        return 2;
+    }
+    return 1;
+}
+
+static bool wait_and_check (Enc &enc, Dec &dec, const uint8_t sbn,
+                                        const std::vector<uint8_t> &input,
+                                        const std::vector<size_t> &offsets)
+{
+    for (uint32_t wait = 0; wait < 60000; ++wait) {
+        const uint8_t res = check_block (enc, dec, sbn, input, offsets);
+        if (res != 0)
+            return res == 1;
+        std::this_thread::sleep_for (std::chrono::milliseconds (1));
+    }
+    return false;
+}
+
+static bool test_distinct (Enc &enc, const std::vector<uint8_t> &input,
+                                                            const bool pool)
+{
+    Dec dec (enc.OTI_Common(), enc.OTI_Scheme_Specific());
+    if (!pool)
+        dec.compute (RFC6330::Compute::NO_POOL).get();
+    const auto offsets = block_offsets (enc);
+    std::vector<uint8_t> ok (threads, 0);
+    std::vector<std::thread> workers;
+    for (uint8_t th = 0; th < threads; ++th) {
+        workers.emplace_back ([&, th]() {
+            bool all = true;
+            for (uint16_t sbn = th; sbn < enc.blocks(); sbn += threads) {
+                const uint8_t sbn8 = static_cast<uint8_t> (sbn);
+                send (enc, dec, sbn8, 0, 1);
+                all = wait_and_check (enc, dec, sbn8, input, offsets) && all;
+                dec.free (sbn8);
+                all = !dec.is_block_ready (sbn8) && all;
+            }
+            ok[th] = all ? 1 : 0;
+        });
+    }
+    for (auto &th : workers)
+        th.join();
+    return std::count (ok.begin(), ok.end(), 1) == threads;
+}
+
+static bool test_shared (Enc &enc, const std::vector<uint8_t> &input,
+                                                            const bool pool)
+{
+    Dec dec (enc.OTI_Common(), enc.OTI_Scheme_Specific());
+    if (!pool)
+        dec.compute (RFC6330::Compute::NO_POOL).get();
+    const auto offsets = block_offsets (enc);
+    std::vector<std::thread> workers;
+    for (uint8_t th = 0; th < threads; ++th) {
+        workers.emplace_back ([&, th]() {
+            // every thread goes through the blocks in its own order
+            std::vector<uint8_t> order;
+            for (uint8_t sbn = 0; sbn < enc.blocks(); ++sbn)
+                order.push_back (sbn);
+            std::shuffle (order.begin(), order.end(), std::mt19937 (th));
+            for (const uint8_t sbn : order)
+                send (enc, dec, sbn, th, threads);
+        });
+    }
+    // decode and free the blocks as soon as they are ready
+    std::vector<uint8_t> done (enc.blocks(), 0);
+    bool ok = true;
+    for (uint32_t wait = 0; wait < 60000 && ok &&
+                    std::count (done.begin(), done.end(), 1) < enc.blocks();
+                                                                    ++wait) {
+        for (uint8_t sbn = 0; sbn < enc.blocks(); ++sbn) {
+            if (done[sbn] != 0)
+                continue;
+            const uint8_t res = check_block (enc, dec, sbn, input, offsets);
+            if (res == 0)
+                continue;
+            ok = ok && res == 1;
+            done[sbn] = 1;
+            dec.free (sbn);
+        }
+        std::this_thread::sleep_for (std::chrono::milliseconds (1));
+    }
+    for (auto &th : workers)
+        th.join();
+    return ok && std::count (done.begin(), done.end(), 1) == enc.blocks();
+}
+
+int main()
+{
+    std::mt19937 rnd (7);
+    bool ok = true;
+    for (uint32_t iter = 0; ok && iter < 4; ++iter) {
+        std::vector<uint8_t> input (200000 + rnd() % 300000);
+        for (auto &byte : input)
+            byte = static_cast<uint8_t> (rnd());
+        Enc enc (input.data(), input.data() + input.size(), symbol_bytes,
+                                                        symbol_bytes, 40000);
+        enc.compute (RFC6330::Compute::COMPLETE |
+                                    RFC6330::Compute::NO_BACKGROUND).get();
+        const bool pool = iter % 2 == 0;
+        if (!test_distinct (enc, input, pool)) {
+            std::cout << "distinct blocks failed\n";
+            ok = false;
+        } else if (!test_shared (enc, input, pool)) {
+            std::cout << "shared blocks failed\n";
+            ok = false;
+        }
+    }
+    if (!ok) {
+        std::cout << "Block slots test FAILED\n";
+        return 1;
+    }
+    std::cout << "Block slots test OK\n";
+    return 0;
+}
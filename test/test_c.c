@@ -18,11 +18,13 @@
  * along with libRaptorQ.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include "../src/RaptorQ/RaptorQ.h"
 #include "../src/RaptorQ/RFC6330.h"
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 #include <math.h>
 
@@ -343,6 +345,374 @@ bool decode (struct RFC6330_v1 *rfc, uint32_t mysize, float drop_prob,
     return true;
 }
 
+// Batched calls of the RAW interface: encode_symbols, add_symbols and
+// decode_range, with symbols back to back in a single buffer.
+// Checked against the one-symbol calls, with a "size" too short for the
+// whole batch, and with the wrong kind of handle (that must return 0).
+bool bulk (struct RaptorQ_v1 *raw, RaptorQ_type enc_type,
+                        RaptorQ_type dec_type, RaptorQ_Block_Size block);
+bool bulk (struct RaptorQ_v1 *raw, RaptorQ_type enc_type,
+                        RaptorQ_type dec_type, RaptorQ_Block_Size block)
+{
+    const size_t symbol_size = 64;
+    const size_t elem_size = (enc_type == RQ_ENC_8 ? 1 : 4);
+    const size_t symbols = (size_t) block;
+    const size_t bytes = symbols * symbol_size;
+    bool ok = true;
+
+    uint8_t *myvec = (uint8_t *) malloc (bytes);
+    for (size_t i = 0; i < bytes; ++i)
+        myvec[i] = (uint8_t) rand();
+    // every 5th source symbol is lost, repair symbols make up for it.
+    const size_t n = symbols + symbols / 4 + 10;
+    uint32_t *esi = (uint32_t *) malloc (n * sizeof(uint32_t));
+    size_t esi_count = 0;
+    for (uint32_t id = 0; esi_count < n; ++id) {
+        if (id >= symbols || id % 5 != 1)
+            esi[esi_count++] = id;
+    }
+    uint8_t *encoded = (uint8_t *) malloc (n * symbol_size);
+    uint8_t *one = (uint8_t *) malloc (symbol_size);
+    uint8_t *received = (uint8_t *) malloc (bytes);
+
+    struct RaptorQ_ptr *enc = raw->Encoder (enc_type, block, symbol_size);
+    struct RaptorQ_ptr *dec = raw->Decoder (dec_type, block, symbol_size,
+                                                                RQ_COMPLETE);
+    void *from = myvec;
+    // "size" in elements, but the result is in bytes
+    if (!raw->initialized (enc) || !raw->initialized (dec) ||
+                    raw->set_data (enc, &from, bytes / elem_size) != bytes) {
+        fprintf(stderr, "bulk: could not initialize\n");
+        ok = false;
+    }
+
+    // a short buffer only gets the symbols that fit whole
+    if (ok && raw->encode_symbols (enc, encoded, 3 * symbol_size + 1,
+                                                            esi, n) != 3) {
+        fprintf(stderr, "bulk: short encode_symbols\n");
+        ok = false;
+    }
+    if (ok && raw->encode_symbols (enc, encoded, n * symbol_size,
+                                                            esi, n) != n) {
+        fprintf(stderr, "bulk: encode_symbols\n");
+        ok = false;
+    }
+    for (size_t i = 0; ok && i < n; ++i) {
+        void *data = one;
+        if (raw->encode (enc, &data, symbol_size / elem_size, esi[i]) !=
+                                                    symbol_size / elem_size ||
+                    memcmp (one, encoded + i * symbol_size, symbol_size) != 0) {
+            fprintf(stderr, "bulk: symbol %u differs from encode()\n", esi[i]);
+            ok = false;
+        }
+    }
+
+    // wrong handles
+    if (ok && (raw->encode_symbols (dec, encoded, n * symbol_size, esi, n) != 0
+                || raw->add_symbols (enc, encoded, n * symbol_size, esi, n) != 0
+                || raw->decode_range (enc, received, bytes, 0) != 0)) {
+        fprintf(stderr, "bulk: wrong handle type accepted\n");
+        ok = false;
+    }
+
+    // nothing decoded yet: nothing written
+    if (ok && raw->decode_range (dec, received, bytes, 0) != 0) {
+        fprintf(stderr, "bulk: decode_range before the symbols\n");
+        ok = false;
+    }
+    // a short buffer: only the first 2 symbols, then the rest
+    if (ok && raw->add_symbols (dec, encoded, 2 * symbol_size + 1,
+                                                            esi, n) != 2) {
+        fprintf(stderr, "bulk: short add_symbols\n");
+        ok = false;
+    }
+    if (ok && raw->add_symbols (dec, encoded + 2 * symbol_size,
+                                        (n - 2) * symbol_size,
+                                        esi + 2, n - 2) != n - 2) {
+        fprintf(stderr, "bulk: add_symbols\n");
+        ok = false;
+    }
+    if (ok && raw->decode_once (dec) != RQ_DEC_DECODED) {
+        fprintf(stderr, "bulk: could not decode\n");
+        ok = false;
+    }
+    if (ok && (raw->decode_range (dec, received, bytes, 0) != bytes ||
+                                        memcmp (received, myvec, bytes) != 0)) {
+        fprintf(stderr, "bulk: decode_range\n");
+        ok = false;
+    }
+    // a range in the middle, and one past the end of the block
+    memset (received, 0, bytes);
+    if (ok && (raw->decode_range (dec, received, 100, 37) != 100 ||
+                                memcmp (received, myvec + 37, 100) != 0 ||
+                                received[100] != 0)) {
+        fprintf(stderr, "bulk: partial decode_range\n");
+        ok = false;
+    }
+    if (ok && raw->decode_range (dec, received, bytes, bytes) != 0) {
+        fprintf(stderr, "bulk: decode_range past the end\n");
+        ok = false;
+    }
+
+    if (ok)
+        printf("Bulk: %zu symbols\n", symbols);
+    raw->free (&enc);
+    raw->free (&dec);
+    free (received);
+    free (one);
+    free (encoded);
+    free (esi);
+    free (myvec);
+    return ok;
+}
+
+// Batched RFC packets: encode_packets, then add_packets with and without
+// the per-packet status. Every 4th source packet is lost, the repair
+// packets make up for it.
+bool packets (struct RFC6330_v1 *rfc);
+bool packets (struct RFC6330_v1 *rfc)
+{
+    const size_t bytes = 20000;
+    const uint16_t symbol_size = 64;
+    bool ok = true;
+
+    uint8_t *myvec = (uint8_t *) malloc (bytes);
+    uint8_t *received = (uint8_t *) malloc (bytes);
+    for (size_t i = 0; i < bytes; ++i)
+        myvec[i] = (uint8_t) rand();
+
+    struct RFC6330_ptr *enc = rfc->Encoder (RQ_ENC_8, myvec, bytes,
+                                                symbol_size, symbol_size, 4000);
+    struct RFC6330_future *async_enc = rfc->compute (enc,
+                                RQ_COMPUTE_COMPLETE | RQ_COMPUTE_NO_BACKGROUND);
+    rfc->future_wait (async_enc);
+    rfc->future_free (&async_enc);
+
+    const uint8_t blocks = rfc->blocks (enc);
+    struct RFC6330_Packet_Range *ranges = (struct RFC6330_Packet_Range *)
+                    malloc (blocks * sizeof(struct RFC6330_Packet_Range));
+    size_t total = 0;
+    for (uint8_t sbn = 0; sbn < blocks; ++sbn) {
+        ranges[sbn].sbn = sbn;
+        ranges[sbn].esi = 0;
+        const uint32_t K = rfc->symbols (enc, sbn);
+        ranges[sbn].symbols = K + K / 4 + 10u;
+        total += ranges[sbn].symbols;
+    }
+    const size_t stride = rfc->packet_stride (enc);
+    uint8_t *buffer = (uint8_t *) malloc (total * stride);
+    struct RFC6330_Packet *pkts = (struct RFC6330_Packet *)
+                                malloc (total * sizeof(struct RFC6330_Packet));
+    RFC6330_Error *status = (RFC6330_Error *)
+                                        malloc (total * sizeof(RFC6330_Error));
+    if (rfc->encode_packets (enc, ranges, blocks, buffer, total * stride,
+                                                    pkts, total) != total) {
+        fprintf(stderr, "packets: encode_packets\n");
+        ok = false;
+    }
+    // drop every 4th source packet
+    size_t kept = 0;
+    for (size_t i = 0; ok && i < total; ++i) {
+        const uint8_t *id = (const uint8_t *) pkts[i].data;
+        const uint32_t esi = ((uint32_t) id[1] << 16) |
+                                            ((uint32_t) id[2] << 8) | id[3];
+        if (esi < rfc->symbols (enc, id[0]) && esi % 4 == 1)
+            continue;
+        pkts[kept++] = pkts[i];
+    }
+
+    struct RFC6330_ptr *dec = rfc->Decoder (RQ_DEC_8, rfc->OTI_Common (enc),
+                                            rfc->OTI_Scheme_Specific (enc));
+    struct RFC6330_future *async_dec = rfc->compute (dec, RQ_COMPUTE_COMPLETE);
+    // the first half with the status, the rest without
+    const size_t half = kept / 2;
+    if (ok && rfc->add_packets (dec, pkts, half, status) != half) {
+        fprintf(stderr, "packets: add_packets\n");
+        ok = false;
+    }
+    for (size_t i = 0; ok && i < half; ++i) {
+        if (status[i] != RQ_ERR_NONE) {
+            fprintf(stderr, "packets: status %zu: %d\n", i, (int) status[i]);
+            ok = false;
+        }
+    }
+    if (ok && rfc->add_packets (dec, pkts + half, kept - half, NULL) == 0) {
+        fprintf(stderr, "packets: add_packets without status\n");
+        ok = false;
+    }
+    // an encoder is not a decoder: nothing added, every status set
+    status[0] = RQ_ERR_NONE;
+    if (ok && (rfc->add_packets (enc, pkts, 1, status) != 0 ||
+                                        status[0] != RQ_ERR_INITIALIZATION)) {
+        fprintf(stderr, "packets: add_packets on an encoder\n");
+        ok = false;
+    }
+    rfc->future_wait (async_dec);
+    struct RFC6330_Result dec_stat = rfc->future_get (async_dec);
+    rfc->future_free (&async_dec);
+    void *rec = received;
+    if (ok && (dec_stat.error != RQ_ERR_NONE ||
+                    rfc->decode_bytes (dec, &rec, bytes, 0) != bytes ||
+                                    memcmp (received, myvec, bytes) != 0)) {
+        fprintf(stderr, "packets: could not decode\n");
+        ok = false;
+    }
+    // every block was computed by the encoder and decoded from repair symbols
+    struct RaptorQ_Stats_Summary summary;
+    for (uint8_t sbn = 0; ok && sbn < blocks; ++sbn) {
+        if (rfc->stats (enc, sbn).total == 0 ||
+                                        rfc->stats (dec, sbn).total == 0) {
+            fprintf(stderr, "packets: no stats for block %u\n", (unsigned) sbn);
+            ok = false;
+        }
+    }
+    if (ok && (rfc->stats (dec, blocks).total != 0 ||
+                !rfc->stats_summary (RQ_STATS_DECODER, &summary) ||
+                                    summary.total.count < blocks ||
+                                    rfc->metrics_prometheus (NULL, 0) == 0)) {
+        fprintf(stderr, "packets: wrong stats\n");
+        ok = false;
+    }
+
+    if (ok)
+        printf("Packets: %zu in %u blocks\n", total, (unsigned) blocks);
+    rfc->free (&dec);
+    rfc->free (&enc);
+    free (status);
+    free (pkts);
+    free (buffer);
+    free (ranges);
+    free (received);
+    free (myvec);
+    return ok;
+}
+
+// streaming encoder: all blocks fed, then each one is encoded until
+// its repair budget is used up. The last one has no budget: free_block.
+bool stream (struct RFC6330_v1 *rfc);
+bool stream (struct RFC6330_v1 *rfc)
+{
+    const size_t bytes = 20000;
+    const uint16_t symbol_size = 64;
+    bool ok = true;
+
+    uint8_t *myvec = (uint8_t *) malloc (bytes);
+    uint8_t *received = (uint8_t *) malloc (bytes);
+    uint8_t *sym = (uint8_t *) malloc (symbol_size);
+    for (size_t i = 0; i < bytes; ++i)
+        myvec[i] = (uint8_t) rand();
+
+    struct RFC6330_ptr *enc = rfc->Encoder_stream (RQ_ENC_8, bytes,
+                                                symbol_size, symbol_size, 4000);
+    const uint8_t blocks = rfc->blocks (enc);
+    size_t offset = 0;
+    for (uint8_t sbn = 0; ok && sbn < blocks; ++sbn) {
+        const uint32_t K = rfc->symbols (enc, sbn);
+        const uint32_t budget = sbn == blocks - 1 ? 0 : K / 4 + 10u;
+        size_t size = K * (size_t) symbol_size;
+        if (size > bytes - offset)
+            size = bytes - offset;
+        if (rfc->feed (enc, sbn, myvec + offset, size - 1, budget) !=
+                                                        RQ_ERR_WRONG_INPUT ||
+                rfc->feed (enc, sbn, myvec + offset, size, budget) !=
+                                                        RQ_ERR_NONE) {
+            fprintf(stderr, "stream: feed of block %u\n", (unsigned) sbn);
+            ok = false;
+        }
+        offset += size;
+    }
+    struct RFC6330_future *async_enc = rfc->compute (enc, RQ_COMPUTE_COMPLETE);
+    rfc->future_wait (async_enc);
+    rfc->future_free (&async_enc);
+
+    struct RFC6330_ptr *dec = rfc->Decoder (RQ_DEC_8, rfc->OTI_Common (enc),
+                                            rfc->OTI_Scheme_Specific (enc));
+    struct RFC6330_future *async_dec = rfc->compute (dec, RQ_COMPUTE_COMPLETE);
+    offset = 0;
+    for (uint8_t sbn = 0; ok && sbn < blocks; ++sbn) {
+        const uint32_t K = rfc->symbols (enc, sbn);
+        size_t size = K * (size_t) symbol_size;
+        if (size > bytes - offset)
+            size = bytes - offset;
+        // drop every 4th source symbol
+        for (uint32_t esi = 0; ok && esi < K + K / 4 + 10u; ++esi) {
+            if (esi < K && esi % 4 == 1)
+                continue;
+            void *data = sym;
+            if (rfc->encode (enc, &data, symbol_size, esi, sbn) !=
+                                                                symbol_size) {
+                fprintf(stderr, "stream: block %u esi %u\n", (unsigned) sbn,
+                                                                esi);
+                ok = false;
+                break;
+            }
+            data = sym;
+            rfc->add_symbol (dec, &data, symbol_size, esi, sbn);
+        }
+        if (sbn == blocks - 1)
+            rfc->free_block (enc, sbn);
+        // released: nothing more to encode, and no new data
+        void *data = sym;
+        if (ok && (rfc->encode (enc, &data, symbol_size, 0, sbn) != 0 ||
+                    rfc->feed (enc, sbn, myvec + offset, size, 1) !=
+                                                        RQ_ERR_NOT_NEEDED)) {
+            fprintf(stderr, "stream: block %u not released\n", (unsigned) sbn);
+            ok = false;
+        }
+        offset += size;
+    }
+    rfc->future_wait (async_dec);
+    struct RFC6330_Result dec_stat = rfc->future_get (async_dec);
+    rfc->future_free (&async_dec);
+    void *rec = received;
+    if (ok && (dec_stat.error != RQ_ERR_NONE ||
+                    rfc->decode_bytes (dec, &rec, bytes, 0) != bytes ||
+                                    memcmp (received, myvec, bytes) != 0)) {
+        fprintf(stderr, "stream: could not decode\n");
+        ok = false;
+    }
+
+    if (ok)
+        printf("Stream: %u blocks\n", (unsigned) blocks);
+    rfc->free (&dec);
+    rfc->free (&enc);
+    free (sym);
+    free (received);
+    free (myvec);
+    return ok;
+}
+
+// metrics_prometheus() works like snprintf: the whole length is returned
+// even when the buffer is too small, and the text is always terminated
+bool prometheus (struct RaptorQ_v1 *raw);
+bool prometheus (struct RaptorQ_v1 *raw)
+{
+    struct RaptorQ_Metrics met;
+    if (!raw->metrics (&met) || raw->metrics (NULL)) {
+        fprintf(stderr, "prometheus: metrics\n");
+        return false;
+    }
+    const size_t len = raw->metrics_prometheus (NULL, 0);
+    char *full = (char *) malloc (len + 1);
+    char small[32];
+    memset (small, 'x', sizeof(small));
+    bool ok = len > sizeof(small) &&
+                        raw->metrics_prometheus (full, len + 1) == len &&
+                        strlen (full) == len &&
+                        raw->metrics_prometheus (small, sizeof(small)) == len &&
+                        small[sizeof(small) - 1] == '\0' &&
+                        strncmp (small, full, sizeof(small) - 1) == 0;
+    // size 1: only the terminator
+    small[0] = 'x';
+    ok = ok && raw->metrics_prometheus (small, 1) == len && small[0] == '\0';
+    if (!ok)
+        fprintf(stderr, "prometheus: wrong text or length\n");
+    else
+        printf("Prometheus: %zu chars\n", len);
+    free (full);
+    return ok;
+}
+
 int main (void)
 {
 
@@ -357,15 +727,30 @@ int main (void)
 #ifdef RQ_USE_LZ4
     rfc->set_compression (RQ_COMPRESS_LZ4);
 #else
-    RaptorQ_set_compression (RQ_COMPRESS_NONE);
+    rfc->set_compression (RQ_COMPRESS_NONE);
 #endif
     rfc->local_cache_size (100*1024*1024);
     rfc->set_thread_pool (2, 2, RQ_WORK_ABORT_COMPUTATION);
     // encode and decode
-    bool ret = decode (rfc, 501, 20.0, 4);
+    bool ret = decode (rfc, 501, 20.0, 4) && packets (rfc) &&
+                                                                stream (rfc);
 
     RFC6330_free_api ((struct RFC6330_base_api**)&rfc);
 
+    struct RaptorQ_v1 *raw = (struct RaptorQ_v1*) RaptorQ_api (1);
+    if (raw == NULL) {
+        fprintf(stderr, "ERR: could not get RaptorQ API\n");
+        return 1;
+    }
+    const RaptorQ_Block_Size blocks[] = { RQ_Block_10, RQ_Block_101,
+                                                                RQ_Block_1002 };
+    for (size_t i = 0; ret && i < sizeof(blocks) / sizeof(blocks[0]); ++i) {
+        ret = bulk (raw, RQ_ENC_8, RQ_DEC_8, blocks[i]) &&
+                                bulk (raw, RQ_ENC_32, RQ_DEC_32, blocks[i]);
+    }
+    ret = ret && prometheus (raw);
+    RaptorQ_free_api ((struct RaptorQ_base_api**)&raw);
+
     return (ret == true ? 0 : -1);
 }
 
@@ -0,0 +1,298 @@
+/*
+ * Copyright (c) 2016-2017, Luca Fulchir<luca@fulchir.it>, All rights reserved.
+ *
+ * This file is part of "libRaptorQ".
+ *
+ * libRaptorQ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * libRaptorQ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * and a copy of the GNU Lesser General Public License
+ * along with libRaptorQ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// The codecs of the cached operations.
+// Sparse:
+//  * all-zero, all-dense and mixed round trips, with their exact sizes
+//  * truncated input, trailing bytes, mask bits past the end and output
+//    sizes over what the input can hold must be rejected
+// Framed LZ4 (only with LZ4):
+//  * single and multi-frame round trips, the big ones helped by the
+//    thread pool, with the same output as a single thread
+//  * truncated buffers and corrupted headers or frame tables must be
+//    rejected before anything is allocated
+
+#include "../src/RaptorQ/RaptorQ_v1_hdr.hpp"
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace RaptorQ = RaptorQ__v1;
+
+// compressible, but not trivially: runs of older bytes and some noise
+static std::vector<uint8_t> test_data (const size_t size)
+{
+    std::mt19937 rnd (42);
+    std::vector<uint8_t> data (size);
+    for (size_t idx = 0; idx < size; ++idx) {
+        if (idx < 100 || rnd() % 4 == 0)
+            data[idx] = static_cast<uint8_t> (rnd());
+        else
+            data[idx] = data[idx - 100];
+    }
+    return data;
+}
+
+static bool test_sparse_round_trip (const std::vector<uint8_t> &data,
+                                                    const size_t expected_size)
+{
+    const RaptorQ::Impl::Sparse_Codec sparse;
+    const auto encoded = sparse.encode (data);
+    if (encoded.size() != expected_size || sparse.decode (encoded) != data) {
+        std::cout << "sparse: round trip of " << data.size() << " bytes, " <<
+                        encoded.size() << " instead of " << expected_size <<
+                                                                        "\n";
+        return false;
+    }
+    return true;
+}
+
+static bool test_sparse()
+{
+    const RaptorQ::Impl::Sparse_Codec sparse;
+    const size_t sizes[] = { 1, 8, 1003 };
+    for (const size_t size : sizes) {
+        const size_t masks = (size + 7) / 8;
+        std::vector<uint8_t> dense (size);
+        for (size_t idx = 0; idx < size; ++idx)
+            dense[idx] = static_cast<uint8_t> (1 + idx % 255);
+        if (!test_sparse_round_trip (std::vector<uint8_t> (size, 0),
+                                                sizeof(uint32_t) + masks) ||
+                !test_sparse_round_trip (dense,
+                                        sizeof(uint32_t) + masks + size)) {
+            return false;
+        }
+    }
+    auto mixed = test_data (1003);
+    for (size_t idx = 0; idx < mixed.size(); idx += 3)
+        mixed[idx] = 0;
+    const auto encoded = sparse.encode (mixed);
+    if (sparse.decode (encoded) != mixed) {
+        std::cout << "sparse: mixed round trip\n";
+        return false;
+    }
+    // truncated anywhere, or with trailing bytes
+    for (size_t len = 0; len < encoded.size(); ++len) {
+        if (sparse.decode (encoded.data(), len).size() != 0) {
+            std::cout << "sparse: accepted truncated at " << len << "\n";
+            return false;
+        }
+    }
+    auto longer = encoded;
+    longer.push_back (1);
+    if (sparse.decode (longer).size() != 0) {
+        std::cout << "sparse: accepted trailing bytes\n";
+        return false;
+    }
+    // 1003 bytes: the last group has 3, the other mask bits must be 0
+    auto past_end = sparse.encode (std::vector<uint8_t> (1003, 0));
+    past_end.back() = 1 << 3;
+    past_end.push_back (1);
+    if (sparse.decode (past_end).size() != 0) {
+        std::cout << "sparse: accepted mask bits past the end\n";
+        return false;
+    }
+
+    // every mask byte holds at most 8 bytes: up to the bound it is fine,
+    // over it nothing must be allocated
+    std::vector<uint8_t> zeros (sizeof(uint32_t) + 10, 0);
+    uint32_t out_size = 8 * 10;
+    std::memcpy (zeros.data(), &out_size, sizeof(out_size));
+    if (sparse.decode (zeros) != std::vector<uint8_t> (out_size, 0)) {
+        std::cout << "sparse: output at the bound rejected\n";
+        return false;
+    }
+    const uint32_t over[] = { 8 * 10 + 1, 0xFFFFFFFF };
+    for (const uint32_t bad : over) {
+        std::memcpy (zeros.data(), &bad, sizeof(bad));
+        if (sparse.decode (zeros).size() != 0) {
+            std::cout << "sparse: accepted output size " << bad << "\n";
+            return false;
+        }
+    }
+    // only the header: no room for any output
+    out_size = 1;
+    if (sparse.decode (reinterpret_cast<const uint8_t *> (&out_size),
+                                            sizeof(out_size)).size() != 0) {
+        std::cout << "sparse: accepted a header without masks\n";
+        return false;
+    }
+    return true;
+}
+
+#ifdef RQ_USE_LZ4
+using LZ4_Enc = RaptorQ::Impl::LZ4<RaptorQ::Impl::LZ4_t::ENCODER>;
+using LZ4_Enc_HC = RaptorQ::Impl::LZ4<RaptorQ::Impl::LZ4_t::ENCODER_HC>;
+using LZ4_Dec = RaptorQ::Impl::LZ4<RaptorQ::Impl::LZ4_t::DECODER>;
+
+static uint32_t get_u32 (const std::vector<uint8_t> &buf, const size_t idx)
+{
+    uint32_t val;
+    std::memcpy (&val, buf.data() + idx * sizeof(uint32_t), sizeof(val));
+    return val;
+}
+
+static void set_u32 (std::vector<uint8_t> &buf, const size_t idx,
+                                                            const uint32_t val)
+    { std::memcpy (buf.data() + idx * sizeof(uint32_t), &val, sizeof(val)); }
+
+// must be rejected by both decoded_size and decode
+static bool rejected (const std::vector<uint8_t> &buf, const size_t size)
+{
+    LZ4_Dec dec;
+    return LZ4_Dec::decoded_size (buf.data(), size) == 0 &&
+                                    dec.decode (buf.data(), size).size() == 0;
+}
+
+template<typename Enc>
+static bool test_lz4_round_trip (const size_t size, const uint16_t threads)
+{
+    const auto data = test_data (size);
+    Enc enc;
+    const auto compressed = enc.encode (data, threads);
+    const uint32_t frames = static_cast<uint32_t> (
+                    (size + RaptorQ::Impl::lz4_frame_size - 1) /
+                                            RaptorQ::Impl::lz4_frame_size);
+    if (compressed.size() == 0 || compressed.size() >= size ||
+                                    get_u32 (compressed, 0) != size ||
+                                    get_u32 (compressed, 1) != frames) {
+        std::cout << "lz4: bad encoding of " << size << " bytes\n";
+        return false;
+    }
+    LZ4_Dec dec;
+    if (dec.decode (compressed) != data) {
+        std::cout << "lz4: round trip of " << size << " bytes\n";
+        return false;
+    }
+    // frames are independent: the pool must not change the output
+    if (threads != 1 && enc.encode (data, 1) != compressed) {
+        std::cout << "lz4: " << threads << " threads, different output\n";
+        return false;
+    }
+    // wrong destination size
+    std::vector<uint8_t> out (size + 1);
+    if (dec.decode (compressed.data(), compressed.size(), out.data(),
+                                                            size + 1) ||
+                dec.decode (compressed.data(), compressed.size(), out.data(),
+                                                                size - 1)) {
+        std::cout << "lz4: decoded in the wrong size\n";
+        return false;
+    }
+    return true;
+}
+
+static bool test_lz4_framing()
+{
+    const uint32_t frame = RaptorQ::Impl::lz4_frame_size;
+    const size_t size = 5 * frame + 1234;
+    const auto compressed = LZ4_Enc().encode (test_data (size), 1);
+    const uint32_t frames = get_u32 (compressed, 1);
+    const size_t head = 2 + frames;
+    if (frames != 6 || LZ4_Dec::decoded_size (compressed.data(),
+                                            compressed.size()) != size) {
+        std::cout << "lz4: bad frame header\n";
+        return false;
+    }
+    // truncated anywhere, or with trailing bytes
+    for (size_t len = 0; len < compressed.size(); ++len) {
+        if (!rejected (compressed, len)) {
+            std::cout << "lz4: accepted truncated at " << len << "\n";
+            return false;
+        }
+    }
+    auto longer = compressed;
+    longer.push_back (0);
+    if (!rejected (longer, longer.size())) {
+        std::cout << "lz4: accepted trailing bytes\n";
+        return false;
+    }
+
+    // corrupted header
+    const uint32_t bad_frames[] = { 0, frames - 1, frames + 1, 0xFFFFFFFF };
+    for (const uint32_t bad : bad_frames) {
+        auto copy = compressed;
+        set_u32 (copy, 1, bad);
+        if (!rejected (copy, copy.size())) {
+            std::cout << "lz4: accepted " << bad << " frames\n";
+            return false;
+        }
+    }
+    const uint32_t bad_sizes[] = { 0, (frames - 1) * frame,
+                                            frames * frame + 1, 0xFFFFFFFF };
+    for (const uint32_t bad : bad_sizes) {
+        auto copy = compressed;
+        set_u32 (copy, 0, bad);
+        if (!rejected (copy, copy.size())) {
+            std::cout << "lz4: accepted size " << bad << "\n";
+            return false;
+        }
+    }
+    // corrupted frame table: it must add up to the payload exactly
+    for (size_t idx = 2; idx < head; ++idx) {
+        const uint32_t frame_size = get_u32 (compressed, idx);
+        const uint32_t bad_table[] = { 0, frame_size - 1, frame_size + 1,
+                                                                0xFFFFFFFF };
+        for (const uint32_t bad : bad_table) {
+            auto copy = compressed;
+            set_u32 (copy, idx, bad);
+            if (!rejected (copy, copy.size())) {
+                std::cout << "lz4: accepted frame " << idx - 2 <<
+                                                        " size " << bad << "\n";
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static bool test_lz4()
+{
+    const size_t frame = RaptorQ::Impl::lz4_frame_size;
+    const size_t many = 4 * RaptorQ::Impl::lz4_frames_per_thread * frame;
+    return test_lz4_round_trip<LZ4_Enc> (1000, 0) &&
+            test_lz4_round_trip<LZ4_Enc> (frame, 0) &&
+            test_lz4_round_trip<LZ4_Enc> (frame + 1, 0) &&
+            test_lz4_round_trip<LZ4_Enc> (many + 777, 0) &&
+            test_lz4_round_trip<LZ4_Enc> (many, 3) &&
+            test_lz4_round_trip<LZ4_Enc_HC> (1000, 0) &&
+            test_lz4_round_trip<LZ4_Enc_HC> (many + 777, 0) &&
+            test_lz4_framing();
+}
+#endif
+
+int main()
+{
+    RFC6330__v1::set_thread_pool (4, 4, RFC6330__v1::Work_State::KEEP_WORKING);
+    if (!test_sparse()) {
+        std::cout << "Codecs test FAILED: sparse\n";
+        return 1;
+    }
+#ifdef RQ_USE_LZ4
+    if (!test_lz4()) {
+        std::cout << "Codecs test FAILED: lz4\n";
+        return 1;
+    }
+#else
+    std::cout << "lz4: not built, skipped\n";
+#endif
+    std::cout << "Codecs test OK\n";
+    return 0;
+}
@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2018, Luca Fulchir<luca@fulchir.it>, All rights reserved.
+ *
+ * This file is part of "libRaptorQ".
+ *
+ * libRaptorQ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * libRaptorQ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * and a copy of the GNU Lesser General Public License
+ * along with libRaptorQ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// The pool of RFC block decoders:
+//  * a decoder that is not pooled drops its repair symbols once decoded,
+//    a pooled one keeps them for the next block
+//  * decoders go back to the pool when their last reference is dropped,
+//    until the budget is used up
+//  * a reused decoder starts again from scratch, and decodes
+//  * shrinking the budget drops the idle decoders
+
+#include "../src/RaptorQ/RaptorQ_v1_hdr.hpp"
+#include "../src/RaptorQ/v1/Shared_Computation/Decoder_Pool.hpp"
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace RaptorQ = RaptorQ__v1;
+
+using Enc = RaptorQ::Encoder<uint8_t*, uint8_t*>;
+using Raw_Dec = RaptorQ::Impl::Raw_Decoder<uint8_t*>;
+using Pool = RaptorQ::Impl::Decoder_Pool<uint8_t*>;
+using Budget = RaptorQ::Impl::Decoder_Pool_Budget;
+
+static const RaptorQ::Block_Size block = RaptorQ::Block_Size::Block_101;
+static const uint16_t symbols = static_cast<uint16_t> (block);
+static const uint16_t symbol_bytes = 64;
+
+// lose every 4th source symbol, repair with a few more than needed.
+static bool decode (Raw_Dec &dec, Enc &enc)
+{
+    std::vector<uint8_t> sym (symbol_bytes);
+    for (uint32_t esi = 0; esi < symbols + symbols / 4 + 4u; ++esi) {
+        if (esi < symbols && esi % 4 == 1)
+            continue;
+        uint8_t *out = sym.data();
+        if (enc.encode (out, sym.data() + sym.size(), esi) != symbol_bytes)
+            return false;
+        uint8_t *in = sym.data();
+        if (dec.add_symbol (in, sym.data() + sym.size(), esi, false) !=
+                                                        RaptorQ::Error::NONE) {
+            return false;
+        }
+    }
+    RaptorQ::Work_State state = RaptorQ::Work_State::KEEP_WORKING;
+    return dec.decode (&state) == RaptorQ::Decoder_Result::DECODED;
+}
+
+// the repair storage is freed after decoding, unless the decoder is pooled
+static bool test_repair_memory (Enc &enc)
+{
+    Raw_Dec plain (block, symbol_bytes, 0);
+    const size_t empty = plain.bytes();
+    if (!decode (plain, enc) || plain.bytes() != empty) {
+        std::cout << "repair symbols kept: " << plain.bytes() << " bytes, " <<
+                                                        empty << " empty\n";
+        return false;
+    }
+    Raw_Dec pooled (block, symbol_bytes, 0);
+    pooled.keep_memory();
+    if (!decode (pooled, enc) || pooled.bytes() <= empty) {
+        std::cout << "repair symbols of a pooled decoder dropped\n";
+        return false;
+    }
+    return true;
+}
+
+static bool test_pool (Enc &enc)
+{
+    auto &budget = Budget::get();
+    // no budget: nothing comes back
+    RaptorQ::decoder_pool_size (0);
+    auto dec = Pool::get()->acquire (block, symbol_bytes, 0);
+    if (!decode (*dec, enc))
+        return false;
+    dec.reset();
+    if (budget.get_used() != 0) {
+        std::cout << "pool: decoder kept without budget\n";
+        return false;
+    }
+
+    // room for a single decoder
+    RaptorQ::decoder_pool_size (size_t (1) << 30);
+    auto first = Pool::get()->acquire (block, symbol_bytes, 0);
+    auto second = Pool::get()->acquire (block, symbol_bytes, 0);
+    if (!decode (*first, enc) || !decode (*second, enc))
+        return false;
+    const size_t idle_bytes = first->bytes();
+    RaptorQ::decoder_pool_size (idle_bytes + idle_bytes / 2);
+    const Raw_Dec *kept = first.get();
+    first.reset();
+    if (budget.get_used() != idle_bytes) {
+        std::cout << "pool: decoder not returned\n";
+        return false;
+    }
+    second.reset();
+    if (budget.get_used() != idle_bytes) {
+        std::cout << "pool: budget exceeded\n";
+        return false;
+    }
+
+    // reused: same decoder, as if just constructed
+    auto reused = Pool::get()->acquire (block, symbol_bytes, 0);
+    if (reused.get() != kept || budget.get_used() != 0) {
+        std::cout << "pool: decoder not reused\n";
+        return false;
+    }
+    if (reused->ready() || reused->is_stopped() || reused->has_symbol (0) ||
+                                reused->needed_symbols() != symbols ||
+                                reused->stats().total != 0) {
+        std::cout << "pool: decoder not reset\n";
+        return false;
+    }
+    if (!decode (*reused, enc)) {
+        std::cout << "pool: reused decoder failed\n";
+        return false;
+    }
+    // a different key is a different decoder
+    auto other = Pool::get()->acquire (block, symbol_bytes / 2, 0);
+    if (other.get() == kept)
+        return false;
+    other.reset();
+
+    // shrinking drops what is idle
+    reused.reset();
+    if (budget.get_used() == 0)
+        return false;
+    RaptorQ::decoder_pool_size (0);
+    if (budget.get_used() != 0) {
+        std::cout << "pool: not flushed\n";
+        return false;
+    }
+    return true;
+}
+
+int main()
+{
+    std::mt19937 rnd (3);
+    std::vector<uint8_t> data (symbols * symbol_bytes);
+    for (auto &byte : data)
+        byte = static_cast<uint8_t> (rnd());
+    Enc enc (block, symbol_bytes);
+    if (enc.set_data (data.data(), data.data() + data.size()) != data.size() ||
+                                                        !enc.compute_sync()) {
+        std::cout << "encoder failed\n";
+        return 1;
+    }
+    if (!test_repair_memory (enc) || !test_pool (enc)) {
+        std::cout << "Decoder pool test FAILED\n";
+        return 1;
+    }
+    std::cout << "Decoder pool test OK\n";
+    return 0;
+}
@@ -0,0 +1,229 @@
+/*
+ * Copyright (c) 2016-2017, Luca Fulchir<luca@fulchir.it>, All rights reserved.
+ *
+ * This file is part of "libRaptorQ".
+ *
+ * libRaptorQ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * libRaptorQ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * and a copy of the GNU Lesser General Public License
+ * along with libRaptorQ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// GF(256) products of gemm.hpp against the Octet arithmetic:
+//  * each kernel (plain, and ssse3/avx2 when the cpu has them) on 1 to 4
+//    rows of odd and SIMD-sized lengths
+//  * gf256_gemm with each kernel, on one thread and split on the pool,
+//    also when called from inside pool work.
+
+#include "../src/RaptorQ/RaptorQ_v1_hdr.hpp"
+#include "../src/RaptorQ/v1/gemm.hpp"
+#include "../src/RaptorQ/v1/Octet.hpp"
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace Impl = RaptorQ__v1::Impl;
+
+struct Kernel
+{
+    std::string name;
+    Impl::Gf256_Kernel fun;
+};
+
+static std::vector<Kernel> kernels()
+{
+    std::vector<Kernel> ret;
+    ret.push_back ({"plain", &Impl::gf256_add_mul_plain});
+#if RQ_GF256_X86
+    if (__builtin_cpu_supports ("ssse3"))
+        ret.push_back ({"ssse3", &Impl::gf256_add_mul_ssse3});
+    if (__builtin_cpu_supports ("avx2"))
+        ret.push_back ({"avx2", &Impl::gf256_add_mul_avx2});
+#endif
+    return ret;
+}
+
+static std::vector<uint8_t> random_bytes (std::mt19937_64 &rnd,
+                                                            const size_t size)
+{
+    std::uniform_int_distribution<uint16_t> byte (0, 255);
+    std::vector<uint8_t> ret (size);
+    for (auto &el : ret)
+        el = static_cast<uint8_t> (byte (rnd));
+    return ret;
+}
+
+// c = a * b with the Octet arithmetic
+static std::vector<uint8_t> octet_product (const std::vector<uint8_t> &a,
+                                            const std::vector<uint8_t> &b,
+                                            const size_t m, const size_t k,
+                                                            const size_t n)
+{
+    std::vector<uint8_t> c (m * n);
+    for (size_t row = 0; row < m; ++row) {
+        for (size_t col = 0; col < n; ++col) {
+            Impl::Octet sum (0);
+            for (size_t p = 0; p < k; ++p)
+                sum += Impl::Octet (a[row * k + p]) *
+                                                Impl::Octet (b[p * n + col]);
+            c[row * n + col] = static_cast<uint8_t> (sum);
+        }
+    }
+    return c;
+}
+
+static bool test_kernel (std::mt19937_64 &rnd, const Kernel &kernel)
+{
+    const size_t lengths[] = {1, 15, 16, 17, 31, 32, 33, 63, 64, 100, 4099};
+    for (const size_t len : lengths) {
+        for (uint8_t rows = 1; rows <= 4; ++rows) {
+            std::vector<std::vector<uint8_t>> src;
+            const uint8_t *src_ptr[4];
+            for (uint8_t idx = 0; idx < rows; ++idx) {
+                src.push_back (random_bytes (rnd, len));
+                src_ptr[idx] = src.back().data();
+            }
+            // keep the scalars 0, 1 and 255 in the mix
+            auto scalar = random_bytes (rnd, 4);
+            scalar[0] = static_cast<uint8_t> ((len % 3 == 0) ? 0 :
+                                            ((len % 3 == 1) ? 1 : 255));
+            auto dst = random_bytes (rnd, len);
+            auto expected = dst;
+            for (size_t i = 0; i < len; ++i) {
+                Impl::Octet sum (expected[i]);
+                for (uint8_t idx = 0; idx < rows; ++idx)
+                    sum += Impl::Octet (scalar[idx]) *
+                                                Impl::Octet (src[idx][i]);
+                expected[i] = static_cast<uint8_t> (sum);
+            }
+            kernel.fun (dst.data(), src_ptr, scalar.data(), rows, len);
+            if (dst != expected) {
+                std::cout << kernel.name << ": wrong result with " <<
+                                    static_cast<uint32_t> (rows) <<
+                                    " rows of " << len << " bytes\n";
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// mostly zero "a" rows, like the ones of the precode
+static std::vector<uint8_t> sparse_bytes (std::mt19937_64 &rnd,
+                                                            const size_t size)
+{
+    auto ret = random_bytes (rnd, size);
+    std::uniform_int_distribution<uint16_t> keep (0, 3);
+    for (auto &el : ret) {
+        if (keep (rnd) != 0)
+            el = 0;
+    }
+    return ret;
+}
+
+static bool test_gemm (std::mt19937_64 &rnd, const Kernel &kernel,
+                                const size_t m, const size_t k, const size_t n,
+                                                    const uint16_t threads)
+{
+    const auto a = sparse_bytes (rnd, m * k);
+    const auto b = random_bytes (rnd, k * n);
+    const auto expected = octet_product (a, b, m, k, n);
+    // garbage in "c": gf256_gemm must clear it
+    auto c = random_bytes (rnd, m * n);
+    Impl::gf256_gemm (c.data(), n, a.data(), k, b.data(), n, m, k, n,
+                                                        threads, kernel.fun);
+    if (c != expected) {
+        std::cout << kernel.name << ": wrong " << m << "x" << k << " * " <<
+                        k << "x" << n << " with " << threads << " threads\n";
+        return false;
+    }
+    return true;
+}
+
+// a big product started from a pool thread, while the other pool
+// threads are busy with the rest of its tiles.
+class Gemm_In_Pool final : public RFC6330__v1::Impl::Pool_Work
+{
+public:
+    Gemm_In_Pool (std::mt19937_64 &rnd, const Kernel &kernel, bool &result,
+                                    bool &done, std::mutex &mtx,
+                                    std::condition_variable &cond)
+        : _rnd (rnd), _kernel (kernel), _result (result), _done (done),
+                                                _mtx (mtx), _cond (cond) {}
+
+    RFC6330__v1::Work_Exit_Status do_work (RaptorQ__v1::Work_State *state)
+                                                                    override
+    {
+        RQ_UNUSED (state);
+        const bool res = test_gemm (_rnd, _kernel, 512, 256, 512, 8);
+        std::lock_guard<std::mutex> guard (_mtx);
+        RQ_UNUSED (guard);
+        _result = res;
+        _done = true;
+        _cond.notify_all();
+        return RFC6330__v1::Work_Exit_Status::DONE;
+    }
+private:
+    std::mt19937_64 &_rnd;
+    const Kernel _kernel;
+    bool &_result, &_done;
+    std::mutex &_mtx;
+    std::condition_variable &_cond;
+};
+
+int main()
+{
+    std::mt19937_64 rnd;
+    std::random_device rd;
+    const auto seed = rd();
+    rnd.seed (seed);
+    std::cout << "seed: " << seed << "\n";
+    RFC6330__v1::set_thread_pool (4, 4, RFC6330__v1::Work_State::KEEP_WORKING);
+
+    bool ok = true;
+    for (const auto &kernel : kernels()) {
+        std::cout << "kernel: " << kernel.name << "\n";
+        ok = ok && test_kernel (rnd, kernel);
+        // small, with a column tile edge, with a "b" panel edge
+        ok = ok && test_gemm (rnd, kernel, 7, 13, 33, 1);
+        ok = ok && test_gemm (rnd, kernel, 3, 5, 4097, 1);
+        ok = ok && test_gemm (rnd, kernel, 9, 300, 1000, 1);
+        // big enough to be split: 2^25 multiplications
+        ok = ok && test_gemm (rnd, kernel, 512, 256, 256, 1);
+        ok = ok && test_gemm (rnd, kernel, 512, 256, 256, 2);
+        ok = ok && test_gemm (rnd, kernel, 513, 256, 512, 8);
+        if (!ok)
+            break;
+        bool result = false, done = false;
+        std::mutex mtx;
+        std::condition_variable cond;
+        RFC6330__v1::Impl::Thread_Pool::get().add_work (
+                    std::unique_ptr<RFC6330__v1::Impl::Pool_Work> (
+                                        new Gemm_In_Pool (rnd, kernel, result,
+                                                        done, mtx, cond)));
+        std::unique_lock<std::mutex> lock (mtx);
+        while (!done)
+            cond.wait (lock);
+        ok = result;
+        if (!ok)
+            break;
+    }
+    if (!ok) {
+        std::cout << "GF(256) gemm test FAILED\n";
+        return 1;
+    }
+    std::cout << "GF(256) gemm test OK\n";
+    return 0;
+}
@@ -0,0 +1,295 @@
+/*
+ * Copyright (c) 2016-2017, Luca Fulchir<luca@fulchir.it>, All rights reserved.
+ *
+ * This file is part of "libRaptorQ".
+ *
+ * libRaptorQ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * libRaptorQ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * and a copy of the GNU Lesser General Public License
+ * along with libRaptorQ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// The process-wide metrics:
+//  * the local cache gauges follow the stored entries, evictions included
+//  * live encoders/decoders, run summaries and thread pool counters
+//    after encoding and decoding
+//  * Prometheus text: the "le" bound of every bucket, "+Inf", sum and count
+
+#include "../src/RaptorQ/RaptorQ_v1_hdr.hpp"
+#include "../src/RaptorQ/RFC6330_v1_hdr.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace RaptorQ = RaptorQ__v1;
+namespace RFC6330 = RFC6330__v1;
+
+using Enc = RaptorQ::Encoder<uint8_t*, uint8_t*>;
+using Dec = RaptorQ::Decoder<uint8_t*, uint8_t*>;
+
+using Local_Cache = RaptorQ::Impl::DLF<std::vector<uint8_t>,
+                                                    RaptorQ::Impl::Cache_Key>;
+
+static RaptorQ::Impl::Cache_Key test_key (const uint16_t id)
+{
+    return RaptorQ::Impl::Cache_Key (id, 0, 0, std::vector<bool>(),
+                                                        std::vector<bool>());
+}
+
+// cache_bytes must be the stored bytes plus a fixed overhead per entry
+static bool check_cache_bytes (const size_t entry_overhead)
+{
+    const auto met = RaptorQ::metrics();
+    const auto entries = RaptorQ::local_cache_stats();
+    size_t stored = 0;
+    for (const auto &entry : entries)
+        stored += entry.compressed + entry_overhead;
+    if (met.cache_entries != entries.size() || met.cache_bytes != stored ||
+                                    met.cache_bytes > met.cache_max_bytes) {
+        std::cout << "cache_bytes: " << met.cache_bytes << " expected: " <<
+                        stored << " max: " << met.cache_max_bytes <<
+                        " entries: " << met.cache_entries << "/" <<
+                                                    entries.size() << "\n";
+        return false;
+    }
+    return true;
+}
+
+static bool test_cache_bytes()
+{
+    const size_t entry_bytes = 1000;
+    RaptorQ::local_cache_size (4 * entry_bytes + 512);
+    auto *cache = Local_Cache::get();
+
+    std::vector<uint8_t> raw (entry_bytes, 1);
+    if (!cache->add (RaptorQ::Compress::NONE, raw, test_key (1))) {
+        std::cout << "cache: first entry rejected\n";
+        return false;
+    }
+    const auto first = RaptorQ::metrics();
+    if (first.cache_entries != 1 || first.cache_bytes <= entry_bytes) {
+        std::cout << "cache: first entry not accounted\n";
+        return false;
+    }
+    const size_t entry_overhead = first.cache_bytes - entry_bytes;
+    if (!check_cache_bytes (entry_overhead))
+        return false;
+
+    // the cache only holds 4 entries: the older ones must go
+    for (uint16_t id = 2; id < 20; ++id) {
+        raw.assign (entry_bytes, static_cast<uint8_t> (id));
+        cache->add (RaptorQ::Compress::NONE, raw, test_key (id));
+        if (!check_cache_bytes (entry_overhead))
+            return false;
+    }
+    if (RaptorQ::metrics().cache_evictions == 0) {
+        std::cout << "cache: nothing evicted\n";
+        return false;
+    }
+    // shrinking evicts, too
+    RaptorQ::local_cache_size (2 * entry_bytes + 256);
+    if (!check_cache_bytes (entry_overhead))
+        return false;
+    RaptorQ::local_cache_size (0);
+    if (!check_cache_bytes (entry_overhead) ||
+                                        RaptorQ::metrics().cache_bytes != 0) {
+        return false;
+    }
+    return true;
+}
+
+// one block encoded, then decoded with every 4th source symbol lost
+static bool test_encode_decode()
+{
+    const RaptorQ::Block_Size block = RaptorQ::Block_Size::Block_101;
+    const uint16_t symbols = static_cast<uint16_t> (block);
+    const size_t symbol_bytes = 64;
+    RaptorQ::stats_reset();
+    const auto before = RaptorQ::metrics();
+    {
+        std::vector<uint8_t> data (symbols * symbol_bytes);
+        for (size_t idx = 0; idx < data.size(); ++idx)
+            data[idx] = static_cast<uint8_t> (idx * 7);
+        Enc enc (block, symbol_bytes);
+        if (enc.set_data (data.data(), data.data() + data.size()) !=
+                                        data.size() || !enc.compute_sync()) {
+            return false;
+        }
+        Dec dec (block, symbol_bytes, Dec::Report::COMPLETE);
+        std::vector<uint8_t> sym (symbol_bytes);
+        for (uint32_t esi = 0; esi < symbols + symbols / 4 + 4u; ++esi) {
+            if (esi < symbols && esi % 4 == 1)
+                continue;
+            uint8_t *out = sym.data();
+            enc.encode (out, sym.data() + sym.size(), esi);
+            uint8_t *in = sym.data();
+            dec.add_symbol (in, sym.data() + sym.size(), esi);
+        }
+        if (dec.decode_once() != RaptorQ::Decoder_Result::DECODED)
+            return false;
+
+        const auto live = RaptorQ::metrics();
+        if (live.encoders != before.encoders + 1 ||
+                                live.decoders != before.decoders + 1 ||
+                                live.encoder_bytes <= before.encoder_bytes ||
+                                live.decoder_bytes <= before.decoder_bytes) {
+            std::cout << "metrics: live objects not counted\n";
+            return false;
+        }
+        const auto enc_sum = RaptorQ::stats_summary (
+                                                RaptorQ::Stats_Source::ENCODER);
+        const auto dec_sum = RaptorQ::stats_summary (
+                                                RaptorQ::Stats_Source::DECODER);
+        if (enc_sum.total.count != 1 || dec_sum.total.count != 1 ||
+                    dec_sum.overhead.count != 1 ||
+                    dec_sum.overhead.sum != enc.stats().overhead +
+                                                    dec.stats().overhead ||
+                    dec_sum.total.sum != dec.stats().total ||
+                    enc_sum.total.sum != enc.stats().total) {
+            std::cout << "metrics: runs not summarized\n";
+            return false;
+        }
+    }
+    const auto after = RaptorQ::metrics();
+    if (after.encoders != before.encoders ||
+                                after.decoders != before.decoders ||
+                                after.encoder_bytes != before.encoder_bytes ||
+                                after.decoder_bytes != before.decoder_bytes) {
+        std::cout << "metrics: live objects not released\n";
+        return false;
+    }
+
+    // RFC blocks are computed by the thread pool
+    std::vector<uint8_t> input (200000);
+    for (size_t idx = 0; idx < input.size(); ++idx)
+        input[idx] = static_cast<uint8_t> (idx * 13);
+    RFC6330::Encoder<uint8_t*, uint8_t*> rfc (input.data(),
+                                input.data() + input.size(), 16, 256, 4000);
+    if (rfc.compute (RFC6330::Compute::COMPLETE).get().first !=
+                                                        RFC6330::Error::NONE) {
+        return false;
+    }
+    // the block is ready a moment before its thread counts it as done
+    auto pooled = RaptorQ::metrics();
+    for (uint16_t wait = 0; wait < 1000 &&
+                    pooled.pool_done < after.pool_done + rfc.blocks(); ++wait) {
+        std::this_thread::sleep_for (std::chrono::milliseconds (5));
+        pooled = RaptorQ::metrics();
+    }
+    if (pooled.pool_threads == 0 ||
+                pooled.pool_enqueued < after.pool_enqueued + rfc.blocks() ||
+                pooled.pool_done < after.pool_done + rfc.blocks() ||
+                pooled.pool_work.count < after.pool_work.count + rfc.blocks()) {
+        std::cout << "metrics: pool work not counted\n";
+        return false;
+    }
+    return true;
+}
+
+// the "le" and value of the buckets of one histogram, in order
+static bool histogram_lines (const std::string &text, const std::string &name,
+                                            std::vector<std::string> &le,
+                                            std::vector<uint64_t> &value)
+{
+    const std::string start = name + "_bucket{source=\"decoder\",le=\"";
+    std::istringstream lines (text);
+    std::string line;
+    while (std::getline (lines, line)) {
+        if (line.compare (0, start.size(), start) != 0)
+            continue;
+        const size_t quote = line.find ('"', start.size());
+        if (quote == std::string::npos || line.compare (quote, 3, "\"} ") != 0)
+            return false;
+        le.push_back (line.substr (start.size(), quote - start.size()));
+        value.push_back (std::strtoull (line.c_str() + quote + 3, nullptr, 10));
+    }
+    return !le.empty();
+}
+
+static bool has_line (const std::string &text, const std::string &line)
+    { return text.find ("\n" + line + "\n") != std::string::npos; }
+
+static bool test_prometheus()
+{
+    // known values in the decoder overhead histogram
+    RaptorQ::stats_reset();
+    const uint32_t overheads[] = { 0, 1, 2, 3, 4, 1000 };
+    for (const uint32_t overhead : overheads) {
+        RaptorQ::Stats stats;
+        stats.overhead = overhead;
+        RaptorQ::Impl::Stats_Registry::get().add (
+                                        RaptorQ::Stats_Source::DECODER, stats);
+    }
+    const std::string text = RaptorQ::metrics_prometheus ("rq");
+    std::vector<std::string> le;
+    std::vector<uint64_t> value;
+    if (!histogram_lines (text, "rq_run_overhead_symbols", le, value) ||
+                                                            le.size() != 49) {
+        std::cout << "prometheus: buckets not found\n";
+        return false;
+    }
+    // bucket "idx" holds the values up to 2^idx - 1, cumulative
+    for (size_t idx = 0; idx + 1 < le.size(); ++idx) {
+        const uint64_t bound = (uint64_t (1) << idx) - 1;
+        uint64_t expected = 0;
+        for (const uint32_t overhead : overheads)
+            expected += overhead <= bound ? 1 : 0;
+        if (le[idx] != std::to_string (bound) || value[idx] != expected) {
+            std::cout << "prometheus: bucket " << idx << " le=" << le[idx] <<
+                                            " value " << value[idx] << "\n";
+            return false;
+        }
+    }
+    if (le.back() != "+Inf" || value.back() != 6 ||
+        !has_line (text,
+                "rq_run_overhead_symbols_sum{source=\"decoder\"} 1010") ||
+        !has_line (text,
+                "rq_run_overhead_symbols_count{source=\"decoder\"} 6") ||
+        !has_line (text, "# TYPE rq_run_overhead_symbols histogram")) {
+        std::cout << "prometheus: wrong +Inf, sum or count\n";
+        return false;
+    }
+    // every sample has the prefix
+    std::istringstream lines (text);
+    std::string line;
+    while (std::getline (lines, line)) {
+        if (line.empty() || (line[0] != '#' &&
+                                        line.compare (0, 3, "rq_") != 0)) {
+            std::cout << "prometheus: line without prefix: " << line << "\n";
+            return false;
+        }
+    }
+    RaptorQ::stats_reset();
+    return true;
+}
+
+int main (void)
+{
+    if (!test_cache_bytes()) {
+        std::cout << "FAILED: local cache gauges\n";
+        return 1;
+    }
+    if (!test_encode_decode()) {
+        std::cout << "FAILED: encoder and decoder metrics\n";
+        return 1;
+    }
+    if (!test_prometheus()) {
+        std::cout << "FAILED: prometheus text\n";
+        return 1;
+    }
+    std::cout << "All tests passed\n";
+    return 0;
+}
@@ -0,0 +1,328 @@
+/*
+ * Copyright (c) 2016-2017, Luca Fulchir<luca@fulchir.it>, All rights reserved.
+ *
+ * This file is part of "libRaptorQ".
+ *
+ * libRaptorQ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * libRaptorQ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * and a copy of the GNU Lesser General Public License
+ * along with libRaptorQ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// poll() of the RAW decoder, for each report mode:
+//  * PARTIAL_FROM_BEGINNING: the growing prefix of the received symbols,
+//    each prefix reported once
+//  * PARTIAL_ANY: each received symbol once, with many threads polling at
+//    the same time, both after and while the symbols are added
+//  * COMPLETE: nothing until the whole block is there
+// and then the whole block once it is decoded from repair symbols.
+// K both a multiple of 64 (the tracker word size) and not.
+
+#include "../src/RaptorQ/RaptorQ_v1_hdr.hpp"
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace RaptorQ = RaptorQ__v1;
+
+using Enc = RaptorQ::Encoder<uint8_t*, uint8_t*>;
+using Dec = RaptorQ::Decoder<uint8_t*, uint8_t*>;
+
+static const size_t test_symbol_bytes = 16;
+static const uint8_t pollers = 4;
+
+// a computed encoder, and the source symbols
+struct Block
+{
+    RaptorQ::Block_Size block;
+    uint16_t symbols;
+    std::vector<uint8_t> data;
+    std::unique_ptr<Enc> enc;
+};
+
+static bool make_block (std::mt19937_64 &rnd, const RaptorQ::Block_Size block,
+                                                                    Block &out)
+{
+    out.block = block;
+    out.symbols = static_cast<uint16_t> (block);
+    out.data.resize (out.symbols * test_symbol_bytes);
+    std::uniform_int_distribution<uint16_t> byte (0, 255);
+    for (auto &el : out.data)
+        el = static_cast<uint8_t> (byte (rnd));
+    out.enc.reset (new Enc (block, test_symbol_bytes));
+    if (out.enc->set_data (out.data.data(), out.data.data() + out.data.size())
+                                                        != out.data.size()) {
+        return false;
+    }
+    return out.enc->compute_sync();
+}
+
+static bool add (Dec &dec, Block &blk, const uint32_t esi)
+{
+    std::vector<uint8_t> sym (test_symbol_bytes);
+    uint8_t *out = sym.data();
+    if (blk.enc->encode (out, sym.data() + sym.size(), esi) !=
+                                                        test_symbol_bytes) {
+        return false;
+    }
+    uint8_t *in = sym.data();
+    return dec.add_symbol (in, sym.data() + sym.size(), esi) ==
+                                                        RaptorQ::Error::NONE;
+}
+
+// nothing new to report, and nobody is decoding
+static bool nothing_new (Dec &dec)
+{
+    const auto res = dec.poll();
+    return res.error == RaptorQ::Error::NEED_DATA;
+}
+
+// add repair symbols until the block decodes
+static bool decode_with_repair (Dec &dec, Block &blk)
+{
+    uint32_t esi = blk.symbols;
+    for (uint16_t idx = 0; idx < dec.needed_symbols() + 2u; ++idx) {
+        if (!add (dec, blk, esi++))
+            return false;
+    }
+    while (dec.decode_once() != RaptorQ::Decoder_Result::DECODED) {
+        if (!add (dec, blk, esi++))
+            return false;
+    }
+    return true;
+}
+
+static bool test_from_beginning (std::mt19937_64 &rnd, Block &blk)
+{
+    Dec dec (blk.block, test_symbol_bytes, Dec::Report::PARTIAL_FROM_BEGINNING);
+    if (!nothing_new (dec))
+        return false;
+    // a prefix that ends just before a tracker word, when there is one
+    const uint16_t prefix = std::min<uint16_t> (63, blk.symbols / 2);
+    // symbols after the hole do not count
+    const uint16_t after = static_cast<uint16_t> (std::min<uint32_t> (
+                                        blk.symbols - 1u, prefix + 1u + (
+                                        std::uniform_int_distribution<uint16_t>
+                                                            (0, 100) (rnd))));
+    for (uint16_t esi = prefix + 1u; esi <= after; ++esi) {
+        if (!add (dec, blk, esi))
+            return false;
+    }
+    if (!nothing_new (dec))
+        return false;
+    for (uint16_t esi = 0; esi < prefix; ++esi) {
+        if (!add (dec, blk, esi))
+            return false;
+    }
+    auto res = dec.poll();
+    if (prefix != 0 && (res.error != RaptorQ::Error::NONE ||
+                                                    res.symbol != prefix)) {
+        std::cout << "FROM_BEGINNING: got " << res.symbol << " instead of " <<
+                                                                prefix << "\n";
+        return false;
+    }
+    if (!nothing_new (dec))
+        return false;
+    // fill the hole: everything up to "after" is there now
+    if (!add (dec, blk, prefix))
+        return false;
+    res = dec.poll();
+    const uint32_t expected = after + 1u;
+    if (res.error != RaptorQ::Error::NONE || res.symbol != expected) {
+        std::cout << "FROM_BEGINNING: got " << res.symbol << " instead of " <<
+                                                            expected << "\n";
+        return false;
+    }
+    // with the whole block there, poll() keeps reporting all of it
+    if (expected < blk.symbols) {
+        if (!nothing_new (dec) || !decode_with_repair (dec, blk))
+            return false;
+    }
+    res = dec.poll();
+    if (res.error != RaptorQ::Error::NONE || res.symbol != blk.symbols) {
+        std::cout << "FROM_BEGINNING: decoded block not reported\n";
+        return false;
+    }
+    dec.clear_data();
+    return nothing_new (dec);
+}
+
+// poll from many threads until the decoder has nothing more.
+// "seen" counts the reports of each symbol. "stop": keep polling
+// until it is set, for the symbols that are still being added.
+static bool poll_any (Dec &dec, const uint16_t symbols,
+                                    std::vector<std::atomic<uint32_t>> &seen,
+                                    const std::atomic<bool> *stop)
+{
+    std::atomic<bool> wrong (false);
+    std::vector<std::thread> threads;
+    for (uint8_t idx = 0; idx < pollers; ++idx) {
+        threads.emplace_back ([&]() {
+            for (;;) {
+                const auto res = dec.poll();
+                if (res.error == RaptorQ::Error::NONE) {
+                    if (res.symbol == symbols)
+                        break;
+                    if (res.symbol > symbols) {
+                        wrong = true;
+                        break;
+                    }
+                    ++seen[res.symbol];
+                    continue;
+                }
+                if (stop == nullptr || *stop)
+                    break;
+                std::this_thread::yield();
+            }
+        });
+    }
+    for (auto &th : threads)
+        th.join();
+    return !wrong;
+}
+
+static bool test_any (std::mt19937_64 &rnd, Block &blk)
+{
+    Dec dec (blk.block, test_symbol_bytes, Dec::Report::PARTIAL_ANY);
+    if (!nothing_new (dec))
+        return false;
+    std::vector<uint16_t> order (blk.symbols);
+    for (uint16_t esi = 0; esi < blk.symbols; ++esi)
+        order[esi] = esi;
+    std::shuffle (order.begin(), order.end(), rnd);
+
+    // first quarter added before polling, the second while polling.
+    const size_t first = order.size() / 4;
+    const size_t second = order.size() / 2;
+    std::vector<std::atomic<uint32_t>> seen (blk.symbols);
+    for (auto &el : seen)
+        el = 0;
+    for (size_t idx = 0; idx < first; ++idx) {
+        if (!add (dec, blk, order[idx]))
+            return false;
+    }
+    if (!poll_any (dec, blk.symbols, seen, nullptr))
+        return false;
+    for (size_t idx = 0; idx < blk.symbols; ++idx) {
+        const uint32_t expected = idx < first ? 1 : 0;
+        if (seen[order[idx]] != expected) {
+            std::cout << "PARTIAL_ANY: symbol " << order[idx] << " reported " <<
+                                                seen[order[idx]] << " times\n";
+            return false;
+        }
+    }
+    std::atomic<bool> stop (false);
+    bool added = true;
+    std::thread adder ([&]() {
+        for (size_t idx = first; idx < second; ++idx)
+            added = added && add (dec, blk, order[idx]);
+        stop = true;
+    });
+    const bool polled = poll_any (dec, blk.symbols, seen, &stop);
+    adder.join();
+    // the last symbols might have come after the last poll
+    if (!polled || !added || !poll_any (dec, blk.symbols, seen, nullptr))
+        return false;
+    for (size_t idx = 0; idx < blk.symbols; ++idx) {
+        const uint32_t expected = idx < second ? 1 : 0;
+        if (seen[order[idx]] != expected) {
+            std::cout << "PARTIAL_ANY: symbol " << order[idx] << " reported " <<
+                                                seen[order[idx]] << " times\n";
+            return false;
+        }
+    }
+    if (!nothing_new (dec) || !decode_with_repair (dec, blk))
+        return false;
+    const auto res = dec.poll();
+    if (res.error != RaptorQ::Error::NONE || res.symbol != blk.symbols) {
+        std::cout << "PARTIAL_ANY: decoded block not reported\n";
+        return false;
+    }
+    dec.clear_data();
+    return nothing_new (dec);
+}
+
+static bool test_complete (std::mt19937_64 &rnd, Block &blk)
+{
+    Dec dec (blk.block, test_symbol_bytes, Dec::Report::COMPLETE);
+    std::vector<uint16_t> order (blk.symbols);
+    for (uint16_t esi = 0; esi < blk.symbols; ++esi)
+        order[esi] = esi;
+    std::shuffle (order.begin(), order.end(), rnd);
+    // all but one source symbol: nothing to report
+    for (size_t idx = 0; idx + 1 < order.size(); ++idx) {
+        if (!add (dec, blk, order[idx]))
+            return false;
+        if (idx % 64 == 0 && !nothing_new (dec)) {
+            std::cout << "COMPLETE: reported early\n";
+            return false;
+        }
+    }
+    if (!nothing_new (dec)) {
+        std::cout << "COMPLETE: reported early\n";
+        return false;
+    }
+    if (!decode_with_repair (dec, blk))
+        return false;
+    const auto res = dec.poll();
+    if (res.error != RaptorQ::Error::NONE) {
+        std::cout << "COMPLETE: decoded block not reported\n";
+        return false;
+    }
+    dec.clear_data();
+    return nothing_new (dec);
+}
+
+int main()
+{
+    std::mt19937_64 rnd;
+    std::random_device rd;
+    const auto seed = rd();
+    rnd.seed (seed);
+    std::cout << "seed: " << seed << "\n";
+
+    // 1152 and 1600 are multiples of 64, the others are not.
+    const RaptorQ::Block_Size blocks[] = { RaptorQ::Block_Size::Block_10,
+                                            RaptorQ::Block_Size::Block_26,
+                                            RaptorQ::Block_Size::Block_101,
+                                            RaptorQ::Block_Size::Block_1002,
+                                            RaptorQ::Block_Size::Block_1152,
+                                            RaptorQ::Block_Size::Block_1600 };
+    bool ok = true;
+    for (const auto block : blocks) {
+        Block blk;
+        if (!make_block (rnd, block, blk)) {
+            std::cout << "can not encode " << static_cast<uint32_t> (block) <<
+                                                                " symbols\n";
+            ok = false;
+            break;
+        }
+        std::cout << "K: " << blk.symbols << "\n";
+        // the big blocks take most of the time to decode
+        const uint8_t runs = blk.symbols < 1000 ? 5 : 1;
+        for (uint8_t run = 0; ok && run < runs; ++run) {
+            ok = test_from_beginning (rnd, blk) && test_any (rnd, blk) &&
+                                                    test_complete (rnd, blk);
+        }
+        if (!ok)
+            break;
+    }
+    if (!ok) {
+        std::cout << "Poll test FAILED\n";
+        return 1;
+    }
+    std::cout << "Poll test OK\n";
+    return 0;
+}
@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2016-2017, Luca Fulchir<luca@fulchir.it>, All rights reserved.
+ *
+ * This file is part of "libRaptorQ".
+ *
+ * libRaptorQ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * libRaptorQ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * and a copy of the GNU Lesser General Public License
+ * along with libRaptorQ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// The precode solver must give the same results no matter how it gets there:
+//  * phase 2 with the precomputed xor tables always on, or never used
+//  * phase 1 with the RFC or the LOOKAHEAD pivots
+//  * the recorded operations, replayed one row at a time, must give the
+//    same intermediate symbols
+//  * the intermediate symbols must encode back to the original data
+
+#include "../src/RaptorQ/RaptorQ_v1_hdr.hpp"
+#include "../src/RaptorQ/v1/Precode_Matrix.hpp"
+#include <iostream>
+#include <limits>
+#include <random>
+#include <vector>
+
+namespace RaptorQ = RaptorQ__v1;
+using RaptorQ::Impl::DenseMtx;
+using RaptorQ::Impl::Op_Log;
+using RaptorQ::Impl::Precode_Matrix;
+
+struct Solved
+{
+    bool ok;
+    DenseMtx C;
+    std::vector<uint8_t> ops;
+};
+
+static Solved solve (const RaptorQ::Impl::Parameters &params,
+                                const DenseMtx &D, const size_t table_rows,
+                                const RaptorQ::Pivot pivot)
+{
+    Solved ret;
+    Precode_Matrix<RaptorQ::Impl::Save_Computation::ON> precode (params);
+    precode.set_phase2_table_rows (table_rows);
+    precode.set_pivot (pivot);
+    precode.gen (0);
+    DenseMtx work = D;
+    Op_Log ops;
+    bool keep_working = true;
+    const RaptorQ::Work_State state = RaptorQ::Work_State::KEEP_WORKING;
+    const auto res = precode.intermediate (work, ops, keep_working, &state);
+    ret.ok = res.first == RaptorQ::Impl::Precode_Result::DONE;
+    ret.C = res.second;
+    ret.ops = ops.serialize();
+    if (!ret.ok)
+        return ret;
+
+    // replay the operations one at a time on the original data
+    DenseMtx replayed = D;
+    ops.replay (replayed);
+    if (replayed.block (0, 0, params.L, D.cols()) != ret.C) {
+        std::cout << "replayed operations differ\n";
+        ret.ok = false;
+    }
+    // the LT rows of the matrix must give back the data
+    for (uint16_t isi = 0; isi < params.K_padded; ++isi) {
+        if (precode.encode (ret.C, isi).row (0) !=
+                                            D.row (params.S + params.H + isi)) {
+            std::cout << "symbol " << isi << " does not encode back\n";
+            ret.ok = false;
+            break;
+        }
+    }
+    return ret;
+}
+
+static bool test (const uint16_t K, const uint16_t T, std::mt19937 &rnd)
+{
+    const RaptorQ::Impl::Parameters params (K);
+    DenseMtx D (params.L, T);
+    D.setZero();
+    // the first S + H rows are constraints, they stay zero.
+    for (uint16_t row = params.S + params.H; row < params.L; ++row) {
+        for (uint16_t col = 0; col < T; ++col)
+            D (row, col) = static_cast<uint8_t> (rnd());
+    }
+    const size_t table_rows = RaptorQ::Impl::phase2_m4ri_rows;
+    const Solved base = solve (params, D, table_rows, RaptorQ::Pivot::RFC);
+    const Solved always = solve (params, D, 0, RaptorQ::Pivot::RFC);
+    const Solved never = solve (params, D,
+                                        std::numeric_limits<size_t>::max(),
+                                        RaptorQ::Pivot::RFC);
+    // different pivots, different operations. Same result.
+    const Solved lookahead = solve (params, D, table_rows,
+                                                RaptorQ::Pivot::LOOKAHEAD);
+    if (!base.ok || !always.ok || !never.ok || !lookahead.ok) {
+        std::cout << "K=" << K << ": solver failed\n";
+        return false;
+    }
+    if (base.C != always.C || base.C != never.C || base.C != lookahead.C) {
+        std::cout << "K=" << K << ": intermediate symbols differ\n";
+        return false;
+    }
+    if (base.ops != always.ops || base.ops != never.ops) {
+        std::cout << "K=" << K << ": operations differ\n";
+        return false;
+    }
+    return true;
+}
+
+int main()
+{
+    std::mt19937 rnd (42);
+    // small ones have no full panel, the big ones have lots of table users
+    const uint16_t Ks[] = { 10, 26, 101, 500, 1002 };
+    bool ok = true;
+    for (const uint16_t K : Ks) {
+        for (const uint16_t T : { 1, 64, 333 })
+            ok = test (K, T, rnd) && ok;
+    }
+    if (!ok) {
+        std::cout << "Precode test FAILED\n";
+        return 1;
+    }
+    std::cout << "Precode test OK\n";
+    return 0;
+}
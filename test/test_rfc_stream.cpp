@@ -0,0 +1,482 @@
+/*
+ * Copyright (c) 2016-2017, Luca Fulchir<luca@fulchir.it>, All rights reserved.
+ *
+ * This file is part of "libRaptorQ".
+ *
+ * libRaptorQ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * libRaptorQ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * and a copy of the GNU Lesser General Public License
+ * along with libRaptorQ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Streaming RFC decoder:
+//  * blocks reach the sink in SBN order, whatever order the symbols come in
+//  * symbols beyond the "max_blocks" window get Error::OUT_OF_WINDOW,
+//    and are accepted once the stream gets there
+//  * symbols of blocks already streamed get Error::NOT_NEEDED
+// Batched packets:
+//  * encode_packets: payload IDs, 16-byte stride, ranges that cross from
+//    source to repair symbols, invalid ranges skipped, the 24-bit ESI limit
+//  * add_packets: packets of all blocks mixed together, bad and duplicated
+//    packets in the batch, the status of each packet
+// Streaming encoder:
+//  * blocks fed one at a time, nothing to encode before their data is there
+//  * a block is released once its repair budget is used up (or with free()),
+//    then it can not be encoded nor fed again
+
+#include "../src/RaptorQ/RFC6330_v1_hdr.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace RFC6330 = RFC6330__v1;
+
+using Enc = RFC6330::Encoder<uint8_t*, uint8_t*>;
+using Dec = RFC6330::Decoder<uint8_t*, uint8_t*>;
+
+static const uint16_t symbol_bytes = 256;
+static const uint8_t window = 2;
+
+struct Received
+{
+    std::vector<uint8_t> data;
+    size_t offset = 0;
+    uint16_t next = 0;
+    bool out_of_order = false;
+};
+
+static bool sink (void *user_data, const uint8_t sbn, const uint8_t *data,
+                                                            const size_t size)
+{
+    Received *rec = static_cast<Received*> (user_data);
+    if (sbn != rec->next || rec->offset + size > rec->data.size()) {
+        rec->out_of_order = true;
+        return false;
+    }
+    ++rec->next;
+    std::memcpy (rec->data.data() + rec->offset, data, size);
+    rec->offset += size;
+    return true;
+}
+
+static RFC6330::Error add (Enc &enc, Dec &dec, const uint8_t sbn,
+                                                        const uint32_t esi)
+{
+    std::vector<uint8_t> sym (symbol_bytes);
+    uint8_t *out = sym.data();
+    enc.encode (out, sym.data() + sym.size(), esi, sbn);
+    uint8_t *in = sym.data();
+    return dec.add_symbol (in, sym.data() + sym.size(), esi, sbn);
+}
+
+// all the source symbols, and enough repair symbols for the lost ones
+static bool add_block (Enc &enc, Dec &dec, const uint8_t sbn,
+                                                        const bool retry)
+{
+    const uint32_t K = enc.symbols (sbn);
+    for (uint32_t esi = 0; esi < K + K / 6 + 20; ++esi) {
+        if (esi % 7 == 3)
+            continue;
+        RFC6330::Error err;
+        while ((err = add (enc, dec, sbn, esi)) ==
+                                            RFC6330::Error::OUT_OF_WINDOW) {
+            if (!retry)
+                return false;
+            std::this_thread::sleep_for (std::chrono::microseconds (200));
+        }
+        if (err != RFC6330::Error::NONE && err != RFC6330::Error::NOT_NEEDED)
+            return false;
+    }
+    return true;
+}
+
+static bool test_window (Enc &enc, const std::vector<uint8_t> &input)
+{
+    Dec dec (enc.OTI_Common(), enc.OTI_Scheme_Specific());
+    Received rec;
+    rec.data.resize (input.size());
+    if (dec.stream (&sink, &rec, window) != RFC6330::Error::NONE)
+        return false;
+    dec.compute (RFC6330::Compute::NO_POOL).get();
+
+    // outside of the window: refused, with add_symbol and add_packets
+    if (add (enc, dec, window, 0) != RFC6330::Error::OUT_OF_WINDOW) {
+        std::cout << "symbol outside of the window accepted\n";
+        return false;
+    }
+    std::vector<uint8_t> raw (sizeof(uint32_t) + symbol_bytes, 0);
+    raw[0] = window + 1;
+    RFC6330::Packet packet = { raw.data(), raw.size() };
+    RFC6330::Error status = RFC6330::Error::NONE;
+    if (dec.add_packets (&packet, 1, &status) != 0 ||
+                                status != RFC6330::Error::OUT_OF_WINDOW) {
+        std::cout << "packet outside of the window accepted\n";
+        return false;
+    }
+    // complete the window out of order: nothing until block 0 is there
+    if (!add_block (enc, dec, 1, false) || rec.next != 0 ||
+                                        !add_block (enc, dec, 0, false) ||
+                                        rec.next != 2 || rec.out_of_order) {
+        std::cout << "window not streamed in order\n";
+        return false;
+    }
+    // the window moved: streamed blocks are not needed anymore
+    if (add (enc, dec, 0, 0) != RFC6330::Error::NOT_NEEDED ||
+                            add (enc, dec, window, 0) != RFC6330::Error::NONE) {
+        std::cout << "window did not move\n";
+        return false;
+    }
+    for (uint8_t sbn = window; sbn < enc.blocks(); ++sbn) {
+        if (!add_block (enc, dec, sbn, false))
+            return false;
+    }
+    return !rec.out_of_order && rec.offset == input.size() &&
+                                                        rec.data == input;
+}
+
+// sbn and esi of an RFC packet
+static void payload_id (const RFC6330::Packet &pkt, uint8_t &sbn,
+                                                                uint32_t &esi)
+{
+    const uint8_t *p = static_cast<const uint8_t*> (pkt.data);
+    sbn = p[0];
+    esi = (static_cast<uint32_t> (p[1]) << 16) |
+                                (static_cast<uint32_t> (p[2]) << 8) | p[3];
+}
+
+static bool test_encode_packets (Enc &enc, const std::vector<uint8_t> &input)
+{
+    const size_t stride = enc.packet_stride();
+    if (stride % 16 != 0 || stride < sizeof(uint32_t) + symbol_bytes ||
+                                stride >= sizeof(uint32_t) + symbol_bytes + 16) {
+        std::cout << "wrong packet stride: " << stride << "\n";
+        return false;
+    }
+    // per block: the source symbols but the last 5, then a range from
+    // there into the repair symbols. Invalid ranges in between.
+    std::vector<RFC6330::Packet_Range> ranges;
+    size_t expected = 0;
+    for (uint8_t sbn = 0; sbn < enc.blocks(); ++sbn) {
+        const uint32_t K = enc.symbols (sbn);
+        ranges.push_back ({0, K - 5, sbn});
+        ranges.push_back ({1u << 24, 3, sbn});
+        ranges.push_back ({0, 2, enc.blocks()});
+        ranges.push_back ({K - 5, 5 + K / 6 + 20, sbn});
+        expected += K + K / 6 + 20;
+    }
+    std::vector<uint8_t> buffer (expected * stride + stride - 1);
+    std::vector<RFC6330::Packet> packets (expected + 1);
+    if (enc.encode_packets (ranges.data(), ranges.size(), buffer.data(),
+                        buffer.size(), packets.data(), packets.size()) !=
+                                                                    expected) {
+        std::cout << "encode_packets: wrong packet count\n";
+        return false;
+    }
+    std::vector<uint8_t> sym (symbol_bytes);
+    uint8_t next_sbn = 0;
+    uint32_t next_esi = 0;
+    for (size_t idx = 0; idx < expected; ++idx) {
+        uint8_t sbn;
+        uint32_t esi;
+        payload_id (packets[idx], sbn, esi);
+        const uint32_t K = enc.symbols (next_sbn);
+        if (next_esi == K + K / 6 + 20) {
+            ++next_sbn;
+            next_esi = 0;
+        }
+        uint8_t *out = sym.data();
+        enc.encode (out, sym.data() + sym.size(), esi, sbn);
+        if (packets[idx].data != buffer.data() + idx * stride ||
+                    packets[idx].size != sizeof(uint32_t) + symbol_bytes ||
+                    sbn != next_sbn || esi != next_esi ||
+                    std::memcmp (static_cast<uint8_t*> (packets[idx].data) +
+                            sizeof(uint32_t), sym.data(), sym.size()) != 0) {
+            std::cout << "encode_packets: wrong packet " << idx << "\n";
+            return false;
+        }
+        ++next_esi;
+    }
+
+    // lose some source symbols, the repair symbols make up for them
+    std::vector<RFC6330::Packet> kept;
+    for (size_t idx = 0; idx < expected; ++idx) {
+        uint8_t sbn;
+        uint32_t esi;
+        payload_id (packets[idx], sbn, esi);
+        if (esi >= enc.symbols (sbn) || esi % 7 != 3)
+            kept.push_back (packets[idx]);
+    }
+    Dec dec (enc.OTI_Common(), enc.OTI_Scheme_Specific());
+    auto res = dec.compute (RFC6330::Compute::COMPLETE);
+    dec.add_packets (kept.data(), kept.size(), nullptr);
+    std::vector<uint8_t> output (input.size());
+    uint8_t *out = output.data();
+    if (res.get().first != RFC6330::Error::NONE ||
+                dec.decode_bytes (out, output.data() + output.size(), 0) !=
+                                    input.size() || output != input) {
+        std::cout << "encode_packets: could not decode\n";
+        return false;
+    }
+
+    // the ESI stops at 24 bits
+    const RFC6330::Packet_Range last = {(1u << 24) - 2, 10, 0};
+    if (enc.encode_packets (&last, 1, buffer.data(), buffer.size(),
+                                    packets.data(), packets.size()) != 2) {
+        std::cout << "encode_packets: ESI past 24 bits\n";
+        return false;
+    }
+    for (uint32_t idx = 0; idx < 2; ++idx) {
+        uint8_t sbn;
+        uint32_t esi;
+        payload_id (packets[idx], sbn, esi);
+        if (sbn != 0 || esi != (1u << 24) - 2 + idx)
+            return false;
+    }
+    // a short buffer only gets the packets that fit whole
+    if (enc.encode_packets (ranges.data(), 1, buffer.data(), 3 * stride - 1,
+                                    packets.data(), packets.size()) != 2) {
+        std::cout << "encode_packets: short buffer\n";
+        return false;
+    }
+    return true;
+}
+
+// RFC packet with "symbols" symbols from "esi"
+static std::vector<uint8_t> make_packet (Enc &enc, const uint8_t sbn,
+                                    const uint32_t esi, const uint32_t symbols)
+{
+    std::vector<uint8_t> pkt (sizeof(uint32_t) + symbols * symbol_bytes);
+    pkt[0] = sbn;
+    pkt[1] = static_cast<uint8_t> (esi >> 16);
+    pkt[2] = static_cast<uint8_t> (esi >> 8);
+    pkt[3] = static_cast<uint8_t> (esi);
+    uint8_t *out = pkt.data() + sizeof(uint32_t);
+    for (uint32_t idx = 0; idx < symbols; ++idx)
+        enc.encode (out, pkt.data() + pkt.size(), esi + idx, sbn);
+    return pkt;
+}
+
+static bool test_add_packets (Enc &enc, const std::vector<uint8_t> &input,
+                                                            std::mt19937 &rnd)
+{
+    // the packets of add_block, one in every 10 with two symbols,
+    // then shuffled so that the blocks are mixed
+    std::vector<std::vector<uint8_t>> raw;
+    for (uint8_t sbn = 0; sbn < enc.blocks(); ++sbn) {
+        const uint32_t K = enc.symbols (sbn);
+        for (uint32_t esi = 0; esi < K + K / 6 + 20; ++esi) {
+            if (esi % 7 == 3)
+                continue;
+            const bool two = esi % 10 == 0 && (esi + 1) % 7 != 3;
+            raw.push_back (make_packet (enc, sbn, esi, two ? 2 : 1));
+            if (two)
+                ++esi;
+        }
+    }
+    std::shuffle (raw.begin(), raw.end(), rnd);
+    const size_t good = raw.size();
+    // bad: no symbol, sbn out of range. Then a copy of the first packet.
+    raw.push_back (std::vector<uint8_t> (sizeof(uint32_t) + 3, 0));
+    raw.push_back (make_packet (enc, 0, 0, 1));
+    raw.back()[0] = enc.blocks();
+    raw.push_back (raw[0]);
+    std::vector<RFC6330::Packet> packets;
+    for (auto &pkt : raw)
+        packets.push_back ({pkt.data(), pkt.size()});
+
+    Dec dec (enc.OTI_Common(), enc.OTI_Scheme_Specific());
+    auto res = dec.compute (RFC6330::Compute::COMPLETE);
+    std::vector<RFC6330::Error> status (packets.size(),
+                                                RFC6330::Error::INITIALIZATION);
+    if (dec.add_packets (packets.data(), packets.size(), status.data()) !=
+                                                                        good) {
+        std::cout << "add_packets: wrong useful count\n";
+        return false;
+    }
+    for (size_t idx = 0; idx < good; ++idx) {
+        if (status[idx] != RFC6330::Error::NONE) {
+            std::cout << "add_packets: packet " << idx << " refused\n";
+            return false;
+        }
+    }
+    if (status[good] != RFC6330::Error::WRONG_INPUT ||
+                            status[good + 1] != RFC6330::Error::WRONG_INPUT ||
+                            status[good + 2] != RFC6330::Error::NOT_NEEDED) {
+        std::cout << "add_packets: bad packets not reported\n";
+        return false;
+    }
+    std::vector<uint8_t> output (input.size());
+    uint8_t *out = output.data();
+    if (res.get().first != RFC6330::Error::NONE ||
+                dec.decode_bytes (out, output.data() + output.size(), 0) !=
+                                    input.size() || output != input) {
+        std::cout << "add_packets: could not decode\n";
+        return false;
+    }
+    return true;
+}
+
+// feed the blocks one at a time, each one with a repair budget just big
+// enough for the lost source symbols. The last one is freed by hand.
+static bool test_stream_encoder (const std::vector<uint8_t> &input,
+                                                const uint16_t min_subsymbol,
+                                                const size_t max_sub_block)
+{
+    std::vector<uint8_t> data (input);
+    Enc enc (data.size(), min_subsymbol, symbol_bytes, max_sub_block);
+    enc.compute (RFC6330::Compute::NO_POOL).get();
+    Dec dec (enc.OTI_Common(), enc.OTI_Scheme_Specific());
+    auto res = dec.compute (RFC6330::Compute::COMPLETE);
+
+    std::vector<uint8_t> sym (symbol_bytes);
+    uint8_t *const sym_end = sym.data() + sym.size();
+    uint8_t *out;
+    size_t offset = 0;
+    for (uint8_t sbn = 0; sbn < enc.blocks(); ++sbn) {
+        const uint32_t K = enc.symbols (sbn);
+        const bool last = sbn == enc.blocks() - 1;
+        const uint32_t budget = last ? 0 : K / 6 + 20;
+        const size_t bytes = std::min<size_t> (enc.block_size (sbn),
+                                                        data.size() - offset);
+        uint8_t *from = data.data() + offset;
+        out = sym.data();
+        if (enc.encode (out, sym_end, 0, sbn) != 0) {
+            std::cout << "stream encoder: block " << int(sbn) <<
+                                                    " encoded before feed\n";
+            return false;
+        }
+        if (enc.feed (sbn, from, from + bytes - 1, budget) !=
+                                            RFC6330::Error::WRONG_INPUT ||
+                enc.feed (sbn, from, from + bytes, budget) !=
+                                                    RFC6330::Error::NONE ||
+                enc.feed (sbn, from, from + bytes, budget) !=
+                                                RFC6330::Error::NOT_NEEDED) {
+            std::cout << "stream encoder: feed of block " << int(sbn) << "\n";
+            return false;
+        }
+        for (uint32_t esi = 0; esi < K + K / 6 + 20; ++esi) {
+            if (esi < K && esi % 7 == 3)
+                continue;
+            out = sym.data();
+            if (enc.encode (out, sym_end, esi, sbn) == 0) {
+                std::cout << "stream encoder: block " << int(sbn) <<
+                                                " esi " << esi << " missing\n";
+                return false;
+            }
+            uint8_t *in = sym.data();
+            const auto err = dec.add_symbol (in, sym_end, esi, sbn);
+            if (err != RFC6330::Error::NONE &&
+                                        err != RFC6330::Error::NOT_NEEDED) {
+                return false;
+            }
+        }
+        if (last)
+            enc.free (sbn);
+        out = sym.data();
+        if (enc.encode (out, sym_end, 0, sbn) != 0 ||
+                            enc.encode (out, sym_end, K + budget, sbn) != 0 ||
+                            enc.feed (sbn, from, from + bytes, budget) !=
+                                                RFC6330::Error::NOT_NEEDED) {
+            std::cout << "stream encoder: block " << int(sbn) <<
+                                                        " not released\n";
+            return false;
+        }
+        offset += bytes;
+    }
+    std::vector<uint8_t> output (input.size());
+    out = output.data();
+    if (res.get().first != RFC6330::Error::NONE ||
+                dec.decode_bytes (out, output.data() + output.size(), 0) !=
+                                    input.size() || output != input) {
+        std::cout << "stream encoder: could not decode\n";
+        return false;
+    }
+    return true;
+}
+
+// symbols of all blocks from many threads at once
+static bool test_threads (Enc &enc, const std::vector<uint8_t> &input,
+                                                            const bool pool)
+{
+    Dec dec (enc.OTI_Common(), enc.OTI_Scheme_Specific());
+    Received rec;
+    rec.data.resize (input.size());
+    if (dec.stream (&sink, &rec, window) != RFC6330::Error::NONE)
+        return false;
+    std::future<std::pair<RFC6330::Error, uint8_t>> res;
+    if (pool) {
+        res = dec.compute (RFC6330::Compute::COMPLETE);
+    } else {
+        dec.compute (RFC6330::Compute::NO_POOL).get();
+    }
+    const uint8_t threads = 3;
+    std::vector<std::thread> workers;
+    std::vector<uint8_t> ok (threads, 0);
+    for (uint8_t th = 0; th < threads; ++th) {
+        workers.emplace_back ([&, th]() {
+            bool all = true;
+            for (uint16_t sbn = th; sbn < enc.blocks(); sbn += threads)
+                all = add_block (enc, dec, static_cast<uint8_t> (sbn), true) &&
+                                                                        all;
+            ok[th] = all ? 1 : 0;
+        });
+    }
+    for (auto &th : workers)
+        th.join();
+    if (pool && res.get().first != RFC6330::Error::NONE)
+        return false;
+    for (const uint8_t th_ok : ok) {
+        if (th_ok == 0)
+            return false;
+    }
+    return !rec.out_of_order && rec.offset == input.size() &&
+                                            rec.data == input && dec.is_ready();
+}
+
+int main()
+{
+    std::mt19937 rnd (9);
+    bool ok = true;
+    for (uint32_t iter = 0; ok && iter < 4; ++iter) {
+        std::vector<uint8_t> input (300000 + rnd() % 300000);
+        for (auto &byte : input)
+            byte = static_cast<uint8_t> (rnd());
+        // sub-blocks: interleaved blocks go through a buffer
+        const bool sub_blocks = iter % 2 != 0;
+        const uint16_t min_subsymbol = sub_blocks ? 16 : symbol_bytes;
+        const size_t max_sub_block = sub_blocks ? 5000 : 40000;
+        Enc enc (input.data(), input.data() + input.size(), min_subsymbol,
+                                            symbol_bytes, max_sub_block);
+        enc.compute (RFC6330::Compute::COMPLETE |
+                                    RFC6330::Compute::NO_BACKGROUND).get();
+        if (enc.blocks() <= window + 1) {
+            std::cout << "not enough blocks\n";
+            return 1;
+        }
+        ok = test_window (enc, input) && test_threads (enc, input, false) &&
+                                        test_threads (enc, input, true) &&
+                                        test_encode_packets (enc, input) &&
+                                        test_add_packets (enc, input, rnd) &&
+                                        test_stream_encoder (input,
+                                                min_subsymbol, max_sub_block);
+    }
+    if (!ok) {
+        std::cout << "RFC stream test FAILED\n";
+        return 1;
+    }
+    std::cout << "RFC stream test OK\n";
+    return 0;
+}
@@ -0,0 +1,278 @@
+/*
+ * Copyright (c) 2016-2017, Luca Fulchir<luca@fulchir.it>, All rights reserved.
+ *
+ * This file is part of "libRaptorQ".
+ *
+ * libRaptorQ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * libRaptorQ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * and a copy of the GNU Lesser General Public License
+ * along with libRaptorQ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// The shared cache between processes:
+//  * one process creates the segment and publishes the operations,
+//    another attaches and decodes with them
+//  * corrupted operations in the segment must be rejected, not replayed
+//  * a segment left uninitialized by a dead process must be replaced
+
+#include "../src/RaptorQ/RaptorQ_v1_hdr.hpp"
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace RaptorQ = RaptorQ__v1;
+
+static const size_t test_segment_size = 4 * 1024 * 1024;
+static const size_t test_symbol_size = 64;
+static const RaptorQ::Block_Size block = RaptorQ::Block_Size::Block_101;
+
+// entries published in the segment
+static uint32_t published (const std::string &path)
+{
+    const int fd = open (path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return 0;
+    void *mem = mmap (nullptr, sizeof(RaptorQ::Impl::Shm_Header), PROT_READ,
+                                                            MAP_SHARED, fd, 0);
+    close (fd);
+    if (mem == MAP_FAILED)
+        return 0;
+    const auto *head = static_cast<const RaptorQ::Impl::Shm_Header*> (mem);
+    const uint32_t ret = head->magic.load() == RaptorQ::Impl::shm_magic ?
+                                                    head->entries.load() : 0;
+    munmap (mem, sizeof(RaptorQ::Impl::Shm_Header));
+    return ret;
+}
+
+// encode and decode the same block, with the same lost symbols, every time.
+// "hit": the decoder used the cached operations
+static bool decode_block (bool &hit)
+{
+    const uint16_t K = static_cast<uint16_t> (block);
+    std::mt19937 rnd (42);
+    std::vector<uint8_t> input (K * test_symbol_size);
+    for (auto &byte : input)
+        byte = static_cast<uint8_t> (rnd());
+
+    RaptorQ::Encoder<uint8_t*, uint8_t*> enc (block, test_symbol_size);
+    RaptorQ::Decoder<uint8_t*, uint8_t*> dec (block, test_symbol_size,
+                                    RaptorQ::Decoder<uint8_t*, uint8_t*>::
+                                                            Report::COMPLETE);
+    if (enc.set_data (input.data(), input.data() + input.size()) !=
+                                            input.size() || !enc.compute_sync())
+        return false;
+    std::vector<uint8_t> sym (test_symbol_size);
+    // lose every 10th source symbol, send as many repair symbols
+    for (uint32_t esi = 0; esi < K + K / 10u + 2; ++esi) {
+        if (esi < K && esi % 10 == 0)
+            continue;
+        uint8_t *out = sym.data();
+        if (enc.encode (out, sym.data() + sym.size(), esi) != test_symbol_size)
+            return false;
+        uint8_t *in = sym.data();
+        dec.add_symbol (in, sym.data() + sym.size(), esi);
+    }
+    if (dec.decode_once() != RaptorQ::Decoder_Result::DECODED)
+        return false;
+    hit = dec.stats().cache_hit != 0;
+    std::vector<uint8_t> output (input.size());
+    uint8_t *out = output.data();
+    const auto res = dec.decode_bytes (out, output.data() + output.size(),
+                                                                        0, 0);
+    return res.written == output.size() && output == input;
+}
+
+// run "fun" in a child process. true if the child returned 0
+template <typename Fun>
+static bool in_child (Fun fun)
+{
+    const pid_t pid = fork();
+    if (pid == 0)
+        _exit (fun() ? 0 : 1);
+    int status;
+    return pid > 0 && waitpid (pid, &status, 0) == pid &&
+                                WIFEXITED (status) && WEXITSTATUS (status) == 0;
+}
+
+// call "fun" on every entry of the segment, with its data
+template <typename Fun>
+static bool for_each_entry (const std::string &path, Fun fun)
+{
+    const int fd = open (path.c_str(), O_RDWR);
+    if (fd < 0)
+        return false;
+    void *mem = mmap (nullptr, test_segment_size, PROT_READ | PROT_WRITE,
+                                                            MAP_SHARED, fd, 0);
+    close (fd);
+    if (mem == MAP_FAILED)
+        return false;
+    using namespace RaptorQ::Impl;
+    uint8_t *raw = static_cast<uint8_t*> (mem);
+    const Shm_Header *head = reinterpret_cast<const Shm_Header*> (raw);
+    uint64_t offset = (sizeof(Shm_Header) + head->buckets *
+                        sizeof(std::atomic<uint64_t>) + 7) & ~uint64_t (7);
+    while (offset < head->used.load()) {
+        const Shm_Entry *entry = reinterpret_cast<const Shm_Entry*> (
+                                                                raw + offset);
+        fun (*entry, raw + offset + sizeof(Shm_Entry) + entry->key_size);
+        offset += (sizeof(Shm_Entry) + entry->key_size + entry->data_size +
+                                                        7) & ~uint64_t (7);
+    }
+    munmap (mem, test_segment_size);
+    return true;
+}
+
+static uint32_t compressed_entries (const std::string &path)
+{
+    uint32_t ret = 0;
+    for_each_entry (path, [&](const RaptorQ::Impl::Shm_Entry &entry,
+                                                                uint8_t*) {
+        if (entry.algorithm != static_cast<uint8_t> (RaptorQ::Compress::NONE))
+            ++ret;
+    });
+    return ret;
+}
+
+static bool test_two_processes (const std::string &path,
+                                            const RaptorQ::Compress compression)
+{
+    unlink (path.c_str());
+    // first process: creates the segment, computes, publishes
+    const bool creator = in_child ([&]() {
+        if (!RaptorQ::set_compression (compression) ||
+                !RaptorQ::shared_cache_attach (path, test_segment_size)) {
+            return false;
+        }
+        bool hit = true;
+        if (!decode_block (hit) || hit)
+            return false;
+        // the operations are saved in the background
+        for (uint32_t wait = 0; wait < 500 && published (path) < 2; ++wait)
+            std::this_thread::sleep_for (std::chrono::milliseconds (10));
+        return published (path) >= 2;
+    });
+    if (!creator) {
+        std::cout << "creator failed\n";
+        return false;
+    }
+    // second process: attaches and uses the published operations
+    const bool user = in_child ([&]() {
+        if (!RaptorQ::set_compression (compression) ||
+                !RaptorQ::shared_cache_attach (path, test_segment_size)) {
+            return false;
+        }
+        bool hit = false;
+        return decode_block (hit) && hit;
+    });
+    if (!user) {
+        std::cout << "attached process did not use the cache\n";
+        return false;
+    }
+    // compressed entries are decompressed straight from the segment
+    if (compression != RaptorQ::Compress::NONE &&
+                                            compressed_entries (path) == 0) {
+        std::cout << "nothing was compressed\n";
+        return false;
+    }
+    return true;
+}
+
+static bool test_corrupted (const std::string &path)
+{
+    // operations of test_two_processes, uncompressed:
+    // point all the records outside of the matrix.
+    using RaptorQ::Impl::Op_Rec;
+    uint32_t corrupted = 0;
+    for_each_entry (path, [&](const RaptorQ::Impl::Shm_Entry &entry,
+                                                            uint8_t *data) {
+        uint32_t records;
+        std::memcpy (&records, data, sizeof(records));
+        if (entry.algorithm != static_cast<uint8_t> (RaptorQ::Compress::NONE)
+                    || 3 * sizeof(uint32_t) + records * sizeof(Op_Rec) >
+                                                            entry.data_size) {
+            return;
+        }
+        Op_Rec *rec = reinterpret_cast<Op_Rec*> (data + 3 * sizeof(uint32_t));
+        for (uint32_t idx = 0; idx < records; ++idx)
+            rec[idx].row_1 = 0xfff0;
+        ++corrupted;
+    });
+    if (corrupted == 0) {
+        std::cout << "nothing to corrupt\n";
+        return false;
+    }
+    const bool ok = in_child ([&]() {
+        if (!RaptorQ::shared_cache_attach (path, test_segment_size))
+            return false;
+        bool hit = true;
+        return decode_block (hit) && !hit;
+    });
+    if (!ok)
+        std::cout << "corrupted operations were not rejected\n";
+    return ok;
+}
+
+static bool test_stale (const std::string &path)
+{
+    // what a creator that died right after creating the file leaves
+    unlink (path.c_str());
+    const int fd = open (path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0)
+        return false;
+    close (fd);
+    const bool ok = in_child ([&]() {
+        if (!RaptorQ::shared_cache_attach (path, test_segment_size))
+            return false;
+        bool hit = true;
+        if (!decode_block (hit))
+            return false;
+        for (uint32_t wait = 0; wait < 500 && published (path) < 2; ++wait)
+            std::this_thread::sleep_for (std::chrono::milliseconds (10));
+        return published (path) >= 2;
+    });
+    struct stat info;
+    if (!ok || stat (path.c_str(), &info) != 0 ||
+                    static_cast<size_t> (info.st_size) != test_segment_size) {
+        std::cout << "stale segment was not replaced\n";
+        return false;
+    }
+    return true;
+}
+
+int main()
+{
+    const std::string dir = access ("/dev/shm", W_OK) == 0 ? "/dev/shm" :
+                                                                    "/tmp";
+    const std::string path = dir + "/rq_test_shared_cache." +
+                                                    std::to_string (getpid());
+    bool ok = true;
+    ok = ok && test_two_processes (path, RaptorQ::Compress::NONE);
+    ok = ok && test_corrupted (path);
+    ok = ok && test_two_processes (path, RaptorQ::Compress::SPARSE);
+    ok = ok && test_stale (path);
+    unlink (path.c_str());
+    if (!ok) {
+        std::cout << "Shared cache test FAILED\n";
+        return 1;
+    }
+    std::cout << "Shared cache test OK\n";
+    return 0;
+}